@@ -117,6 +117,16 @@ uint3 GetPrimitive(MeshData mesh, uint primitiveIndex)
 	return indices;
 }
 
+uint LoadMeshletVertex(MeshData mesh, uint index)
+{
+	if(mesh.MeshletVertexByteSize == 4)
+		return ByteBufferLoad<uint>(mesh.BufferIndex, index, mesh.MeshletVertexOffset);
+
+	uint byteOffset = index * 2;
+	uint two16BitIndices = ByteBufferLoad<uint>(mesh.BufferIndex, 0, mesh.MeshletVertexOffset + (byteOffset & ~3));
+	return (byteOffset & 2) ? two16BitIndices >> 16 : two16BitIndices & 0xffff;
+}
+
 struct Vertex
 {
 	float3 Position;
@@ -129,7 +139,10 @@ struct Vertex
 Vertex LoadVertex(MeshData mesh, uint vertexId)
 {
 	Vertex vertex;
-	vertex.Position = ByteBufferLoad<float3>(mesh.BufferIndex, vertexId, mesh.PositionsOffset);
+	if(mesh.PositionsQuantized)
+		vertex.Position = mesh.PositionsCenter + RGBA16_SNORM::Unpack(ByteBufferLoad<uint2>(mesh.BufferIndex, vertexId, mesh.PositionsOffset)).xyz * mesh.PositionsExtents;
+	else
+		vertex.Position = ByteBufferLoad<float3>(mesh.BufferIndex, vertexId, mesh.PositionsOffset);
 	vertex.UV = RG16_FLOAT::Unpack(ByteBufferLoad<uint>(mesh.BufferIndex, vertexId, mesh.UVsOffset));
 
 	uint2 normalData = ByteBufferLoad<uint2>(mesh.BufferIndex, vertexId, mesh.NormalsOffset);
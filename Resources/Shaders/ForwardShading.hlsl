@@ -184,7 +184,7 @@ void MSMain(
 
 	for(uint i = groupThreadID; i < meshlet.VertexCount; i += NUM_MESHLET_THREADS)
 	{
-		uint vertexId = ByteBufferLoad<uint>(mesh.BufferIndex, i + meshlet.VertexOffset, mesh.MeshletVertexOffset);
+		uint vertexId = LoadMeshletVertex(mesh, i + meshlet.VertexOffset);
 		InterpolantsVSToPS result = LoadVertex(mesh, instance.LocalToWorld, vertexId);
 		verts[i] = result;
 	}
@@ -53,6 +53,12 @@ struct MeshData
 	uint MeshletTriangleOffset;
 	uint MeshletBoundsOffset;
 	uint MeshletCount;
+	uint MeshletVertexByteSize;
+
+	// When set, positions are RGBA16_SNORM relative to the box: position = PositionsCenter + value * PositionsExtents
+	uint PositionsQuantized;
+	float3 PositionsCenter;
+	float3 PositionsExtents;
 };
 
 struct Meshlet
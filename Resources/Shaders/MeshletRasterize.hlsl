@@ -83,7 +83,7 @@ VertexAttribute FetchVertexAttributes(MeshData mesh, float4x4 world, uint vertex
 
 	for(uint i = groupThreadID; i < meshlet.VertexCount; i += NUM_MESHLET_THREADS)
 	{
-		uint vertexId = ByteBufferLoad<uint>(mesh.BufferIndex, i + meshlet.VertexOffset, mesh.MeshletVertexOffset);
+		uint vertexId = LoadMeshletVertex(mesh, i + meshlet.VertexOffset);
 		VertexAttribute result = FetchVertexAttributes(mesh, instance.LocalToWorld, vertexId);
 		verts[i] = result;
 	}
@@ -133,9 +133,9 @@ void RasterizeCS(uint groupThreadID : SV_GroupIndex, uint groupID : SV_GroupID)
 		Meshlet::Triangle tri = ByteBufferLoad<Meshlet::Triangle>(mesh.BufferIndex, i + meshlet.TriangleOffset, mesh.MeshletTriangleOffset);
 
 		uint3 indices = uint3(
-			ByteBufferLoad<uint>(mesh.BufferIndex, tri.V0 + meshlet.VertexOffset, mesh.MeshletVertexOffset),
-			ByteBufferLoad<uint>(mesh.BufferIndex, tri.V1 + meshlet.VertexOffset, mesh.MeshletVertexOffset),
-			ByteBufferLoad<uint>(mesh.BufferIndex, tri.V2 + meshlet.VertexOffset, mesh.MeshletVertexOffset)
+			LoadMeshletVertex(mesh, tri.V0 + meshlet.VertexOffset),
+			LoadMeshletVertex(mesh, tri.V1 + meshlet.VertexOffset),
+			LoadMeshletVertex(mesh, tri.V2 + meshlet.VertexOffset)
 		);
 
 		float3 p0 = LoadVertex(mesh, indices[0]).Position;
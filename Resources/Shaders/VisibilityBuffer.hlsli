@@ -96,9 +96,9 @@ VisBufferVertexAttribute GetVertexAttributes(float2 screenUV, InstanceData insta
 	Meshlet::Triangle tri = ByteBufferLoad<Meshlet::Triangle>(mesh.BufferIndex, primitiveID + meshlet.TriangleOffset, mesh.MeshletTriangleOffset);
 
 	uint3 indices = uint3(
-		ByteBufferLoad<uint>(mesh.BufferIndex, tri.V0 + meshlet.VertexOffset, mesh.MeshletVertexOffset),
-		ByteBufferLoad<uint>(mesh.BufferIndex, tri.V1 + meshlet.VertexOffset, mesh.MeshletVertexOffset),
-		ByteBufferLoad<uint>(mesh.BufferIndex, tri.V2 + meshlet.VertexOffset, mesh.MeshletVertexOffset)
+		LoadMeshletVertex(mesh, tri.V0 + meshlet.VertexOffset),
+		LoadMeshletVertex(mesh, tri.V1 + meshlet.VertexOffset),
+		LoadMeshletVertex(mesh, tri.V2 + meshlet.VertexOffset)
 	);
 
 	Vertex vertices[3];
@@ -12,6 +12,7 @@
 #include "RHI/Device.h"
 #include "RHI/CommandQueue.h"
 #include "RHI/CommandContext.h"
+#include "RHI/Texture.h"
 
 #include "Renderer/RenderTypes.h"
 #include "Renderer/Techniques/ImGuiRenderer.h"
@@ -78,8 +79,17 @@ static SuperluminalAPI sSuperluminal;
 int App::Run()
 {
 	Init_Internal();
+
+	// Optionally stop after a fixed number of frames, for benchmarking
+	int maxFrames = 0;
+	CommandLine::GetInt("frames", maxFrames);
+
+	uint32 frameIndex = 0;
 	while (m_Window.PollMessages())
 	{
+		if (maxFrames > 0 && frameIndex++ >= (uint32)maxFrames)
+			break;
+
 		PROFILE_FRAME();
 
 		Update_Internal();
@@ -119,13 +129,17 @@ static void InitializeProfiler(GraphicsDevice* pDevice)
 		};
 	gCPUProfiler.SetEventCallback(cpuCallbacks);
 
-	ID3D12CommandQueue* pQueues[] =
+	// GPU timestamps are never resolved on the null device
+	if (!pDevice->IsNullDevice())
 	{
-		pDevice->GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT)->GetCommandQueue(),
-		pDevice->GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COMPUTE)->GetCommandQueue(),
-		pDevice->GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COPY)->GetCommandQueue(),
-	};
-	gGPUProfiler.Initialize(pDevice->GetDevice(), pQueues, frameHistory, 3, maxGPUEvents, maxGPUCopyEvents, maxGPUActiveCmdLists);
+		ID3D12CommandQueue* pQueues[] =
+		{
+			pDevice->GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT)->GetCommandQueue(),
+			pDevice->GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COMPUTE)->GetCommandQueue(),
+			pDevice->GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COPY)->GetCommandQueue(),
+		};
+		gGPUProfiler.Initialize(pDevice->GetDevice(), pQueues, frameHistory, 3, maxGPUEvents, maxGPUCopyEvents, maxGPUActiveCmdLists);
+	}
 
 #if ENABLE_PIX
 	GPUProfilerCallbacks gpuCallbacks;
@@ -135,6 +149,15 @@ static void InitializeProfiler(GraphicsDevice* pDevice)
 #endif
 
 	PROFILE_REGISTER_THREAD("Main Thread");
+
+	// Stream a trace of the profiler to disk, for example "-trace=Saved/Trace.json -traceframes=1000"
+	const char* pTracePath = nullptr;
+	if (CommandLine::GetValue("trace", &pTracePath))
+	{
+		int traceFrames = 0;
+		CommandLine::GetInt("traceframes", traceFrames);
+		ProfilerExport::BeginStreaming(pTracePath, (uint32)Math::Max(traceFrames, 0));
+	}
 }
 
 void App::Init_Internal()
@@ -160,6 +183,18 @@ void App::Init_Internal()
 	Console::Initialize();
 	ConsoleManager::Initialize();
 
+	// Compare two profiler stats summaries and exit. Used to detect performance regressions in CI.
+	const char* pStatsBaseline = nullptr;
+	const char* pStatsCurrent = nullptr;
+	if (CommandLine::GetValue("statsbaseline", &pStatsBaseline) && CommandLine::GetValue("statscurrent", &pStatsCurrent))
+	{
+		const char* pThreshold = nullptr;
+		float threshold = CommandLine::GetValue("statsthreshold", &pThreshold) ? strtof(pThreshold, nullptr) : 10.0f;
+		int numFailures = ProfilerStats::CompareSummaries(pStatsBaseline, pStatsCurrent, threshold, CommandLine::GetBool("statsfailmissing"));
+		Console::Shutdown();
+		::ExitProcess(numFailures == 0 ? 0 : 1);
+	}
+
 	TaskQueue::Initialize(std::thread::hardware_concurrency());
 
 	Vector2i displayDimensions = Window::GetDisplaySize();
@@ -183,11 +218,20 @@ void App::Init_Internal()
 	options.UseGPUValidation	= CommandLine::GetBool("gpuvalidation");
 	options.UseWarp				= CommandLine::GetBool("warp");
 	options.UseStablePowerState = CommandLine::GetBool("stablepowerstate");
+	options.UseNullDevice		= CommandLine::GetBool("nulldevice");
 	m_pDevice = new GraphicsDevice(options);
 
 	InitializeProfiler(m_pDevice);
 
-	m_pSwapchain = new SwapChain(m_pDevice, DisplayMode::SDR, 3, m_Window.GetNativeWindow());
+	if (m_pDevice->IsNullDevice())
+	{
+		Vector2i size = m_Window.GetRect();
+		m_pHeadlessTarget = m_pDevice->CreateTexture(TextureDesc::Create2D(Math::Max(size.x, 1), Math::Max(size.y, 1), ResourceFormat::RGBA8_UNORM, 1, TextureFlag::RenderTarget), "Headless Target");
+	}
+	else
+	{
+		m_pSwapchain = new SwapChain(m_pDevice, DisplayMode::SDR, 3, m_Window.GetNativeWindow());
+	}
 
 	GraphicsCommon::Create(m_pDevice);
 
@@ -207,11 +251,12 @@ void App::Update_Internal()
 	{
 		PROFILE_CPU_SCOPE("Execute Commandlist");
 		CommandContext* pContext = m_pDevice->AllocateCommandContext();
-		ImGuiRenderer::Render(*pContext, m_pSwapchain->GetBackBuffer());
-		pContext->InsertResourceBarrier(m_pSwapchain->GetBackBuffer(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+		ImGuiRenderer::Render(*pContext, GetBackBuffer());
+		pContext->InsertResourceBarrier(GetBackBuffer(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
 		pContext->Execute();
 	}
 
+	if (m_pSwapchain)
 	{
 		PROFILE_CPU_SCOPE("Present");
 		m_pSwapchain->Present();
@@ -228,6 +273,12 @@ void App::Shutdown_Internal()
 	Shutdown();
 
 	m_pDevice->IdleGPU();
+	ProfilerExport::EndStreaming();
+
+	const char* pStatsSummary = nullptr;
+	if (CommandLine::GetValue("statssummary", &pStatsSummary))
+		ProfilerStats::WriteSummary(pStatsSummary);
+
 	gGPUProfiler.Shutdown();
 	gCPUProfiler.Shutdown();
 
@@ -241,5 +292,11 @@ void App::Shutdown_Internal()
 void App::OnWindowResizeOrMove(uint32 width, uint32 height)
 {
 	E_LOG(Info, "Window resized: %dx%d", width, height);
-	m_pSwapchain->OnResizeOrMove(width, height);
+	if (m_pSwapchain)
+		m_pSwapchain->OnResizeOrMove(width, height);
+}
+
+Texture* App::GetBackBuffer() const
+{
+	return m_pSwapchain ? m_pSwapchain->GetBackBuffer() : m_pHeadlessTarget.Get();
 }
@@ -16,7 +16,8 @@ protected:
 
 protected:
 	Ref<GraphicsDevice> m_pDevice;
-	Ref<SwapChain> m_pSwapchain;
+	Ref<SwapChain> m_pSwapchain;			///< Null when running on the null device
+	Ref<Texture> m_pHeadlessTarget;			///< Replaces the swapchain backbuffer on the null device
 	Window m_Window;
 
 private:
@@ -24,6 +25,7 @@ private:
 	void Update_Internal();
 	void Shutdown_Internal();
 	void OnWindowResizeOrMove(uint32 width, uint32 height);
+	Texture* GetBackBuffer() const;
 };
 
 #define DECLARE_MAIN(app_class) \
@@ -0,0 +1,16 @@
+#include "stdafx.h"
+#include "Benchmark.h"
+
+namespace Benchmark
+{
+	bool Report(const Context& context)
+	{
+		if (context.GetNumFailed() > 0)
+		{
+			E_LOG(Warning, "%s: %d of %d checks failed", context.GetName(), context.GetNumFailed(), context.GetNumChecks());
+			return false;
+		}
+		E_LOG(Info, "%s: all %d checks passed", context.GetName(), context.GetNumChecks());
+		return true;
+	}
+}
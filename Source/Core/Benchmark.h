@@ -0,0 +1,80 @@
+#pragma once
+#include "Core/ConsoleVariables.h"
+
+/*
+	Shared harness of the "bench.*" console commands.
+
+	A benchmark logs its measurements and verifies its outputs with Context::Check.
+	Failed checks log a warning and every run ends with a line that says whether all checks passed,
+	so a benchmark that got faster by computing the wrong result is caught in the same log.
+
+	Usage:
+		static void Run(Benchmark::Context& context)
+		{
+			...
+			context.Check(numMissed == 0, "%d visible boxes were culled", numMissed);
+		}
+		static Benchmark::Command<> gBenchmarkCommand("bench.Name", &Run);
+*/
+
+namespace Benchmark
+{
+	// State of a single benchmark run
+	class Context
+	{
+	public:
+		explicit Context(const char* pName)
+			: m_pName(pName)
+		{}
+
+		// Log a warning when `condition` is false. Returns `condition`.
+		template<typename... Args>
+		bool Check(bool condition, const char* pFormat, Args&&... args)
+		{
+			++m_NumChecks;
+			if (!condition)
+			{
+				++m_NumFailed;
+				Console::LogFormat(LogType::Warning, pFormat, std::forward<Args>(args)...);
+			}
+			return condition;
+		}
+
+		const char* GetName() const		{ return m_pName; }
+		uint32		GetNumChecks() const	{ return m_NumChecks; }
+		uint32		GetNumFailed() const	{ return m_NumFailed; }
+
+	private:
+		const char* m_pName;
+		uint32		m_NumChecks = 0;
+		uint32		m_NumFailed = 0;
+	};
+
+	// Log the outcome of a finished run. Returns true if all checks passed.
+	bool Report(const Context& context);
+
+	// Run a benchmark and report its checks.
+	// Used directly by benchmarks that can't run from within the console command, for example because they need the device.
+	template<typename TFunction, typename... Args>
+	bool Run(const char* pName, TFunction&& function, Args&&... args)
+	{
+		Context context(pName);
+		function(context, std::forward<Args>(args)...);
+		return Report(context);
+	}
+
+	// Console command that runs a benchmark with the arguments of the command
+	template<typename... Args>
+	class Command
+	{
+	public:
+		using Function = void(*)(Context&, Args...);
+
+		Command(const char* pName, Function function)
+			: m_Command(pName, [pName, function](Args... args) { Run(pName, function, args...); })
+		{}
+
+	private:
+		ConsoleCommand<Args...> m_Command;
+	};
+}
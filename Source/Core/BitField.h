@@ -1,5 +1,7 @@
 #pragma once
 
+#include <bit>
+
 namespace BitOperations
 {
 	template<typename T>
@@ -379,6 +381,21 @@ public:
 		return Bits;
 	}
 
+	Storage* GetData()
+	{
+		return Data;
+	}
+
+	const Storage* GetData() const
+	{
+		return Data;
+	}
+
+	static constexpr uint32 NumStorageElements()
+	{
+		return Elements();
+	}
+
 private:
 
 	static constexpr uint32 StorageIndexOfBit(uint32 bit)
@@ -408,3 +425,279 @@ private:
 
 	Storage Data[Elements()];
 };
+
+
+// Bit field with a size chosen at runtime.
+// The storage is cache line aligned and bits past Size() are always cleared, so whole words can be scanned.
+class DynamicBitField
+{
+public:
+	using Storage = uint32;
+
+	class SetBitsIterator
+	{
+	public:
+		explicit SetBitsIterator(const DynamicBitField* pBitField, bool end = false)
+			: m_CurrentIndex(INVALID), m_WordIndex(0), m_Word(0), m_pBitField(pBitField)
+		{
+			if (!end && pBitField->NumStorageElements() > 0)
+			{
+				m_Word = pBitField->m_pData[0];
+				Advance();
+			}
+		}
+
+		void operator++()
+		{
+			Advance();
+		}
+
+		bool operator!=(const SetBitsIterator& other)
+		{
+			return m_CurrentIndex != other.m_CurrentIndex;
+		}
+
+		bool Valid() const
+		{
+			return m_CurrentIndex != INVALID;
+		}
+
+		uint32 Value() const
+		{
+			return m_CurrentIndex;
+		}
+
+		uint32 operator*() const
+		{
+			return m_CurrentIndex;
+		}
+
+		static constexpr uint32 INVALID = ~0u;
+
+	private:
+		// Skips empty words and pops the lowest set bit of the current word
+		void Advance()
+		{
+			while (m_Word == 0)
+			{
+				if (++m_WordIndex >= m_pBitField->NumStorageElements())
+				{
+					m_CurrentIndex = INVALID;
+					return;
+				}
+				m_Word = m_pBitField->m_pData[m_WordIndex];
+			}
+			m_CurrentIndex = m_WordIndex * BitsPerStorage() + std::countr_zero(m_Word);
+			m_Word &= m_Word - 1;
+		}
+
+		uint32 m_CurrentIndex;
+		uint32 m_WordIndex;
+		Storage m_Word;
+		const DynamicBitField* m_pBitField;
+	};
+
+	DynamicBitField() = default;
+
+	explicit DynamicBitField(uint32 bits, bool set = false)
+	{
+		Resize(bits, set);
+	}
+
+	DynamicBitField(const DynamicBitField& other)
+	{
+		*this = other;
+	}
+
+	DynamicBitField(DynamicBitField&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	~DynamicBitField()
+	{
+		Release();
+	}
+
+	DynamicBitField& operator=(const DynamicBitField& other)
+	{
+		if (this != &other)
+		{
+			Resize(other.m_Bits);
+			memcpy(m_pData, other.m_pData, sizeof(Storage) * NumStorageElements());
+		}
+		return *this;
+	}
+
+	DynamicBitField& operator=(DynamicBitField&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Release();
+			m_pData = other.m_pData;
+			m_Bits = other.m_Bits;
+			m_Capacity = other.m_Capacity;
+			other.m_pData = nullptr;
+			other.m_Bits = 0;
+			other.m_Capacity = 0;
+		}
+		return *this;
+	}
+
+	// Resizes to the given amount of bits and sets all bits to the given value.
+	// Memory is only reallocated when growing beyond the current capacity.
+	void Resize(uint32 bits, bool set = false)
+	{
+		const uint32 numElements = (bits + BitsPerStorage() - 1) / BitsPerStorage();
+		if (numElements > m_Capacity)
+		{
+			Release();
+			m_Capacity = (numElements + ElementsPerCacheLine - 1) / ElementsPerCacheLine * ElementsPerCacheLine;
+			m_pData = static_cast<Storage*>(::operator new[](sizeof(Storage) * m_Capacity, std::align_val_t(CacheLineSize)));
+		}
+		m_Bits = bits;
+		set ? SetAll() : ClearAll();
+	}
+
+	void ClearAll()
+	{
+		if (m_pData)
+		{
+			memset(m_pData, 0x00000000, sizeof(Storage) * NumStorageElements());
+		}
+	}
+
+	void SetAll()
+	{
+		if (m_pData)
+		{
+			memset(m_pData, 0xFFFFFFFF, sizeof(Storage) * NumStorageElements());
+			ClearTail();
+		}
+	}
+
+	inline void SetBit(uint32 bit)
+	{
+		gAssert(bit < Size());
+		m_pData[bit / BitsPerStorage()] |= (Storage)1 << (bit % BitsPerStorage());
+	}
+
+	inline void ClearBit(uint32 bit)
+	{
+		gAssert(bit < Size());
+		m_pData[bit / BitsPerStorage()] &= ~((Storage)1 << (bit % BitsPerStorage()));
+	}
+
+	inline bool GetBit(uint32 bit) const
+	{
+		gAssert(bit < Size());
+		return (m_pData[bit / BitsPerStorage()] & ((Storage)1 << (bit % BitsPerStorage()))) != 0;
+	}
+
+	void AssignBit(uint32 bit, bool set)
+	{
+		set ? SetBit(bit) : ClearBit(bit);
+	}
+
+	// Clears the bits of the last word that are past Size().
+	// Call after writing whole words through GetData().
+	void ClearTail()
+	{
+		const uint32 tailBits = m_Bits % BitsPerStorage();
+		if (tailBits != 0)
+		{
+			m_pData[NumStorageElements() - 1] &= ((Storage)1 << tailBits) - 1;
+		}
+	}
+
+	bool HasAnyBitSet() const
+	{
+		for (uint32 i = 0; i < NumStorageElements(); ++i)
+		{
+			if (m_pData[i] > 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	uint32 CountSetBits() const
+	{
+		uint32 count = 0;
+		for (uint32 i = 0; i < NumStorageElements(); ++i)
+		{
+			count += std::popcount(m_pData[i]);
+		}
+		return count;
+	}
+
+	SetBitsIterator GetSetBitsIterator() const
+	{
+		return SetBitsIterator(this);
+	}
+
+	SetBitsIterator begin() const
+	{
+		return SetBitsIterator(this);
+	}
+
+	SetBitsIterator end() const
+	{
+		return SetBitsIterator(this, true);
+	}
+
+	bool operator[](uint32 index) const
+	{
+		return GetBit(index);
+	}
+
+	Storage* GetData()
+	{
+		return m_pData;
+	}
+
+	const Storage* GetData() const
+	{
+		return m_pData;
+	}
+
+	uint32 Size() const
+	{
+		return m_Bits;
+	}
+
+	uint32 Capacity() const
+	{
+		return m_Capacity * BitsPerStorage();
+	}
+
+	uint32 NumStorageElements() const
+	{
+		return (m_Bits + BitsPerStorage() - 1) / BitsPerStorage();
+	}
+
+	static constexpr uint32 BitsPerStorage()
+	{
+		return sizeof(Storage) * 8;
+	}
+
+private:
+	static constexpr uint32 CacheLineSize = 64;
+	static constexpr uint32 ElementsPerCacheLine = CacheLineSize / sizeof(Storage);
+
+	void Release()
+	{
+		if (m_pData)
+		{
+			::operator delete[](m_pData, std::align_val_t(CacheLineSize));
+		}
+		m_pData = nullptr;
+		m_Capacity = 0;
+		m_Bits = 0;
+	}
+
+	Storage* m_pData = nullptr;
+	uint32 m_Bits = 0;
+	uint32 m_Capacity = 0;		///< In storage elements
+};
@@ -203,6 +203,11 @@ namespace Paths
 		return SavedDir() + "ShaderCache/";
 	}
 
+	String MeshCacheDir()
+	{
+		return SavedDir() + "MeshCache/";
+	}
+
 	String ShadersDir()
 	{
 		return ResourcesDir() + "Shaders/";
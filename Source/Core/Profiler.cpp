@@ -1,17 +1,18 @@
 
 #include "stdafx.h"
 #include "Profiler.h"
+#include <intrin.h>
 
 #if WITH_PROFILING
 
 CPUProfiler gCPUProfiler;
 GPUProfiler gGPUProfiler;
 
-static uint32 ColorFromString(const char* pStr, float hueMin, float hueMax)
+static uint32 ColorFromHash(uint64 hash, float hueMin, float hueMax)
 {
 	const float saturation = 0.5f;
 	const float value = 0.6f;
-	float hue = (float)std::hash<std::string>{}(pStr) / std::numeric_limits<size_t>::max();
+	float hue = (float)hash / (float)std::numeric_limits<uint64>::max();
 	hue = hueMin + hue * (hueMax - hueMin);
 	float R = std::max(std::min(fabs(hue * 6 - 3) - 1, 1.0f), 0.0f);
 	float G = std::max(std::min(2 - fabs(hue * 6 - 2), 1.0f), 0.0f);
@@ -28,6 +29,52 @@ static uint32 ColorFromString(const char* pStr, float hueMin, float hueMax)
 }
 
 
+//-----------------------------------------------------------------------------
+// [SECTION] Name Interning
+//-----------------------------------------------------------------------------
+
+namespace ProfilerNames
+{
+	static std::mutex							sLock;
+	static HashMap<uint64, ProfilerName*>		sNames;		// Global table of all interned names
+	static std::deque<ProfilerName>				sStorage;	// Stable storage of names
+	static thread_local HashMap<uint64, const ProfilerName*> tCache;
+
+	static const ProfilerName& InternSlow(uint64 hash, StringView name)
+	{
+		std::scoped_lock lock(sLock);
+		auto it = sNames.find(hash);
+		if (it != sNames.end())
+			return *it->second;
+
+		char* pCopy = new char[name.length() + 1];
+		memcpy(pCopy, name.data(), name.length());
+		pCopy[name.length()] = '\0';
+
+		ProfilerName& entry = sStorage.emplace_back();
+		entry.pName		= pCopy;
+		entry.CPUColor	= ColorFromHash(hash, 0.5f, 1.0f);
+		entry.GPUColor	= ColorFromHash(hash, 0.0f, 0.5f);
+		sNames[hash]	= &entry;
+		return entry;
+	}
+}
+
+const ProfilerName& InternProfilerName(const char* pName)
+{
+	StringView name(pName);
+	uint64 hash = ankerl::unordered_dense::hash<StringView>{}(name);
+
+	auto it = ProfilerNames::tCache.find(hash);
+	if (it != ProfilerNames::tCache.end())
+		return *it->second;
+
+	const ProfilerName& entry = ProfilerNames::InternSlow(hash, name);
+	ProfilerNames::tCache[hash] = &entry;
+	return entry;
+}
+
+
 //-----------------------------------------------------------------------------
 // [SECTION] GPU Profiler
 //-----------------------------------------------------------------------------
@@ -131,11 +178,12 @@ void GPUProfiler::BeginEvent(ID3D12GraphicsCommandList* pCmd, const char* pName,
 	cmdListQuery.EventIndex			= eventIndex;
 
 	// Allocate an event in the sample history
+	const ProfilerName& name		= InternProfilerName(pName);
 	ProfilerEvent& event			= eventData.Events[eventIndex];
-	event.pName						= eventData.Allocator.String(pName);
+	event.pName						= name.pName;
 	event.pFilePath					= pFilePath;
 	event.LineNumber				= lineNumber;
-	event.Color						= color == 0 ? ColorFromString(pName, 0.0f, 0.5f) : color;
+	event.Color						= color == 0 ? name.GPUColor : color;
 }
 
 
@@ -249,7 +297,6 @@ void GPUProfiler::Tick()
 
 		ProfilerEventData& eventFrame = GetSampleFrame();
 		eventFrame.NumEvents = 0;
-		eventFrame.Allocator.Reset();
 		for (uint32 i = 0; i < (uint32)m_Queues.size(); ++i)
 			eventFrame.EventOffsetAndCountPerTrack[i] = {};
 
@@ -409,44 +456,80 @@ void GPUProfiler::QueryHeap::Reset(uint32 frameIndex)
 //-----------------------------------------------------------------------------
 
 
-void CPUProfiler::Initialize(uint32 historySize)
+void CPUProfiler::Initialize(uint32 historySize, uint32 maxEventsPerThread)
 {
-	m_pEventData	= new ProfilerEventData[historySize];
-	m_HistorySize	= historySize;
-	m_IsInitialized = true;
+	m_pEventData		= new ProfilerEventData[historySize];
+	m_HistorySize		= historySize;
+	m_EventsPerThread	= Math::NextPowerOfTwo(maxEventsPerThread);
+
+	// Events are timestamped with the TSC, which is much cheaper to read than QPC.
+	// They are converted to QPC when resolved. The ratio is refined every Tick as the measured interval grows.
+	QueryPerformanceCounter((LARGE_INTEGER*)&m_CalibrationQPC);
+	m_CalibrationTSC	= __rdtsc();
+	uint64 qpcFrequency = 0;
+	QueryPerformanceFrequency((LARGE_INTEGER*)&qpcFrequency);
+	uint64 qpcEnd = m_CalibrationQPC + qpcFrequency / 1000;
+	uint64 qpc = m_CalibrationQPC;
+	while (qpc < qpcEnd)
+		QueryPerformanceCounter((LARGE_INTEGER*)&qpc);
+	m_QPCPerTSC			= (double)(qpc - m_CalibrationQPC) / (double)(__rdtsc() - m_CalibrationTSC);
+
+	m_IsInitialized		= true;
 }
 
 
 void CPUProfiler::Shutdown()
 {
 	delete[] m_pEventData;
+	for (uint32 i = 0; i < m_NumThreads; ++i)
+		delete[] m_ThreadData[i].pEvents;
 }
 
 
 // Begin a new CPU event on the current thread
-void CPUProfiler::BeginEvent(const char* pName, uint32 color, const char* pFilePath, uint32 lineNumber)
+void CPUProfiler::BeginEvent(const ProfilerName& name, uint32 color, const char* pFilePath, uint32 lineNumber)
 {
 	if (!m_IsInitialized)
 		return;
 
 	if (m_EventCallback.OnEventBegin)
-		m_EventCallback.OnEventBegin(pName, m_EventCallback.pUserData);
+		m_EventCallback.OnEventBegin(name.pName, m_EventCallback.pUserData);
 
 	if (m_Paused)
 		return;
 
-	// Record new event on TLS
-	TLS& tls = GetTLS();
-	tls.EventStack.Push()		= (uint32)tls.Events.size();
+	TLS& tls					= GetTLS();
+
+	// Threads without a slot still push, so EndEvent stays balanced
+	if (!tls.pThreadData)
+	{
+		tls.EventStack.Push()	= TLS::INVALID_EVENT;
+		return;
+	}
+	ThreadData& thread			= *tls.pThreadData;
+
+	// Only the owning thread writes the head. If the ring is full, drop the event.
+	uint64 head					= thread.Head.load(std::memory_order_relaxed);
+	if (head - thread.Tail.load(std::memory_order_acquire) >= thread.Capacity)
+	{
+		thread.NumDropped.fetch_add(1, std::memory_order_relaxed);
+		tls.EventStack.Push()	= TLS::INVALID_EVENT;
+		return;
+	}
 
-	ProfilerEvent& newEvent		= tls.Events.emplace_back();
-	newEvent.Depth				= tls.EventStack.GetSize();
-	newEvent.ThreadIndex		= tls.ThreadIndex;
-	newEvent.pName				= GetData().Allocator.String(pName);
+	ProfilerEvent& newEvent		= thread.pEvents[head & (thread.Capacity - 1)];
+	newEvent.pName				= name.pName;
 	newEvent.pFilePath			= pFilePath;
+	newEvent.Color				= color == 0 ? name.CPUColor : color;
+	newEvent.Depth				= tls.EventStack.GetSize() + 1;
 	newEvent.LineNumber			= lineNumber;
-	newEvent.Color				= color == 0 ? ColorFromString(pName, 0.5f, 1.0f) : color;
-	QueryPerformanceCounter((LARGE_INTEGER*)(&newEvent.TicksBegin));
+	newEvent.ThreadIndex		= thread.Index;
+	newEvent.TicksEnd			= 0;
+	tls.EventStack.Push()		= head;
+	newEvent.TicksBegin			= __rdtsc();
+
+	// Publish the event. The end timestamp signals completion to Tick.
+	thread.Head.store(head + 1, std::memory_order_release);
 }
 
 
@@ -463,12 +546,17 @@ void CPUProfiler::EndEvent()
 		return;
 
 	// End and pop an event of the stack
+	uint64 ticks			= __rdtsc();
 	TLS& tls				= GetTLS();
 
 	gAssert(tls.EventStack.GetSize() > 0, "Event mismatch. Called EndEvent more than BeginEvent");
-	uint32 eventIndex		= tls.EventStack.Pop();
-	ProfilerEvent& event	= tls.Events[eventIndex];
-	QueryPerformanceCounter((LARGE_INTEGER*)(&event.TicksEnd));
+	uint64 eventIndex		= tls.EventStack.Pop();
+	if (eventIndex == TLS::INVALID_EVENT)
+		return;
+
+	ThreadData& thread		= *tls.pThreadData;
+	ProfilerEvent& event	= thread.pEvents[eventIndex & (thread.Capacity - 1)];
+	std::atomic_ref<uint64>(event.TicksEnd).store(ticks, std::memory_order_release);
 }
 
 
@@ -486,32 +574,61 @@ void CPUProfiler::Tick()
 	if (m_FrameIndex)
 		EndEvent();
 
-	std::scoped_lock lock(m_ThreadDataLock);
+	// Refine the TSC to QPC ratio with the interval since initialization
+	uint64 qpc;
+	QueryPerformanceCounter((LARGE_INTEGER*)&qpc);
+	uint64 tsc = __rdtsc();
+	m_QPCPerTSC = (double)(qpc - m_CalibrationQPC) / (double)(tsc - m_CalibrationTSC);
 
-	// Collect recorded events from all threads
+	// Collect recorded events from all threads.
+	// Threads keep recording while this runs. Only events that have ended are collected.
+	// The tail can't move past an event that is still open, so events that ended after it are marked as collected
+	// and skipped once the open event has ended and the tail moves past them.
 	ProfilerEventData& data = GetData();
-	data.NumEvents = (uint32)data.Events.size();
-	data.EventOffsetAndCountPerTrack.resize(m_ThreadData.size());
+	uint32 numThreads = m_NumThreads.load(std::memory_order_acquire);
+	data.EventOffsetAndCountPerTrack.resize(numThreads);
 	data.Events.clear();
-	for (uint32 threadIndex = 0; threadIndex < (uint32)m_ThreadData.size(); ++threadIndex)
+	for (uint32 threadIndex = 0; threadIndex < numThreads; ++threadIndex)
 	{
-		ThreadData& threadData = m_ThreadData[threadIndex];
-
-		// Check if all threads have ended all open sample events
-		gAssert(threadData.pTLS->EventStack.GetSize() == 0, "Thread %s has not closed all events", threadData.Name);
+		ThreadData& thread	= m_ThreadData[threadIndex];
+		uint64 tail			= thread.Tail.load(std::memory_order_relaxed);
+		uint64 head			= thread.Head.load(std::memory_order_acquire);
 
-		// Copy all events for the thread to the common array
 		// Keep track of which range of events belong to what thread
-		data.EventOffsetAndCountPerTrack[threadIndex] = ProfilerEventData::OffsetAndSize((uint32)data.Events.size(), (uint32)threadData.pTLS->Events.size());
-		data.Events.insert(data.Events.end(), threadData.pTLS->Events.begin(), threadData.pTLS->Events.end());
-		threadData.pTLS->Events.clear();
+		uint32 offset		= (uint32)data.Events.size();
+		bool hasOpenEvent	= false;
+		for (uint64 eventIndex = tail; eventIndex < head; ++eventIndex)
+		{
+			ProfilerEvent& event = thread.pEvents[eventIndex & (thread.Capacity - 1)];
+			std::atomic_ref<uint64> ticksEndRef(event.TicksEnd);
+			uint64 ticksEnd = ticksEndRef.load(std::memory_order_acquire);
+			if (ticksEnd == 0)
+			{
+				hasOpenEvent = true;
+			}
+			else if (ticksEnd != TICKS_END_COLLECTED)
+			{
+				ProfilerEvent& resolvedEvent	= data.Events.emplace_back(event);
+				resolvedEvent.TicksBegin		= ConvertToQPC(event.TicksBegin);
+				resolvedEvent.TicksEnd			= ConvertToQPC(ticksEnd);
+
+				// The event has ended, so the owning thread doesn't write it again until the tail has moved past it
+				if (hasOpenEvent)
+					ticksEndRef.store(TICKS_END_COLLECTED, std::memory_order_relaxed);
+			}
+
+			if (!hasOpenEvent)
+				tail = eventIndex + 1;
+		}
+		thread.Tail.store(tail, std::memory_order_release);
+		data.EventOffsetAndCountPerTrack[threadIndex] = ProfilerEventData::OffsetAndSize(offset, (uint32)data.Events.size() - offset);
 	}
+	data.NumEvents = (uint32)data.Events.size();
 
 	// Advance the frame and reset its data
 	++m_FrameIndex;
 
 	ProfilerEventData& newData = GetData();
-	newData.Allocator.Reset();
 	newData.NumEvents = 0;
 
 	// Begin a "CPU Frame" event
@@ -525,9 +642,16 @@ void CPUProfiler::RegisterThread(const char* pName)
 	TLS& tls = GetTLSUnsafe();
 	gAssert(!tls.IsInitialized);
 	tls.IsInitialized	= true;
+
+	// Only registration takes the lock. Readers use the atomic thread count.
 	std::scoped_lock lock(m_ThreadDataLock);
-	tls.ThreadIndex		= (uint32)m_ThreadData.size();
-	ThreadData& data	= m_ThreadData.emplace_back();
+	uint32 index		= m_NumThreads.load(std::memory_order_relaxed);
+	if (index >= MAX_THREADS)
+	{
+		E_LOG(Warning, "Profiler: More than %d threads registered. Events of thread %u are dropped.", MAX_THREADS, GetCurrentThreadId());
+		return;
+	}
+	ThreadData& data	= m_ThreadData[index];
 
 	// If the name is not provided, retrieve it using GetThreadDescription()
 	if (pName)
@@ -542,8 +666,12 @@ void CPUProfiler::RegisterThread(const char* pName)
 		gVerify(wcstombs_s(&converted, data.Name, ARRAYSIZE(data.Name), pDescription, ARRAYSIZE(data.Name)), == 0);
 	}
 	data.ThreadID	= GetCurrentThreadId();
-	data.pTLS		= &tls;
-	data.Index		= (uint32)m_ThreadData.size() - 1;
+	data.Index		= index;
+	data.Capacity	= m_EventsPerThread;
+	data.pEvents	= new ProfilerEvent[m_EventsPerThread];
+	tls.pThreadData = &data;
+
+	m_NumThreads.store(index + 1, std::memory_order_release);
 }
 
 #endif
@@ -18,7 +18,7 @@
 
 /// Usage:
 //		PROFILE_FRAME()
-#define PROFILE_FRAME() gCPUProfiler.Tick(); gGPUProfiler.Tick()
+#define PROFILE_FRAME() gCPUProfiler.Tick(); gGPUProfiler.Tick(); ProfilerStats::Tick(); ProfilerExport::Tick()
 
 /// Usage:
 ///		PROFILE_EXECUTE_COMMANDLISTS(ID3D12CommandQueue* pQueue, Span<ID3D12CommandLists*> commandLists)
@@ -31,7 +31,12 @@
 // Usage:
 //		PROFILE_CPU_SCOPE(const char* pName)
 //		PROFILE_CPU_SCOPE()
-#define PROFILE_CPU_SCOPE(...)							CPUProfileScope MACRO_CONCAT(profiler, __COUNTER__)(__FUNCTION__, __FILE__, __LINE__, __VA_ARGS__)
+// The name is interned once per call site, so it must be a string literal. Use PROFILE_CPU_SCOPE_DYNAMIC for names that change.
+#define PROFILE_CPU_SCOPE(...)							CPUProfileScope MACRO_CONCAT(profiler, __COUNTER__)(InternProfileScopeName(GetProfileScopeName(__FUNCTION__, __VA_ARGS__), []{}), __FILE__, __LINE__, __VA_ARGS__)
+
+// Usage:
+//		PROFILE_CPU_SCOPE_DYNAMIC(const char* pName)
+#define PROFILE_CPU_SCOPE_DYNAMIC(...)					CPUProfileScope MACRO_CONCAT(profiler, __COUNTER__)(__FUNCTION__, __FILE__, __LINE__, __VA_ARGS__)
 
 // Usage:
 //		PROFILE_CPU_BEGIN(const char* pName)
@@ -66,6 +71,7 @@
 #define PROFILE_EXECUTE_COMMANDLISTS(...)
 
 #define PROFILE_CPU_SCOPE(...)
+#define PROFILE_CPU_SCOPE_DYNAMIC(...)
 #define PROFILE_CPU_BEGIN(...)
 #define PROFILE_CPU_END()
 
@@ -109,65 +115,28 @@ private:
 
 
 
-// Simple Linear Allocator
-class LinearAllocator
-{
-public:
-	explicit LinearAllocator(uint32 size)
-		: m_pData(new char[size]), m_Size(size), m_Offset(0)
-	{
-	}
-
-	~LinearAllocator()
-	{
-		delete[] m_pData;
-	}
-
-	LinearAllocator(LinearAllocator&) = delete;
-	LinearAllocator& operator=(LinearAllocator&) = delete;
-
-	void Reset()
-	{
-		m_Offset = 0;
-	}
-
-	template<typename T, typename... Args>
-	T* Allocate(Args... args)
-	{
-		void* pData = Allocate(sizeof(T));
-		T* pValue = new (pData) T(std::forward<Args>(args)...);
-		return pValue;
-	}
+void DrawProfilerHUD();
 
-	void* Allocate(uint32 size)
-	{
-		uint32 offset = m_Offset.fetch_add(size);
-		gAssert(offset + size <= m_Size);
-		return m_pData + offset;
-	}
 
-	const char* String(const char* pStr)
-	{
-		uint32 len = (uint32)strlen(pStr) + 1;
-		char* pData = (char*)Allocate(len);
-		strcpy_s(pData, len, pStr);
-		return pData;
-	}
 
-private:
-	char* m_pData;
-	uint32 m_Size;
-	std::atomic<uint32> m_Offset;
+// Interned event name. Created once per unique name.
+struct ProfilerName
+{
+	const char* pName		= nullptr;	///< Persistent copy of the name
+	uint32		CPUColor	= 0;		///< Color for CPU events
+	uint32		GPUColor	= 0;		///< Color for GPU events
 };
 
-void DrawProfilerHUD();
+// Return the interned name for the given string.
+// Lookups go through a thread-local cache, only the first lookup of a name on a thread takes a lock.
+const ProfilerName& InternProfilerName(const char* pName);
 
 
 
 // Single event
 struct ProfilerEvent
 {
-	const char* pName				= nullptr;	///< Name of event
+	const char* pName				= nullptr;	///< Interned name of event. Pointers are unique per name and valid for the lifetime of the program
 	const char* pFilePath			= nullptr;	///< File path of location where event was started
 	uint32		Color		: 24	= 0xFFFFFF;	///< Color
 	uint32		Depth		: 8		= 0;		///< Stack depth of event
@@ -188,10 +157,6 @@ struct ProfilerEvent
 class ProfilerEventData
 {
 public:
-	ProfilerEventData()
-		: Allocator(1 << 16)
-	{}
-
 	Span<const ProfilerEvent> GetEvents() const						{ return Span<const ProfilerEvent>(Events.data(), NumEvents); }
 	Span<const ProfilerEvent> GetEvents(uint32 trackIndex) const	{ return trackIndex < EventOffsetAndCountPerTrack.size() && EventOffsetAndCountPerTrack[trackIndex].Size > 0 ? Span<const ProfilerEvent>(&Events[EventOffsetAndCountPerTrack[trackIndex].Offset], EventOffsetAndCountPerTrack[trackIndex].Size) : Span<const ProfilerEvent>(); }
 
@@ -205,7 +170,6 @@ private:
 		uint32 Size;
 	};
 
-	LinearAllocator						Allocator;						///< Scratch allocator for frame
 	Array<OffsetAndSize>				EventOffsetAndCountPerTrack;	///< Span of events for each track
 	Array<ProfilerEvent>				Events;							///< Event storage for frame
 	uint32								NumEvents = 0;					///< Total number of recorded events
@@ -515,11 +479,14 @@ struct CPUProfilerCallbacks
 class CPUProfiler
 {
 public:
-	void Initialize(uint32 historySize);
+	void Initialize(uint32 historySize, uint32 maxEventsPerThread = 1 << 14);
 	void Shutdown();
 
 	// Start and push an event on the current thread
-	void BeginEvent(const char* pName, uint32 color, const char* pFilePath, uint32 lineNumber);
+	void BeginEvent(const ProfilerName& name, uint32 color, const char* pFilePath, uint32 lineNumber);
+
+	// Start and push an event on the current thread
+	void BeginEvent(const char* pName, uint32 color, const char* pFilePath, uint32 lineNumber) { BeginEvent(InternProfilerName(pName), color, pFilePath, lineNumber); }
 
 	// Start and push an event on the current thread
 	void BeginEvent(const char* pName, uint32 color = 0) { BeginEvent(pName, color, "", 0); }
@@ -531,27 +498,41 @@ public:
 	// Call at the START of the frame.
 	void Tick();
 
-	// Initialize a thread with an optional name
+	// Initialize a thread with an optional name.
+	// Threads registered after MAX_THREADS don't get a slot and their events are dropped.
 	void RegisterThread(const char* pName = nullptr);
 
+	static constexpr uint32 MAX_THREADS = 128;
+
+	// Structure describing a registered thread.
+	// Each thread records events in a fixed-size ring buffer. The thread writes at the head, Tick consumes from the tail.
+	// Tick collects every event that has ended, but the tail stops at the oldest event that is still open.
+	// A long scope on a worker thread therefore holds the ring, which must fit all events the thread records while it is open.
+	// Events that don't fit are dropped and counted in NumDropped.
+	struct ThreadData
+	{
+		char					Name[128]	{};
+		uint32					ThreadID	= 0;
+		uint32					Index		= 0;
+		ProfilerEvent*			pEvents		= nullptr;	///< Ring buffer of events. Timestamps are in TSC ticks until resolved in Tick
+		uint32					Capacity	= 0;		///< Size of the ring buffer. Power of 2
+		std::atomic<uint64>		Head		= 0;		///< Index of the next event to write. Written by the owning thread
+		std::atomic<uint64>		Tail		= 0;		///< Index of the oldest unconsumed event. Written by Tick
+		std::atomic<uint32>		NumDropped	= 0;		///< Number of events dropped because the ring buffer was full
+	};
+
+	// TicksEnd of an event that Tick collected while an older event on its thread was still open
+	static constexpr uint64 TICKS_END_COLLECTED = ~0ull;
+
 	// Thread-local storage to keep track of current depth and event stack
 	struct TLS
 	{
 		static constexpr int MAX_STACK_DEPTH = 32;
+		static constexpr uint64 INVALID_EVENT = ~0ull;
 
-		FixedStack<uint32, MAX_STACK_DEPTH> EventStack;
-		uint32								ThreadIndex		= 0;
+		FixedStack<uint64, MAX_STACK_DEPTH> EventStack;
+		ThreadData*							pThreadData		= nullptr;	///< Null if the thread did not get a slot
 		bool								IsInitialized	= false;
-		Array<ProfilerEvent>				Events;
-	};
-
-	// Structure describing a registered thread
-	struct ThreadData
-	{
-		char		Name[128]	{};
-		uint32		ThreadID	= 0;
-		uint32		Index		= 0;
-		TLS*		pTLS		= nullptr;
 	};
 
 	URange GetFrameRange() const
@@ -567,7 +548,7 @@ public:
 		return GetData(frameIndex);
 	}
 
-	Span<const ThreadData> GetThreads() const { return m_ThreadData; }
+	Span<const ThreadData> GetThreads() const { return Span<const ThreadData>(m_ThreadData.data(), m_NumThreads.load(std::memory_order_acquire)); }
 
 	void SetEventCallback(const CPUProfilerCallbacks& inCallbacks)	{ m_EventCallback = inCallbacks; }
 	void SetPaused(bool paused)										{ m_QueuedPaused = paused; }
@@ -597,8 +578,17 @@ private:
 
 	CPUProfilerCallbacks	m_EventCallback;
 
-	std::mutex				m_ThreadDataLock;				// Mutex for accesing thread data
-	Array<ThreadData>		m_ThreadData;					// Data describing each registered thread
+	// Convert a TSC timestamp to a QueryPerformanceCounter timestamp
+	uint64 ConvertToQPC(uint64 tsc) const { return m_CalibrationQPC + (uint64)((double)(int64)(tsc - m_CalibrationTSC) * m_QPCPerTSC); }
+
+	std::mutex								m_ThreadDataLock;				// Mutex for registering threads
+	StaticArray<ThreadData, MAX_THREADS>	m_ThreadData;					// Data describing each registered thread
+	std::atomic<uint32>						m_NumThreads		= 0;		// Number of registered threads
+	uint32									m_EventsPerThread	= 1 << 14;	// Ring buffer size of each thread. Threads registered before Initialize use the default
+
+	uint64					m_CalibrationTSC	= 0;		// TSC at initialization
+	uint64					m_CalibrationQPC	= 0;		// QPC at initialization
+	double					m_QPCPerTSC			= 0;		// Ratio between QPC and TSC frequency, refined every Tick
 
 	ProfilerEventData*		m_pEventData		= nullptr;	// Per-frame data
 	uint32					m_HistorySize		= 0;		// History size
@@ -609,9 +599,40 @@ private:
 };
 
 
+// Select the event name from the arguments of PROFILE_CPU_SCOPE.
+// The name is cached per call site, so only constant character arrays (string literals) are accepted.
+template<typename TName> requires std::is_convertible_v<TName, const char*>
+constexpr const char* GetProfileScopeName(const char* pFunctionName, TName&& name, uint32 color = 0)
+{
+	using NameType = std::remove_reference_t<TName>;
+	static_assert(std::is_array_v<NameType> && std::is_const_v<std::remove_extent_t<NameType>>,
+		"PROFILE_CPU_SCOPE requires a string literal. Use PROFILE_CPU_SCOPE_DYNAMIC for names known at runtime.");
+	return name;
+}
+inline const char* GetProfileScopeName(const char* pFunctionName, uint32 color = 0)						{ return pFunctionName; }
+
+// Intern the name of a PROFILE_CPU_SCOPE on its first use.
+// Each call site passes a lambda of its own type, so each call site gets its own cached name.
+template<typename TCallSite>
+const ProfilerName& InternProfileScopeName(const char* pName, TCallSite)
+{
+	static const ProfilerName& name = InternProfilerName(pName);
+	return name;
+}
+
 // Helper RAII-style structure to push and pop a CPU sample region
 struct CPUProfileScope
 {
+	CPUProfileScope(const ProfilerName& name, const char* pFilePath, uint32 lineNumber, const char* pName, uint32 color = 0)
+	{
+		gCPUProfiler.BeginEvent(name, color, pFilePath, lineNumber);
+	}
+
+	CPUProfileScope(const ProfilerName& name, const char* pFilePath, uint32 lineNumber, uint32 color = 0)
+	{
+		gCPUProfiler.BeginEvent(name, color, pFilePath, lineNumber);
+	}
+
 	CPUProfileScope(const char* pFunctionName, const char* pFilePath, uint32 lineNumber, const char* pName, uint32 color = 0)
 	{
 		gCPUProfiler.BeginEvent(pName, color, pFilePath, lineNumber);
@@ -630,3 +651,6 @@ struct CPUProfileScope
 	CPUProfileScope(const CPUProfileScope&) = delete;
 	CPUProfileScope& operator=(const CPUProfileScope&) = delete;
 };
+
+#include "ProfilerExport.h"
+#include "ProfilerStats.h"
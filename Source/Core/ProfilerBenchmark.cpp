@@ -0,0 +1,50 @@
+#include "stdafx.h"
+#include "Profiler.h"
+#include "Core/Benchmark.h"
+#include "Core/Utils.h"
+
+/*
+	Microbenchmark for the CPU profiler recording overhead.
+	Run from the console with "bench.Profiler".
+*/
+
+#if WITH_PROFILING
+
+namespace ProfilerBenchmark
+{
+	// Budget for a single Begin/End pair
+	static constexpr float MaxNanosecondsPerScope = 20.0f;
+
+	static void Run(Benchmark::Context& context)
+	{
+		// Stay well below the ring capacity so events are not dropped during the measurement
+		constexpr uint32 numScopes = 4000;
+		volatile uint32 sink = 0;
+
+		// Make sure the thread is registered before timing
+		{
+			PROFILE_CPU_SCOPE("Profiler Benchmark Warmup");
+		}
+
+		Utils::TimeScope baselineTimer;
+		for (uint32 i = 0; i < numScopes; ++i)
+			sink = sink + i;
+		float baselineTime = baselineTimer.Stop();
+
+		Utils::TimeScope scopeTimer;
+		for (uint32 i = 0; i < numScopes; ++i)
+		{
+			PROFILE_CPU_SCOPE("Profiler Benchmark Scope");
+			sink = sink + i;
+		}
+		float scopeTime = scopeTimer.Stop();
+
+		float nsPerScope = Math::Max(0.0f, scopeTime - baselineTime) * 1'000'000'000.0f / numScopes;
+		E_LOG(Info, "Profiler benchmark - %d scopes: %.2f ns/scope", numScopes, nsPerScope);
+		context.Check(nsPerScope <= MaxNanosecondsPerScope, "Profiler scope overhead (%.2f ns) exceeds budget of %.2f ns", nsPerScope, MaxNanosecondsPerScope);
+	}
+
+	static Benchmark::Command<> gBenchmarkCommand("bench.Profiler", &Run);
+}
+
+#endif
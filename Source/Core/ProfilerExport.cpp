@@ -0,0 +1,347 @@
+#include "stdafx.h"
+#include "ProfilerExport.h"
+#include "Core/ConsoleVariables.h"
+#include "Core/Paths.h"
+#include "Core/Stream.h"
+#include "Core/Thread.h"
+
+#if WITH_PROFILING
+
+namespace ProfilerExport
+{
+	// Events collected from one or more profiler frames
+	struct TraceFrame
+	{
+		Array<ProfilerEvent> CPUEvents;
+		Array<ProfilerEvent> GPUEvents;
+	};
+
+	static constexpr uint32 CPUProcessID = 0;
+	static constexpr uint32 GPUProcessID = 1;
+
+	/*
+		Writes events in the Chrome Trace Event JSON array format.
+		The closing bracket is optional in this format, so a trace that is cut short is still readable.
+	*/
+	class ChromeTraceWriter
+	{
+	public:
+		bool Open(const char* pFilePath)
+		{
+			String fullPath = Paths::MakeAbsolute(pFilePath);
+			Paths::CreateDirectoryTree(fullPath);
+			if (!m_File.Open(fullPath.c_str(), FileMode::Write | FileMode::Create))
+			{
+				E_LOG(Warning, "Failed to open trace file '%s'", fullPath.c_str());
+				return false;
+			}
+
+			uint64 frequency = 0;
+			QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+			m_TicksToMicroseconds	= 1'000'000.0 / frequency;
+			m_BaseTicks				= 0;
+			m_NumThreadsWritten		= 0;
+			m_IsFirstEvent			= true;
+			m_Buffer.clear();
+			m_Buffer += "[\n";
+
+			WriteMetadata(CPUProcessID, 0, "process_name", "CPU");
+			WriteMetadata(GPUProcessID, 0, "process_name", "GPU");
+			for (const GPUProfiler::QueueInfo& queue : gGPUProfiler.GetQueues())
+				WriteMetadata(GPUProcessID, queue.Index, "thread_name", queue.Name);
+			return true;
+		}
+
+		void Close()
+		{
+			if (!m_File.IsOpen())
+				return;
+			m_Buffer += "\n]\n";
+			Flush();
+			m_File.Close();
+		}
+
+		void WriteFrame(const TraceFrame& frame)
+		{
+			// Threads can be registered at any time, name the ones that appeared since the last frame
+			Span<const CPUProfiler::ThreadData> threads = gCPUProfiler.GetThreads();
+			for (; m_NumThreadsWritten < threads.GetSize(); ++m_NumThreadsWritten)
+			{
+				const CPUProfiler::ThreadData& thread = threads[m_NumThreadsWritten];
+				WriteMetadata(CPUProcessID, thread.Index, "thread_name", thread.Name);
+			}
+
+			if (m_BaseTicks == 0)
+			{
+				for (const ProfilerEvent& event : frame.CPUEvents)
+				{
+					if (event.IsValid())
+					{
+						m_BaseTicks = event.TicksBegin;
+						break;
+					}
+				}
+			}
+
+			for (const ProfilerEvent& event : frame.CPUEvents)
+				WriteEvent(event, CPUProcessID, event.ThreadIndex);
+			for (const ProfilerEvent& event : frame.GPUEvents)
+				WriteEvent(event, GPUProcessID, event.QueueIndex);
+
+			if (m_Buffer.size() > FlushThreshold)
+				Flush();
+		}
+
+	private:
+		static constexpr size_t FlushThreshold = 1 << 20;
+
+		void WriteEvent(const ProfilerEvent& event, uint32 processID, uint32 threadID)
+		{
+			if (!event.IsValid())
+				return;
+
+			double ts		= ((double)event.TicksBegin - (double)m_BaseTicks) * m_TicksToMicroseconds;
+			double duration = (double)(event.TicksEnd - event.TicksBegin) * m_TicksToMicroseconds;
+
+			BeginEntry();
+			m_Buffer += "{\"name\":\"";
+			AppendEscaped(event.pName);
+			Append("\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", processID, threadID, ts, duration);
+			if (event.pFilePath && event.pFilePath[0])
+			{
+				m_Buffer += ",\"args\":{\"file\":\"";
+				AppendEscaped(event.pFilePath);
+				Append("\",\"line\":%u}", (uint32)event.LineNumber);
+			}
+			m_Buffer += "}";
+		}
+
+		void WriteMetadata(uint32 processID, uint32 threadID, const char* pType, const char* pName)
+		{
+			BeginEntry();
+			Append("{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"", pType, processID, threadID);
+			AppendEscaped(pName);
+			m_Buffer += "\"}}";
+		}
+
+		void BeginEntry()
+		{
+			if (!m_IsFirstEvent)
+				m_Buffer += ",\n";
+			m_IsFirstEvent = false;
+		}
+
+		template<typename... Args>
+		void Append(const char* pFormat, Args&&... args)
+		{
+			char buffer[256];
+			FormatString(buffer, ARRAYSIZE(buffer), pFormat, std::forward<Args>(args)...);
+			m_Buffer += buffer;
+		}
+
+		void AppendEscaped(const char* pText)
+		{
+			for (const char* pChar = pText; *pChar; ++pChar)
+			{
+				char c = *pChar;
+				if (c == '"' || c == '\\')
+					m_Buffer += '\\';
+				m_Buffer += (uint8)c < 0x20 ? ' ' : c;
+			}
+		}
+
+		void Flush()
+		{
+			if (!m_Buffer.empty())
+				m_File.Write(m_Buffer.data(), (uint32)m_Buffer.size());
+			m_Buffer.clear();
+		}
+
+		FileStream	m_File;
+		String		m_Buffer;
+		double		m_TicksToMicroseconds	= 0.0;
+		uint64		m_BaseTicks				= 0;		///< Timestamps are written relative to the first event
+		uint32		m_NumThreadsWritten		= 0;		///< Number of CPU threads that have a name entry
+		bool		m_IsFirstEvent			= true;
+	};
+
+
+	//-----------------------------------------------------------------------------
+	// [SECTION] Streaming
+	//-----------------------------------------------------------------------------
+
+	// Max number of frames waiting for the writer thread before frames are dropped
+	static constexpr uint32 MaxPendingFrames = 64;
+
+	static std::mutex				sLock;
+	static std::condition_variable	sWakeUpCondition;
+	static std::deque<TraceFrame>	sPendingFrames;			// Frames waiting to be written
+	static Array<TraceFrame>		sFreeFrames;			// Recycled frames to avoid reallocating event storage
+	static bool						sStopRequested = false;
+
+	static Thread					sWriterThread;
+	static ChromeTraceWriter		sStreamWriter;
+	static bool						sIsStreaming		= false;
+	static uint32					sNextCPUFrame		= 0;
+	static uint32					sNextGPUFrame		= 0;
+	static uint32					sMaxFrames			= 0;
+	static uint32					sNumFramesStreamed	= 0;
+	static uint32					sNumFramesDropped	= 0;
+
+	static DWORD WINAPI WriterThreadFunction(LPVOID)
+	{
+		while (true)
+		{
+			TraceFrame frame;
+			{
+				std::unique_lock lock(sLock);
+				sWakeUpCondition.wait(lock, []() { return !sPendingFrames.empty() || sStopRequested; });
+				if (sPendingFrames.empty())
+					break;
+				frame = std::move(sPendingFrames.front());
+				sPendingFrames.pop_front();
+			}
+
+			sStreamWriter.WriteFrame(frame);
+			frame.CPUEvents.clear();
+			frame.GPUEvents.clear();
+
+			std::scoped_lock lock(sLock);
+			sFreeFrames.push_back(std::move(frame));
+		}
+		sStreamWriter.Close();
+		return 0;
+	}
+
+	// Copy the events of a range of frames from either the CPU or GPU profiler
+	template<typename ProfilerType>
+	static void AppendFrames(Array<ProfilerEvent>& outEvents, const ProfilerType& profiler, URange range)
+	{
+		for (uint32 frameIndex = range.Begin; frameIndex < range.End; ++frameIndex)
+		{
+			Span<const ProfilerEvent> events = profiler.GetEventData(frameIndex).GetEvents();
+			outEvents.insert(outEvents.end(), events.begin(), events.end());
+		}
+	}
+
+
+	bool WriteChromeTrace(const char* pFilePath)
+	{
+		TraceFrame frame;
+		AppendFrames(frame.CPUEvents, gCPUProfiler, gCPUProfiler.GetFrameRange());
+		AppendFrames(frame.GPUEvents, gGPUProfiler, gGPUProfiler.GetFrameRange());
+
+		ChromeTraceWriter writer;
+		if (!writer.Open(pFilePath))
+			return false;
+		writer.WriteFrame(frame);
+		writer.Close();
+
+		E_LOG(Info, "Wrote trace with %d CPU and %d GPU events to '%s'", (uint32)frame.CPUEvents.size(), (uint32)frame.GPUEvents.size(), pFilePath);
+		return true;
+	}
+
+
+	bool BeginStreaming(const char* pFilePath, uint32 maxFrames)
+	{
+		if (sIsStreaming)
+			EndStreaming();
+
+		if (!sStreamWriter.Open(pFilePath))
+			return false;
+
+		// Only stream frames that start after this point
+		sNextCPUFrame		= gCPUProfiler.GetFrameRange().End;
+		sNextGPUFrame		= gGPUProfiler.GetFrameRange().End;
+		sMaxFrames			= maxFrames;
+		sNumFramesStreamed	= 0;
+		sNumFramesDropped	= 0;
+		sStopRequested		= false;
+		sIsStreaming		= true;
+
+		sWriterThread.RunThread(WriterThreadFunction, nullptr);
+		sWriterThread.SetName("Profiler Export");
+
+		E_LOG(Info, "Started streaming trace to '%s'", pFilePath);
+		return true;
+	}
+
+
+	void EndStreaming()
+	{
+		if (!sIsStreaming)
+			return;
+
+		{
+			std::scoped_lock lock(sLock);
+			sStopRequested = true;
+		}
+		sWakeUpCondition.notify_one();
+
+		// Wait for the writer to drain the pending frames and close the file
+		sWriterThread.StopThread();
+		sIsStreaming = false;
+
+		E_LOG(Info, "Stopped streaming trace. %d frames written, %d frames dropped", sNumFramesStreamed - sNumFramesDropped, sNumFramesDropped);
+	}
+
+
+	bool IsStreaming()
+	{
+		return sIsStreaming;
+	}
+
+
+	void Tick()
+	{
+		if (!sIsStreaming)
+			return;
+
+		URange cpuRange = gCPUProfiler.GetFrameRange();
+		URange gpuRange = gGPUProfiler.GetFrameRange();
+		cpuRange.Begin = Math::Max(cpuRange.Begin, sNextCPUFrame);
+		gpuRange.Begin = Math::Max(gpuRange.Begin, sNextGPUFrame);
+		if (cpuRange.Begin >= cpuRange.End && gpuRange.Begin >= gpuRange.End)
+			return;
+
+		uint32 numCPUFrames = cpuRange.End > cpuRange.Begin ? cpuRange.End - cpuRange.Begin : 0;
+		sNextCPUFrame = Math::Max(sNextCPUFrame, cpuRange.End);
+		sNextGPUFrame = Math::Max(sNextGPUFrame, gpuRange.End);
+		sNumFramesStreamed += numCPUFrames;
+
+		// Only copy the events here. Formatting and writing is left to the writer thread.
+		TraceFrame frame;
+		{
+			std::scoped_lock lock(sLock);
+			if (sPendingFrames.size() >= MaxPendingFrames)
+			{
+				sNumFramesDropped += numCPUFrames;
+				return;
+			}
+			if (!sFreeFrames.empty())
+			{
+				frame = std::move(sFreeFrames.back());
+				sFreeFrames.pop_back();
+			}
+		}
+
+		AppendFrames(frame.CPUEvents, gCPUProfiler, cpuRange);
+		AppendFrames(frame.GPUEvents, gGPUProfiler, gpuRange);
+
+		{
+			std::scoped_lock lock(sLock);
+			sPendingFrames.push_back(std::move(frame));
+		}
+		sWakeUpCondition.notify_one();
+
+		if (sMaxFrames > 0 && sNumFramesStreamed >= sMaxFrames)
+			EndStreaming();
+	}
+
+
+	static ConsoleCommand<const char*> gWriteTraceCommand("profiler.WriteTrace", [](const char* pPath) { WriteChromeTrace(pPath); });
+	static ConsoleCommand<const char*> gBeginTraceCommand("profiler.BeginTrace", [](const char* pPath) { BeginStreaming(pPath); });
+	static ConsoleCommand<> gEndTraceCommand("profiler.EndTrace", []() { EndStreaming(); });
+}
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+#include "Profiler.h"
+
+/*
+	Export of CPU and GPU profiler events to the Chrome Trace Event format.
+	The resulting json can be opened in chrome://tracing or https://ui.perfetto.dev.
+	CPU threads and GPU queues each get their own track, named after ThreadData::Name and QueueInfo::Name.
+
+	Usage:
+		// Write the frames currently in the profiler history
+		ProfilerExport::WriteChromeTrace("Saved/Trace.json");
+
+		// Continuously stream every frame to disk until EndStreaming is called
+		ProfilerExport::BeginStreaming("Saved/Trace.json");
+
+	Command line:
+		-trace=<path>		Start streaming at startup
+		-traceframes=<n>	Stop streaming after n CPU frames
+*/
+
+#if WITH_PROFILING
+
+namespace ProfilerExport
+{
+	// Write all frames in the CPU and GPU profiler history to a file. Blocks until the file is written.
+	bool WriteChromeTrace(const char* pFilePath);
+
+	// Start streaming completed frames to a file. Formatting and file IO happen on a background thread.
+	// If `maxFrames` is not 0, streaming stops automatically after that many CPU frames.
+	bool BeginStreaming(const char* pFilePath, uint32 maxFrames = 0);
+
+	// Stop streaming, flush all pending frames and close the file
+	void EndStreaming();
+
+	bool IsStreaming();
+
+	// Collect the frames completed since the last call and hand them to the background writer.
+	// Called by PROFILE_FRAME after the profilers are ticked.
+	void Tick();
+}
+
+#endif
@@ -0,0 +1,446 @@
+#include "stdafx.h"
+#include "ProfilerStats.h"
+#include "Core/ConsoleVariables.h"
+#include "Core/Paths.h"
+#include "Core/Stream.h"
+
+#if WITH_PROFILING
+
+namespace ProfilerStats
+{
+	static ConsoleVariable gEnabled("profiler.Stats", true);
+	static ConsoleVariable gWindowSize("profiler.Stats.Window", 512);
+	static ConsoleVariable gMinRegressionMs("profiler.Stats.MinRegressionMs", 0.05f);
+
+	/*
+		Log-linear histogram of sample times.
+		Each power of two is split in `NumSubBuckets` linear buckets, which bounds the relative error
+		of a percentile to half a bucket width without having to keep every sample.
+	*/
+	struct Histogram
+	{
+		static constexpr uint32 NumSubBuckets	= 32;
+		static constexpr int	MinExponent		= -14;		// 2^-14 ms ~= 61ns
+		static constexpr uint32 NumOctaves		= 27;		// Up to 2^13 ms ~= 8s
+		static constexpr uint32 NumBuckets		= NumSubBuckets * NumOctaves;
+
+		void Add(float value)
+		{
+			++Counts[GetBucket(value)];
+		}
+
+		float GetPercentile(float percentile, uint32 numSamples) const
+		{
+			uint32 target = Math::Max(1u, (uint32)ceilf(percentile * numSamples));
+			uint32 count = 0;
+			for (uint32 i = 0; i < NumBuckets; ++i)
+			{
+				count += Counts[i];
+				if (count >= target)
+					return GetBucketValue(i);
+			}
+			return GetBucketValue(NumBuckets - 1);
+		}
+
+	private:
+		static uint32 GetBucket(float value)
+		{
+			if (value <= 0.0f)
+				return 0;
+			// value = mantissa * 2^exponent, mantissa in [0.5, 1)
+			int exponent;
+			float mantissa = frexpf(value, &exponent);
+			int octave = exponent - MinExponent;
+			if (octave < 0)
+				return 0;
+			if (octave >= (int)NumOctaves)
+				return NumBuckets - 1;
+			uint32 subBucket = Math::Min((uint32)((mantissa - 0.5f) * 2.0f * NumSubBuckets), NumSubBuckets - 1);
+			return octave * NumSubBuckets + subBucket;
+		}
+
+		static float GetBucketValue(uint32 bucket)
+		{
+			uint32 octave = bucket / NumSubBuckets;
+			uint32 subBucket = bucket % NumSubBuckets;
+			float mantissa = 0.5f + (subBucket + 0.5f) / (2.0f * NumSubBuckets);
+			return ldexpf(mantissa, (int)octave + MinExponent);
+		}
+
+		StaticArray<uint32, NumBuckets> Counts{};
+	};
+
+	struct EventStats
+	{
+		const char*		pName			= nullptr;
+		const char*		pFilePath		= nullptr;
+		uint32			LineNumber		= 0;
+		bool			IsGPU			= false;
+
+		// Rolling window of per-frame samples
+		Array<float>	Window;
+		uint32			WindowIndex		= 0;
+		uint32			WindowCount		= 0;
+
+		// Lifetime
+		Histogram		Lifetime;
+		uint32			NumSamples		= 0;
+		double			Sum				= 0.0;
+		float			Min				= FLT_MAX;
+		float			Max				= 0.0f;
+	};
+
+	// Key of an event before hashing. Names are interned so pointers can be compared directly.
+	struct EventKey
+	{
+		const char* pName;
+		const char* pFilePath;
+		uint32		LineNumber;
+		uint32		QueueIndex;
+
+		bool operator==(const EventKey& rhs) const { return pName == rhs.pName && pFilePath == rhs.pFilePath && LineNumber == rhs.LineNumber && QueueIndex == rhs.QueueIndex; }
+
+		struct Hasher
+		{
+			using is_avalanching = void;
+			uint64 operator()(const EventKey& key) const
+			{
+				return ankerl::unordered_dense::detail::wyhash::hash(&key, sizeof(EventKey));
+			}
+		};
+	};
+
+	static HashMap<StringHash, EventStats>					sEvents;
+	static HashMap<EventKey, StringHash, EventKey::Hasher>	sHashCache;		// Avoid hashing strings for every event, every frame
+	static HashMap<StringHash, float>						sFrameTotals;	// Scratch: total time per event in a frame
+	static Array<float>										sSortScratch;
+	static uint32											sNextCPUFrame = 0;
+	static uint32											sNextGPUFrame = 0;
+	static float											sTicksToMs = 0.0f;
+
+	static StringHash GetCachedEventHash(const ProfilerEvent& event)
+	{
+		EventKey key{ event.pName, event.pFilePath, event.LineNumber, event.QueueIndex };
+		auto it = sHashCache.find(key);
+		if (it != sHashCache.end())
+			return it->second;
+		StringHash hash = GetEventHash(event);
+		sHashCache[key] = hash;
+		return hash;
+	}
+
+	static void AddSample(EventStats& stats, float time)
+	{
+		uint32 windowSize = (uint32)Math::Max(gWindowSize.Get(), 1);
+		if (stats.Window.size() != windowSize)
+		{
+			stats.Window.resize(windowSize);
+			stats.WindowIndex = 0;
+			stats.WindowCount = 0;
+		}
+		stats.Window[stats.WindowIndex] = time;
+		stats.WindowIndex = (stats.WindowIndex + 1) % windowSize;
+		stats.WindowCount = Math::Min(stats.WindowCount + 1, windowSize);
+
+		stats.Lifetime.Add(time);
+		++stats.NumSamples;
+		stats.Sum += time;
+		stats.Min = Math::Min(stats.Min, time);
+		stats.Max = Math::Max(stats.Max, time);
+	}
+
+	// Accumulate the total time of each event in a frame and record it as a single sample
+	static void AddFrame(Span<const ProfilerEvent> events, bool isGPU)
+	{
+		sFrameTotals.clear();
+		for (const ProfilerEvent& event : events)
+		{
+			if (!event.IsValid())
+				continue;
+
+			StringHash hash = GetCachedEventHash(event);
+			float time = (float)(event.TicksEnd - event.TicksBegin) * sTicksToMs;
+			auto it = sFrameTotals.find(hash);
+			if (it == sFrameTotals.end())
+			{
+				sFrameTotals[hash] = time;
+				EventStats& stats = sEvents[hash];
+				if (!stats.pName)
+				{
+					stats.pName			= event.pName;
+					stats.pFilePath		= event.pFilePath;
+					stats.LineNumber	= event.LineNumber;
+					stats.IsGPU			= isGPU;
+				}
+			}
+			else
+			{
+				it->second += time;
+			}
+		}
+
+		for (auto& [hash, time] : sFrameTotals)
+			AddSample(sEvents[hash], time);
+	}
+
+	static Summary GetRollingSummary(const EventStats& stats)
+	{
+		Summary summary;
+		if (stats.WindowCount == 0)
+			return summary;
+
+		sSortScratch.assign(stats.Window.begin(), stats.Window.begin() + stats.WindowCount);
+		std::sort(sSortScratch.begin(), sSortScratch.end());
+
+		auto Percentile = [](float percentile)
+			{
+				uint32 index = Math::Max(1u, (uint32)ceilf(percentile * sSortScratch.size())) - 1;
+				return sSortScratch[index];
+			};
+
+		double sum = 0.0;
+		for (float sample : sSortScratch)
+			sum += sample;
+
+		summary.NumSamples	= stats.WindowCount;
+		summary.Min			= sSortScratch.front();
+		summary.Max			= sSortScratch.back();
+		summary.Average		= (float)(sum / stats.WindowCount);
+		summary.P50			= Percentile(0.50f);
+		summary.P95			= Percentile(0.95f);
+		summary.P99			= Percentile(0.99f);
+		return summary;
+	}
+
+	static Summary GetLifetimeSummary(const EventStats& stats)
+	{
+		Summary summary;
+		if (stats.NumSamples == 0)
+			return summary;
+
+		summary.NumSamples	= stats.NumSamples;
+		summary.Min			= stats.Min;
+		summary.Max			= stats.Max;
+		summary.Average		= (float)(stats.Sum / stats.NumSamples);
+		// Clamp the histogram estimates to the exact range
+		summary.P50			= Math::Clamp(stats.Lifetime.GetPercentile(0.50f, stats.NumSamples), stats.Min, stats.Max);
+		summary.P95			= Math::Clamp(stats.Lifetime.GetPercentile(0.95f, stats.NumSamples), stats.Min, stats.Max);
+		summary.P99			= Math::Clamp(stats.Lifetime.GetPercentile(0.99f, stats.NumSamples), stats.Min, stats.Max);
+		return summary;
+	}
+
+
+	void Tick()
+	{
+		if (!gEnabled.Get())
+			return;
+
+		PROFILE_CPU_SCOPE("Profiler Stats");
+
+		if (sTicksToMs == 0.0f)
+		{
+			uint64 frequency = 0;
+			QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+			sTicksToMs = 1000.0f / frequency;
+		}
+
+		URange cpuRange = gCPUProfiler.GetFrameRange();
+		for (uint32 frameIndex = Math::Max(cpuRange.Begin, sNextCPUFrame); frameIndex < cpuRange.End; ++frameIndex)
+			AddFrame(gCPUProfiler.GetEventData(frameIndex).GetEvents(), false);
+		sNextCPUFrame = Math::Max(sNextCPUFrame, cpuRange.End);
+
+		URange gpuRange = gGPUProfiler.GetFrameRange();
+		for (uint32 frameIndex = Math::Max(gpuRange.Begin, sNextGPUFrame); frameIndex < gpuRange.End; ++frameIndex)
+			AddFrame(gGPUProfiler.GetEventData(frameIndex).GetEvents(), true);
+		sNextGPUFrame = Math::Max(sNextGPUFrame, gpuRange.End);
+	}
+
+
+	void Reset()
+	{
+		sEvents.clear();
+	}
+
+
+	bool GetStats(StringHash eventHash, Summary* pOutRolling, Summary* pOutLifetime)
+	{
+		auto it = sEvents.find(eventHash);
+		if (it == sEvents.end())
+			return false;
+
+		if (pOutRolling)
+			*pOutRolling = GetRollingSummary(it->second);
+		if (pOutLifetime)
+			*pOutLifetime = GetLifetimeSummary(it->second);
+		return true;
+	}
+
+
+	bool FindEvent(const char* pName, bool isGPU, StringHash* pOutHash)
+	{
+		for (const auto& [hash, stats] : sEvents)
+		{
+			if (stats.IsGPU == isGPU && strcmp(stats.pName, pName) == 0)
+			{
+				*pOutHash = hash;
+				return true;
+			}
+		}
+		return false;
+	}
+
+
+	//-----------------------------------------------------------------------------
+	// [SECTION] Summary files
+	//-----------------------------------------------------------------------------
+
+	/*
+		Tab-separated, one event per line:
+			hash	type	samples	min	avg	p50	p95	p99	max	name	location
+	*/
+	static constexpr const char* pSummaryHeader = "# hash\ttype\tsamples\tmin\tavg\tp50\tp95\tp99\tmax\tname\tlocation\n";
+
+	struct SummaryEntry
+	{
+		String	Name;
+		bool	IsGPU = false;
+		Summary	Stats;
+	};
+
+	static bool ReadSummary(const char* pFilePath, HashMap<StringHash, SummaryEntry>& outEntries)
+	{
+		FileStream stream;
+		if (!stream.Open(pFilePath, FileMode::Read))
+		{
+			E_LOG(Warning, "Failed to open stats summary '%s'", pFilePath);
+			return false;
+		}
+
+		char line[1024];
+		while (stream.ReadLine(line, ARRAYSIZE(line)))
+		{
+			if (line[0] == '#' || line[0] == '\0')
+				continue;
+
+			char buffer[1024];
+			const char* pFields[11];
+			if (CString::SplitString(line, buffer, pFields, ARRAYSIZE(pFields), false, '\t') < 10)
+				continue;
+
+			SummaryEntry entry;
+			entry.IsGPU				= strcmp(pFields[1], "GPU") == 0;
+			entry.Stats.NumSamples	= (uint32)strtoul(pFields[2], nullptr, 10);
+			entry.Stats.Min			= strtof(pFields[3], nullptr);
+			entry.Stats.Average		= strtof(pFields[4], nullptr);
+			entry.Stats.P50			= strtof(pFields[5], nullptr);
+			entry.Stats.P95			= strtof(pFields[6], nullptr);
+			entry.Stats.P99			= strtof(pFields[7], nullptr);
+			entry.Stats.Max			= strtof(pFields[8], nullptr);
+			entry.Name				= pFields[9];
+			outEntries[StringHash((uint32)strtoul(pFields[0], nullptr, 16))] = std::move(entry);
+		}
+		return true;
+	}
+
+
+	bool WriteSummary(const char* pFilePath)
+	{
+		String fullPath = Paths::MakeAbsolute(pFilePath);
+		Paths::CreateDirectoryTree(fullPath);
+
+		FileStream stream;
+		if (!stream.Open(fullPath.c_str(), FileMode::Write | FileMode::Create))
+		{
+			E_LOG(Warning, "Failed to open stats summary '%s'", fullPath.c_str());
+			return false;
+		}
+
+		String output = pSummaryHeader;
+		for (const auto& [hash, stats] : sEvents)
+		{
+			Summary summary = GetLifetimeSummary(stats);
+			String location = stats.pFilePath && stats.pFilePath[0] ? Sprintf("%s:%d", Paths::GetFileName(stats.pFilePath).c_str(), stats.LineNumber) : "-";
+			output += Sprintf("%08x\t%s\t%u\t%.4f\t%.4f\t%.4f\t%.4f\t%.4f\t%.4f\t%s\t%s\n",
+				(uint32)hash, stats.IsGPU ? "GPU" : "CPU", summary.NumSamples,
+				summary.Min, summary.Average, summary.P50, summary.P95, summary.P99, summary.Max,
+				stats.pName, location.c_str());
+		}
+		stream.Write(output.c_str(), (uint32)output.length());
+
+		E_LOG(Info, "Wrote stats summary of %d events to '%s'", (uint32)sEvents.size(), fullPath.c_str());
+		return true;
+	}
+
+
+	int CompareSummaries(const char* pBaselinePath, const char* pCurrentPath, float thresholdPercent, bool failOnMissing)
+	{
+		HashMap<StringHash, SummaryEntry> baseline;
+		HashMap<StringHash, SummaryEntry> current;
+		if (!ReadSummary(pBaselinePath, baseline) || !ReadSummary(pCurrentPath, current))
+			return -1;
+
+		// Ignore tiny absolute differences, those are mostly noise
+		const float minDifference = gMinRegressionMs.Get();
+		const float ratio = 1.0f + thresholdPercent / 100.0f;
+
+		int numRegressions = 0;
+		int numMissing = 0;
+		for (const auto& [hash, baseEntry] : baseline)
+		{
+			// A scope that disappeared may have been renamed, removed or just not run during the capture. It can't be compared.
+			auto it = current.find(hash);
+			if (it == current.end())
+			{
+				E_LOG(Warning, "[%s] %s: missing from current summary", baseEntry.IsGPU ? "GPU" : "CPU", baseEntry.Name.c_str());
+				++numMissing;
+				continue;
+			}
+
+			const Summary& base = baseEntry.Stats;
+			const Summary& curr = it->second.Stats;
+			if (curr.P95 > base.P95 * ratio && curr.P95 - base.P95 > minDifference)
+			{
+				E_LOG(Warning, "[%s] %s: p95 %.3f ms -> %.3f ms (+%.1f%%). p99 %.3f ms -> %.3f ms",
+					baseEntry.IsGPU ? "GPU" : "CPU", baseEntry.Name.c_str(),
+					base.P95, curr.P95, base.P95 > 0.0f ? (curr.P95 / base.P95 - 1.0f) * 100.0f : 0.0f,
+					base.P99, curr.P99);
+				++numRegressions;
+			}
+		}
+
+		for (const auto& [hash, entry] : current)
+		{
+			if (!baseline.contains(hash))
+				E_LOG(Info, "[%s] %s: new in current summary (p95 %.3f ms)", entry.IsGPU ? "GPU" : "CPU", entry.Name.c_str(), entry.Stats.P95);
+		}
+
+		E_LOG(Info, "Compared %d events. %d regressed by more than %.1f%%, %d missing", (uint32)baseline.size(), numRegressions, thresholdPercent, numMissing);
+		return failOnMissing ? numRegressions + numMissing : numRegressions;
+	}
+
+
+	// Log the events with the highest rolling p95
+	static void PrintStats(int count)
+	{
+		Array<std::pair<const EventStats*, Summary>> entries;
+		for (const auto& [hash, stats] : sEvents)
+			entries.emplace_back(&stats, GetRollingSummary(stats));
+		std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.second.P95 > b.second.P95; });
+
+		E_LOG(Info, "%-40s | %4s | %8s | %8s | %8s | %8s | %8s", "Event", "Type", "Avg", "p50", "p95", "p99", "Max");
+		for (uint32 i = 0; i < Math::Min((uint32)entries.size(), (uint32)count); ++i)
+		{
+			const EventStats& stats = *entries[i].first;
+			const Summary& summary = entries[i].second;
+			E_LOG(Info, "%-40s | %4s | %8.3f | %8.3f | %8.3f | %8.3f | %8.3f", stats.pName, stats.IsGPU ? "GPU" : "CPU",
+				summary.Average, summary.P50, summary.P95, summary.P99, summary.Max);
+		}
+	}
+
+	static ConsoleCommand<int> gPrintCommand("profiler.Stats.Print", [](int count) { PrintStats(count); });
+	static ConsoleCommand<> gResetCommand("profiler.Stats.Reset", []() { Reset(); });
+	static ConsoleCommand<const char*> gWriteCommand("profiler.Stats.Write", [](const char* pPath) { WriteSummary(pPath); });
+	static ConsoleCommand<const char*, const char*, float> gCompareCommand("profiler.Stats.Compare", [](const char* pBaseline, const char* pCurrent, float threshold) { CompareSummaries(pBaseline, pCurrent, threshold); });
+}
+
+#endif
@@ -0,0 +1,81 @@
+#pragma once
+#include "Profiler.h"
+
+/*
+	Frame statistics on top of the CPU and GPU profiler.
+	Every frame, the total time of each event is recorded as one sample. Events are identified by name,
+	source file name and GPU queue. The directory and line are left out, so the same scope maps to the same entry
+	across checkouts and unrelated edits of the file. Scopes with the same name in the same file therefore share
+	one entry, and their times are summed per frame. Give them distinct names to measure them separately.
+
+	Two sets of statistics are kept per event:
+		- Rolling: exact, over the last `profiler.Stats.Window` frames
+		- Lifetime: since startup or the last Reset. Percentiles come from a histogram with ~2% error
+
+	The lifetime statistics can be written to a tab-separated summary file and two summaries
+	can be compared to find scopes whose p95 regressed.
+
+	Command line:
+		-statssummary=<path>				Write a summary on exit
+		-statsbaseline=<path>				Compare two summaries and exit. The exit code is 1 if anything regressed
+		-statscurrent=<path>
+		-statsthreshold=<percent>			Allowed p95 increase before a scope counts as regressed. Default 10
+		-statsfailmissing					Also fail when a scope of the baseline is missing from the current summary
+*/
+
+#if WITH_PROFILING
+
+namespace ProfilerStats
+{
+	// Identifies an event by name, source file name and queue
+	inline StringHash GetEventHash(const ProfilerEvent& event)
+	{
+		const char* pFileName = event.pFilePath;
+		for (const char* pChar = event.pFilePath; pChar && *pChar; ++pChar)
+		{
+			if (*pChar == '/' || *pChar == '\\')
+				pFileName = pChar + 1;
+		}
+
+		StringHash hash;
+		hash.Combine(StringHash(event.pName));
+		hash.Combine(StringHash(pFileName));
+		hash.Combine(event.QueueIndex);
+		return hash;
+	}
+
+	// Statistics in milliseconds
+	struct Summary
+	{
+		uint32	NumSamples	= 0;
+		float	Min			= 0.0f;
+		float	Average		= 0.0f;
+		float	P50			= 0.0f;
+		float	P95			= 0.0f;
+		float	P99			= 0.0f;
+		float	Max			= 0.0f;
+	};
+
+	// Gather the frames completed since the last call. Called by PROFILE_FRAME after the profilers are ticked.
+	void Tick();
+
+	// Clear all statistics
+	void Reset();
+
+	// Retrieve statistics of an event. Returns false if the event was never recorded.
+	bool GetStats(StringHash eventHash, Summary* pOutRolling, Summary* pOutLifetime = nullptr);
+
+	// Find the hash of the first recorded event with the given name
+	bool FindEvent(const char* pName, bool isGPU, StringHash* pOutHash);
+
+	// Write the lifetime statistics of all events to a tab-separated file
+	bool WriteSummary(const char* pFilePath);
+
+	// Compare two summary files and report each event whose p95 increased by more than `thresholdPercent`.
+	// Events of the baseline that are missing from the current summary are reported as warnings,
+	// and only count as failures with `failOnMissing`, since scopes that don't run every frame may be absent from a short capture.
+	// Returns the number of failures or -1 if either file could not be read.
+	int CompareSummaries(const char* pBaselinePath, const char* pCurrentPath, float thresholdPercent, bool failOnMissing = false);
+}
+
+#endif
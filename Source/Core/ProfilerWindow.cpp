@@ -95,16 +95,6 @@ static void EditStyle(StyleOptions& style)
 	ImGui::PopItemWidth();
 }
 
-static StringHash GetEventHash(const ProfilerEvent& event)
-{
-	StringHash hash;
-	hash.Combine(StringHash(event.pName));
-	hash.Combine(StringHash(event.pFilePath));
-	hash.Combine(event.LineNumber);
-	hash.Combine(event.QueueIndex);
-	return hash;
-}
-
 static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 {
 	PROFILE_CPU_SCOPE();
@@ -334,8 +324,8 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 					}
 					if (clicked)
 					{
-						StringHash eventHash = GetEventHash(event);
-						context.SelectedEvent.Set(GetEventHash(event), isCPUEvent);
+						StringHash eventHash = ProfilerStats::GetEventHash(event);
+						context.SelectedEvent.Set(ProfilerStats::GetEventHash(event), isCPUEvent);
 					}
 				}
 			};
@@ -547,7 +537,7 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 					const ProfilerEventData& eventData = gCPUProfiler.GetEventData(i);
 					for (const ProfilerEvent& event : eventData.GetEvents())
 					{
-						if (GetEventHash(event) == selectedEvent.Hash)
+						if (ProfilerStats::GetEventHash(event) == selectedEvent.Hash)
 						{
 							float time = TicksToMs * (float)(event.TicksEnd - event.TicksBegin);
 							selectedEvent.AddSample(time);
@@ -566,7 +556,7 @@ static void DrawProfilerTimeline(const ImVec2& size = ImVec2(0, 0))
 					const ProfilerEventData& eventData = gGPUProfiler.GetEventData(i);
 					for (const ProfilerEvent& event : eventData.GetEvents())
 					{
-						if (GetEventHash(event) == context.SelectedEvent.Hash)
+						if (ProfilerStats::GetEventHash(event) == context.SelectedEvent.Hash)
 						{
 							float time = TicksToMs * (float)(event.TicksEnd - event.TicksBegin);
 							selectedEvent.AddSample(time);
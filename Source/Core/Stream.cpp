@@ -217,3 +217,55 @@ void FileStream::Seek(int offset, StreamSeekMode mode)
 		m_Position += offset;
 	}
 }
+
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const char* pFile)
+{
+	Close();
+
+	m_pFile = ::CreateFileA(pFile, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_pFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(m_pFile, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_pMapping = ::CreateFileMappingA(m_pFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_pMapping)
+	{
+		Close();
+		return false;
+	}
+
+	m_pData = ::MapViewOfFile(m_pMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!m_pData)
+	{
+		Close();
+		return false;
+	}
+	m_Size = (uint64)size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_pData)
+		::UnmapViewOfFile(m_pData);
+	if (m_pMapping)
+		::CloseHandle(m_pMapping);
+	if (m_pFile != INVALID_HANDLE_VALUE)
+		::CloseHandle(m_pFile);
+	m_pData = nullptr;
+	m_pMapping = nullptr;
+	m_pFile = INVALID_HANDLE_VALUE;
+	m_Size = 0;
+}
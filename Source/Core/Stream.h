@@ -177,3 +177,29 @@ private:
 	uint32 m_Position	= 0;
 	FileMode m_Mode		= FileMode::None;
 };
+
+
+// Read-only view of a whole file mapped into memory.
+// Pages are read in by the OS as they are touched, so nothing is copied up front.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const char* pFile);
+	void Close();
+
+	const void* GetData() const		{ return m_pData; }
+	uint64		GetSize() const		{ return m_Size; }
+	bool		IsOpen() const		{ return m_pData != nullptr; }
+
+private:
+	HANDLE		m_pFile		= INVALID_HANDLE_VALUE;
+	HANDLE		m_pMapping	= nullptr;
+	const void* m_pData		= nullptr;
+	uint64		m_Size		= 0;
+};
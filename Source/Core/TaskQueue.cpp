@@ -1,18 +1,140 @@
 #include "stdafx.h"
 #include "TaskQueue.h"
+#include <semaphore>
 
 struct AsyncTask
 {
-	AsyncTaskDelegate Action;
-	TaskContext* pCounter;
+	AsyncTaskDelegate	Action;
+	TaskContext*		pCounter	= nullptr;	///< Optional counter decremented when the task finishes
+	bool				IsPooled	= false;	///< False if heap allocated by a thread not owned by the scheduler
+	std::atomic<bool>	InUse		= false;	///< True while the pool slot is occupied
 };
 
-static std::deque<AsyncTask> m_Queue;
-static std::condition_variable m_WakeUpCondition;
-static std::mutex m_QueueMutex;
-static std::mutex m_SleepMutex;
-static bool m_Shutdown = false;
+static constexpr uint32 MaxTasksPerThread = 2048;
+static_assert((MaxTasksPerThread & (MaxTasksPerThread - 1)) == 0, "Must be a power of 2");
+
+// Fixed capacity, lock-free work-stealing deque.
+// Based on "Correct and Efficient Work-Stealing for Weak Memory Models" - Le et al. 2013
+// Only the owning thread can Push/Pop, any thread can Steal.
+class TaskDeque
+{
+public:
+	bool Push(AsyncTask* pTask)
+	{
+		int64 bottom = m_Bottom.load(std::memory_order_relaxed);
+		int64 top = m_Top.load(std::memory_order_acquire);
+		if (bottom - top >= (int64)MaxTasksPerThread)
+			return false;
+		m_Tasks[bottom & (MaxTasksPerThread - 1)].store(pTask, std::memory_order_relaxed);
+		m_Bottom.store(bottom + 1, std::memory_order_release);
+		return true;
+	}
+
+	AsyncTask* Pop()
+	{
+		int64 bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+		m_Bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64 top = m_Top.load(std::memory_order_relaxed);
+
+		AsyncTask* pTask = nullptr;
+		if (top <= bottom)
+		{
+			pTask = m_Tasks[bottom & (MaxTasksPerThread - 1)].load(std::memory_order_relaxed);
+			if (top == bottom)
+			{
+				// Last element, race against stealers
+				if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					pTask = nullptr;
+				m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+			}
+		}
+		else
+		{
+			m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+		return pTask;
+	}
+
+	AsyncTask* Steal()
+	{
+		int64 top = m_Top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64 bottom = m_Bottom.load(std::memory_order_acquire);
+		if (top < bottom)
+		{
+			AsyncTask* pTask = m_Tasks[top & (MaxTasksPerThread - 1)].load(std::memory_order_relaxed);
+			if (m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				return pTask;
+		}
+		return nullptr;
+	}
+
+	bool IsEmpty() const
+	{
+		return m_Bottom.load(std::memory_order_relaxed) <= m_Top.load(std::memory_order_relaxed);
+	}
+
+	bool IsFull() const
+	{
+		return m_Bottom.load(std::memory_order_relaxed) - m_Top.load(std::memory_order_relaxed) >= (int64)MaxTasksPerThread;
+	}
+
+private:
+	alignas(64) std::atomic<int64>									m_Top		= 0;
+	alignas(64) std::atomic<int64>									m_Bottom	= 0;
+	alignas(64) StaticArray<std::atomic<AsyncTask*>, MaxTasksPerThread>	m_Tasks		{};
+};
+
+// Per-thread task storage.
+// Only the owning thread allocates, any thread can release after executing the task.
+// Sized larger than the deque so that, when the deque is not full, a free slot is found within a few probes.
+class TaskPool
+{
+public:
+	static constexpr uint32 Capacity = MaxTasksPerThread * 2;
+
+	AsyncTask* Allocate()
+	{
+		for (uint32 i = 0; i < Capacity; ++i)
+		{
+			AsyncTask& task = m_Tasks[m_Next++ & (Capacity - 1)];
+			if (!task.InUse.load(std::memory_order_acquire))
+			{
+				task.InUse.store(true, std::memory_order_relaxed);
+				task.IsPooled = true;
+				return &task;
+			}
+		}
+		return nullptr;
+	}
+
+private:
+	StaticArray<AsyncTask, Capacity>	m_Tasks;
+	uint32								m_Next = 0;
+};
+
+struct WorkerData
+{
+	TaskDeque				Queue;
+	TaskPool				Pool;
+	std::binary_semaphore	WakeUpSignal{ 0 };
+	std::atomic<bool>		IsSleeping	= false;
+	uint32					RandomSeed	= 0;
+};
+
+static WorkerData* m_pWorkers = nullptr;
+static uint32 m_NumWorkers = 0;
+static std::deque<AsyncTask*> m_InjectionQueue;
+static std::mutex m_InjectionMutex;
+static std::atomic<uint32> m_InjectionQueueSize = 0;
+static std::atomic<uint32> m_NumSleeping = 0;
+static std::atomic<bool> m_Shutdown = false;
 static Array<Thread> m_Threads;
+static thread_local int32 tThreadIndex = -1;
+
+// Number of failed attempts to find work before a worker parks
+static constexpr uint32 SpinCountBeforeSleep = 64;
 
 TaskQueue::~TaskQueue()
 {
@@ -21,47 +143,231 @@ TaskQueue::~TaskQueue()
 
 void TaskQueue::Initialize(uint32 threads)
 {
+	threads = Math::Max(threads, 1u);
+	m_Shutdown = false;
+	m_NumWorkers = threads;
+	m_pWorkers = new WorkerData[threads];
+	for (uint32 i = 0; i < threads; ++i)
+		m_pWorkers[i].RandomSeed = 0x9E3779B9u * (i + 1);
+
+	// The thread initializing the queue is worker 0 and participates when it Joins
+	tThreadIndex = 0;
 	CreateThreads(threads);
 }
 
+// Wake up a worker if it is parked. Returns true if this call woke it up.
+static bool WakeWorker(WorkerData& worker)
+{
+	if (worker.IsSleeping.load(std::memory_order_relaxed) && worker.IsSleeping.exchange(false))
+	{
+		m_NumSleeping.fetch_sub(1);
+		worker.WakeUpSignal.release();
+		return true;
+	}
+	return false;
+}
+
+// Wake up to `count` parked workers
+static void WakeWorkers(uint32 count)
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_NumSleeping.load() == 0)
+		return;
+
+	// Worker 0 is the main thread which never parks
+	for (uint32 i = 1; i < m_NumWorkers && count > 0; ++i)
+	{
+		if (WakeWorker(m_pWorkers[i]))
+			--count;
+	}
+}
+
 void TaskQueue::Shutdown()
 {
+	if (!m_pWorkers)
+		return;
+
 	m_Shutdown = true;
-	m_WakeUpCondition.notify_all();
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	for (uint32 i = 1; i < m_NumWorkers; ++i)
+		WakeWorker(m_pWorkers[i]);
+
+	m_Threads.clear();
+	delete[] m_pWorkers;
+	m_pWorkers = nullptr;
+	m_NumWorkers = 0;
 }
 
-bool DoWork(uint32 threadIndex)
+static bool HasWork()
 {
-	m_QueueMutex.lock();
-	if (!m_Queue.empty())
-	{
-		AsyncTask task = m_Queue.front();
-		m_Queue.pop_front();
-		m_QueueMutex.unlock();
-		task.Action.Execute(threadIndex);
-		task.pCounter->fetch_sub(1);
+	if (m_InjectionQueueSize.load() > 0)
 		return true;
+	for (uint32 i = 0; i < m_NumWorkers; ++i)
+	{
+		if (!m_pWorkers[i].Queue.IsEmpty())
+			return true;
+	}
+	return false;
+}
+
+// Returns nullptr if the calling thread's queue is full, in which case the task should be executed inline.
+static AsyncTask* AllocateTask(int32 threadIndex)
+{
+	if (threadIndex >= 0)
+	{
+		WorkerData& worker = m_pWorkers[threadIndex];
+		if (worker.Queue.IsFull())
+			return nullptr;
+		return worker.Pool.Allocate();
+	}
+	return new AsyncTask();
+}
+
+// Push a task on the calling thread's queue.
+// Returns false if the task could not be queued and should be executed inline.
+static bool PushTask(AsyncTask* pTask, int32 threadIndex)
+{
+	if (threadIndex >= 0)
+		return m_pWorkers[threadIndex].Queue.Push(pTask);
+
+	std::scoped_lock lock(m_InjectionMutex);
+	m_InjectionQueue.push_back(pTask);
+	m_InjectionQueueSize.fetch_add(1);
+	return true;
+}
+
+static void ExecuteTask(AsyncTask* pTask, int32 threadIndex)
+{
+	pTask->Action.Execute(Math::Max(threadIndex, 0));
+
+	// Release the task before signaling the counter. The counter may be destroyed as soon as it reaches 0.
+	TaskContext* pCounter = pTask->pCounter;
+	if (pTask->IsPooled)
+	{
+		pTask->Action.Clear();
+		pTask->InUse.store(false, std::memory_order_release);
 	}
 	else
 	{
-		m_QueueMutex.unlock();
+		delete pTask;
+	}
+	if (pCounter)
+		pCounter->fetch_sub(1);
+}
+
+// Queue a task on the calling thread, or execute it inline if the queue is full.
+// Returns true if the task was queued.
+static bool ScheduleTask(AsyncTaskDelegate&& action, TaskContext* pContext, int32 threadIndex)
+{
+	AsyncTask* pTask = AllocateTask(threadIndex);
+	if (!pTask)
+	{
+		action.Execute(Math::Max(threadIndex, 0));
 		return false;
 	}
+
+	pTask->pCounter = pContext;
+	pTask->Action = std::move(action);
+	if (pContext)
+		pContext->fetch_add(1);
+
+	if (!PushTask(pTask, threadIndex))
+	{
+		ExecuteTask(pTask, threadIndex);
+		return false;
+	}
+	return true;
+}
+
+static AsyncTask* FindWork(int32 threadIndex)
+{
+	// Own queue first, LIFO for cache locality
+	if (threadIndex >= 0)
+	{
+		if (AsyncTask* pTask = m_pWorkers[threadIndex].Queue.Pop())
+			return pTask;
+	}
+
+	// Tasks pushed by threads not owned by the scheduler
+	if (m_InjectionQueueSize.load(std::memory_order_relaxed) > 0)
+	{
+		std::scoped_lock lock(m_InjectionMutex);
+		if (!m_InjectionQueue.empty())
+		{
+			AsyncTask* pTask = m_InjectionQueue.front();
+			m_InjectionQueue.pop_front();
+			m_InjectionQueueSize.fetch_sub(1);
+			return pTask;
+		}
+	}
+
+	// Steal from a random victim
+	uint32 seed = threadIndex >= 0 ? m_pWorkers[threadIndex].RandomSeed : Thread::GetCurrentId();
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	if (threadIndex >= 0)
+		m_pWorkers[threadIndex].RandomSeed = seed;
+
+	for (uint32 i = 0; i < m_NumWorkers; ++i)
+	{
+		uint32 victimIndex = (seed + i) % m_NumWorkers;
+		if ((int32)victimIndex == threadIndex)
+			continue;
+
+		WorkerData& victim = m_pWorkers[victimIndex];
+		if (AsyncTask* pTask = victim.Queue.Steal())
+		{
+			// If there's more work left, chain the wake-up to another worker
+			if (!victim.Queue.IsEmpty())
+				WakeWorkers(1);
+			return pTask;
+		}
+	}
+	return nullptr;
+}
+
+static void ParkWorker(uint32 threadIndex)
+{
+	WorkerData& worker = m_pWorkers[threadIndex];
+	worker.IsSleeping.store(true);
+	m_NumSleeping.fetch_add(1);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// Re-check after announcing the intent to sleep so a concurrent push can't be missed
+	if (HasWork() || m_Shutdown)
+	{
+		if (worker.IsSleeping.exchange(false))
+		{
+			m_NumSleeping.fetch_sub(1);
+			return;
+		}
+		// Someone already claimed this worker to be woken up. Consume the signal.
+	}
+	worker.WakeUpSignal.acquire();
 }
 
 DWORD WINAPI WorkFunction(LPVOID lpParameter)
 {
-	wchar_t* pDescription;
-	GetThreadDescription(GetCurrentThread(), &pDescription);
+	uint32 threadIndex = (uint32)reinterpret_cast<size_t>(lpParameter);
+	tThreadIndex = (int32)threadIndex;
 
-	size_t threadIndex = reinterpret_cast<size_t>(lpParameter);
+	uint32 failedAttempts = 0;
 	while (!m_Shutdown)
 	{
-		bool didWork = DoWork((uint32)threadIndex);
-		if (!didWork)
+		if (AsyncTask* pTask = FindWork(threadIndex))
 		{
-			std::unique_lock lock(m_SleepMutex);
-			m_WakeUpCondition.wait(lock);
+			ExecuteTask(pTask, threadIndex);
+			failedAttempts = 0;
+		}
+		else if (++failedAttempts < SpinCountBeforeSleep)
+		{
+			YieldProcessor();
+		}
+		else
+		{
+			ParkWorker(threadIndex);
+			failedAttempts = 0;
 		}
 	}
 	return 0;
@@ -83,32 +389,122 @@ void TaskQueue::CreateThreads(uint32 count)
 
 void TaskQueue::AddWorkItem(const AsyncTaskDelegate& action, TaskContext& context)
 {
-	AsyncTask task;
-	task.pCounter = &context;
-	task.Action = action;
-
-	std::scoped_lock lock(m_QueueMutex);
-	m_Queue.push_back(task);
-	context.fetch_add(1);
+	if (ScheduleTask(AsyncTaskDelegate(action), &context, tThreadIndex))
+		WakeWorkers(1);
+}
 
-	m_WakeUpCondition.notify_one();
+// Execute pending work on the calling thread until the counter reaches 0
+static void HelpUntilZero(const TaskContext& counter)
+{
+	int32 threadIndex = tThreadIndex;
+	while (counter.load() > 0)
+	{
+		if (AsyncTask* pTask = FindWork(threadIndex))
+			ExecuteTask(pTask, threadIndex);
+		else
+			YieldProcessor();
+	}
 }
 
 void TaskQueue::Join(TaskContext& context)
 {
-	if (context > 0)
+	HelpUntilZero(context);
+}
+
+uint32 TaskQueue::ThreadCount()
+{
+	return (uint32)m_Threads.size();
+}
+
+int32 TaskQueue::GetThreadIndex()
+{
+	return tThreadIndex;
+}
+
+//-----------------------------------------------------------------------------
+// [SECTION] Parallel Loops
+//-----------------------------------------------------------------------------
+
+// Shared state of all tasks working on a single range
+struct RangeTaskState
+{
+	AsyncRangeDelegate		Action;
+	TaskContext*			pContext		= nullptr;	///< Counter tracking all range tasks
+	uint32					GrainSize		= 1;		///< Ranges are not split below this size
+	std::atomic<uint32>		NumRefs			= 1;		///< Number of tasks referencing the state
+	bool					IsHeapAllocated	= false;	///< If true, deleted by the last task referencing it
+};
+
+static uint32 ComputeGrainSize(uint32 count)
+{
+	// Aim for a few ranges per thread so stealing can balance uneven work
+	constexpr uint32 RangesPerThread = 4;
+	return Math::Max(1u, count / (TaskQueue::ThreadCount() * RangesPerThread));
+}
+
+static void ReleaseRangeState(RangeTaskState* pState)
+{
+	if (pState->NumRefs.fetch_sub(1) == 1 && pState->IsHeapAllocated)
+		delete pState;
+}
+
+// Split the range in halves, push the upper half for other threads to steal and continue with the lower half.
+static void ExecuteRange(RangeTaskState* pState, uint32 begin, uint32 end)
+{
+	while (end - begin > pState->GrainSize)
 	{
-		m_WakeUpCondition.notify_all();
-		while (context.load() > 0)
-		{
-			DoWork(0);
-		}
+		uint32 mid = begin + (end - begin) / 2;
+		pState->NumRefs.fetch_add(1);
+		auto executeUpper = [pState, mid, end](int)
+			{
+				ExecuteRange(pState, mid, end);
+				ReleaseRangeState(pState);
+			};
+		if (ScheduleTask(AsyncTaskDelegate::CreateLambda(std::move(executeUpper)), pState->pContext, tThreadIndex))
+			WakeWorkers(1);
+		end = mid;
 	}
+	pState->Action.Execute(begin, end, Math::Max(tThreadIndex, 0));
 }
 
-uint32 TaskQueue::ThreadCount()
+void TaskQueue::ParallelForInternal(uint32 count, const AsyncRangeDelegate& action, uint32 grainSize, uint32 maxThreads)
 {
-	return (uint32)m_Threads.size() + 1;
+	if (count == 0)
+		return;
+
+	TaskContext context;
+	if (maxThreads > 0)
+	{
+		// A fixed number of lanes pull ranges from a shared counter, so no more than `maxThreads` threads run the loop at once
+		const uint32 laneGrainSize = grainSize > 0 ? grainSize : ComputeGrainSize(count);
+		std::atomic<uint64> next = 0;
+		auto executeLane = [&](int)
+			{
+				while (true)
+				{
+					const uint64 begin = next.fetch_add(laneGrainSize);
+					if (begin >= count)
+						break;
+					action.Execute((uint32)begin, (uint32)Math::Min<uint64>(begin + laneGrainSize, count), Math::Max(tThreadIndex, 0));
+				}
+			};
+		for (uint32 i = 1; i < maxThreads; ++i)
+		{
+			if (ScheduleTask(AsyncTaskDelegate::CreateLambda(executeLane), &context, tThreadIndex))
+				WakeWorkers(1);
+		}
+		executeLane(0);
+		HelpUntilZero(context);
+		return;
+	}
+
+	RangeTaskState state;
+	state.Action	= action;
+	state.pContext	= &context;
+	state.GrainSize = grainSize > 0 ? grainSize : ComputeGrainSize(count);
+
+	ExecuteRange(&state, 0, count);
+	HelpUntilZero(context);
 }
 
 void TaskQueue::Distribute(TaskContext& context, const AsyncDistributeDelegate& action, uint32 count, int32 groupSize /*= -1*/)
@@ -117,30 +513,100 @@ void TaskQueue::Distribute(TaskContext& context, const AsyncDistributeDelegate&
 	{
 		return;
 	}
-	if (groupSize == -1)
+
+	// The state outlives this call, it's released by the last task working on the range
+	RangeTaskState* pState = new RangeTaskState();
+	pState->pContext		= &context;
+	pState->GrainSize		= groupSize > 0 ? (uint32)groupSize : ComputeGrainSize(count);
+	pState->IsHeapAllocated = true;
+	pState->Action			= AsyncRangeDelegate::CreateLambda([action](uint32 begin, uint32 end, int threadIndex)
+		{
+			for (uint32 i = begin; i < end; ++i)
+			{
+				action.Execute(TaskDistributeArgs{ (int)i, threadIndex });
+			}
+		});
+
+	auto executeRoot = [pState, count](int)
+		{
+			ExecuteRange(pState, 0, count);
+			ReleaseRangeState(pState);
+		};
+	if (ScheduleTask(AsyncTaskDelegate::CreateLambda(std::move(executeRoot)), &context, tThreadIndex))
+		WakeWorkers(1);
+}
+
+
+//-----------------------------------------------------------------------------
+// [SECTION] Task Graph
+//-----------------------------------------------------------------------------
+
+// Called when a dependency of the task is resolved. Schedules the task when none are left.
+void TaskQueue::ReleaseDependency(const TaskHandle& pTask)
+{
+	if (pTask->m_NumPending.fetch_sub(1) == 1)
 	{
-		groupSize = ThreadCount();
+		if (ScheduleTask(AsyncTaskDelegate::CreateLambda([pTask](int threadIndex) { RunTaskNode(pTask, threadIndex); }), nullptr, tThreadIndex))
+			WakeWorkers(1);
 	}
-	uint32 jobs = (uint32)Math::Ceil((float)count / groupSize);
-	context.fetch_add(jobs);
+}
+
+void TaskQueue::RunTaskNode(const TaskHandle& pNode, int threadIndex)
+{
+	pNode->m_Action.Execute(threadIndex);
+	pNode->m_Action.Clear();
 
+	// Mark finished and take the continuations. No continuations can be added after this point.
+	Array<TaskHandle> continuations;
 	{
-		std::scoped_lock lock(m_QueueMutex);
-		for (uint32 i = 0; i < jobs; ++i)
-		{
-			AsyncTask task;
-			task.pCounter = &context;
-			task.Action = AsyncTaskDelegate::CreateLambda([action, i, count, groupSize](int threadIndex)
-				{
-					uint32 start = i * groupSize;
-					uint32 end = Math::Min(start + groupSize, count);
-					for (uint32 j = start; j < end; ++j)
-					{
-						action.Execute(TaskDistributeArgs{ (int)j, threadIndex });
-					}
-				});
-			m_Queue.push_back(task);
-		}
+		std::scoped_lock lock(pNode->m_ContinuationLock);
+		pNode->m_IsFinished = true;
+		continuations.swap(pNode->m_Continuations);
 	}
-	m_WakeUpCondition.notify_all();
+
+	for (const TaskHandle& pContinuation : continuations)
+		ReleaseDependency(pContinuation);
+
+	// Signal the counters last, continuations are already accounted for in the context
+	pNode->m_Counter.fetch_sub(1);
+	if (pNode->m_pContext)
+		pNode->m_pContext->fetch_sub(1);
+}
+
+TaskHandle TaskQueue::CreateTaskInternal(AsyncTaskDelegate&& action, Span<const TaskHandle> predecessors, TaskContext* pContext)
+{
+	TaskHandle pTask = new TaskNode();
+	pTask->m_Action = std::move(action);
+	pTask->m_pContext = pContext;
+	if (pContext)
+		pContext->fetch_add(1);
+	for (const TaskHandle& pPredecessor : predecessors)
+		AddDependency(pTask, pPredecessor);
+	return pTask;
+}
+
+void TaskQueue::AddDependency(const TaskHandle& pTask, const TaskHandle& pPredecessor)
+{
+	gAssert(pTask && !pTask->m_IsSubmitted, "Dependencies can only be added before the task is submitted");
+	if (!pPredecessor)
+		return;
+
+	std::scoped_lock lock(pPredecessor->m_ContinuationLock);
+	if (pPredecessor->m_IsFinished)
+		return;
+	pTask->m_NumPending.fetch_add(1);
+	pPredecessor->m_Continuations.push_back(pTask);
+}
+
+void TaskQueue::Submit(const TaskHandle& pTask)
+{
+	gAssert(!pTask->m_IsSubmitted, "Task is already submitted");
+	pTask->m_IsSubmitted = true;
+	ReleaseDependency(pTask);
+}
+
+void TaskQueue::Join(const TaskHandle& pTask)
+{
+	if (pTask)
+		HelpUntilZero(pTask->m_Counter);
 }
@@ -10,9 +10,38 @@ struct TaskDistributeArgs
 
 DECLARE_DELEGATE(AsyncTaskDelegate, int);
 DECLARE_DELEGATE(AsyncDistributeDelegate, TaskDistributeArgs);
+DECLARE_DELEGATE(AsyncRangeDelegate, uint32 /*begin*/, uint32 /*end*/, int /*threadIndex*/);
 
 using TaskContext = std::atomic<uint32>;
 
+// A task in a dependency graph. See TaskQueue::CreateTask.
+class TaskNode : public RefCounted<TaskNode>
+{
+public:
+	bool IsFinished() const { return m_Counter.load() == 0; }
+
+private:
+	friend class TaskQueue;
+
+	AsyncTaskDelegate		m_Action;
+	TaskContext				m_Counter		= 1;		///< Reaches 0 when the task and its continuation scheduling is done
+	TaskContext*			m_pContext		= nullptr;	///< Optional context to track the task in
+	std::atomic<uint32>		m_NumPending	= 1;		///< Number of unfinished predecessors. +1 until submitted
+	std::mutex				m_ContinuationLock;
+	Array<Ref<TaskNode>>	m_Continuations;			///< Tasks waiting on this task
+	bool					m_IsFinished	= false;	///< Guarded by m_ContinuationLock
+	bool					m_IsSubmitted	= false;
+};
+
+using TaskHandle = Ref<TaskNode>;
+
+/*
+	Work-stealing task scheduler.
+	Each thread owns a Chase-Lev deque. Tasks pushed by a thread go to its own deque,
+	the owner pops from the bottom (LIFO) while idle threads steal from the top (FIFO).
+	Threads that are not owned by the scheduler push into a shared injection queue.
+	Idle workers park individually and are woken one at a time when work is pushed.
+*/
 class TaskQueue
 {
 public:
@@ -25,17 +54,119 @@ public:
 	{
 		AddWorkItem(AsyncTaskDelegate::CreateLambda(std::forward<Callback>(action)), context);
 	}
+	// Asynchronously execute `count` jobs. The jobs are split recursively into ranges of at most `groupSize` jobs, like ParallelFor.
+	// -1 picks the size from the job count, aiming for a few ranges per thread so stealing can balance uneven jobs.
+	// The default used to be ThreadCount() jobs per group. Pass ThreadCount() to keep that.
 	template<typename Callback>
 	static void ExecuteMany(Callback&& action, TaskContext& context, uint32 count, int32 groupSize = -1)
 	{
 		Distribute(context, AsyncDistributeDelegate::CreateLambda(std::forward<Callback>(action)), count, groupSize);
 	}
 	static void Join(TaskContext& context);
+
+	/*
+		Parallel loops.
+		The range is split recursively in halves down to the grain size. The second half is pushed
+		as a task that idle threads can steal while the first half is processed by the current thread.
+		A grain size of 0 picks one based on the range size and the number of threads.
+		`maxThreads` limits the number of threads working on the range at the same time, including the calling thread. 0 means no limit.
+		With a limit, that many tasks pull ranges of the grain size from a shared counter instead of splitting the range.
+		Both functions block until the whole range is processed.
+
+		Usage:
+			TaskQueue::ParallelFor(numItems, [&](TaskDistributeArgs args) { Process(args.JobIndex); });
+			float sum = TaskQueue::ParallelReduce(numItems, 0.0f, [&](uint32 i) { return values[i]; }, [](float a, float b) { return a + b; });
+	*/
+	template<typename Callback>
+	static void ParallelFor(uint32 count, Callback&& action, uint32 grainSize = 0, uint32 maxThreads = 0)
+	{
+		ParallelForInternal(count, AsyncRangeDelegate::CreateLambda([&action](uint32 begin, uint32 end, int threadIndex)
+			{
+				for (uint32 i = begin; i < end; ++i)
+					action(TaskDistributeArgs{ (int)i, threadIndex });
+			}), grainSize, maxThreads);
+	}
+
+	// `reduce` must be associative and commutative, the order in which partial results are combined is not deterministic.
+	template<typename T, typename MapFn, typename ReduceFn>
+	static T ParallelReduce(uint32 count, const T& identity, MapFn&& map, ReduceFn&& reduce, uint32 grainSize = 0, uint32 maxThreads = 0)
+	{
+		struct alignas(64) Partial
+		{
+			T Value;
+		};
+		Array<Partial> partials(ThreadCount(), Partial{ identity });
+		std::mutex externalLock;
+		T externalValue = identity;
+
+		ParallelForInternal(count, AsyncRangeDelegate::CreateLambda([&](uint32 begin, uint32 end, int)
+			{
+				T value = identity;
+				for (uint32 i = begin; i < end; ++i)
+					value = reduce(value, map(i));
+
+				int32 threadIndex = GetThreadIndex();
+				if (threadIndex >= 0)
+				{
+					partials[threadIndex].Value = reduce(partials[threadIndex].Value, value);
+				}
+				else
+				{
+					std::scoped_lock lock(externalLock);
+					externalValue = reduce(externalValue, value);
+				}
+			}), grainSize, maxThreads);
+
+		T result = externalValue;
+		for (const Partial& partial : partials)
+			result = reduce(result, partial.Value);
+		return result;
+	}
+
+	/*
+		Task graph.
+		A task is created with an optional list of predecessors and is scheduled automatically
+		once it is submitted and all its predecessors have finished.
+		More predecessors can be added with AddDependency until the task is submitted.
+		If a context is provided, it tracks the task from creation, so joining the context waits for the whole graph.
+
+		Usage:
+			TaskHandle parse = TaskQueue::CreateTask([](int) { ... });
+			TaskHandle build = TaskQueue::CreateTask([](int) { ... }, { parse });
+			TaskQueue::Submit(build);
+			TaskQueue::Submit(parse);
+			TaskQueue::Join(build);
+	*/
+	template<typename Callback>
+	NODISCARD static TaskHandle CreateTask(Callback&& action, Span<const TaskHandle> predecessors = {}, TaskContext* pContext = nullptr)
+	{
+		return CreateTaskInternal(AsyncTaskDelegate::CreateLambda(std::forward<Callback>(action)), predecessors, pContext);
+	}
+	// Create and submit a task
+	template<typename Callback>
+	static TaskHandle Schedule(Callback&& action, Span<const TaskHandle> predecessors = {}, TaskContext* pContext = nullptr)
+	{
+		TaskHandle pTask = CreateTask(std::forward<Callback>(action), predecessors, pContext);
+		Submit(pTask);
+		return pTask;
+	}
+	static void AddDependency(const TaskHandle& pTask, const TaskHandle& pPredecessor);
+	static void Submit(const TaskHandle& pTask);
+	// Wait for a specific task to finish while executing other work
+	static void Join(const TaskHandle& pTask);
+
 	static uint32 ThreadCount();
 
+	// Returns the index of the calling thread in the scheduler or -1 if it's not a scheduler thread.
+	static int32 GetThreadIndex();
+
 private:
 	TaskQueue();
 	static void Distribute(TaskContext& context, const AsyncDistributeDelegate& action, uint32 count, int32 groupSize = -1);
 	static void AddWorkItem(const AsyncTaskDelegate& action, TaskContext& context);
 	static void CreateThreads(uint32 count);
+	static void ParallelForInternal(uint32 count, const AsyncRangeDelegate& action, uint32 grainSize, uint32 maxThreads);
+	static TaskHandle CreateTaskInternal(AsyncTaskDelegate&& action, Span<const TaskHandle> predecessors, TaskContext* pContext);
+	static void ReleaseDependency(const TaskHandle& pTask);
+	static void RunTaskNode(const TaskHandle& pTask, int threadIndex);
 };
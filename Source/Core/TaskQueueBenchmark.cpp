@@ -0,0 +1,223 @@
+#include "stdafx.h"
+#include "TaskQueue.h"
+#include "Core/Benchmark.h"
+#include "Core/Utils.h"
+#include <thread>
+
+/*
+	Microbenchmarks for the TaskQueue.
+	Run from the console with "bench.TaskQueue" and "bench.ParallelFor".
+*/
+
+namespace TaskQueueBenchmark
+{
+	// Reference implementation of the previous scheduler: a single mutex-guarded deque and a shared condition variable.
+	class LegacyTaskQueue
+	{
+	public:
+		explicit LegacyTaskQueue(uint32 numThreads)
+		{
+			for (uint32 i = 1; i < numThreads; ++i)
+				m_Threads.emplace_back([this, i]() { WorkFunction(i); });
+		}
+
+		~LegacyTaskQueue()
+		{
+			m_Shutdown = true;
+			m_WakeUpCondition.notify_all();
+			for (std::thread& thread : m_Threads)
+				thread.join();
+		}
+
+		void Execute(const AsyncTaskDelegate& action, TaskContext& context)
+		{
+			std::scoped_lock lock(m_QueueMutex);
+			m_Queue.push_back(Task{ action, &context });
+			context.fetch_add(1);
+			m_WakeUpCondition.notify_one();
+		}
+
+		void Join(TaskContext& context)
+		{
+			if (context > 0)
+			{
+				m_WakeUpCondition.notify_all();
+				while (context.load() > 0)
+					DoWork(0);
+			}
+		}
+
+	private:
+		struct Task
+		{
+			AsyncTaskDelegate	Action;
+			TaskContext*		pCounter;
+		};
+
+		bool DoWork(uint32 threadIndex)
+		{
+			m_QueueMutex.lock();
+			if (!m_Queue.empty())
+			{
+				Task task = m_Queue.front();
+				m_Queue.pop_front();
+				m_QueueMutex.unlock();
+				task.Action.Execute(threadIndex);
+				task.pCounter->fetch_sub(1);
+				return true;
+			}
+			m_QueueMutex.unlock();
+			return false;
+		}
+
+		void WorkFunction(uint32 threadIndex)
+		{
+			while (!m_Shutdown)
+			{
+				if (!DoWork(threadIndex))
+				{
+					std::unique_lock lock(m_SleepMutex);
+					m_WakeUpCondition.wait_for(lock, std::chrono::milliseconds(1));
+				}
+			}
+		}
+
+		std::deque<Task>			m_Queue;
+		std::condition_variable		m_WakeUpCondition;
+		std::mutex					m_QueueMutex;
+		std::mutex					m_SleepMutex;
+		std::atomic<bool>			m_Shutdown = false;
+		Array<std::thread>			m_Threads;
+	};
+
+	// A tiny amount of work so scheduling overhead dominates.
+	// Every task adds to the sink, so a task that is skipped or runs twice changes the total.
+	static void TinyTask(std::atomic<uint64>& sink, uint32 value)
+	{
+		uint32 hash = value * 0x9E3779B9u;
+		hash ^= hash >> 16;
+		sink.fetch_add((hash & 0xFF) + 1, std::memory_order_relaxed);
+	}
+
+	static void Run(Benchmark::Context& context)
+	{
+		constexpr uint32 taskCounts[] = { 1'000, 10'000, 100'000, 1'000'000 };
+
+		E_LOG(Info, "TaskQueue benchmark - %d threads", TaskQueue::ThreadCount());
+		E_LOG(Info, "%10s | %14s | %14s | %14s", "Tasks", "Legacy (ms)", "Execute (ms)", "ExecuteMany (ms)");
+
+		LegacyTaskQueue legacyQueue(TaskQueue::ThreadCount());
+		for (uint32 numTasks : taskCounts)
+		{
+			// Every task must run exactly once
+			std::atomic<uint64> expected = 0;
+			for (uint32 i = 0; i < numTasks; ++i)
+				TinyTask(expected, i);
+			std::atomic<uint64> sink = 0;
+			auto CheckSink = [&](const char* pName)
+				{
+					context.Check(sink == expected, "%s: %d tasks produced %llu instead of %llu", pName, numTasks, sink.load(), expected.load());
+					sink = 0;
+				};
+
+			float legacyTime = 0;
+			{
+				TaskContext taskContext;
+				Utils::TimeScope timer;
+				for (uint32 i = 0; i < numTasks; ++i)
+					legacyQueue.Execute(AsyncTaskDelegate::CreateLambda([&sink, i](int) { TinyTask(sink, i); }), taskContext);
+				legacyQueue.Join(taskContext);
+				legacyTime = timer.Stop() * 1000.0f;
+				CheckSink("Legacy");
+			}
+
+			float executeTime = 0;
+			{
+				TaskContext taskContext;
+				Utils::TimeScope timer;
+				for (uint32 i = 0; i < numTasks; ++i)
+					TaskQueue::Execute([&sink, i](int) { TinyTask(sink, i); }, taskContext);
+				TaskQueue::Join(taskContext);
+				executeTime = timer.Stop() * 1000.0f;
+				CheckSink("Execute");
+			}
+
+			float executeManyTime = 0;
+			{
+				TaskContext taskContext;
+				Utils::TimeScope timer;
+				TaskQueue::ExecuteMany([&sink](TaskDistributeArgs args) { TinyTask(sink, args.JobIndex); }, taskContext, numTasks, 1);
+				TaskQueue::Join(taskContext);
+				executeManyTime = timer.Stop() * 1000.0f;
+				CheckSink("ExecuteMany");
+			}
+
+			E_LOG(Info, "%10d | %14.3f | %14.3f | %14.3f", numTasks, legacyTime, executeTime, executeManyTime);
+		}
+	}
+
+	// Measures ParallelFor/ParallelReduce scaling by limiting the loops to 1 to N threads.
+	// The last row runs without a limit, which splits the range recursively and balances it by stealing.
+	static void RunParallelFor(Benchmark::Context& context)
+	{
+		constexpr uint32 numItems = 1 << 22;
+		const uint32 maxThreads = TaskQueue::ThreadCount();
+
+		Array<float> values(numItems);
+		for (uint32 i = 0; i < numItems; ++i)
+			values[i] = (float)(i % 1024);
+		Array<float> results(numItems);
+
+		// Uneven per-item cost to show the effect of stealing
+		auto heavyItem = [&](TaskDistributeArgs args)
+			{
+				float v = values[args.JobIndex];
+				uint32 iterations = 1 + (args.JobIndex % 64);
+				for (uint32 j = 0; j < iterations; ++j)
+					v = sqrtf(v * v + 1.0f);
+				results[args.JobIndex] = v;
+			};
+
+		// Serial reference. Every item has a fixed result, only the order of the sum differs between runs.
+		Array<float> reference(numItems);
+		double referenceSum = 0.0;
+		for (uint32 i = 0; i < numItems; ++i)
+		{
+			heavyItem(TaskDistributeArgs{ .JobIndex = (int)i, .ThreadIndex = 0 });
+			reference[i] = results[i];
+			referenceSum += results[i];
+		}
+
+		E_LOG(Info, "ParallelFor benchmark - %d items", numItems);
+		E_LOG(Info, "%8s | %14s | %8s | %14s | %8s", "Threads", "For (ms)", "Speedup", "Reduce (ms)", "Speedup");
+
+		float baseForTime = 0;
+		float baseReduceTime = 0;
+		for (uint32 numThreads = 1; numThreads <= maxThreads + 1; ++numThreads)
+		{
+			// 0 is no limit
+			const uint32 threadLimit = numThreads <= maxThreads ? numThreads : 0;
+
+			std::fill(results.begin(), results.end(), 0.0f);
+			Utils::TimeScope forTimer;
+			TaskQueue::ParallelFor(numItems, heavyItem, 0, threadLimit);
+			float forTime = forTimer.Stop() * 1000.0f;
+			context.Check(results == reference, "ParallelFor with %d threads did not process every item exactly once", threadLimit);
+
+			Utils::TimeScope reduceTimer;
+			double sum = TaskQueue::ParallelReduce(numItems, 0.0, [&](uint32 i) { return (double)results[i]; }, [](double a, double b) { return a + b; }, 0, threadLimit);
+			float reduceTime = reduceTimer.Stop() * 1000.0f;
+			context.Check(fabs(sum - referenceSum) <= 1.0e-9 * referenceSum, "ParallelReduce with %d threads returned %f instead of %f", threadLimit, sum, referenceSum);
+
+			if (numThreads == 1)
+			{
+				baseForTime = forTime;
+				baseReduceTime = reduceTime;
+			}
+			E_LOG(Info, "%8s | %14.3f | %7.2fx | %14.3f | %7.2fx (sum: %.0f)", threadLimit > 0 ? Sprintf("%d", threadLimit).c_str() : "All", forTime, baseForTime / forTime, reduceTime, baseReduceTime / reduceTime, sum);
+		}
+	}
+
+	static Benchmark::Command<> gBenchmarkCommand("bench.TaskQueue", &Run);
+	static Benchmark::Command<> gParallelForBenchmarkCommand("bench.ParallelFor", &RunParallelFor);
+}
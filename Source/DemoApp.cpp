@@ -4,6 +4,8 @@
 #include "Core/CommandLine.h"
 #include "Core/Profiler.h"
 #include "Core/ConsoleVariables.h"
+#include "Core/Benchmark.h"
+#include "Core/TaskQueue.h"
 
 #include "Renderer/Renderer.h"
 #include "Renderer/Techniques/DDGI.h"
@@ -20,6 +22,10 @@
 #include <ImGuizmo.h>
 
 bool sScreenshotNextFrame = false;
+String sBenchmarkScenePath;
+static ConsoleCommand<const char*> gBenchmarkMeshCache("bench.MeshCache", [](const char* pPath) { sBenchmarkScenePath = pPath; });
+static Benchmark::Command<const char*> gBenchmarkMeshletLOD("bench.MeshletLOD", &SceneLoader::BenchmarkMeshletLOD);
+static Benchmark::Command<const char*> gBenchmarkMeshCompression("bench.MeshCompression", &SceneLoader::BenchmarkMeshCompression);
 
 DemoApp::DemoApp() = default;
 
@@ -36,6 +42,13 @@ void DemoApp::Init()
 
 void DemoApp::Update()
 {
+	if (!sBenchmarkScenePath.empty())
+	{
+		// Loads scenes with the device, so it runs here rather than from the console command
+		Benchmark::Run("bench.MeshCache", &SceneLoader::BenchmarkMeshCache, sBenchmarkScenePath.c_str(), m_pDevice);
+		sBenchmarkScenePath.clear();
+	}
+
 	DrawImGui();
 
 	Camera& camera = m_World.GetComponent<Camera>(m_World.Camera);
@@ -44,14 +57,31 @@ void DemoApp::Update()
 
 	{
 		PROFILE_CPU_SCOPE("Update Entity Transforms");
-		auto view = m_World.Registry.view<Transform>();
-		view.each([&](Transform& transform)
+		// World matrices are computed in parallel straight over the Transform storage.
+		// Only transforms that changed, or that moved last frame, are patched so the renderer can upload just those.
+		// Patching emits signals, so that part stays on this thread.
+		auto& storage = m_World.Registry.storage<Transform>();
+		const uint32 numTransforms = (uint32)storage.size();
+		Array<uint8> moved(numTransforms);
+		TaskQueue::ParallelFor(numTransforms, [&](TaskDistributeArgs args)
 			{
-				transform.WorldPrev = transform.World;
-				transform.World = Matrix::CreateScale(transform.Scale) *
+				Transform& transform = storage.get(storage[args.JobIndex]);
+				Matrix world = Matrix::CreateScale(transform.Scale) *
 					Matrix::CreateFromQuaternion(transform.Rotation) *
 					Matrix::CreateTranslation(transform.Position);
-			});
+				if (world != transform.World || transform.WorldPrev != transform.World)
+				{
+					transform.WorldPrev = transform.World;
+					transform.World = world;
+					moved[args.JobIndex] = 1;
+				}
+			}, 256);
+
+		for (uint32 i = 0; i < numTransforms; ++i)
+		{
+			if (moved[i])
+				m_World.Registry.patch<Transform>(storage[i]);
+		}
 	}
 
 	if (m_pViewportTexture)
@@ -73,6 +103,7 @@ void DemoApp::Shutdown()
 
 void DemoApp::SetupScene(const char* pFilePath)
 {
+	m_Renderer.ResetScene();
 	m_World = {};
 
 	Material& defaultMaterial = m_World.Materials.emplace_back();
@@ -293,7 +324,7 @@ void DemoApp::DrawImGui()
 
 	if (ImGui::Begin("Settings"))
 	{
-		if (ImGui::CollapsingHeader("Swapchain"))
+		if (m_pSwapchain && ImGui::CollapsingHeader("Swapchain"))
 		{
 			bool vsync = m_pSwapchain->GetVSync();
 			if (ImGui::Checkbox("Vertical Sync", &vsync))
@@ -139,6 +139,25 @@ namespace Math
 		return frustum;
 	}
 
+	BoundingBox TransformBoundingBox(const BoundingBox& box, const Matrix& transform)
+	{
+		// Extents are projected on the absolute basis vectors of the transform.
+		// Gives the same box as BoundingBox::Transform, without transforming all 8 corners.
+		using namespace DirectX;
+		const XMMATRIX m = transform;
+		const XMVECTOR center = XMLoadFloat3(&box.Center);
+		const XMVECTOR extents = XMLoadFloat3(&box.Extents);
+
+		XMVECTOR outExtents = XMVectorMultiply(XMVectorSplatX(extents), XMVectorAbs(m.r[0]));
+		outExtents = XMVectorMultiplyAdd(XMVectorSplatY(extents), XMVectorAbs(m.r[1]), outExtents);
+		outExtents = XMVectorMultiplyAdd(XMVectorSplatZ(extents), XMVectorAbs(m.r[2]), outExtents);
+
+		BoundingBox out;
+		XMStoreFloat3(&out.Center, XMVector3Transform(center, m));
+		XMStoreFloat3(&out.Extents, outExtents);
+		return out;
+	}
+
 	void GetProjectionClipPlanes(const Matrix& projection, float& nearZ, float& farZ)
 	{
 		nearZ = -projection._43 / projection._33;
@@ -113,6 +113,7 @@ namespace Math
 	Matrix CreateOrthographicOffCenterMatrix(float left, float right, float bottom, float top, float nearPlane, float farPlane);
 	Matrix CreateLookToMatrix(const Vector3& position, const Vector3& direction, const Vector3& up);
 	BoundingFrustum CreateBoundingFrustum(const Matrix& projection, const Matrix& view = Matrix::Identity);
+	BoundingBox TransformBoundingBox(const BoundingBox& box, const Matrix& transform);
 
 	void GetProjectionClipPlanes(const Matrix& projection, float& nearPlane, float& farPlane);
 	void ReverseZProjection(Matrix& projection);
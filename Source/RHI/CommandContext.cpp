@@ -112,7 +112,7 @@ void CommandContext::ClearState()
 }
 
 
-void CommandContext::InsertResourceBarrier(DeviceResource* pResource, D3D12_RESOURCE_STATES beforeState, D3D12_RESOURCE_STATES afterState, uint32 subResource /*= D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES*/)
+void CommandContext::InsertResourceBarrier(DeviceResource* pResource, D3D12_RESOURCE_STATES beforeState, D3D12_RESOURCE_STATES afterState, uint32 subResource /*= D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES*/, D3D12_RESOURCE_BARRIER_FLAGS flags /*= D3D12_RESOURCE_BARRIER_FLAG_NONE*/)
 {
 	gAssert(!m_InRenderPass);
 	gAssert(pResource && pResource->GetResource());
@@ -125,6 +125,17 @@ void CommandContext::InsertResourceBarrier(DeviceResource* pResource, D3D12_RESO
 	gAssert(beforeState == D3D12_RESOURCE_STATE_UNKNOWN || localBeforeState == D3D12_RESOURCE_STATE_UNKNOWN || localBeforeState == beforeState, "Provided before state %s of resource %s does not match with tracked resource state %s",
 		D3D::ResourceStateToString(beforeState), pResource->GetName(), D3D::ResourceStateToString(localBeforeState));
 
+	// Split barriers are planned ahead by the caller and are issued as is.
+	// The resource keeps its before state until the end barrier.
+	if (flags != D3D12_RESOURCE_BARRIER_FLAG_NONE)
+	{
+		gAssert(beforeState != D3D12_RESOURCE_STATE_UNKNOWN, "Split barriers on resource %s require a known before state", pResource->GetName());
+		AddBarrier(CD3DX12_RESOURCE_BARRIER::Transition(pResource->GetResource(), beforeState, afterState, subResource, flags));
+		if (flags == D3D12_RESOURCE_BARRIER_FLAG_END_ONLY)
+			localResourceState.Set(afterState, subResource);
+		return;
+	}
+
 	// If the given before state is "Unknown", get it from the commandlist
 	if(beforeState == D3D12_RESOURCE_STATE_UNKNOWN)
 		beforeState = localBeforeState;
@@ -147,6 +158,7 @@ void CommandContext::InsertResourceBarrier(DeviceResource* pResource, D3D12_RESO
 				// If the previous barrier is for the same resource, see if we can combine the barrier.
 				D3D12_RESOURCE_BARRIER& last = m_BatchedBarriers[m_NumBatchedBarriers - 1];
 				if (last.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION
+					&& last.Flags == D3D12_RESOURCE_BARRIER_FLAG_NONE
 					&& last.Transition.pResource == pResource->GetResource()
 					&& last.Transition.StateBefore == beforeState
 					&& D3D::CanCombineResourceState(afterState, last.Transition.StateAfter))
@@ -522,6 +534,13 @@ void CommandContext::BeginRenderPass(const RenderPassInfo& renderPassInfo)
 		GetParent()->GetDevice()->CreateDepthStencilView(renderPassInfo.DepthStencilTarget.pTarget->GetResource(), &dsvDesc, dsvHandle);
 	}
 
+	if (renderPassInfo.DepthStencilTarget.pTarget && clearFlags == (D3D12_CLEAR_FLAGS)0
+		&& EnumHasAllFlags(renderPassInfo.DepthStencilTarget.Flags, RenderPassDepthFlags::DiscardLoad)
+		&& !EnumHasAnyFlags(renderPassInfo.DepthStencilTarget.Flags, RenderPassDepthFlags::ReadOnly))
+	{
+		DiscardResource(renderPassInfo.DepthStencilTarget.pTarget);
+	}
+
 	if (clearFlags != (D3D12_CLEAR_FLAGS)0)
 	{
 		const ClearBinding& clearBinding = renderPassInfo.DepthStencilTarget.pTarget->GetClearBinding();
@@ -581,6 +600,10 @@ void CommandContext::BeginRenderPass(const RenderPassInfo& renderPassInfo)
 			gAssert(data.pTarget->GetClearBinding().BindingValue == ClearBinding::ClearBindingValue::Color);
 			m_pCommandList->ClearRenderTargetView(rtv, &data.pTarget->GetClearBinding().Color.x, 0, nullptr);
 		}
+		else if (EnumHasAllFlags(data.Flags, RenderPassColorFlags::DiscardLoad))
+		{
+			DiscardResource(data.pTarget);
+		}
 		rtvs[i] = rtv;
 	}
 	m_pCommandList->OMSetRenderTargets(renderPassInfo.RenderTargetCount, rtvs.data(), false, dsvHandle.ptr != 0 ? &dsvHandle : nullptr);
@@ -614,8 +637,17 @@ void CommandContext::EndRenderPass()
 				CopyResource(data.pTarget, data.pResolveTarget);
 			}
 		}
+		else if (EnumHasAllFlags(data.Flags, RenderPassColorFlags::DiscardStore))
+		{
+			DiscardResource(data.pTarget);
+		}
 	}
 
+	// A read-only depth target is not in a state it can be discarded in
+	const RenderPassInfo::DepthTargetInfo& depthInfo = m_CurrentRenderPassInfo.DepthStencilTarget;
+	if (depthInfo.pTarget && EnumHasAllFlags(depthInfo.Flags, RenderPassDepthFlags::DiscardStore) && !EnumHasAnyFlags(depthInfo.Flags, RenderPassDepthFlags::ReadOnly))
+		DiscardResource(depthInfo.pTarget);
+
 	m_InRenderPass = false;
 }
 
@@ -661,6 +693,14 @@ void CommandContext::ResolveResource(Texture* pSource, uint32 sourceSubResource,
 	m_pCommandList->ResolveSubresource(pTarget->GetResource(), targetSubResource, pSource->GetResource(), sourceSubResource, D3D::ConvertFormat(format));
 }
 
+void CommandContext::DiscardResource(const DeviceResource* pResource)
+{
+	gAssert(pResource && pResource->GetResource(), "Resource is invalid");
+
+	FlushResourceBarriers();
+	m_pCommandList->DiscardResource(pResource->GetResource(), nullptr);
+}
+
 void CommandContext::PrepareDraw()
 {
 	gAssert(m_CurrentCommandContext != CommandListContext::Invalid);
@@ -16,9 +16,11 @@ enum class CommandListContext : uint8
 
 enum class RenderPassColorFlags : uint8
 {
-	None		= 0,
-	Clear		= 1 << 0,
-	Resolve		= 1 << 1,
+	None			= 0,
+	Clear			= 1 << 0,
+	Resolve			= 1 << 1,
+	DiscardLoad		= 1 << 2,	///< Previous contents are not needed. Discarded at the start of the render pass
+	DiscardStore	= 1 << 3,	///< Contents are not needed after the render pass. Discarded at the end
 };
 DEFINE_ENUM_FLAG_OPERATORS(RenderPassColorFlags)
 
@@ -29,6 +31,8 @@ enum class RenderPassDepthFlags : uint8
 	ClearStencil	= 1 << 1,
 	ReadOnlyDepth	= 1 << 2,
 	ReadOnlyStencil = 1 << 3,
+	DiscardLoad		= 1 << 4,	///< Previous contents are not needed. Discarded at the start of the render pass
+	DiscardStore	= 1 << 5,	///< Contents are not needed after the render pass. Discarded at the end
 
 	ReadOnly		= ReadOnlyDepth | ReadOnlyStencil,
 	Clear			= ClearDepth | ClearStencil,
@@ -110,7 +114,7 @@ public:
 	void Free(const SyncPoint& syncPoint);
 	void ClearState();
 
-	void InsertResourceBarrier(DeviceResource* pResource, D3D12_RESOURCE_STATES beforeState, D3D12_RESOURCE_STATES afterState, uint32 subResource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+	void InsertResourceBarrier(DeviceResource* pResource, D3D12_RESOURCE_STATES beforeState, D3D12_RESOURCE_STATES afterState, uint32 subResource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_BARRIER_FLAGS flags = D3D12_RESOURCE_BARRIER_FLAG_NONE);
 	void InsertAliasingBarrier(const DeviceResource* pResource);
 	void InsertUAVBarrier(const DeviceResource* pResource = nullptr);
 	void FlushResourceBarriers();
@@ -131,6 +135,7 @@ public:
 	void DispatchGraph(const D3D12_DISPATCH_GRAPH_DESC& graphDesc);
 
 	void ResolveResource(Texture* pSource, uint32 sourceSubResource, Texture* pTarget, uint32 targetSubResource, ResourceFormat format);
+	void DiscardResource(const DeviceResource* pResource);
 
 	void BeginRenderPass(const RenderPassInfo& renderPassInfo);
 	void EndRenderPass();
@@ -59,6 +59,7 @@ SyncPoint CommandQueue::ExecuteCommandLists(Span<CommandContext* const> contexts
 	VERIFY_HR_EX(pCurrentContext->GetCommandList()->Close(), GetParent()->GetDevice());
 	commandLists.push_back(pCurrentContext->GetCommandList());
 
+	if (!GetParent()->IsNullDevice())
 	{
 		PROFILE_CPU_SCOPE("ExecuteCommandLists");
 		PROFILE_EXECUTE_COMMANDLISTS(m_pCommandQueue, commandLists);
@@ -93,7 +94,7 @@ void CommandQueue::FreeAllocator(const SyncPoint& syncPoint, Ref<ID3D12CommandAl
 
 void CommandQueue::InsertWait(const SyncPoint& syncPoint)
 {
-	if(syncPoint.IsValid())
+	if(syncPoint.IsValid() && !GetParent()->IsNullDevice())
 		m_pCommandQueue->Wait(syncPoint.GetFence()->GetFence(), syncPoint.GetFenceValue());
 }
 
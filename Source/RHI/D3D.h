@@ -214,9 +214,15 @@ namespace D3D
 		if (after == D3D12_RESOURCE_STATE_COMMON)
 			return before != D3D12_RESOURCE_STATE_COMMON;
 
-		//Combine already transitioned bits
-		if (D3D::CanCombineResourceState(before, after) && !EnumHasAllFlags(before, after))
+		if (D3D::CanCombineResourceState(before, after))
+		{
+			//Already in all requested read states
+			if (EnumHasAllFlags(before, after))
+				return false;
+
+			//Combine already transitioned bits
 			after |= before;
+		}
 
 		return true;
 	}
@@ -279,8 +279,14 @@ GraphicsDevice::GraphicsDevice(GraphicsDeviceOptions options)
 		}
 	}
 
+	// The null device still needs a device to create objects and record commandlists.
+	// WARP is a software device, so no GPU is required.
+	m_IsNullDevice = options.UseNullDevice;
+	if (m_IsNullDevice)
+		E_LOG(Warning, "Null device enabled. Commandlists are recorded but not executed");
+
 	Ref<IDXGIAdapter4> pAdapter;
-	if (!options.UseWarp)
+	if (!options.UseWarp && !m_IsNullDevice)
 	{
 		uint32 adapterIndex = 0;
 		E_LOG(Info, "Adapters:");
@@ -362,7 +368,7 @@ GraphicsDevice::GraphicsDevice(GraphicsDeviceOptions options)
 		}
 	}
 
-	if (options.UseStablePowerState)
+	if (options.UseStablePowerState && !m_IsNullDevice)
 	{
 		VERIFY_HR(m_pDevice->SetStablePowerState(TRUE));
 		E_LOG(Warning, "D3D12 Enabled Stable Power State");
@@ -489,60 +495,82 @@ void GraphicsDevice::UnregisterGlobalResourceView(DescriptorHandle& handle)
 	}
 }
 
-Ref<Texture> GraphicsDevice::CreateTexture(const TextureDesc& desc, const char* pName, Span<D3D12_SUBRESOURCE_DATA> initData)
+static D3D12_RESOURCE_DESC GetResourceDesc(const TextureDesc& textureDesc)
 {
-	return CreateTexture(desc, nullptr, 0, pName, initData);
-}
+	DXGI_FORMAT format = D3D::ConvertFormat(textureDesc.Format);
 
-Ref<Texture> GraphicsDevice::CreateTexture(const TextureDesc& desc, ID3D12Heap* pHeap, uint64 offset, const char* pName, Span<D3D12_SUBRESOURCE_DATA> initData)
-{
-	auto GetResourceDesc = [](const TextureDesc& textureDesc)
+	D3D12_RESOURCE_DESC desc{};
+	switch (textureDesc.Type)
 	{
-		DXGI_FORMAT format = D3D::ConvertFormat(textureDesc.Format);
+	case TextureType::Texture1D:
+	case TextureType::Texture1DArray:
+		desc = CD3DX12_RESOURCE_DESC::Tex1D(format, textureDesc.Width, (uint16)textureDesc.ArraySize, (uint16)textureDesc.Mips, D3D12_RESOURCE_FLAG_NONE, D3D12_TEXTURE_LAYOUT_UNKNOWN);
+		break;
+	case TextureType::Texture2D:
+	case TextureType::Texture2DArray:
+		desc = CD3DX12_RESOURCE_DESC::Tex2D(format, textureDesc.Width, textureDesc.Height, (uint16)textureDesc.ArraySize, (uint16)textureDesc.Mips, textureDesc.SampleCount, 0, D3D12_RESOURCE_FLAG_NONE, D3D12_TEXTURE_LAYOUT_UNKNOWN);
+		break;
+	case TextureType::TextureCube:
+	case TextureType::TextureCubeArray:
+		desc = CD3DX12_RESOURCE_DESC::Tex2D(format, textureDesc.Width, textureDesc.Height, (uint16)textureDesc.ArraySize * 6, (uint16)textureDesc.Mips, textureDesc.SampleCount, 0, D3D12_RESOURCE_FLAG_NONE, D3D12_TEXTURE_LAYOUT_UNKNOWN);
+		break;
+	case TextureType::Texture3D:
+		desc = CD3DX12_RESOURCE_DESC::Tex3D(format, textureDesc.Width, textureDesc.Height, (uint16)textureDesc.Depth, (uint16)textureDesc.Mips, D3D12_RESOURCE_FLAG_NONE, D3D12_TEXTURE_LAYOUT_UNKNOWN);
+		break;
+	default:
+		gUnreachable();
+		break;
+	}
 
-		D3D12_RESOURCE_DESC desc{};
-		switch (textureDesc.Type)
+	if (EnumHasAnyFlags(textureDesc.Flags, TextureFlag::UnorderedAccess))
+	{
+		desc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+	}
+	if (EnumHasAnyFlags(textureDesc.Flags, TextureFlag::RenderTarget))
+	{
+		desc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+	}
+	if (EnumHasAnyFlags(textureDesc.Flags, TextureFlag::DepthStencil))
+	{
+		desc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+		if (!EnumHasAnyFlags(textureDesc.Flags, TextureFlag::ShaderResource))
 		{
-		case TextureType::Texture1D:
-		case TextureType::Texture1DArray:
-			desc = CD3DX12_RESOURCE_DESC::Tex1D(format, textureDesc.Width, (uint16)textureDesc.ArraySize, (uint16)textureDesc.Mips, D3D12_RESOURCE_FLAG_NONE, D3D12_TEXTURE_LAYOUT_UNKNOWN);
-			break;
-		case TextureType::Texture2D:
-		case TextureType::Texture2DArray:
-			desc = CD3DX12_RESOURCE_DESC::Tex2D(format, textureDesc.Width, textureDesc.Height, (uint16)textureDesc.ArraySize, (uint16)textureDesc.Mips, textureDesc.SampleCount, 0, D3D12_RESOURCE_FLAG_NONE, D3D12_TEXTURE_LAYOUT_UNKNOWN);
-			break;
-		case TextureType::TextureCube:
-		case TextureType::TextureCubeArray:
-			desc = CD3DX12_RESOURCE_DESC::Tex2D(format, textureDesc.Width, textureDesc.Height, (uint16)textureDesc.ArraySize * 6, (uint16)textureDesc.Mips, textureDesc.SampleCount, 0, D3D12_RESOURCE_FLAG_NONE, D3D12_TEXTURE_LAYOUT_UNKNOWN);
-			break;
-		case TextureType::Texture3D:
-			desc = CD3DX12_RESOURCE_DESC::Tex3D(format, textureDesc.Width, textureDesc.Height, (uint16)textureDesc.Depth, (uint16)textureDesc.Mips, D3D12_RESOURCE_FLAG_NONE, D3D12_TEXTURE_LAYOUT_UNKNOWN);
-			break;
-		default:
-			gUnreachable();
-			break;
+			//I think this can be a significant optimization on some devices because then the depth buffer can never be (de)compressed
+			desc.Flags |= D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE;
 		}
+	}
+	return desc;
+}
 
-		if (EnumHasAnyFlags(textureDesc.Flags, TextureFlag::UnorderedAccess))
-		{
-			desc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-		}
-		if (EnumHasAnyFlags(textureDesc.Flags, TextureFlag::RenderTarget))
-		{
-			desc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
-		}
-		if (EnumHasAnyFlags(textureDesc.Flags, TextureFlag::DepthStencil))
-		{
-			desc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
-			if (!EnumHasAnyFlags(textureDesc.Flags, TextureFlag::ShaderResource))
-			{
-				//I think this can be a significant optimization on some devices because then the depth buffer can never be (de)compressed
-				desc.Flags |= D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE;
-			}
-		}
-		return desc;
-	};
+static D3D12_RESOURCE_DESC GetResourceDesc(const BufferDesc& bufferDesc)
+{
+	D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(bufferDesc.Size, D3D12_RESOURCE_FLAG_NONE);
+	if (EnumHasAnyFlags(bufferDesc.Flags, BufferFlag::UnorderedAccess))
+		desc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+	if (EnumHasAnyFlags(bufferDesc.Flags, BufferFlag::AccelerationStructure))
+		desc.Flags |= D3D12_RESOURCE_FLAG_RAYTRACING_ACCELERATION_STRUCTURE;
+	return desc;
+}
 
+D3D12_RESOURCE_ALLOCATION_INFO GraphicsDevice::GetResourceAllocationInfo(const TextureDesc& desc) const
+{
+	D3D12_RESOURCE_DESC resourceDesc = GetResourceDesc(desc);
+	return m_pDevice->GetResourceAllocationInfo(0, 1, &resourceDesc);
+}
+
+D3D12_RESOURCE_ALLOCATION_INFO GraphicsDevice::GetResourceAllocationInfo(const BufferDesc& desc) const
+{
+	D3D12_RESOURCE_DESC resourceDesc = GetResourceDesc(desc);
+	return m_pDevice->GetResourceAllocationInfo(0, 1, &resourceDesc);
+}
+
+Ref<Texture> GraphicsDevice::CreateTexture(const TextureDesc& desc, const char* pName, Span<D3D12_SUBRESOURCE_DATA> initData)
+{
+	return CreateTexture(desc, nullptr, 0, pName, initData);
+}
+
+Ref<Texture> GraphicsDevice::CreateTexture(const TextureDesc& desc, ID3D12Heap* pHeap, uint64 offset, const char* pName, Span<D3D12_SUBRESOURCE_DATA> initData)
+{
 	D3D12_RESOURCE_STATES resourceState = D3D12_RESOURCE_STATE_COMMON;
 	gAssert(EnumHasAllFlags(desc.Flags, TextureFlag::RenderTarget | TextureFlag::DepthStencil) == false);
 
@@ -675,16 +703,6 @@ Ref<Texture> GraphicsDevice::CreateTextureForSwapchain(ID3D12ResourceX* pSwapcha
 
 Ref<Buffer> GraphicsDevice::CreateBuffer(const BufferDesc& desc, ID3D12Heap* pHeap, uint64 offset, const char* pName, const void* pInitData)
 {
-	auto GetResourceDesc = [](const BufferDesc& bufferDesc)
-	{
-		D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(bufferDesc.Size, D3D12_RESOURCE_FLAG_NONE);
-		if (EnumHasAnyFlags(bufferDesc.Flags, BufferFlag::UnorderedAccess))
-			desc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-		if (EnumHasAnyFlags(bufferDesc.Flags, BufferFlag::AccelerationStructure))
-			desc.Flags |= D3D12_RESOURCE_FLAG_RAYTRACING_ACCELERATION_STRUCTURE;
-		return desc;
-	};
-
 	D3D12_RESOURCE_DESC resourceDesc = GetResourceDesc(desc);
 	D3D12_HEAP_TYPE heapType = D3D12_HEAP_TYPE_DEFAULT;
 	D3D12_RESOURCE_STATES initialState = D3D12_RESOURCE_STATE_UNKNOWN;
@@ -1088,6 +1106,7 @@ void GraphicsCapabilities::Initialize(GraphicsDevice* pDevice)
 	gAssert(m_FeatureSupport.WaveOps(), "Device does not support wave ops which is required.");
 
 	RenderPassTier = m_FeatureSupport.RenderPassesTier();
+	ResourceHeapTier = m_FeatureSupport.ResourceHeapTier();
 	RayTracingTier = m_FeatureSupport.RaytracingTier();
 	VRSTier = m_FeatureSupport.VariableShadingRateTier();
 	VRSTileSize = m_FeatureSupport.ShadingRateImageTileSize();
@@ -104,6 +104,7 @@ struct GraphicsDeviceOptions
 	bool LoadPIX = false;
 	bool UseWarp = false;
 	bool UseStablePowerState = false;
+	bool UseNullDevice = false;		///< Record commandlists on the WARP device but never execute them. See GraphicsDevice::IsNullDevice
 };
 
 class GraphicsCapabilities
@@ -120,6 +121,7 @@ public:
 	bool CheckUAVSupport(DXGI_FORMAT format) const;
 
 	D3D12_RENDER_PASS_TIER RenderPassTier = D3D12_RENDER_PASS_TIER_0;
+	D3D12_RESOURCE_HEAP_TIER ResourceHeapTier = D3D12_RESOURCE_HEAP_TIER_1;
 	D3D12_RAYTRACING_TIER RayTracingTier = D3D12_RAYTRACING_TIER_NOT_SUPPORTED;
 	uint16 ShaderModel = (D3D_SHADER_MODEL)0;
 	D3D12_MESH_SHADER_TIER MeshShaderSupport = D3D12_MESH_SHADER_TIER_NOT_SUPPORTED;
@@ -157,6 +159,8 @@ public:
 	Ref<Texture> CreateTextureForSwapchain(ID3D12ResourceX* pSwapchainResource, uint32 index);
 	Ref<Buffer> CreateBuffer(const BufferDesc& desc, ID3D12Heap* pHeap, uint64 offset, const char* pName, const void* pInitData = nullptr);
 	Ref<Buffer> CreateBuffer(const BufferDesc& desc, const char* pName, const void* pInitData = nullptr);
+	D3D12_RESOURCE_ALLOCATION_INFO GetResourceAllocationInfo(const TextureDesc& desc) const;
+	D3D12_RESOURCE_ALLOCATION_INFO GetResourceAllocationInfo(const BufferDesc& desc) const;
 	void DeferReleaseObject(ID3D12Object* pObject);
 	ScratchAllocation AllocateUploadScratch(uint32 inSize, uint32 inAlignment = 1);
 
@@ -184,6 +188,9 @@ public:
 	ShaderManager* GetShaderManager() const { return m_pShaderManager.get(); }
 	const GraphicsCapabilities& GetCapabilities() const { return m_Capabilities; }
 	Fence* GetFrameFence() const { return m_pFrameFence; }
+	// In null device mode, all CPU work up to commandlist submission runs as usual but nothing is executed on the GPU.
+	// Fences are signaled from the CPU, so waits complete immediately.
+	bool IsNullDevice() const { return m_IsNullDevice; }
 	IDXGIFactory6* GetFactory() const { return m_pFactory; }
 
 private:
@@ -193,6 +200,7 @@ private:
 	} Reporter;
 
 	GraphicsCapabilities m_Capabilities;
+	bool m_IsNullDevice = false;
 
 	Ref<IDXGIFactoryX> m_pFactory;
 	Ref<ID3D12DeviceX> m_pDevice;
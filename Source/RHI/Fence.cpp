@@ -19,7 +19,11 @@ Fence::~Fence()
 
 uint64 Fence::Signal(CommandQueue* pQueue)
 {
-	pQueue->GetCommandQueue()->Signal(m_pFence.Get(), m_CurrentValue);
+	// Nothing is executed on the null device, signal from the CPU so the value is reached immediately
+	if (GetParent()->IsNullDevice())
+		VERIFY_HR(m_pFence->Signal(m_CurrentValue));
+	else
+		pQueue->GetCommandQueue()->Signal(m_pFence.Get(), m_CurrentValue);
 	m_LastSignaled = m_CurrentValue;
 	m_CurrentValue++;
 	return m_LastSignaled;
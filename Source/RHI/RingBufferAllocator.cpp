@@ -3,6 +3,7 @@
 #include "Device.h"
 #include "Buffer.h"
 #include "CommandContext.h"
+#include <thread>
 
 RingBufferAllocator::RingBufferAllocator(GraphicsDevice* pDevice, uint32 size)
 	: DeviceObject(pDevice), m_pQueue(pDevice->GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COPY)), m_Size(size), m_ConsumeOffset(0), m_ProduceOffset(0)
@@ -19,24 +20,56 @@ RingBufferAllocator::~RingBufferAllocator()
 
 bool RingBufferAllocator::Allocate(uint32 size, RingBufferAllocation& allocation)
 {
-	std::lock_guard lock(m_Lock);
+	if (size > m_Size)
+		return false;
 
-	while (!m_RetiredAllocations.empty())
+	// When the ring is full, wait for the oldest upload and try again.
+	// The wait happens outside of the lock so other threads can still free their allocations.
+	while (true)
+	{
+		SyncPoint oldestSync;
+		{
+			std::lock_guard lock(m_Lock);
+			if (TryAllocate(size, allocation))
+				return true;
+			if (!m_InFlightAllocations.empty() && m_InFlightAllocations.front().IsFreed)
+				oldestSync = m_InFlightAllocations.front().Sync;
+		}
+
+		if (oldestSync.IsValid())
+			oldestSync.Wait();
+		else
+			std::this_thread::yield();
+	}
+}
+
+bool RingBufferAllocator::TryAllocate(uint32 size, RingBufferAllocation& allocation)
+{
+	while (!m_InFlightAllocations.empty())
 	{
-		const RetiredAllocation& retired = m_RetiredAllocations.front();
-		if (!retired.Sync.IsComplete())
+		const InFlightAllocation& oldest = m_InFlightAllocations.front();
+		if (!oldest.IsFreed || !oldest.Sync.IsComplete())
 			break;
-		m_ConsumeOffset = retired.Offset + retired.Size;
-		m_RetiredAllocations.pop();
+		m_ConsumeOffset = oldest.Offset + oldest.Size;
+		m_InFlightAllocations.pop_front();
+	}
+
+	// Equal offsets mean either an empty or a full ring, which only the allocations in flight tell apart
+	const bool isEmpty = m_InFlightAllocations.empty();
+	if (isEmpty)
+	{
+		m_ConsumeOffset = 0;
+		m_ProduceOffset = 0;
 	}
 
 	constexpr uint32 InvalidOffset = 0xFFFFFFFF;
 	uint32 offset = InvalidOffset;
 
-	if (size > m_Size)
-		return false;
-
-	if (m_ProduceOffset >= m_ConsumeOffset)
+	if (m_ProduceOffset == m_ConsumeOffset && !isEmpty)
+	{
+		// Full
+	}
+	else if (m_ProduceOffset >= m_ConsumeOffset)
 	{
 		if (m_ProduceOffset + size <= m_Size)
 		{
@@ -58,6 +91,8 @@ bool RingBufferAllocator::Allocate(uint32 size, RingBufferAllocation& allocation
 	if (offset == InvalidOffset)
 		return false;
 
+	m_InFlightAllocations.push_back(InFlightAllocation{ SyncPoint(), offset, size, false });
+
 	allocation.pContext = GetParent()->AllocateCommandContext(D3D12_COMMAND_LIST_TYPE_COPY);
 	allocation.Offset = offset;
 	allocation.Size = size;
@@ -67,21 +102,23 @@ bool RingBufferAllocator::Allocate(uint32 size, RingBufferAllocation& allocation
 	return true;
 }
 
-void RingBufferAllocator::Free(RingBufferAllocation& allocation)
+SyncPoint RingBufferAllocator::Free(RingBufferAllocation& allocation)
 {
 	std::lock_guard lock(m_Lock);
 
-	RetiredAllocation retired;
-	retired.Offset = allocation.Offset;
-	retired.Size = allocation.Size;
-	retired.Sync = allocation.pContext->Execute();
-	m_RetiredAllocations.push(retired);
+	auto it = std::find_if(m_InFlightAllocations.begin(), m_InFlightAllocations.end(), [&](const InFlightAllocation& inFlight)
+		{
+			return inFlight.Offset == allocation.Offset && !inFlight.IsFreed;
+		});
+	gAssert(it != m_InFlightAllocations.end(), "Freeing an allocation that is not in flight");
+	it->Sync = allocation.pContext->Execute();
+	it->IsFreed = true;
+	m_LastSync = it->Sync;
 
 	allocation.pBackingResource = nullptr;
 	allocation.pContext = nullptr;
 	allocation.pMappedMemory = nullptr;
-
-	m_LastSync = retired.Sync;
+	return m_LastSync;
 }
 
 void RingBufferAllocator::Sync()
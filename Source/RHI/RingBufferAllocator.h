@@ -22,17 +22,23 @@ public:
 	~RingBufferAllocator();
 
 	bool Allocate(uint32 size, RingBufferAllocation& allocation);
-	void Free(RingBufferAllocation& allocation);
+	// Submits the copies recorded on the allocation's context. The space is reclaimed once they complete.
+	SyncPoint Free(RingBufferAllocation& allocation);
 	void Sync();
 
 private:
-	struct RetiredAllocation
+	bool TryAllocate(uint32 size, RingBufferAllocation& allocation);
+
+	// Allocations in the order they were made. Space is only reclaimed from the front, so an allocation
+	// that is freed before an older one, by another thread, does not hand out memory still in use.
+	struct InFlightAllocation
 	{
 		SyncPoint Sync;
 		uint32 Offset;
 		uint32 Size;
+		bool IsFreed;
 	};
-	std::queue<RetiredAllocation> m_RetiredAllocations;
+	std::deque<InFlightAllocation> m_InFlightAllocations;
 
 	CommandQueue* m_pQueue;
 	std::mutex m_Lock;
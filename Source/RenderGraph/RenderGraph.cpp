@@ -2,8 +2,10 @@
 #include "RenderGraph.h"
 #include "Core/Profiler.h"
 #include "Core/TaskQueue.h"
+#include "Core/Utils.h"
 #include "RHI/Device.h"
 #include "RHI/CommandContext.h"
+#include "RHI/CommandQueue.h"
 
 RGPass& RGPass::Read(Span<RGResource*> resources)
 {
@@ -79,22 +81,93 @@ void RGPass::AddAccess(RGResource* pResource, D3D12_RESOURCE_STATES state)
 	}
 }
 
-RGGraph::RGGraph(uint64 allocatorSize /*= 0xFFFF*/)
-	: m_Allocator(allocatorSize)
+RGGraphAllocator::~RGGraphAllocator()
+{
+	Reset();
+	for (Chunk& chunk : m_Chunks)
+		delete[] chunk.pData;
+}
+
+void* RGGraphAllocator::Allocate(uint64 size, uint64 alignment)
+{
+	// Chunks from new[] are aligned to the default new alignment
+	gAssert(alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+
+	// Move on to the next chunk that fits the allocation, or add a new chunk
+	uint64 offset = Math::AlignUp(m_CurrentOffset, alignment);
+	while (m_CurrentChunk < m_Chunks.size() && offset + size > m_Chunks[m_CurrentChunk].Size)
+	{
+		++m_CurrentChunk;
+		m_CurrentOffset = 0;
+		offset = 0;
+	}
+	if (m_CurrentChunk == m_Chunks.size())
+	{
+		uint64 chunkSize = Math::Max(m_ChunkSize, size);
+		m_Chunks.push_back(Chunk{ new char[chunkSize], chunkSize });
+		m_Capacity += chunkSize;
+	}
+
+	void* pData = m_Chunks[m_CurrentChunk].pData + offset;
+	m_Size += offset + size - m_CurrentOffset;
+	m_CurrentOffset = offset + size;
+	return pData;
+}
+
+void RGGraphAllocator::Reset()
+{
+	for (AllocatedObject* pObject : m_NonPODAllocations)
+		pObject->~AllocatedObject();
+	m_NonPODAllocations.clear();
+
+	m_HighWaterMark = Math::Max(m_HighWaterMark, m_Size);
+	m_LastSize = m_Size;
+	m_Size = 0;
+	m_CurrentChunk = 0;
+	m_CurrentOffset = 0;
+}
+
+RGGraph::RGGraph()
+	: m_pOwnedAllocator(std::make_unique<RGGraphAllocator>()), m_Allocator(*m_pOwnedAllocator)
+{
+}
+
+RGGraph::RGGraph(RGGraphAllocator& allocator)
+	: m_Allocator(allocator)
 {
 }
 
 RGGraph::~RGGraph()
 {
 	DestroyData();
+	m_Allocator.Reset();
 }
 
-void RGGraph::Compile(RGResourcePool& resourcePool, const RGGraphOptions& options)
+void RGGraph::Compile(RGResourcePool& resourcePool, const RGGraphOptions& options, RGCompileCache* pCache)
 {
 	PROFILE_CPU_SCOPE();
 
 	gAssert(!m_IsCompiled);
 
+	m_pCostModel = options.Jobify ? options.pCostModel : nullptr;
+
+	if (pCache)
+	{
+		uint64 hash = ComputeStructureHash(options);
+		pCache->m_WasHit = pCache->m_IsValid && pCache->m_Hash == hash && LoadFromCache(*pCache, resourcePool);
+		if (pCache->m_WasHit)
+		{
+			++pCache->m_NumHits;
+			m_IsCompiled = true;
+			return;
+		}
+
+		// Give the resources held by the cache back to the pool before compiling
+		++pCache->m_NumMisses;
+		pCache->Invalidate();
+		pCache->m_Hash = hash;
+	}
+
 	if (options.PassCulling)
 	{
 		PROFILE_CPU_SCOPE("Pass Culling");
@@ -148,6 +221,10 @@ void RGGraph::Compile(RGResourcePool& resourcePool, const RGGraphOptions& option
 			pPass->IsCulled = false;
 	}
 
+	// Resource states on the compute queue are limited, so the states of all accesses must be known during compilation
+	if (options.AsyncCompute && options.StateTracking)
+		ScheduleAsyncCompute();
+
 	// Tell the resources when they're first/last accessed and apply usage flags
 	for (const RGPass* pPass : m_Passes)
 	{
@@ -184,37 +261,135 @@ void RGGraph::Compile(RGResourcePool& resourcePool, const RGGraphOptions& option
 		}
 	}
 
+	// Combine the read states of consecutive reads so a resource is transitioned once for all of them
+	if (options.StateTracking)
+	{
+		Array<D3D12_RESOURCE_STATES> readStates(m_Resources.size(), D3D12_RESOURCE_STATE_COMMON);
+		for (auto it = m_Passes.rbegin(); it != m_Passes.rend(); ++it)
+		{
+			RGPass* pPass = *it;
+			if (pPass->IsCulled)
+				continue;
+
+			for (RGPass::ResourceAccess& access : pPass->Accesses)
+			{
+				D3D12_RESOURCE_STATES& states = readStates[access.pResource->ID.GetIndex()];
+				if (D3D::HasWriteResourceState(access.Access))
+					states = D3D12_RESOURCE_STATE_COMMON;
+				else if (pPass->Queue == RGQueue::Compute)
+					states = access.Access;		// The compute queue can't transition to the read states of graphics passes that follow
+				else
+					states |= access.Access;
+				access.ReadStates = states;
+			}
+		}
+	}
+
+	m_BarrierStats = {};
+	Array<D3D12_RESOURCE_STATES> initialStates;
+
 	{
 
 		PROFILE_CPU_SCOPE("Resource Allocation");
 
+		// State of each resource if every access would be transitioned individually. Only used for stats.
+		Array<D3D12_RESOURCE_STATES> unoptimizedStates;
+		if (options.StateTracking)
+			unoptimizedStates.resize(m_Resources.size(), D3D12_RESOURCE_STATE_UNKNOWN);
+
+		auto AllocateResource = [&](RGResource* pResource)
+		{
+			Ref<DeviceResource> pPhysicalResource;
+			if (pResource->GetType() == RGResourceType::Texture)
+				pPhysicalResource = resourcePool.Allocate(pResource->GetName(), static_cast<RGTexture*>(pResource)->GetDesc());
+			else if (pResource->GetType() == RGResourceType::Buffer)
+				pPhysicalResource = resourcePool.Allocate(pResource->GetName(), static_cast<RGBuffer*>(pResource)->GetDesc());
+			else
+				gUnreachable();
+			pResource->SetResource(pPhysicalResource);
+		};
+
+		// Resources that only live within this graph can share memory with other resources that are never alive at the same time.
+		// These are placed in shared heaps up front. Anything else is allocated from the pool on first access.
+		// Resources used on the async compute queue may be accessed at any time between the passes it synchronizes with, so they get their own memory for the whole graph.
+		// Exported resources are allocated before any transient resource is released, so they never take over memory of a resource in the same graph.
+		Array<RGResource*> transientResources;
+		for (RGResource* pResource : m_Resources)
+		{
+			if (!pResource->FirstAccess.IsValid() || pResource->IsImported)
+				continue;
+			if (pResource->IsAsyncCompute || pResource->IsExported)
+				AllocateResource(pResource);
+			else if (options.ResourceAliasing)
+				transientResources.push_back(pResource);
+		}
+		if (options.ResourceAliasing)
+			resourcePool.AllocateAliased(transientResources);
+
+		// State of each physical resource before it's first used in this graph. The cache can only be used when the states are the same.
+		HashSet<DeviceResource*> usedResources;
+		if (pCache)
+			initialStates.resize(m_Resources.size(), D3D12_RESOURCE_STATE_UNKNOWN);
+
+		// Transitions the compute queue can't do are issued on the graphics queue before the compute queue starts waiting.
+		// Without any dependency, that's the first graphics pass.
+		RGPass* pFirstGraphicsPass = nullptr;
+		for (RGPass* pPass : m_Passes)
+		{
+			if (!pPass->IsCulled && pPass->Queue == RGQueue::Graphics)
+			{
+				pFirstGraphicsPass = pPass;
+				break;
+			}
+		}
+
 		// Go through all resources accesses and allocate on first access and de-allocate on last access
 		// It's important to make the distinction between the Ref allocation and the Raw resource itself.
 		// A de-allocate returns the resource back to the pool by resetting the Ref however the Raw resource keeps a reference to it to use during execution.
-		// This is how we can "alias" resources (exact match only for now) and allocate our resources during compilation so that execution is thread-safe.
+		// This is how pooled resources are reused and how all resources are allocated during compilation so that execution is thread-safe.
 		for (RGPass* pPass : m_Passes)
 		{
 			if (pPass->IsCulled)
 				continue;
 
+			bool hasUnoptimizedBarriers = false;
 			for (const RGPass::ResourceAccess& access : pPass->Accesses)
 			{
 				RGResource* pResource = access.pResource;
+
 				if (!pResource->GetPhysicalUnsafe())
 				{
 					gAssert(pResource->FirstAccess == pPass->ID);
-
-					Ref<DeviceResource> pPhysicalResource;
-					if (pResource->GetType() == RGResourceType::Texture)
-						pPhysicalResource = resourcePool.Allocate(pResource->GetName(), static_cast<RGTexture*>(pResource)->GetDesc());
-					else if (pResource->GetType() == RGResourceType::Buffer)
-						pPhysicalResource = resourcePool.Allocate(pResource->GetName(), static_cast<RGBuffer*>(pResource)->GetDesc());
-					else
-						gUnreachable();
-					pResource->SetResource(pPhysicalResource);
+					AllocateResource(pResource);
 				}
 				gAssert(pResource->GetPhysicalUnsafe());
 
+				if (pCache && usedResources.insert(pResource->GetPhysicalUnsafe()).second)
+					initialStates[pResource->ID.GetIndex()] = pResource->GetPhysicalUnsafe()->GetResourceState(0xFFFFFFFF);
+
+				// The memory of an aliased resource was possibly used by another resource before.
+				if (pResource->IsAliased && pResource->FirstAccess == pPass->ID)
+				{
+					RGPass::AliasingBarrier& barrier = pPass->AliasingBarriers.emplace_back(RGPass::AliasingBarrier{ .pResource = pResource, .Discard = false });
+
+					// Render targets and depth stencils must be initialized with a clear, copy or discard before they're used
+					if (pResource->GetType() == RGResourceType::Texture)
+					{
+						const TextureDesc& desc = static_cast<RGTexture*>(pResource)->GetDesc();
+						if (EnumHasAnyFlags(desc.Flags, TextureFlag::RenderTarget | TextureFlag::DepthStencil))
+						{
+							DeviceResource* pPhysical = pResource->GetPhysicalUnsafe();
+							barrier.Discard = true;
+							barrier.DiscardState = EnumHasAnyFlags(desc.Flags, TextureFlag::RenderTarget) ? D3D12_RESOURCE_STATE_RENDER_TARGET : D3D12_RESOURCE_STATE_DEPTH_WRITE;
+							barrier.BeforeState = D3D12_RESOURCE_STATE_UNKNOWN;
+							if (options.StateTracking)
+							{
+								barrier.BeforeState = pPhysical->GetResourceState();
+								pPhysical->SetResourceState(barrier.DiscardState);
+							}
+						}
+					}
+				}
 
 				if (pResource->GetPhysicalUnsafe()->UseStateTracking())
 				{
@@ -224,26 +399,60 @@ void RGGraph::Compile(RGResourcePool& resourcePool, const RGGraphOptions& option
 					if (options.StateTracking)
 					{
 						D3D12_RESOURCE_STATES beforeState = pResource->GetPhysicalUnsafe()->GetResourceState(subResource);
-						D3D12_RESOURCE_STATES afterState = access.Access;
+
+						// Reads transition straight to the combined state of all reads up to the next write. The following reads then need no transition.
+						D3D12_RESOURCE_STATES afterState = D3D::HasWriteResourceState(access.Access) ? access.Access : access.ReadStates;
 						if (D3D::NeedsTransition(beforeState, afterState, true))
 						{
-							pPass->Transitions.push_back({ .pResource = pResource, .BeforeState = beforeState, .AfterState = afterState, .SubResource = subResource });
+							RGPass* pTransitionPass = pPass;
+							if (pPass->Queue == RGQueue::Compute && !D3D::IsTransitionAllowed(D3D12_COMMAND_LIST_TYPE_COMPUTE, beforeState))
+							{
+								if (!pPass->QueueDependency.IsValid())
+									pPass->QueueDependency = pFirstGraphicsPass->ID;
+								pTransitionPass = m_Passes[pPass->QueueDependency.GetIndex()];
+							}
+
+							RGPass::ResourceTransition transition{ .pResource = pResource, .BeforeState = beforeState, .AfterState = afterState, .SubResource = subResource };
+							if (pTransitionPass == pPass)
+								pPass->Transitions.push_back(transition);
+							else
+								pTransitionPass->PostTransitions.push_back(transition);
 							pResource->GetPhysicalUnsafe()->SetResourceState(afterState, subResource);
 						}
+
+						D3D12_RESOURCE_STATES& unoptimizedState = unoptimizedStates[pResource->ID.GetIndex()];
+						if (unoptimizedState == D3D12_RESOURCE_STATE_UNKNOWN)
+							unoptimizedState = beforeState;
+						D3D12_RESOURCE_STATES unoptimizedAfterState = access.Access;
+						bool isRedundantRead = unoptimizedState != unoptimizedAfterState
+							&& unoptimizedAfterState != D3D12_RESOURCE_STATE_COMMON
+							&& D3D::CanCombineResourceState(unoptimizedState, unoptimizedAfterState)
+							&& EnumHasAllFlags(unoptimizedState, unoptimizedAfterState);
+						if (isRedundantRead || D3D::NeedsTransition(unoptimizedState, unoptimizedAfterState, true))
+						{
+							unoptimizedState = unoptimizedAfterState;
+							++m_BarrierStats.NumUnoptimizedBarriers;
+							hasUnoptimizedBarriers = true;
+						}
 					}
 					else
 					{
 						pPass->Transitions.push_back({ .pResource = pResource, .BeforeState = D3D12_RESOURCE_STATE_UNKNOWN, .AfterState = access.Access, .SubResource = subResource });
+						++m_BarrierStats.NumUnoptimizedBarriers;
+						hasUnoptimizedBarriers = true;
 					}
 				}
 			}
 
+			if (hasUnoptimizedBarriers)
+				++m_BarrierStats.NumUnoptimizedBatches;
+
 			if (options.ResourceAliasing)
 			{
 				for (const RGPass::ResourceAccess& access : pPass->Accesses)
 				{
 					RGResource* pResource = access.pResource;
-					if (!pResource->IsImported && !pResource->IsExported && pResource->LastAccess == pPass->ID)
+					if (!pResource->IsImported && !pResource->IsExported && !pResource->IsAsyncCompute && pResource->LastAccess == pPass->ID)
 					{
 						pResource->Release();
 					}
@@ -252,44 +461,30 @@ void RGGraph::Compile(RGResourcePool& resourcePool, const RGGraphOptions& option
 		}
 
 		// If not aliasing resources, all resources still have a referece, so release it.
-		if (!options.ResourceAliasing)
+		// Resources used on the async compute queue are always released at the end.
+		for (RGResource* pResource : m_Resources)
 		{
-			for (RGResource* pResource : m_Resources)
+			if ((!options.ResourceAliasing || pResource->IsAsyncCompute) && !pResource->IsImported && !pResource->IsExported && pResource->IsAllocated())
 			{
-				if (!pResource->IsImported && !pResource->IsExported && pResource->IsAllocated())
-				{
-					pResource->Release();
-				}
+				pResource->Release();
 			}
 		}
 	}
 
 	// Export resources first so they can be available during pass execution.
-	for (ExportedTexture& exportResource : m_ExportTextures)
-	{
-		gAssert(exportResource.pTexture->GetPhysicalUnsafe(), "Exported texture doesn't have a physical resource assigned");
-		Ref<Texture> pTexture = (Texture*)exportResource.pTexture->GetPhysicalUnsafe();
-		pTexture->SetName(exportResource.pTexture->GetName());
-		*exportResource.pTarget = pTexture;
-	}
-	for (ExportedBuffer& exportResource : m_ExportBuffers)
-	{
-		gAssert(exportResource.pBuffer->GetPhysicalUnsafe(), "Exported buffer doesn't have a physical resource assigned");
-		Ref<Buffer> pBuffer = (Buffer*)exportResource.pBuffer->GetPhysicalUnsafe();
-		pBuffer->SetName(exportResource.pBuffer->GetName());
-		*exportResource.pTarget = pBuffer;
-	}
+	ExportResources();
 
 	{
 		PROFILE_CPU_SCOPE("Event Resolving");
 
-		// Move events from passes that are culled
+		// Move events from passes that are culled.
+		// Passes on the compute queue are recorded in other commandlists so they don't take part in the event hierarchy either.
 		Array<RGEventID> eventsToStart;
 		uint32 eventsToEnd = 0;
 		RGPass* pLastActivePass = nullptr;
 		for (RGPass* pPass : m_Passes)
 		{
-			if (pPass->IsCulled)
+			if (pPass->IsCulled || pPass->Queue != RGQueue::Graphics)
 			{
 				while (pPass->NumEventsToEnd > 0 && pPass->EventsToStart.size() > 0)
 				{
@@ -299,6 +494,8 @@ void RGGraph::Compile(RGResourcePool& resourcePool, const RGGraphOptions& option
 				for (RGEventID eventIndex : pPass->EventsToStart)
 					eventsToStart.push_back(eventIndex);
 				eventsToEnd += pPass->NumEventsToEnd;
+				pPass->EventsToStart.clear();
+				pPass->NumEventsToEnd = 0;
 			}
 			else
 			{
@@ -310,6 +507,12 @@ void RGGraph::Compile(RGResourcePool& resourcePool, const RGGraphOptions& option
 				pLastActivePass = pPass;
 			}
 		}
+		// Events that start and end after the last active pass are dropped
+		while (eventsToEnd > 0 && !eventsToStart.empty())
+		{
+			--eventsToEnd;
+			eventsToStart.pop_back();
+		}
 		pLastActivePass->NumEventsToEnd += eventsToEnd;
 		gAssert(eventsToStart.empty());
 	}
@@ -317,60 +520,523 @@ void RGGraph::Compile(RGResourcePool& resourcePool, const RGGraphOptions& option
 	{
 		PROFILE_CPU_SCOPE("Pass Grouping");
 
-		if (options.Jobify)
+		// Split the passes in submissions per queue.
+		// A submission ends after a pass the other queue waits for.
+		// A new submission starts when a pass has to wait for a submission of the other queue that hasn't been waited for yet.
+		Array<bool> isWaitedFor(m_Passes.size(), false);
+		for (const RGPass* pPass : m_Passes)
 		{
-			// Group passes in jobs
-			const uint32 maxPassesPerJob = options.CommandlistGroupSize;
+			if (!pPass->IsCulled && pPass->QueueDependency.IsValid())
+				isWaitedFor[pPass->QueueDependency.GetIndex()] = true;
+		}
 
-			// Duplicate profile events that cross the border of jobs to retain event hierarchy
-			RGPassID firstPass;
-			uint32 currentGroupSize = 0;
-			Array<RGEventID> activeEvents;
-			RGPass* pLastPass = nullptr;
+		struct PendingSubmission
+		{
+			Array<const RGPass*>	Passes;
+			int32					WaitSubmission = -1;
+		};
+		Array<PendingSubmission> submissions;
+		Array<RGQueue> submissionQueues;
+		StaticArray<PendingSubmission, (int)RGQueue::Num> openSubmissions;
+		StaticArray<int32, (int)RGQueue::Num> waitedSubmissions;
+		waitedSubmissions.fill(-1);
+		Array<int32> passSubmissions(m_Passes.size(), -1);
+
+		auto CloseSubmission = [&](RGQueue queue)
+		{
+			PendingSubmission& submission = openSubmissions[(int)queue];
+			if (submission.Passes.empty())
+				return;
+			for (const RGPass* pPass : submission.Passes)
+				passSubmissions[pPass->ID.GetIndex()] = (int32)submissions.size();
+			submissions.push_back(std::move(submission));
+			submissionQueues.push_back(queue);
+			submission = {};
+		};
+
+		for (const RGPass* pPass : m_Passes)
+		{
+			if (pPass->IsCulled)
+				continue;
 
-			for (uint32 passIndex = 0; passIndex < (uint32)m_Passes.size(); ++passIndex)
+			const int queueIndex = (int)pPass->Queue;
+			if (pPass->QueueDependency.IsValid())
 			{
-				RGPass* pPass = m_Passes[passIndex];
-				if (!pPass->IsCulled)
+				int32 dependency = passSubmissions[pPass->QueueDependency.GetIndex()];
+				gAssert(dependency >= 0, "Pass '%s' depends on a pass that isn't submitted yet", pPass->GetName());
+				if (dependency > waitedSubmissions[queueIndex])
 				{
-					pPass->CPUEventsToStart = pPass->EventsToStart;
-					pPass->NumCPUEventsToEnd = pPass->NumEventsToEnd;
+					CloseSubmission(pPass->Queue);
+					openSubmissions[queueIndex].WaitSubmission = dependency;
+					waitedSubmissions[queueIndex] = dependency;
+				}
+			}
+
+			openSubmissions[queueIndex].Passes.push_back(pPass);
+			if (isWaitedFor[pPass->ID.GetIndex()])
+				CloseSubmission(pPass->Queue);
+		}
+		CloseSubmission(RGQueue::Graphics);
+		CloseSubmission(RGQueue::Compute);
+
+		// Predicted recording time of each pass. Without a cost model, all passes cost the same.
+		Array<float> passCosts(m_Passes.size(), 1.0f);
+		float totalCost = 0;
+		for (const PendingSubmission& submission : submissions)
+		{
+			for (const RGPass* pPass : submission.Passes)
+			{
+				if (m_pCostModel)
+					passCosts[pPass->ID.GetIndex()] = m_pCostModel->GetCost(pPass->GetName());
+				totalCost += passCosts[pPass->ID.GetIndex()];
+			}
+		}
 
-					for (RGEventID event : pPass->CPUEventsToStart)
-						activeEvents.push_back(event);
+		// Group passes in jobs
+		// With a cost model, each submission gets a share of the workers relative to its cost and is cut in groups of about equal cost.
+		const uint32 maxPassesPerJob = options.Jobify ? options.CommandlistGroupSize : (uint32)m_Passes.size();
+		const bool balanceByCost = options.Jobify && m_pCostModel;
+		const uint32 numWorkers = Math::Max(TaskQueue::ThreadCount(), 1u);
+		Array<float> fixedGroupCosts;
+		Array<float> groupCosts;
+		for (uint32 submissionIndex = 0; submissionIndex < (uint32)submissions.size(); ++submissionIndex)
+		{
+			const Array<const RGPass*>& passes = submissions[submissionIndex].Passes;
+			m_Submissions.push_back(Submission{ .Queue = submissionQueues[submissionIndex], .FirstGroup = (uint32)m_PassExecuteGroups.size(), .NumGroups = 0, .WaitSubmission = submissions[submissionIndex].WaitSubmission });
 
-					if (currentGroupSize == 0)
+			auto AddGroup = [&](uint32 firstIndex, uint32 lastIndex, float cost)
+			{
+				uint32 firstPass = passes[firstIndex]->ID.GetIndex();
+				uint32 lastPass = passes[lastIndex]->ID.GetIndex();
+				m_PassExecuteGroups.push_back(Span<const RGPass*>(&m_Passes[firstPass], lastPass - firstPass + 1));
+				++m_Submissions.back().NumGroups;
+				groupCosts.push_back(cost);
+			};
+
+			float submissionCost = 0;
+			for (uint32 passIndex = 0; passIndex < (uint32)passes.size(); passIndex += maxPassesPerJob)
+			{
+				float cost = 0;
+				for (uint32 i = passIndex; i < Math::Min(passIndex + maxPassesPerJob, (uint32)passes.size()); ++i)
+					cost += passCosts[passes[i]->ID.GetIndex()];
+				fixedGroupCosts.push_back(cost);
+				submissionCost += cost;
+				if (!balanceByCost)
+					AddGroup(passIndex, Math::Min(passIndex + maxPassesPerJob, (uint32)passes.size()) - 1, cost);
+			}
+
+			if (balanceByCost)
+			{
+				float costShare = totalCost > 0 ? submissionCost / totalCost : 1.0f;
+				uint32 groupsLeft = Math::Clamp((uint32)roundf(numWorkers * costShare), 1u, (uint32)passes.size());
+				float remainingCost = submissionCost;
+				float groupCost = 0;
+				uint32 groupStart = 0;
+				for (uint32 passIndex = 0; passIndex < (uint32)passes.size(); ++passIndex)
+				{
+					// Cut before this pass if the group ends up closer to its share of the remaining cost without it
+					float cost = passCosts[passes[passIndex]->ID.GetIndex()];
+					float targetCost = remainingCost / groupsLeft;
+					if (groupsLeft > 1 && passIndex > groupStart && groupCost + cost - targetCost > targetCost - groupCost)
 					{
-						firstPass = pPass->ID;
-						pPass->CPUEventsToStart = activeEvents;
+						AddGroup(groupStart, passIndex - 1, groupCost);
+						remainingCost -= groupCost;
+						--groupsLeft;
+						groupCost = 0;
+						groupStart = passIndex;
 					}
+					groupCost += cost;
+				}
+				AddGroup(groupStart, (uint32)passes.size() - 1, groupCost);
+			}
+		}
 
-					for (uint32 i = 0; i < pPass->NumCPUEventsToEnd; ++i)
-						activeEvents.pop_back();
+		auto ComputeImbalance = [](const Array<float>& costs)
+		{
+			if (costs.empty())
+				return 0.0f;
+			float maxCost = 0;
+			float sumCost = 0;
+			for (float cost : costs)
+			{
+				maxCost = Math::Max(maxCost, cost);
+				sumCost += cost;
+			}
+			return sumCost > 0 ? maxCost * costs.size() / sumCost : 1.0f;
+		};
+		m_PartitionStats = {};
+		m_PartitionStats.NumGroups = (uint32)m_PassExecuteGroups.size();
+		m_PartitionStats.FixedImbalance = ComputeImbalance(fixedGroupCosts);
+		m_PartitionStats.PredictedImbalance = ComputeImbalance(groupCosts);
 
-					++currentGroupSize;
-					if (currentGroupSize >= maxPassesPerJob)
+		if (options.Jobify)
+		{
+			// Duplicate profile events that cross the border of jobs to retain event hierarchy
+			Array<RGEventID> activeEvents;
+			for (const Submission& submission : m_Submissions)
+			{
+				if (submission.Queue != RGQueue::Graphics)
+					continue;
+
+				for (uint32 groupIndex = submission.FirstGroup; groupIndex < submission.FirstGroup + submission.NumGroups; ++groupIndex)
+				{
+					RGPass* pLastPass = nullptr;
+					for (const RGPass* pGroupPass : m_PassExecuteGroups[groupIndex])
 					{
-						pPass->NumCPUEventsToEnd += (uint32)activeEvents.size();
-						m_PassExecuteGroups.push_back(Span<const RGPass*>(&m_Passes[firstPass.GetIndex()], passIndex - firstPass.GetIndex() + 1));
-						currentGroupSize = 0;
+						RGPass* pPass = m_Passes[pGroupPass->ID.GetIndex()];
+						if (pPass->IsCulled || pPass->Queue != submission.Queue)
+							continue;
+
+						pPass->CPUEventsToStart = pPass->EventsToStart;
+						pPass->NumCPUEventsToEnd = pPass->NumEventsToEnd;
+
+						for (RGEventID event : pPass->CPUEventsToStart)
+							activeEvents.push_back(event);
+
+						if (!pLastPass)
+							pPass->CPUEventsToStart = activeEvents;
+
+						for (uint32 i = 0; i < pPass->NumCPUEventsToEnd; ++i)
+							activeEvents.pop_back();
+
+						pLastPass = pPass;
 					}
-					pLastPass = pPass;
+					pLastPass->NumCPUEventsToEnd += (uint32)activeEvents.size();
 				}
 			}
-			if (currentGroupSize > 0)
-				m_PassExecuteGroups.push_back(Span<const RGPass*>(&m_Passes[firstPass.GetIndex()], (uint32)m_Passes.size() - firstPass.GetIndex()));
-			pLastPass->NumCPUEventsToEnd += (uint32)activeEvents.size();
 		}
-		else
+	}
+
+	// Render passes can't span multiple commandlists either
+	MergeRenderPasses(options);
+
+	// Split barriers need the pass groups, a split barrier can't span multiple commandlists
+	if (options.StateTracking && options.SplitBarriers)
+		SplitBarriers();
+
+	for (const RGPass* pPass : m_Passes)
+	{
+		if (pPass->IsCulled)
+			continue;
+
+		if (!pPass->Transitions.empty())
+			++m_BarrierStats.NumBatches;
+		if (!pPass->PostTransitions.empty())
+			++m_BarrierStats.NumBatches;
+		m_BarrierStats.NumBarriers += (uint32)pPass->PostTransitions.size();
+
+		for (const RGPass::ResourceTransition& transition : pPass->Transitions)
 		{
-			m_PassExecuteGroups.push_back(Span<const RGPass*>(m_Passes.data(), (uint32)m_Passes.size()));
+			if (transition.Flags != D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY)
+				++m_BarrierStats.NumBarriers;
+			if (transition.Flags == D3D12_RESOURCE_BARRIER_FLAG_END_ONLY)
+				++m_BarrierStats.NumSplitBarriers;
 		}
 	}
 
+	if (pCache)
+		StoreInCache(*pCache, initialStates);
+
 	m_IsCompiled = true;
 }
 
+void RGGraph::ScheduleAsyncCompute()
+{
+	PROFILE_CPU_SCOPE();
+
+	// Move compute passes that opted in to the compute queue.
+	// Transitions the compute queue can't do are issued by a graphics pass before it, so there must be one.
+	bool hasGraphicsPass = false;
+	bool hasComputePass = false;
+	for (RGPass* pPass : m_Passes)
+	{
+		if (pPass->IsCulled)
+			continue;
+
+		if (hasGraphicsPass
+			&& EnumHasAllFlags(pPass->Flags, RGPassFlag::Compute | RGPassFlag::AsyncCompute)
+			&& !EnumHasAnyFlags(pPass->Flags, RGPassFlag::Raster | RGPassFlag::Copy))
+		{
+			// The compute queue can't use the pixel shader resource state, compute passes only need the non-pixel shader resource state
+			bool isSupported = true;
+			for (const RGPass::ResourceAccess& access : pPass->Accesses)
+				isSupported &= D3D::IsTransitionAllowed(D3D12_COMMAND_LIST_TYPE_COMPUTE, access.Access & ~D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+			if (isSupported)
+			{
+				pPass->Queue = RGQueue::Compute;
+				for (RGPass::ResourceAccess& access : pPass->Accesses)
+				{
+					access.Access &= ~D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+					access.pResource->IsAsyncCompute = true;
+				}
+				hasComputePass = true;
+			}
+		}
+
+		hasGraphicsPass |= pPass->Queue == RGQueue::Graphics;
+	}
+
+	if (!hasComputePass)
+		return;
+
+	// Each pass waits for the last pass on the other queue that accesses any of its resources.
+	// Two reads are a dependency as well, the state of a resource can't change while the other queue may be accessing it.
+	// Imported resources are tracked by their physical resource because the same resource may be imported more than once.
+	HashMap<const void*, StaticArray<RGPassID, (int)RGQueue::Num>> lastAccesses;
+	for (RGPass* pPass : m_Passes)
+	{
+		if (pPass->IsCulled)
+			continue;
+
+		const RGQueue otherQueue = pPass->Queue == RGQueue::Graphics ? RGQueue::Compute : RGQueue::Graphics;
+		for (const RGPass::ResourceAccess& access : pPass->Accesses)
+		{
+			const void* pKey = access.pResource->IsImported ? (const void*)access.pResource->GetPhysicalUnsafe() : access.pResource;
+			StaticArray<RGPassID, (int)RGQueue::Num>& resourceAccesses = lastAccesses[pKey];
+
+			RGPassID otherAccess = resourceAccesses[(int)otherQueue];
+			if (otherAccess.IsValid() && (!pPass->QueueDependency.IsValid() || otherAccess.GetIndex() > pPass->QueueDependency.GetIndex()))
+				pPass->QueueDependency = otherAccess;
+			resourceAccesses[(int)pPass->Queue] = pPass->ID;
+		}
+	}
+}
+
+void RGGraph::MergeRenderPasses(const RGGraphOptions& options)
+{
+	PROFILE_CPU_SCOPE();
+
+	m_RenderPassStats = {};
+
+	// Commandlist each pass is recorded in
+	Array<int32> passGroups(m_Passes.size(), -1);
+	for (const Submission& submission : m_Submissions)
+	{
+		for (uint32 groupIndex = submission.FirstGroup; groupIndex < submission.FirstGroup + submission.NumGroups; ++groupIndex)
+		{
+			for (const RGPass* pPass : m_PassExecuteGroups[groupIndex])
+			{
+				if (pPass->Queue == submission.Queue)
+					passGroups[pPass->ID.GetIndex()] = (int32)groupIndex;
+			}
+		}
+	}
+
+	// A pass can continue the render pass of the previous pass if it renders to the same targets in the same way,
+	// doesn't have to initialize them and needs no barriers in between.
+	// Resolves are excluded, they transition the targets outside of the graph's state tracking.
+	auto CanMerge = [&](const RGPass* pPrevious, const RGPass* pPass)
+	{
+		if (passGroups[pPrevious->ID.GetIndex()] != passGroups[pPass->ID.GetIndex()])
+			return false;
+		if (!pPass->Transitions.empty() || !pPass->AliasingBarriers.empty() || !pPrevious->PostTransitions.empty())
+			return false;
+		if (pPrevious->RenderTargets.empty() && !pPrevious->DepthStencilTarget.pResource)
+			return false;
+
+		if (pPrevious->RenderTargets.size() != pPass->RenderTargets.size())
+			return false;
+		for (uint32 i = 0; i < (uint32)pPass->RenderTargets.size(); ++i)
+		{
+			const RGPass::RenderTargetAccess& previousTarget = pPrevious->RenderTargets[i];
+			const RGPass::RenderTargetAccess& target = pPass->RenderTargets[i];
+			if (previousTarget.pResource != target.pResource || previousTarget.pResolveTarget || target.pResolveTarget)
+				return false;
+			if (EnumHasAnyFlags(target.Flags, RenderPassColorFlags::Clear))
+				return false;
+		}
+
+		const RGPass::DepthStencilAccess& previousDepth = pPrevious->DepthStencilTarget;
+		const RGPass::DepthStencilAccess& depth = pPass->DepthStencilTarget;
+		if (previousDepth.pResource != depth.pResource)
+			return false;
+		if (depth.pResource && ((previousDepth.Flags ^ depth.Flags) & RenderPassDepthFlags::ReadOnly) != RenderPassDepthFlags::None)
+			return false;
+		return !EnumHasAnyFlags(depth.Flags, RenderPassDepthFlags::Clear);
+	};
+
+	// Targets of transient resources don't have to be loaded before their first access or stored after their last access.
+	// Aliased resources are discarded by their aliasing barrier already.
+	auto ResolveLoadStore = [&](RGPass* pFirst, const RGPass* pLast)
+	{
+		auto IsTransient = [](const RGResource* pResource) { return !pResource->IsImported && !pResource->IsExported; };
+
+		for (RGPass::RenderTargetAccess& target : pFirst->RenderTargets)
+		{
+			const RGResource* pResource = target.pResource;
+			if (!IsTransient(pResource))
+				continue;
+			if (pResource->FirstAccess == pFirst->ID && !pResource->IsAliased && !EnumHasAnyFlags(target.Flags, RenderPassColorFlags::Clear))
+			{
+				target.Flags |= RenderPassColorFlags::DiscardLoad;
+				++m_RenderPassStats.NumDiscardedLoads;
+			}
+			if (pResource->LastAccess == pLast->ID && !target.pResolveTarget)
+			{
+				target.Flags |= RenderPassColorFlags::DiscardStore;
+				++m_RenderPassStats.NumDiscardedStores;
+			}
+		}
+
+		// A read-only depth target can't be discarded
+		RGPass::DepthStencilAccess& depth = pFirst->DepthStencilTarget;
+		if (depth.pResource && IsTransient(depth.pResource) && !EnumHasAnyFlags(depth.Flags, RenderPassDepthFlags::ReadOnly))
+		{
+			if (depth.pResource->FirstAccess == pFirst->ID && !depth.pResource->IsAliased && !EnumHasAnyFlags(depth.Flags, RenderPassDepthFlags::Clear))
+			{
+				depth.Flags |= RenderPassDepthFlags::DiscardLoad;
+				++m_RenderPassStats.NumDiscardedLoads;
+			}
+			if (depth.pResource->LastAccess == pLast->ID)
+			{
+				depth.Flags |= RenderPassDepthFlags::DiscardStore;
+				++m_RenderPassStats.NumDiscardedStores;
+			}
+		}
+	};
+
+	// Passes on the compute queue are recorded in other commandlists, so they don't interrupt a render pass.
+	// Any other pass on the graphics queue does.
+	RGPass* pFirst = nullptr;
+	RGPass* pLast = nullptr;
+	auto EndRenderPass = [&]()
+	{
+		if (pFirst && options.RenderPassMerging)
+			ResolveLoadStore(pFirst, pLast);
+		pFirst = nullptr;
+		pLast = nullptr;
+	};
+
+	for (RGPass* pPass : m_Passes)
+	{
+		if (pPass->IsCulled || pPass->Queue != RGQueue::Graphics)
+			continue;
+
+		if (!EnumHasAllFlags(pPass->Flags, RGPassFlag::Raster))
+		{
+			EndRenderPass();
+			continue;
+		}
+
+		++m_RenderPassStats.NumRasterPasses;
+		if (pLast && options.RenderPassMerging && options.StateTracking && CanMerge(pLast, pPass))
+		{
+			pLast->MergedWithNext = true;
+			pPass->MergedWithPrevious = true;
+			pLast = pPass;
+			++m_RenderPassStats.NumMergedPasses;
+			continue;
+		}
+
+		EndRenderPass();
+		pFirst = pPass;
+		pLast = pPass;
+		++m_RenderPassStats.NumRenderPasses;
+	}
+	EndRenderPass();
+}
+
+void RGGraph::SplitBarriers()
+{
+	PROFILE_CPU_SCOPE();
+
+	// First pass of the commandlist each pass is recorded in
+	Array<uint32> groupBegin(m_Passes.size(), 0);
+	for (const Submission& submission : m_Submissions)
+	{
+		for (uint32 groupIndex = submission.FirstGroup; groupIndex < submission.FirstGroup + submission.NumGroups; ++groupIndex)
+		{
+			Span<const RGPass*> group = m_PassExecuteGroups[groupIndex];
+			for (const RGPass* pPass : group)
+			{
+				if (pPass->Queue == submission.Queue)
+					groupBegin[pPass->ID.GetIndex()] = group[0]->ID.GetIndex();
+			}
+		}
+	}
+
+	// Last pass that accessed each physical resource so far.
+	// This is tracked per physical resource because pooled resources are reused by multiple graph resources.
+	HashMap<DeviceResource*, RGPassID> lastAccesses;
+
+	for (RGPass* pPass : m_Passes)
+	{
+		if (pPass->IsCulled)
+			continue;
+
+		const uint32 passIndex = pPass->ID.GetIndex();
+		for (RGPass::ResourceTransition& transition : pPass->Transitions)
+		{
+			RGResource* pResource = transition.pResource;
+			if (transition.Flags != D3D12_RESOURCE_BARRIER_FLAG_NONE || pPass->Queue != RGQueue::Graphics)
+				continue;
+
+			auto it = lastAccesses.find(pResource->GetPhysicalUnsafe());
+			RGPassID previousAccess = it != lastAccesses.end() ? it->second : RGPassID();
+
+			// Before its first access, the memory of an aliased resource may still be in use by another resource
+			if (!previousAccess.IsValid() && pResource->IsAliased)
+				continue;
+
+			// The previous access on the other queue may still be running until this pass waits for it
+			if (previousAccess.IsValid() && m_Passes[previousAccess.GetIndex()]->Queue != pPass->Queue)
+				continue;
+
+			// The transition can begin right after the previous access, within the same commandlist.
+			// Prefer a pass that already flushes barriers, so the begin barrier is batched with those instead of adding a batch.
+			uint32 beginIndex = Math::Max(previousAccess.IsValid() ? previousAccess.GetIndex() + 1u : 0u, groupBegin[passIndex]);
+			RGPass* pBeginPass = nullptr;
+			for (uint32 candidateIndex = beginIndex; candidateIndex < passIndex; ++candidateIndex)
+			{
+				RGPass* pCandidate = m_Passes[candidateIndex];
+				if (pCandidate->IsCulled || pCandidate->Queue != pPass->Queue)
+					continue;
+
+				// Barriers can't be flushed within a merged render pass
+				if (pCandidate->MergedWithPrevious)
+					continue;
+				if (!pBeginPass)
+					pBeginPass = pCandidate;
+				if (!pCandidate->Transitions.empty())
+				{
+					pBeginPass = pCandidate;
+					break;
+				}
+			}
+
+			if (!pBeginPass)
+				continue;
+
+			RGPass::ResourceTransition& beginTransition = pBeginPass->Transitions.emplace_back(transition);
+			beginTransition.Flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+			transition.Flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+		}
+
+		for (const RGPass::ResourceAccess& access : pPass->Accesses)
+			lastAccesses[access.pResource->GetPhysicalUnsafe()] = pPass->ID;
+	}
+}
+
+void RGGraph::ExportResources()
+{
+	for (ExportedTexture& exportResource : m_ExportTextures)
+	{
+		gAssert(exportResource.pTexture->GetPhysicalUnsafe(), "Exported texture doesn't have a physical resource assigned");
+		Ref<Texture> pTexture = (Texture*)exportResource.pTexture->GetPhysicalUnsafe();
+		pTexture->SetName(exportResource.pTexture->GetName());
+		*exportResource.pTarget = pTexture;
+	}
+	for (ExportedBuffer& exportResource : m_ExportBuffers)
+	{
+		gAssert(exportResource.pBuffer->GetPhysicalUnsafe(), "Exported buffer doesn't have a physical resource assigned");
+		Ref<Buffer> pBuffer = (Buffer*)exportResource.pBuffer->GetPhysicalUnsafe();
+		pBuffer->SetName(exportResource.pBuffer->GetName());
+		*exportResource.pTarget = pBuffer;
+	}
+
+}
+
 void RGGraph::Export(RGTexture* pTexture, Ref<Texture>* pTarget, TextureFlag additionalFlags)
 {
 	auto it = std::find_if(m_ExportTextures.begin(), m_ExportTextures.end(), [&](const ExportedTexture& tex) { return tex.pTarget == pTarget; });
@@ -408,8 +1074,34 @@ void RGGraph::Execute(GraphicsDevice* pDevice)
 
 	gAssert(m_IsCompiled);
 
+	auto GetCommandListType = [](RGQueue queue)
+	{
+		return queue == RGQueue::Compute ? D3D12_COMMAND_LIST_TYPE_COMPUTE : D3D12_COMMAND_LIST_TYPE_DIRECT;
+	};
+
 	Array<CommandContext*> contexts;
 	contexts.reserve(m_PassExecuteGroups.size());
+	for (const Submission& submission : m_Submissions)
+	{
+		for (uint32 i = 0; i < submission.NumGroups; ++i)
+			contexts.push_back(pDevice->AllocateCommandContext(GetCommandListType(submission.Queue)));
+	}
+
+	// Every pass is executed by a single job, so the jobs can write their recording times without synchronization
+	m_PassRecordTimes.assign(m_Passes.size(), 0.0f);
+
+	auto ExecuteGroup = [this](Span<const RGPass*> passGroup, RGQueue queue, CommandContext* pContext)
+	{
+		for (const RGPass* pPass : passGroup)
+		{
+			if (!pPass->IsCulled && pPass->Queue == queue)
+			{
+				Utils::TimeScope timer;
+				ExecutePass(pPass, *pContext);
+				m_PassRecordTimes[pPass->ID.GetIndex()] = timer.Stop() * 1000.0f;
+			}
+		}
+	};
 
 	if (m_PassExecuteGroups.size() > 1)
 	{
@@ -417,18 +1109,15 @@ void RGGraph::Execute(GraphicsDevice* pDevice)
 
 		{
 			PROFILE_CPU_SCOPE("Schedule Render Jobs");
-			for (Span<const RGPass*> passGroup : m_PassExecuteGroups)
+			for (const Submission& submission : m_Submissions)
 			{
-				CommandContext* pContext = pDevice->AllocateCommandContext();
-				TaskQueue::Execute([this, passGroup, pContext](int)
-					{
-						for (const RGPass* pPass : passGroup)
+				for (uint32 groupIndex = submission.FirstGroup; groupIndex < submission.FirstGroup + submission.NumGroups; ++groupIndex)
+				{
+					TaskQueue::Execute([&ExecuteGroup, passGroup = m_PassExecuteGroups[groupIndex], queue = submission.Queue, pContext = contexts[groupIndex]](int)
 						{
-							if (!pPass->IsCulled)
-								ExecutePass(pPass, *pContext);
-						}
-					}, context);
-				contexts.push_back(pContext);
+							ExecuteGroup(passGroup, queue, pContext);
+						}, context);
+				}
 			}
 		}
 
@@ -437,20 +1126,76 @@ void RGGraph::Execute(GraphicsDevice* pDevice)
 			TaskQueue::Join(context);
 		}
 	}
-	else
+	else if (m_PassExecuteGroups.size() == 1)
 	{
 		PROFILE_CPU_SCOPE("Schedule Render Jobs");
+		ExecuteGroup(m_PassExecuteGroups[0], m_Submissions[0].Queue, contexts[0]);
+	}
 
-		CommandContext* pContext = pDevice->AllocateCommandContext();
-		for (const RGPass* pPass : m_PassExecuteGroups[0])
+	{
+		PROFILE_CPU_SCOPE("Submit");
+
+		CommandQueue* pGraphicsQueue = pDevice->GetCommandQueue(D3D12_COMMAND_LIST_TYPE_DIRECT);
+		CommandQueue* pComputeQueue = pDevice->GetCommandQueue(D3D12_COMMAND_LIST_TYPE_COMPUTE);
+
+		// Work outside of the graph isn't tracked, so the compute queue starts after everything that was submitted before
+		bool hasComputeWork = std::any_of(m_Submissions.begin(), m_Submissions.end(), [](const Submission& submission) { return submission.Queue == RGQueue::Compute; });
+		if (hasComputeWork)
+			pComputeQueue->InsertWait(pGraphicsQueue);
+
+		Array<SyncPoint> syncPoints(m_Submissions.size());
+		int32 lastComputeSubmission = -1;
+		int32 lastComputeWait = -1;
+		for (uint32 submissionIndex = 0; submissionIndex < (uint32)m_Submissions.size(); ++submissionIndex)
 		{
-			if (!pPass->IsCulled)
-				ExecutePass(pPass, *pContext);
+			const Submission& submission = m_Submissions[submissionIndex];
+			CommandQueue* pQueue = submission.Queue == RGQueue::Compute ? pComputeQueue : pGraphicsQueue;
+			if (submission.WaitSubmission >= 0)
+				pQueue->InsertWait(syncPoints[submission.WaitSubmission]);
+
+			if (submission.Queue == RGQueue::Compute)
+				lastComputeSubmission = submissionIndex;
+			else
+				lastComputeWait = Math::Max(lastComputeWait, submission.WaitSubmission);
+
+			syncPoints[submissionIndex] = CommandContext::Execute(Span<CommandContext* const>(&contexts[submission.FirstGroup], submission.NumGroups));
 		}
-		contexts.push_back(pContext);
+
+		// Everything after the graph expects all of its work to be done when the graphics queue is
+		if (lastComputeSubmission > lastComputeWait)
+			pGraphicsQueue->InsertWait(syncPoints[lastComputeSubmission]);
 	}
 
-	CommandContext::Execute(contexts);
+	{
+		// Compare the recording time of the commandlists and feed the cost model
+		float maxGroupTime = 0;
+		float totalGroupTime = 0;
+		for (const Submission& submission : m_Submissions)
+		{
+			for (uint32 groupIndex = submission.FirstGroup; groupIndex < submission.FirstGroup + submission.NumGroups; ++groupIndex)
+			{
+				float groupTime = 0;
+				for (const RGPass* pPass : m_PassExecuteGroups[groupIndex])
+				{
+					if (!pPass->IsCulled && pPass->Queue == submission.Queue)
+						groupTime += m_PassRecordTimes[pPass->ID.GetIndex()];
+				}
+				maxGroupTime = Math::Max(maxGroupTime, groupTime);
+				totalGroupTime += groupTime;
+			}
+		}
+		m_PartitionStats.MeasuredImbalance = totalGroupTime > 0 ? maxGroupTime * m_PassExecuteGroups.size() / totalGroupTime : 0.0f;
+
+		if (m_pCostModel)
+		{
+			for (const RGPass* pPass : m_Passes)
+			{
+				if (!pPass->IsCulled)
+					m_pCostModel->AddSample(pPass->GetName(), m_PassRecordTimes[pPass->ID.GetIndex()]);
+			}
+			m_pCostModel->EndFrame();
+		}
+	}
 
 	// Update exported resource names
 	for (ExportedTexture& exportResource : m_ExportTextures)
@@ -476,7 +1221,7 @@ void RGGraph::ExecutePass(const RGPass* pPass, CommandContext& context) const
 
 	{
 		PROFILE_GPU_SCOPE(context.GetCommandList(), pPass->GetName());
-		PROFILE_CPU_SCOPE(pPass->GetName());
+		PROFILE_CPU_SCOPE_DYNAMIC(pPass->GetName());
 
 		PrepareResources(pPass, context);
 
@@ -485,19 +1230,45 @@ void RGGraph::ExecutePass(const RGPass* pPass, CommandContext& context) const
 			RGResources resources(*pPass);
 
 			bool useRenderPass = EnumHasAllFlags(pPass->Flags, RGPassFlag::Raster);
-			if (useRenderPass)
+			if (useRenderPass && !pPass->MergedWithPrevious)
+			{
 				context.BeginRenderPass(resources.GetRenderPassInfo());
+			}
+			else if (useRenderPass)
+			{
+				// The render pass is continued, but the viewport of the previous pass is not
+				RenderPassInfo passInfo = resources.GetRenderPassInfo();
+				Texture* pTarget = passInfo.DepthStencilTarget.pTarget ? passInfo.DepthStencilTarget.pTarget : passInfo.RenderTargets[0].pTarget;
+				context.SetViewport(FloatRect(0, 0, (float)pTarget->GetWidth(), (float)pTarget->GetHeight()), 0, 1);
+			}
 
 			pPass->pExecuteCallback->Execute(context, resources);
 
-			if (useRenderPass)
+			if (useRenderPass && !pPass->MergedWithNext)
 				context.EndRenderPass();
 
 #define TEST_STATE_LEAKING 0
 #if TEST_STATE_LEAKING
-			context.ClearState();
+			if (!pPass->MergedWithNext)
+				context.ClearState();
 #endif
 		}
+		else if (pPass->MergedWithPrevious || pPass->MergedWithNext)
+		{
+			// Passes without a callback still begin or end the render pass they're merged in
+			RGResources resources(*pPass);
+			if (!pPass->MergedWithPrevious)
+				context.BeginRenderPass(resources.GetRenderPassInfo());
+			if (!pPass->MergedWithNext)
+				context.EndRenderPass();
+		}
+
+		if (!pPass->PostTransitions.empty())
+		{
+			for (const RGPass::ResourceTransition& transition : pPass->PostTransitions)
+				context.InsertResourceBarrier(transition.pResource->GetPhysicalUnsafe(), transition.BeforeState, transition.AfterState, transition.SubResource);
+			context.FlushResourceBarriers();
+		}
 	}
 
 	for(uint32 i = 0; i < pPass->NumEventsToEnd; ++i)
@@ -508,6 +1279,22 @@ void RGGraph::ExecutePass(const RGPass* pPass, CommandContext& context) const
 
 void RGGraph::PrepareResources(const RGPass* pPass, CommandContext& context) const
 {
+	if (!pPass->AliasingBarriers.empty())
+	{
+		for (const RGPass::AliasingBarrier& barrier : pPass->AliasingBarriers)
+			context.InsertAliasingBarrier(barrier.pResource->GetPhysicalUnsafe());
+		for (const RGPass::AliasingBarrier& barrier : pPass->AliasingBarriers)
+		{
+			if (barrier.Discard)
+				context.InsertResourceBarrier(barrier.pResource->GetPhysicalUnsafe(), barrier.BeforeState, barrier.DiscardState);
+		}
+		for (const RGPass::AliasingBarrier& barrier : pPass->AliasingBarriers)
+		{
+			if (barrier.Discard)
+				context.DiscardResource(barrier.pResource->GetPhysicalUnsafe());
+		}
+	}
+
 	for (const RGPass::ResourceTransition& transition : pPass->Transitions)
 	{
 		RGResource* pResource = transition.pResource;
@@ -515,7 +1302,7 @@ void RGGraph::PrepareResources(const RGPass* pPass, CommandContext& context) con
 		gAssert(pResource->GetPhysicalUnsafe(), "Resource was not allocated during the graph compile phase");
 		gAssert(pResource->IsImported || pResource->IsExported || !pResource->IsAllocated(), "If resource is not external, it's reference should be released during the graph compile phase");
 
-		context.InsertResourceBarrier(pResource->GetPhysicalUnsafe(), transition.BeforeState, transition.AfterState, transition.SubResource);
+		context.InsertResourceBarrier(pResource->GetPhysicalUnsafe(), transition.BeforeState, transition.AfterState, transition.SubResource, transition.Flags);
 	}
 
 	context.FlushResourceBarriers();
@@ -560,66 +1347,417 @@ DeviceResource* RGResources::GetResource(const RGResource* pResource, D3D12_RESO
 	return pResource->GetPhysicalUnsafe();
 }
 
+float RGPassCostModel::GetCost(const char* pPassName) const
+{
+	auto it = m_Costs.find(StringHash(pPassName));
+	return it != m_Costs.end() ? it->second.Cost : m_AverageCost;
+}
+
+void RGPassCostModel::AddSample(const char* pPassName, float time)
+{
+	// Exponential moving average, smooths out spikes from threads being preempted
+	constexpr float smoothing = 0.1f;
+
+	auto it = m_Costs.find(StringHash(pPassName));
+	if (it == m_Costs.end())
+	{
+		m_Costs[StringHash(pPassName)] = PassCost{ .Cost = time, .PartitionCost = time };
+		m_HasDrifted = true;
+		return;
+	}
+
+	PassCost& cost = it->second;
+	cost.Cost = Math::Lerp(smoothing, cost.Cost, time);
+
+	// Small absolute changes in cheap passes don't matter for the balance
+	constexpr float relativeThreshold = 0.25f;
+	constexpr float absoluteThreshold = 0.05f;
+	if (fabs(cost.Cost - cost.PartitionCost) > cost.PartitionCost * relativeThreshold + absoluteThreshold)
+		m_HasDrifted = true;
+}
+
+void RGPassCostModel::EndFrame()
+{
+	if (!m_HasDrifted)
+		return;
+
+	float totalCost = 0;
+	for (auto& [name, cost] : m_Costs)
+	{
+		cost.PartitionCost = cost.Cost;
+		totalCost += cost.Cost;
+	}
+	m_AverageCost = m_Costs.empty() ? 1.0f : totalCost / m_Costs.size();
+	m_HasDrifted = false;
+	++m_Generation;
+}
+
+namespace
+{
+	uint32 GetBucketKey(const TextureDesc& desc)
+	{
+		StringHash hash;
+		hash.Combine(desc.Width);
+		hash.Combine(desc.Height);
+		hash.Combine(desc.Depth);
+		hash.Combine(desc.ArraySize);
+		hash.Combine(desc.Mips);
+		hash.Combine(desc.SampleCount);
+		hash.Combine((uint32)desc.Format);
+		hash.Combine((uint32)desc.Type);
+		return hash;
+	}
+
+	uint32 GetBucketKey(const BufferDesc& desc)
+	{
+		StringHash hash;
+		hash.Combine((uint32)desc.Size);
+		hash.Combine((uint32)(desc.Size >> 32));
+		hash.Combine(desc.ElementSize);
+		hash.Combine((uint32)desc.Format);
+		return hash;
+	}
+
+	// Committed buffers take up at least 64KB, so rounding up to that is free.
+	// Larger buffers are rounded up to an eighth of their size at most.
+	uint64 GetBufferSizeClass(uint64 size, uint32 elementSize)
+	{
+		uint64 granularity = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+		while (granularity * 16 <= size)
+			granularity *= 2;
+		uint64 sizeClass = Math::AlignUp<uint64>(size, granularity);
+		return (sizeClass + elementSize - 1) / elementSize * elementSize;
+	}
+}
+
 Ref<Texture> RGResourcePool::Allocate(const char* pName, const TextureDesc& desc)
 {
-	for (PooledTexture& texture : m_TexturePool)
+	Array<PooledTexture>& bucket = m_TextureBuckets[GetBucketKey(desc)];
+	for (PooledTexture& texture : bucket)
 	{
 		Ref<Texture>& pTexture = texture.pResource;
 		if (pTexture->GetNumRefs() == 1 && pTexture->GetDesc().IsCompatible(desc))
 		{
 			texture.LastUsedFrame = m_FrameIndex;
 			pTexture->SetName(pName);
+			m_FrameStats.BytesReused += texture.Size;
+			++m_FrameStats.NumReused;
 			return pTexture;
 		}
 	}
-	return m_TexturePool.emplace_back(PooledTexture{ GetParent()->CreateTexture(desc, pName), m_FrameIndex }).pResource;
+
+	uint64 size = GetParent()->GetResourceAllocationInfo(desc).SizeInBytes;
+	m_PooledSize += size;
+	m_FrameStats.BytesAllocated += size;
+	++m_FrameStats.NumAllocated;
+	return bucket.emplace_back(PooledTexture{ GetParent()->CreateTexture(desc, pName), size, m_FrameIndex }).pResource;
 }
 
 Ref<Buffer> RGResourcePool::Allocate(const char* pName, const BufferDesc& desc)
 {
-	for (PooledBuffer& buffer : m_BufferPool)
+	BufferDesc poolDesc = desc;
+	if (m_Options.BufferSizeClasses)
+		poolDesc.Size = GetBufferSizeClass(desc.Size, desc.ElementSize);
+
+	Array<PooledBuffer>& bucket = m_BufferBuckets[GetBucketKey(poolDesc)];
+	for (PooledBuffer& buffer : bucket)
 	{
 		Ref<Buffer>& pBuffer = buffer.pResource;
-		if (pBuffer->GetNumRefs() == 1 && pBuffer->GetDesc().IsCompatible(desc))
+		if (pBuffer->GetNumRefs() == 1 && pBuffer->GetDesc().IsCompatible(poolDesc))
 		{
 			buffer.LastUsedFrame = m_FrameIndex;
 			pBuffer->SetName(pName);
+			m_FrameStats.BytesReused += buffer.Size;
+			++m_FrameStats.NumReused;
 			return pBuffer;
 		}
 	}
-	return m_BufferPool.emplace_back(PooledBuffer{ GetParent()->CreateBuffer(desc, pName), m_FrameIndex }).pResource;
+
+	uint64 size = GetParent()->GetResourceAllocationInfo(poolDesc).SizeInBytes;
+	m_PooledSize += size;
+	m_FrameStats.BytesAllocated += size;
+	++m_FrameStats.NumAllocated;
+	return bucket.emplace_back(PooledBuffer{ GetParent()->CreateBuffer(poolDesc, pName), size, m_FrameIndex }).pResource;
 }
 
-void RGResourcePool::Tick()
+void RGResourcePool::AllocateAliased(Span<RGResource*> resources)
 {
-	constexpr uint32 numFrameRetention = 5;
+	PROFILE_CPU_SCOPE();
 
-	for (uint32 i = 0; i < (uint32)m_TexturePool.size();)
+	// Heaps are packed up to this size before a new heap is started
+	constexpr uint64 maxHeapSize = 256ull * 1024 * 1024;
+
+	// On Resource Heap Tier 1, buffers, render target/depth stencil textures and other textures can't share a heap
+	enum HeapGroup
+	{
+		Buffers,
+		RenderTargetTextures,
+		OtherTextures,
+	};
+	constexpr D3D12_HEAP_FLAGS heapGroupFlags[] = { D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS, D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES, D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES };
+	const bool separateHeapGroups = GetParent()->GetCapabilities().ResourceHeapTier < D3D12_RESOURCE_HEAP_TIER_2;
+
+	Array<RGResource*> placedResources;
+	m_Allocations.clear();
+	for (RGResource* pResource : resources)
 	{
-		PooledTexture& texture = m_TexturePool[i];
-		if (texture.pResource->GetNumRefs() == 1 && texture.LastUsedFrame + numFrameRetention < m_FrameIndex)
+		gAssert(pResource->FirstAccess.IsValid() && !pResource->GetPhysicalUnsafe());
+
+		D3D12_RESOURCE_ALLOCATION_INFO allocationInfo;
+		HeapGroup group;
+		if (pResource->GetType() == RGResourceType::Texture)
 		{
-			std::swap(m_TexturePool[i], m_TexturePool.back());
-			m_TexturePool.pop_back();
+			const TextureDesc& desc = static_cast<RGTexture*>(pResource)->GetDesc();
+			allocationInfo = GetParent()->GetResourceAllocationInfo(desc);
+			group = EnumHasAnyFlags(desc.Flags, TextureFlag::RenderTarget | TextureFlag::DepthStencil) ? HeapGroup::RenderTargetTextures : HeapGroup::OtherTextures;
 		}
 		else
 		{
-			++i;
+			// Acceleration structures and CPU visible buffers are left to the pool
+			const BufferDesc& desc = static_cast<RGBuffer*>(pResource)->GetDesc();
+			if (EnumHasAnyFlags(desc.Flags, BufferFlag::AccelerationStructure | BufferFlag::Upload | BufferFlag::Readback))
+				continue;
+			allocationInfo = GetParent()->GetResourceAllocationInfo(desc);
+			group = HeapGroup::Buffers;
+		}
+
+		RGAliasing::Allocation& allocation = m_Allocations.emplace_back();
+		allocation.Size			= allocationInfo.SizeInBytes;
+		allocation.Alignment	= allocationInfo.Alignment;
+		allocation.FirstPass	= pResource->FirstAccess.GetIndex();
+		allocation.LastPass		= pResource->LastAccess.GetIndex();
+		allocation.HeapGroup	= separateHeapGroups ? (uint32)group : 0;
+		placedResources.push_back(pResource);
+	}
+
+	RGAliasing::PackResult packResult;
+	RGAliasing::Pack(m_Allocations, maxHeapSize, packResult);
+	gAssert(RGAliasing::Validate(m_Allocations, packResult), "Aliased resources overlap in memory");
+
+	// Heaps only grow, so small changes in the graph don't cause heaps to be recreated
+	for (uint32 heapIndex = 0; heapIndex < (uint32)packResult.Heaps.size(); ++heapIndex)
+	{
+		const RGAliasing::Heap& requiredHeap = packResult.Heaps[heapIndex];
+		if (heapIndex >= m_Heaps.size())
+			m_Heaps.push_back({});
+
+		TransientHeap& heap = m_Heaps[heapIndex];
+		if (!heap.pHeap || heap.Group != requiredHeap.Group || heap.Size < requiredHeap.Size)
+		{
+			if (heap.pHeap)
+				ReleaseHeap(heap);
+
+			heap.Group = requiredHeap.Group;
+			heap.Size = Math::AlignUp<uint64>(requiredHeap.Size, D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT);
+			m_FrameStats.BytesAllocated += heap.Size;
+			++m_FrameStats.NumAllocated;
+
+			D3D12_HEAP_FLAGS heapFlags = D3D12_HEAP_FLAG_CREATE_NOT_ZEROED;
+			if (separateHeapGroups)
+				heapFlags |= heapGroupFlags[heap.Group];
+			CD3DX12_HEAP_DESC heapDesc(heap.Size, D3D12_HEAP_TYPE_DEFAULT, D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT, heapFlags);
+			VERIFY_HR_EX(GetParent()->GetDevice()->CreateHeap(&heapDesc, IID_PPV_ARGS(heap.pHeap.GetAddressOf())), GetParent()->GetDevice());
+			D3D::SetObjectName(heap.pHeap, Sprintf("RenderGraph Heap %d", heapIndex).c_str());
 		}
+		heap.LastUsedFrame = m_FrameIndex;
 	}
-	for (uint32 i = 0; i < (uint32)m_BufferPool.size();)
+
+	// Reuse placed resources with the same description at the same location. Only an exact match has the same size.
+	auto IsMatchingResource = [](const PlacedResource& placed, const RGResource* pResource)
+	{
+		if (placed.Type != pResource->GetType())
+			return false;
+		if (placed.Type == RGResourceType::Texture)
+		{
+			const TextureDesc& placedDesc = static_cast<Texture*>(placed.pResource.Get())->GetDesc();
+			const TextureDesc& desc = static_cast<const RGTexture*>(pResource)->GetDesc();
+			return placedDesc.IsCompatible(desc) && desc.IsCompatible(placedDesc);
+		}
+		const BufferDesc& placedDesc = static_cast<Buffer*>(placed.pResource.Get())->GetDesc();
+		const BufferDesc& desc = static_cast<const RGBuffer*>(pResource)->GetDesc();
+		return placedDesc.IsCompatible(desc) && desc.IsCompatible(placedDesc);
+	};
+
+	for (uint32 i = 0; i < (uint32)m_Allocations.size(); ++i)
 	{
-		PooledBuffer& buffer = m_BufferPool[i];
-		if (buffer.pResource->GetNumRefs() == 1 && buffer.LastUsedFrame + numFrameRetention < m_FrameIndex)
+		const RGAliasing::Allocation& allocation = m_Allocations[i];
+		RGResource* pResource = placedResources[i];
+		ID3D12Heap* pHeap = m_Heaps[allocation.HeapIndex].pHeap;
+
+		Ref<DeviceResource> pPhysicalResource;
+		for (PlacedResource& placed : m_PlacedResources)
 		{
-			std::swap(m_BufferPool[i], m_BufferPool.back());
-			m_BufferPool.pop_back();
+			if (placed.pHeap == pHeap && placed.Offset == allocation.Offset && placed.LastUsedFrame != m_FrameIndex && IsMatchingResource(placed, pResource))
+			{
+				placed.LastUsedFrame = m_FrameIndex;
+				pPhysicalResource = placed.pResource;
+				m_FrameStats.BytesReused += allocation.Size;
+				++m_FrameStats.NumReused;
+				break;
+			}
+		}
+
+		if (!pPhysicalResource)
+		{
+			if (pResource->GetType() == RGResourceType::Texture)
+				pPhysicalResource = GetParent()->CreateTexture(static_cast<RGTexture*>(pResource)->GetDesc(), pHeap, allocation.Offset, pResource->GetName());
+			else
+				pPhysicalResource = GetParent()->CreateBuffer(static_cast<RGBuffer*>(pResource)->GetDesc(), pHeap, allocation.Offset, pResource->GetName());
+			m_PlacedResources.push_back({ pPhysicalResource, pResource->GetType(), pHeap, allocation.Offset, m_FrameIndex });
+		}
+
+		pPhysicalResource->SetName(pResource->GetName());
+		pResource->SetResource(pPhysicalResource);
+		pResource->IsAliased = true;
+	}
+
+	m_AliasingStats.NumResources	= (uint32)m_Allocations.size();
+	m_AliasingStats.NumHeaps		= (uint32)packResult.Heaps.size();
+	m_AliasingStats.RequiredSize	= packResult.RequiredSize;
+	m_AliasingStats.UnaliasedSize	= packResult.UnaliasedSize;
+	m_AliasingStats.HeapSize		= 0;
+	for (const TransientHeap& heap : m_Heaps)
+		m_AliasingStats.HeapSize += heap.Size;
+}
+
+void RGResourcePool::ReleaseHeap(TransientHeap& heap)
+{
+	m_FrameStats.BytesEvicted += heap.Size;
+	++m_FrameStats.NumEvicted;
+	std::erase_if(m_PlacedResources, [&](const PlacedResource& placed) { return placed.pHeap == heap.pHeap; });
+	GetParent()->DeferReleaseObject(heap.pHeap.Detach());
+	heap.Size = 0;
+}
+
+void RGResourcePool::Tick()
+{
+	PROFILE_CPU_SCOPE();
+
+	// Unused resources that exceed the retention period are released.
+	// Resources with more than the pool's reference are in use, for example by a compile cache.
+	auto EvictExpired = [this](auto& buckets)
+	{
+		for (auto& [key, bucket] : buckets)
+		{
+			std::erase_if(bucket, [this](const auto& pooled)
+				{
+					if (pooled.pResource->GetNumRefs() > 1 || pooled.LastUsedFrame + m_Options.NumFrameRetention >= m_FrameIndex)
+						return false;
+					m_PooledSize -= pooled.Size;
+					m_FrameStats.BytesEvicted += pooled.Size;
+					++m_FrameStats.NumEvicted;
+					return true;
+				});
+		}
+	};
+	EvictExpired(m_TextureBuckets);
+	EvictExpired(m_BufferBuckets);
+
+	for (uint32 i = 0; i < (uint32)m_PlacedResources.size();)
+	{
+		PlacedResource& placed = m_PlacedResources[i];
+		if (placed.pResource->GetNumRefs() == 1 && placed.LastUsedFrame + m_Options.NumFrameRetention < m_FrameIndex)
+		{
+			std::swap(m_PlacedResources[i], m_PlacedResources.back());
+			m_PlacedResources.pop_back();
 		}
 		else
 		{
 			++i;
 		}
 	}
+
+	// Heaps with resources that are still referenced, for example by a compile cache, are in use
+	auto IsHeapReferenced = [this](const TransientHeap& heap)
+	{
+		return std::any_of(m_PlacedResources.begin(), m_PlacedResources.end(), [&](const PlacedResource& placed) { return placed.pHeap == heap.pHeap && placed.pResource->GetNumRefs() > 1; });
+	};
+
+	uint64 heapSize = 0;
+	for (TransientHeap& heap : m_Heaps)
+	{
+		if (heap.pHeap && IsHeapReferenced(heap))
+			heap.LastUsedFrame = m_FrameIndex;
+
+		if (heap.pHeap && heap.LastUsedFrame + m_Options.NumFrameRetention < m_FrameIndex)
+			ReleaseHeap(heap);
+		heapSize += heap.Size;
+	}
+
+	// Over budget, unused resources and heaps are evicted from least to most recently used
+	if (m_Options.Budget > 0 && m_PooledSize + heapSize > m_Options.Budget)
+	{
+		struct EvictionCandidate
+		{
+			uint32	LastUsedFrame;
+			uint32	Key;		///< Bucket key, or the heap index
+			uint32	Index;
+			uint8	Type;		///< 0: Texture, 1: Buffer, 2: Heap
+		};
+		Array<EvictionCandidate> candidates;
+		for (auto& [key, bucket] : m_TextureBuckets)
+		{
+			for (uint32 i = 0; i < (uint32)bucket.size(); ++i)
+			{
+				if (bucket[i].pResource->GetNumRefs() == 1)
+					candidates.push_back({ bucket[i].LastUsedFrame, key, i, 0 });
+			}
+		}
+		for (auto& [key, bucket] : m_BufferBuckets)
+		{
+			for (uint32 i = 0; i < (uint32)bucket.size(); ++i)
+			{
+				if (bucket[i].pResource->GetNumRefs() == 1)
+					candidates.push_back({ bucket[i].LastUsedFrame, key, i, 1 });
+			}
+		}
+		for (uint32 i = 0; i < (uint32)m_Heaps.size(); ++i)
+		{
+			if (m_Heaps[i].pHeap && m_Heaps[i].LastUsedFrame != m_FrameIndex)
+				candidates.push_back({ m_Heaps[i].LastUsedFrame, i, i, 2 });
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const EvictionCandidate& a, const EvictionCandidate& b) { return a.LastUsedFrame < b.LastUsedFrame; });
+
+		// Evicted resources are reset first and removed from their bucket afterwards, so the indices stay valid
+		auto EvictResource = [this](auto& pooled)
+		{
+			m_PooledSize -= pooled.Size;
+			m_FrameStats.BytesEvicted += pooled.Size;
+			++m_FrameStats.NumEvicted;
+			pooled.pResource = nullptr;
+		};
+		for (const EvictionCandidate& candidate : candidates)
+		{
+			if (m_PooledSize + heapSize <= m_Options.Budget)
+				break;
+			if (candidate.Type == 0)
+			{
+				EvictResource(m_TextureBuckets[candidate.Key][candidate.Index]);
+			}
+			else if (candidate.Type == 1)
+			{
+				EvictResource(m_BufferBuckets[candidate.Key][candidate.Index]);
+			}
+			else
+			{
+				heapSize -= m_Heaps[candidate.Index].Size;
+				ReleaseHeap(m_Heaps[candidate.Index]);
+			}
+		}
+		for (auto& [key, bucket] : m_TextureBuckets)
+			std::erase_if(bucket, [](const PooledTexture& pooled) { return !pooled.pResource; });
+		for (auto& [key, bucket] : m_BufferBuckets)
+			std::erase_if(bucket, [](const PooledBuffer& pooled) { return !pooled.pResource; });
+	}
+
+	std::erase_if(m_TextureBuckets, [](const auto& bucket) { return bucket.second.empty(); });
+	std::erase_if(m_BufferBuckets, [](const auto& bucket) { return bucket.second.empty(); });
+	while (!m_Heaps.empty() && !m_Heaps.back().pHeap)
+		m_Heaps.pop_back();
+
+	m_FrameStats.TotalSize = m_PooledSize + heapSize;
+	m_LastFrameStats = m_FrameStats;
+	m_FrameStats = {};
 	++m_FrameIndex;
 }
 
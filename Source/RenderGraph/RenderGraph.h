@@ -1,5 +1,6 @@
 #pragma once
 #include "RenderGraphDefinitions.h"
+#include "RenderGraphAliasing.h"
 #include "RHI/Fence.h"
 #include "RHI/CommandContext.h"
 #include "Blackboard.h"
@@ -8,6 +9,7 @@
 
 class RGGraph;
 class RGPass;
+class RGCompileCache;
 
 // Flags assigned to a pass that can determine various things
 enum class RGPassFlag : uint8
@@ -17,9 +19,18 @@ enum class RGPassFlag : uint8
 	Compute =	1 << 1,		///< Compute pass
 	Copy =		1 << 2,		///< Pass that performs a copy resource operation. Does not play well with Raster/Compute passes
 	NeverCull = 1 << 3,		///< Makes a pass never be culled when not referenced.
+	AsyncCompute = 1 << 4,	///< Compute pass that may run on the async compute queue. Only passes without untracked dependencies should be marked.
 };
 DECLARE_BITMASK_TYPE(RGPassFlag);
 
+// Queue a pass is executed on
+enum class RGQueue : uint8
+{
+	Graphics,
+	Compute,
+	Num,
+};
+
 class RGResources
 {
 public:
@@ -49,6 +60,8 @@ private:
 	const RGPass& m_Pass;
 };
 
+// Linear allocator for the objects of a graph.
+// Memory is allocated in chunks that are kept after a Reset, so a graph that doesn't grow doesn't allocate.
 class RGGraphAllocator
 {
 public:
@@ -67,24 +80,20 @@ public:
 		T Object;
 	};
 
-	RGGraphAllocator(uint64 size)
-		: m_Size(size), m_pData(new char[size]), m_pCurrentOffset(m_pData)
+	RGGraphAllocator(uint64 chunkSize = 1024 * 256)
+		: m_ChunkSize(chunkSize)
 	{}
 
-	~RGGraphAllocator()
-	{
-		for (size_t i = 0; i < m_NonPODAllocations.size(); ++i)
-		{
-			m_NonPODAllocations[i]->~AllocatedObject();
-		}
-		delete[] m_pData;
-	}
+	~RGGraphAllocator();
+
+	RGGraphAllocator(const RGGraphAllocator& other) = delete;
+	RGGraphAllocator& operator=(const RGGraphAllocator& other) = delete;
 
 	template<typename T, typename ...Args>
 	NO_DISCARD T* AllocateObject(Args&&... args)
 	{
 		using AllocatedType = std::conditional_t<std::is_trivial_v<T>, T, TAllocatedObject<T>>;
-		void* pData = Allocate(sizeof(AllocatedType));
+		void* pData = Allocate(sizeof(AllocatedType), alignof(AllocatedType));
 		AllocatedType* pAllocation = new (pData) AllocatedType(std::forward<Args&&>(args)...);
 
 		if constexpr (std::is_trivial_v<T>)
@@ -101,38 +110,39 @@ public:
 	NO_DISCARD const char* AllocateString(const char* pStr)
 	{
 		uint32 len = CString::StrLen(pStr);
-		char* pAlloc = (char*)Allocate(len + 1);
+		char* pAlloc = (char*)Allocate(len + 1, 1);
 		strcpy_s(pAlloc, len + 1, pStr);
 		return pAlloc;
 	}
 
-	NO_DISCARD void* Allocate(uint64 size)
-	{
-		gAssert(m_pCurrentOffset - m_pData + size < m_Size);
-		void* pData = m_pCurrentOffset;
-		m_pCurrentOffset += size;
+	NO_DISCARD void* Allocate(uint64 size, uint64 alignment = alignof(std::max_align_t));
 
-		// For debugging allocations
-#if 0
-		E_LOG(Info, "Allocating %s (%s / %s - %.0f%%)",
-			Math::PrettyPrintDataSize(size).c_str(),
-			Math::PrettyPrintDataSize(GetSize()).c_str(),
-			Math::PrettyPrintDataSize(GetCapacity()).c_str(),
-			(float)GetSize() / GetCapacity() * 100.0f
-		);
-#endif
-
-		return pData;
-	}
+	// Destroys all objects and makes the memory available again. The chunks are kept.
+	void Reset();
 
-	uint64 GetSize() const { return m_pCurrentOffset - m_pData; }
-	uint64 GetCapacity() const { return m_Size; }
+	uint64 GetSize() const			{ return m_Size; }				///< Bytes allocated since the last reset
+	uint64 GetLastSize() const		{ return m_LastSize; }			///< Bytes allocated before the last reset
+	uint64 GetCapacity() const		{ return m_Capacity; }			///< Total size of all chunks
+	uint64 GetHighWaterMark() const { return Math::Max(m_HighWaterMark, m_Size); }	///< Most bytes allocated between two resets
+	uint32 GetNumChunks() const		{ return (uint32)m_Chunks.size(); }
 
 private:
+	struct Chunk
+	{
+		char*	pData;
+		uint64	Size;
+	};
+	Array<Chunk> m_Chunks;
+	uint32 m_CurrentChunk = 0;
+	uint64 m_CurrentOffset = 0;
+	uint64 m_ChunkSize;
+
+	uint64 m_Size = 0;
+	uint64 m_LastSize = 0;
+	uint64 m_Capacity = 0;
+	uint64 m_HighWaterMark = 0;
+
 	Array<AllocatedObject*> m_NonPODAllocations;
-	uint64 m_Size;
-	char* m_pData;
-	char* m_pCurrentOffset;
 };
 
 struct RGEvent
@@ -170,6 +180,7 @@ private:
 public:
 	friend class RGGraph;
 	friend class RGResources;
+	friend class RGGraphCapture;
 
 	struct RenderTargetAccess
 	{
@@ -214,6 +225,7 @@ private:
 	{
 		RGResource* pResource;
 		D3D12_RESOURCE_STATES Access;
+		D3D12_RESOURCE_STATES ReadStates = D3D12_RESOURCE_STATE_COMMON;		///< Compile-time: Combined read states of this and the following accesses up to the next write
 	};
 
 	void AddAccess(RGResource* pResource, D3D12_RESOURCE_STATES state);
@@ -224,6 +236,15 @@ private:
 		D3D12_RESOURCE_STATES	BeforeState;
 		D3D12_RESOURCE_STATES	AfterState;
 		uint32					SubResource;
+		D3D12_RESOURCE_BARRIER_FLAGS Flags		= D3D12_RESOURCE_BARRIER_FLAG_NONE;		///< BEGIN_ONLY/END_ONLY for split barriers
+	};
+
+	struct AliasingBarrier
+	{
+		RGResource*				pResource;
+		bool					Discard;		///< Render targets and depth stencils must be initialized after aliasing
+		D3D12_RESOURCE_STATES	BeforeState;	///< State before the discard
+		D3D12_RESOURCE_STATES	DiscardState;	///< State the resource is discarded in
 	};
 
 	const char*						pName;
@@ -232,6 +253,10 @@ private:
 	RGPassID						ID;
 	RGPassFlag						Flags;
 	bool							IsCulled			= true;
+	RGQueue							Queue				= RGQueue::Graphics;
+	RGPassID						QueueDependency;		///< Last pass on the other queue this pass has to wait for
+	bool							MergedWithPrevious	= false;	///< Continues the render pass of the previous raster pass
+	bool							MergedWithNext		= false;	///< Leaves its render pass open for the next raster pass
 
 	// Profiling
 	Array<RGEventID>			EventsToStart;
@@ -243,20 +268,64 @@ private:
 	DepthStencilAccess				DepthStencilTarget{};
 	IRGPassCallback*				pExecuteCallback = nullptr;
 
+	Array<AliasingBarrier>		AliasingBarriers;
 	Array<ResourceTransition> Transitions;
+	Array<ResourceTransition> PostTransitions;		///< Issued after the pass. Hands resources to the async compute queue in a state it can't transition from
 	Array<ResourceAccess>		Accesses;
 	Array<RGPassID>			PassDependencies;
 };
 
+struct RGAliasingStats
+{
+	uint32	NumResources	= 0;		///< Number of transient resources placed in shared heaps
+	uint32	NumHeaps		= 0;
+	uint64	RequiredSize	= 0;		///< Memory required by the packed resources
+	uint64	UnaliasedSize	= 0;		///< Memory the same resources would require without aliasing
+	uint64	HeapSize		= 0;		///< Total size of all allocated heaps
+
+	uint64 GetBytesSaved() const { return UnaliasedSize > RequiredSize ? UnaliasedSize - RequiredSize : 0; }
+};
+
+struct RGResourcePoolOptions
+{
+	uint64 Budget				= 0;		///< Bytes of pooled resources and heaps to keep. The least recently used are evicted above it. 0 is unlimited
+	uint32 NumFrameRetention	= 5;		///< Frames an unused resource or heap is kept
+	bool BufferSizeClasses		= false;	///< Round buffer sizes up to a size class so buffers of a similar size share one. The physical buffer can be larger than requested
+};
+
+// Memory of the resource pool. Allocations, reuses and evictions are counted per frame.
+struct RGPoolStats
+{
+	uint64 TotalSize			= 0;		///< Memory held by pooled resources and transient heaps
+	uint64 BytesAllocated		= 0;
+	uint64 BytesReused			= 0;
+	uint64 BytesEvicted			= 0;
+	uint32 NumAllocated			= 0;
+	uint32 NumReused			= 0;
+	uint32 NumEvicted			= 0;
+};
+
 class RGResourcePool : public DeviceObject
 {
 public:
-	RGResourcePool(GraphicsDevice* pDevice)
-		: DeviceObject(pDevice)
+	RGResourcePool(GraphicsDevice* pDevice, const RGResourcePoolOptions& options = {})
+		: DeviceObject(pDevice), m_Options(options)
 	{}
 
 	NO_DISCARD Ref<Texture> Allocate(const char* pName, const TextureDesc& desc);
 	NO_DISCARD Ref<Buffer> Allocate(const char* pName, const BufferDesc& desc);
+
+	// Place transient resources in shared heaps based on their FirstAccess/LastAccess. Resources that are never alive at the same time share memory.
+	// Resources that can't be placed are left unallocated.
+	void AllocateAliased(Span<RGResource*> resources);
+
+	const RGAliasingStats& GetAliasingStats() const { return m_AliasingStats; }
+	const RGPoolStats& GetStats() const { return m_LastFrameStats; }		///< Stats of the last frame
+
+	void SetOptions(const RGResourcePoolOptions& options) { m_Options = options; }
+	const RGResourcePoolOptions& GetOptions() const { return m_Options; }
+
+	// Evicts unused resources and heaps that exceed the retention period or the budget, and starts a new frame
 	void Tick();
 
 private:
@@ -264,34 +333,127 @@ private:
 	struct PooledResource
 	{
 		Ref<T> pResource;
+		uint64 Size;
 		uint32 LastUsedFrame;
 	};
 	using PooledTexture = PooledResource<Texture>;
 	using PooledBuffer = PooledResource<Buffer>;
-	Array<PooledTexture> m_TexturePool;
-	Array<PooledBuffer> m_BufferPool;
+
+	// Resources are bucketed by everything in their description except the flags. A pooled resource may have more flags than requested.
+	HashMap<uint32, Array<PooledTexture>> m_TextureBuckets;
+	HashMap<uint32, Array<PooledBuffer>> m_BufferBuckets;
+	uint64 m_PooledSize = 0;
+
+	struct TransientHeap
+	{
+		Ref<ID3D12Heap>		pHeap;
+		uint32				Group;
+		uint64				Size;
+		uint32				LastUsedFrame;
+	};
+	Array<TransientHeap> m_Heaps;
+
+	// Placed resources are kept around so a graph that doesn't change doesn't have to create resources every frame
+	struct PlacedResource
+	{
+		Ref<DeviceResource>	pResource;
+		RGResourceType		Type;
+		ID3D12Heap*			pHeap;
+		uint64				Offset;
+		uint32				LastUsedFrame;
+	};
+	Array<PlacedResource> m_PlacedResources;
+
+	void ReleaseHeap(TransientHeap& heap);
+
+	Array<RGAliasing::Allocation> m_Allocations;
+	RGAliasingStats m_AliasingStats;
+	RGResourcePoolOptions m_Options;
+	RGPoolStats m_FrameStats;
+	RGPoolStats m_LastFrameStats;
 	uint32 m_FrameIndex = 0;
 };
 
+// Rolling estimate of the CPU time it takes to record each pass, by pass name.
+// Passes are partitioned into commandlists of about equal cost with it.
+class RGPassCostModel
+{
+public:
+	float GetCost(const char* pPassName) const;		///< Estimated recording time in ms. Unknown passes get the average cost
+	void AddSample(const char* pPassName, float time);
+
+	// Call after the samples of a frame are added.
+	// Starts a new generation when estimates drifted too far from the ones the last partition was based on.
+	void EndFrame();
+	uint32 GetGeneration() const { return m_Generation; }
+
+private:
+	struct PassCost
+	{
+		float Cost;				///< Rolling average of the recording time in ms
+		float PartitionCost;	///< Cost at the start of the current generation
+	};
+	HashMap<StringHash, PassCost> m_Costs;
+	float m_AverageCost = 1.0f;
+	uint32 m_Generation = 0;
+	bool m_HasDrifted = false;
+};
+
 struct RGGraphOptions
 {
 	bool ResourceAliasing		= true;
 	bool Jobify					= true;
 	bool PassCulling			= true;
 	bool StateTracking			= true;
-	uint32 CommandlistGroupSize = 10;
+	bool SplitBarriers			= true;		///< Begin transitions right after the previous access and end them before the next. Requires StateTracking
+	bool AsyncCompute			= false;	///< Run passes marked with RGPassFlag::AsyncCompute on the compute queue. Requires StateTracking
+	bool RenderPassMerging		= true;		///< Merge adjacent raster passes with the same targets into one render pass and discard targets outside of their lifetime. Merging requires StateTracking
+	uint32 CommandlistGroupSize = 10;						///< Passes per commandlist when not using a cost model
+	RGPassCostModel* pCostModel = nullptr;					///< Partition passes into commandlists by predicted recording time instead. Requires Jobify
+};
+
+// Balance of the commandlists recorded in parallel. Imbalance is the cost of the most expensive commandlist relative to the average.
+struct RGPartitionStats
+{
+	uint32 NumGroups				= 0;
+	float FixedImbalance			= 0;	///< Predicted imbalance when splitting every CommandlistGroupSize passes
+	float PredictedImbalance		= 0;	///< Predicted imbalance of the partition that is used
+	float MeasuredImbalance			= 0;	///< Imbalance of the measured recording times. Available after execution
+};
+
+// Transition barriers of a compiled graph, compared to issuing every transition right before the pass that needs it
+struct RGBarrierStats
+{
+	uint32 NumUnoptimizedBarriers	= 0;	///< Transitions without combining read states
+	uint32 NumUnoptimizedBatches	= 0;	///< Passes that would flush barriers without optimization
+	uint32 NumBarriers				= 0;	///< Transitions issued. A split barrier counts as one
+	uint32 NumSplitBarriers			= 0;
+	uint32 NumBatches				= 0;	///< Passes that flush barriers
+};
+
+// Render passes of a compiled graph
+struct RGRenderPassStats
+{
+	uint32 NumRasterPasses			= 0;
+	uint32 NumRenderPasses			= 0;	///< Render passes begun. Merged raster passes share a render pass
+	uint32 NumMergedPasses			= 0;	///< Raster passes that continue the render pass of the previous pass
+	uint32 NumDiscardedLoads		= 0;	///< Targets that are not loaded because they're first accessed in the render pass
+	uint32 NumDiscardedStores		= 0;	///< Targets that are not stored because they're last accessed in the render pass
 };
 
 class RGGraph
 {
 public:
-	RGGraph(uint64 allocatorSize = 1024 * 256);
+	RGGraph();
+	// Use an allocator that outlives the graph. It's reset when the graph is destroyed, so its memory is reused by the next graph.
+	RGGraph(RGGraphAllocator& allocator);
 	~RGGraph();
 
 	RGGraph(const RGGraph& other) = delete;
 	RGGraph& operator=(const RGGraph& other) = delete;
 
-	void Compile(RGResourcePool& resourcePool, const RGGraphOptions& options);
+	// With a cache, a graph with the same structure as the previously compiled graph reuses its compilation result
+	void Compile(RGResourcePool& resourcePool, const RGGraphOptions& options, RGCompileCache* pCache = nullptr);
 
 	void Execute(GraphicsDevice* pDevice);
 
@@ -378,12 +540,18 @@ public:
 	}
 
 	void DumpDebugGraph(const char* pFilePath) const;
+	void DumpBarrierPlan(const char* pFilePath) const;
+	void DumpSchedule(const char* pFilePath) const;
 	void DrawResourceTracker(bool& enabled) const;
 	void DrawPassView(bool& enabled) const;
 
 	void PushEvent(const char* pName, const char* pFilePath = "", uint32 lineNumber = 0);
 	void PopEvent();
 
+	const RGBarrierStats& GetBarrierStats() const { return m_BarrierStats; }
+	const RGPartitionStats& GetPartitionStats() const { return m_PartitionStats; }
+	const RGRenderPassStats& GetRenderPassStats() const { return m_RenderPassStats; }
+
 	RGBlackboard Blackboard;
 
 private:
@@ -395,15 +563,44 @@ private:
 
 	void ExecutePass(const RGPass* pPass, CommandContext& context) const;
 	void PrepareResources(const RGPass* pPass, CommandContext& context) const;
+	void ScheduleAsyncCompute();
+	void MergeRenderPasses(const RGGraphOptions& options);
+	void SplitBarriers();
+	void ExportResources();
 	void DestroyData();
 
+	// Compile cache
+	uint64 ComputeStructureHash(const RGGraphOptions& options) const;
+	bool LoadFromCache(const RGCompileCache& cache, RGResourcePool& resourcePool);
+	void StoreInCache(RGCompileCache& cache, Span<D3D12_RESOURCE_STATES> initialStates) const;
+
 	bool								m_IsCompiled		= false;
+	RGBarrierStats						m_BarrierStats;
+	RGPartitionStats					m_PartitionStats;
+	RGRenderPassStats					m_RenderPassStats;
+	RGPassCostModel*					m_pCostModel		= nullptr;
+	Array<float>						m_PassRecordTimes;		///< Recording time of each pass in ms, measured during execution
 	Array<RGEventID>				m_PendingEvents;
 	Array<RGEvent>				m_Events;
 
-	RGGraphAllocator					m_Allocator;
+	UniquePtr<RGGraphAllocator>			m_pOwnedAllocator;
+	RGGraphAllocator&					m_Allocator;
 
+	// Commandlists recorded in parallel. Passes in a group that are culled or run on another queue are skipped.
 	Array<Span<const RGPass*>>	m_PassExecuteGroups;
+
+	friend class RGCompileCache;
+	friend class RGGraphCapture;
+
+	// Groups submitted together to a single queue, in submission order
+	struct Submission
+	{
+		RGQueue			Queue;
+		uint32			FirstGroup;
+		uint32			NumGroups;
+		int32			WaitSubmission = -1;	///< Submission on the other queue that has to finish first
+	};
+	Array<Submission>					m_Submissions;
 	Array<RGPass*>				m_Passes;
 	Array<RGResource*>			m_Resources;
 
@@ -422,6 +619,86 @@ private:
 	Array<ExportedBuffer>			m_ExportBuffers;
 };
 
+// Compilation result of the last compiled graph.
+// The next graph is compiled from the cache if it has the same passes, resource accesses and resource descriptions.
+// Only imported resources may be different, as long as they're in the same state as when the cache was stored.
+// The cache keeps the transient resources it assigned alive so they are not handed out by the pool in the meantime.
+class RGCompileCache
+{
+public:
+	void Invalidate();
+
+	uint32 GetNumHits() const { return m_NumHits; }
+	uint32 GetNumMisses() const { return m_NumMisses; }
+	bool WasHit() const { return m_WasHit; }		///< True if the last compile used the cache
+
+private:
+	friend class RGGraph;
+
+	struct Transition
+	{
+		RGResourceID					Resource;
+		D3D12_RESOURCE_STATES			BeforeState;
+		D3D12_RESOURCE_STATES			AfterState;
+		uint32							SubResource;
+		D3D12_RESOURCE_BARRIER_FLAGS	Flags;
+	};
+
+	struct AliasingBarrier
+	{
+		RGResourceID			Resource;
+		bool					Discard;
+		D3D12_RESOURCE_STATES	BeforeState;
+		D3D12_RESOURCE_STATES	DiscardState;
+	};
+
+	struct Pass
+	{
+		bool					IsCulled;
+		RGQueue					Queue;
+		RGPassID				QueueDependency;
+		bool					MergedWithPrevious;
+		bool					MergedWithNext;
+		Array<RenderPassColorFlags>	RenderTargetFlags;		///< Flags after compilation, with the chosen load and store actions
+		RenderPassDepthFlags	DepthStencilFlags;
+		Array<RGEventID>		EventsToStart;
+		Array<RGEventID>		CPUEventsToStart;
+		uint32					NumEventsToEnd;
+		uint32					NumCPUEventsToEnd;
+		Array<AliasingBarrier>	AliasingBarriers;
+		Array<Transition>		Transitions;
+		Array<Transition>		PostTransitions;
+	};
+
+	struct Resource
+	{
+		RGPassID				FirstAccess;
+		RGPassID				LastAccess;
+		bool					IsAliased;
+		bool					IsAsyncCompute;
+		uint32					Flags;					///< Texture or buffer flags after compilation
+		Ref<DeviceResource>		pPhysicalResource;		///< Transient resources only. Exported resources are allocated again.
+		int32					SharedPhysicalIndex;	///< First resource using the same physical resource
+		bool					IsFirstUse;				///< First resource to use its physical resource, its state must match InitialState
+		D3D12_RESOURCE_STATES	InitialState;
+		D3D12_RESOURCE_STATES	FinalState;				///< State of the physical resource after compilation
+	};
+
+	uint64								m_Hash		= 0;
+	bool								m_IsValid	= false;
+	bool								m_WasHit	= false;
+	uint32								m_NumHits	= 0;
+	uint32								m_NumMisses	= 0;
+
+	Array<Pass>							m_Passes;
+	Array<Resource>						m_Resources;
+	Array<std::pair<uint32, uint32>>	m_PassExecuteGroups;		///< First pass and number of passes
+	Array<RGGraph::Submission>			m_Submissions;
+	RGBarrierStats						m_BarrierStats;
+	RGPartitionStats					m_PartitionStats;
+	RGRenderPassStats					m_RenderPassStats;
+};
+
 class RGGraphScope
 {
 public:
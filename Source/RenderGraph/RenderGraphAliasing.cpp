@@ -0,0 +1,132 @@
+#include "stdafx.h"
+#include "RenderGraphAliasing.h"
+
+namespace RGAliasing
+{
+	static bool LifetimesOverlap(const Allocation& a, const Allocation& b)
+	{
+		return a.FirstPass <= b.LastPass && b.FirstPass <= a.LastPass;
+	}
+
+	void Pack(Array<Allocation>& allocations, uint64 maxHeapSize, PackResult& outResult)
+	{
+		outResult = {};
+
+		// Largest allocations are the hardest to fit, so they go first.
+		// Ties are broken by index to keep the result deterministic.
+		Array<uint32> order(allocations.size());
+		for (uint32 i = 0; i < (uint32)order.size(); ++i)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&](uint32 a, uint32 b)
+			{
+				if (allocations[a].Size != allocations[b].Size)
+					return allocations[a].Size > allocations[b].Size;
+				return a < b;
+			});
+
+		struct MemoryRange
+		{
+			uint64 Begin;
+			uint64 End;
+		};
+
+		Array<Array<uint32>> heapAllocations;
+		Array<MemoryRange> usedRanges;
+
+		for (uint32 allocationIndex : order)
+		{
+			Allocation& allocation = allocations[allocationIndex];
+			gAssert(allocation.Alignment > 0 && (allocation.Alignment & (allocation.Alignment - 1)) == 0, "Alignment must be a power of two");
+			gAssert(allocation.FirstPass <= allocation.LastPass);
+			outResult.UnaliasedSize += allocation.Size;
+
+			bool isPlaced = false;
+			for (uint32 heapIndex = 0; heapIndex < (uint32)outResult.Heaps.size() && !isPlaced; ++heapIndex)
+			{
+				Heap& heap = outResult.Heaps[heapIndex];
+				if (heap.Group != allocation.HeapGroup)
+					continue;
+
+				// Gather the memory that is in use during the lifetime of this allocation
+				usedRanges.clear();
+				for (uint32 otherIndex : heapAllocations[heapIndex])
+				{
+					const Allocation& other = allocations[otherIndex];
+					if (LifetimesOverlap(allocation, other))
+						usedRanges.push_back({ other.Offset, other.Offset + other.Size });
+				}
+				std::sort(usedRanges.begin(), usedRanges.end(), [](const MemoryRange& a, const MemoryRange& b) { return a.Begin < b.Begin; });
+
+				// Find the smallest gap that fits. The space after the last range counts as a gap up to the max heap size.
+				const uint64 heapLimit = Math::Max(maxHeapSize, heap.Size);
+				uint64 bestOffset = ~0ull;
+				uint64 bestGapSize = ~0ull;
+				uint64 cursor = 0;
+				for (uint32 rangeIndex = 0; rangeIndex <= (uint32)usedRanges.size(); ++rangeIndex)
+				{
+					uint64 gapEnd = rangeIndex < usedRanges.size() ? usedRanges[rangeIndex].Begin : heapLimit;
+					uint64 offset = Math::AlignUp(cursor, allocation.Alignment);
+					if (gapEnd > cursor && offset + allocation.Size <= gapEnd && gapEnd - cursor < bestGapSize)
+					{
+						bestOffset = offset;
+						bestGapSize = gapEnd - cursor;
+					}
+					if (rangeIndex < usedRanges.size())
+						cursor = Math::Max(cursor, usedRanges[rangeIndex].End);
+				}
+
+				if (bestOffset != ~0ull)
+				{
+					allocation.HeapIndex = heapIndex;
+					allocation.Offset = bestOffset;
+					heap.Size = Math::Max(heap.Size, bestOffset + allocation.Size);
+					heapAllocations[heapIndex].push_back(allocationIndex);
+					isPlaced = true;
+				}
+			}
+
+			if (!isPlaced)
+			{
+				allocation.HeapIndex = (uint32)outResult.Heaps.size();
+				allocation.Offset = 0;
+				outResult.Heaps.push_back(Heap{ .Group = allocation.HeapGroup, .Size = allocation.Size });
+				heapAllocations.emplace_back().push_back(allocationIndex);
+			}
+		}
+
+		for (const Heap& heap : outResult.Heaps)
+			outResult.RequiredSize += heap.Size;
+	}
+
+	bool Validate(Span<Allocation> allocations, const PackResult& result)
+	{
+		for (uint32 i = 0; i < allocations.GetSize(); ++i)
+		{
+			const Allocation& allocation = allocations[i];
+			if (allocation.HeapIndex >= result.Heaps.size())
+			{
+				E_LOG(Warning, "Allocation %d references invalid heap %d", i, allocation.HeapIndex);
+				return false;
+			}
+			const Heap& heap = result.Heaps[allocation.HeapIndex];
+			if (heap.Group != allocation.HeapGroup || allocation.Offset + allocation.Size > heap.Size || allocation.Offset % allocation.Alignment != 0)
+			{
+				E_LOG(Warning, "Allocation %d is misplaced (Heap: %d, Offset: %llu, Size: %llu, Alignment: %llu)", i, allocation.HeapIndex, allocation.Offset, allocation.Size, allocation.Alignment);
+				return false;
+			}
+
+			for (uint32 j = i + 1; j < allocations.GetSize(); ++j)
+			{
+				const Allocation& other = allocations[j];
+				if (other.HeapIndex != allocation.HeapIndex || !LifetimesOverlap(allocation, other))
+					continue;
+				if (allocation.Offset < other.Offset + other.Size && other.Offset < allocation.Offset + allocation.Size)
+				{
+					E_LOG(Warning, "Allocations %d and %d are alive at the same time and share memory", i, j);
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
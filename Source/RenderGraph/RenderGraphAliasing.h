@@ -0,0 +1,50 @@
+#pragma once
+
+/*
+	Lifetime based memory aliasing for transient render graph resources.
+
+	Every transient resource needs its memory from the first until the last pass that accesses it.
+	Resources whose lifetimes don't overlap may share memory, so all of them are packed into a few large heaps.
+	Allocations are placed largest first, each in the smallest gap that doesn't collide with memory in use during its lifetime.
+
+	This doesn't depend on the device so the packing can be run and validated entirely on the CPU.
+*/
+
+namespace RGAliasing
+{
+	struct Allocation
+	{
+		// Input
+		uint64	Size		= 0;
+		uint64	Alignment	= 1;
+		uint32	FirstPass	= 0;		///< First pass that uses the memory
+		uint32	LastPass	= 0;		///< Last pass that uses the memory (inclusive)
+		uint32	HeapGroup	= 0;		///< Allocations can only share a heap with allocations of the same group
+
+		// Output
+		uint32	HeapIndex	= 0;		///< Index in PackResult::Heaps
+		uint64	Offset		= 0;		///< Offset in the heap
+	};
+
+	struct Heap
+	{
+		uint32	Group	= 0;
+		uint64	Size	= 0;
+	};
+
+	struct PackResult
+	{
+		Array<Heap>		Heaps;
+		uint64			RequiredSize	= 0;		///< Sum of all heap sizes
+		uint64			UnaliasedSize	= 0;		///< Memory required if every allocation had its own memory
+
+		uint64 GetBytesSaved() const { return UnaliasedSize > RequiredSize ? UnaliasedSize - RequiredSize : 0; }
+	};
+
+	// Assign a heap and offset to every allocation.
+	// A heap only grows beyond `maxHeapSize` when a single allocation doesn't fit otherwise.
+	void Pack(Array<Allocation>& allocations, uint64 maxHeapSize, PackResult& outResult);
+
+	// Returns false if two allocations that are alive at the same time share memory or if an allocation is misaligned or out of bounds.
+	bool Validate(Span<Allocation> allocations, const PackResult& result);
+}
@@ -0,0 +1,78 @@
+#include "stdafx.h"
+#include "RenderGraphAliasing.h"
+#include "Core/Benchmark.h"
+#include "Core/Utils.h"
+
+/*
+	Microbenchmark of the transient resource packing on synthetic frames.
+	Reports the packing time and memory saved, and checks every packing with RGAliasing::Validate.
+	Run from the console with "bench.RenderGraphAliasing".
+*/
+
+namespace RenderGraphAliasingBenchmark
+{
+	static void Run(Benchmark::Context& context)
+	{
+		constexpr uint32 allocationCounts[] = { 64, 256, 1024, 4096 };
+		constexpr uint32 numPasses = 200;
+		constexpr uint32 numGroups = 3;
+		constexpr uint64 maxHeapSize = 256ull * 1024 * 1024;
+		constexpr uint64 placementAlignment = 64 * 1024;
+		constexpr uint64 msaaPlacementAlignment = 4 * 1024 * 1024;
+
+		E_LOG(Info, "Render graph aliasing benchmark - %d passes", numPasses);
+		E_LOG(Info, "%12s | %10s | %8s | %12s | %12s | %8s", "Allocations", "Pack (ms)", "Heaps", "Unaliased", "Required", "Saved");
+
+		for (uint32 numAllocations : allocationCounts)
+		{
+			// Deterministic pseudo random frame. Most resources are short lived, a few live for most of the frame.
+			uint32 seed = 0x12345678u;
+			auto Random = [&seed](uint32 maxValue)
+				{
+					seed = seed * 1664525u + 1013904223u;
+					return (seed >> 8) % maxValue;
+				};
+
+			Array<RGAliasing::Allocation> allocations(numAllocations);
+			for (RGAliasing::Allocation& allocation : allocations)
+			{
+				const bool isMSAA = Random(16) == 0;
+				allocation.Alignment	= isMSAA ? msaaPlacementAlignment : placementAlignment;
+				allocation.Size			= Math::AlignUp<uint64>(((uint64)Random(32 * 1024) + 1) * 1024, allocation.Alignment);
+				allocation.FirstPass	= Random(numPasses);
+				allocation.LastPass		= Math::Min(allocation.FirstPass + (Random(8) == 0 ? Random(numPasses) : Random(8)), numPasses - 1);
+				allocation.HeapGroup	= Random(numGroups);
+			}
+
+			RGAliasing::PackResult result;
+			Utils::TimeScope timer;
+			RGAliasing::Pack(allocations, maxHeapSize, result);
+			const float packTime = timer.Stop() * 1000.0f;
+
+			E_LOG(Info, "%12d | %10.3f | %8d | %12s | %12s | %7.1f%%",
+				numAllocations, packTime, (uint32)result.Heaps.size(),
+				Math::PrettyPrintDataSize(result.UnaliasedSize).c_str(),
+				Math::PrettyPrintDataSize(result.RequiredSize).c_str(),
+				100.0 * result.GetBytesSaved() / Math::Max<uint64>(result.UnaliasedSize, 1));
+
+			context.Check(RGAliasing::Validate(allocations, result), "%d allocations: packing is invalid", numAllocations);
+			context.Check(result.RequiredSize <= result.UnaliasedSize, "%d allocations: packing needs more memory than no aliasing", numAllocations);
+
+			// Heaps only exceed the limit when they hold a single allocation that doesn't fit otherwise
+			uint32 numOversizedHeaps = 0;
+			for (uint32 heapIndex = 0; heapIndex < (uint32)result.Heaps.size(); ++heapIndex)
+			{
+				if (result.Heaps[heapIndex].Size <= maxHeapSize)
+					continue;
+				const bool isSingleAllocation = std::any_of(allocations.begin(), allocations.end(), [&](const RGAliasing::Allocation& allocation)
+					{
+						return allocation.HeapIndex == heapIndex && allocation.Size == result.Heaps[heapIndex].Size;
+					});
+				numOversizedHeaps += !isSingleAllocation;
+			}
+			context.Check(numOversizedHeaps == 0, "%d allocations: %d heaps exceed the max heap size", numAllocations, numOversizedHeaps);
+		}
+	}
+
+	static Benchmark::Command<> gBenchmarkCommand("bench.RenderGraphAliasing", &Run);
+}
@@ -0,0 +1,337 @@
+#include "stdafx.h"
+#include "RenderGraph.h"
+#include "Core/Profiler.h"
+
+namespace
+{
+	// 64-bit FNV-1a
+	struct StructureHasher
+	{
+		template<typename T>
+		void Add(const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			AddBytes(&value, sizeof(T));
+		}
+
+		void Add(const char* pStr)
+		{
+			AddBytes(pStr, CString::StrLen(pStr) + 1);
+		}
+
+		void AddBytes(const void* pData, size_t size)
+		{
+			const uint8* pBytes = static_cast<const uint8*>(pData);
+			for (size_t i = 0; i < size; ++i)
+				Hash = (Hash ^ pBytes[i]) * 0x100000001b3ull;
+		}
+
+		uint64 Hash = 0xcbf29ce484222325ull;
+	};
+}
+
+void RGCompileCache::Invalidate()
+{
+	m_IsValid = false;
+	m_WasHit = false;
+	m_Passes.clear();
+	m_Resources.clear();
+	m_PassExecuteGroups.clear();
+	m_Submissions.clear();
+}
+
+uint64 RGGraph::ComputeStructureHash(const RGGraphOptions& options) const
+{
+	PROFILE_CPU_SCOPE();
+
+	StructureHasher hasher;
+	hasher.Add(options.ResourceAliasing);
+	hasher.Add(options.Jobify);
+	hasher.Add(options.PassCulling);
+	hasher.Add(options.StateTracking);
+	hasher.Add(options.SplitBarriers);
+	hasher.Add(options.AsyncCompute);
+	hasher.Add(options.RenderPassMerging);
+	hasher.Add(options.CommandlistGroupSize);
+	hasher.Add(m_pCostModel ? m_pCostModel->GetGeneration() + 1 : 0u);
+
+	hasher.Add((uint32)m_Passes.size());
+	hasher.Add((uint32)m_Resources.size());
+	hasher.Add((uint32)m_Events.size());
+
+	for (const RGEvent& event : m_Events)
+		hasher.Add(event.pName);
+
+	for (const RGPass* pPass : m_Passes)
+	{
+		hasher.Add(pPass->pName);
+		hasher.Add(pPass->Flags);
+		hasher.Add((uint32)pPass->EventsToStart.size());
+		for (RGEventID event : pPass->EventsToStart)
+			hasher.Add(event.GetIndex());
+		hasher.Add(pPass->NumEventsToEnd);
+
+		hasher.Add((uint32)pPass->Accesses.size());
+		for (const RGPass::ResourceAccess& access : pPass->Accesses)
+		{
+			hasher.Add(access.pResource->ID.GetIndex());
+			hasher.Add(access.Access);
+		}
+
+		hasher.Add((uint32)pPass->RenderTargets.size());
+		for (const RGPass::RenderTargetAccess& renderTarget : pPass->RenderTargets)
+		{
+			hasher.Add(renderTarget.pResource->ID.GetIndex());
+			hasher.Add(renderTarget.Flags);
+			hasher.Add(renderTarget.pResolveTarget ? renderTarget.pResolveTarget->ID.GetIndex() : RGResourceID().GetIndex());
+		}
+
+		const RGPass::DepthStencilAccess& depthStencil = pPass->DepthStencilTarget;
+		hasher.Add(depthStencil.pResource ? depthStencil.pResource->ID.GetIndex() : RGResourceID().GetIndex());
+		hasher.Add(depthStencil.Flags);
+		hasher.Add(depthStencil.pResource ? depthStencil.Write : false);
+	}
+
+	for (const RGResource* pResource : m_Resources)
+	{
+		hasher.Add(pResource->pName);
+		hasher.Add((uint32)pResource->GetType());
+		hasher.Add((bool)pResource->IsImported);
+		hasher.Add((bool)pResource->IsExported);
+		if (pResource->IsImported)
+			hasher.Add(pResource->GetPhysicalUnsafe()->UseStateTracking());
+
+		// Descriptions are hashed per field, bitfields and padding can't be hashed as raw memory
+		if (pResource->GetType() == RGResourceType::Texture)
+		{
+			const TextureDesc& desc = static_cast<const RGTexture*>(pResource)->GetDesc();
+			hasher.Add((uint32)desc.Width);
+			hasher.Add((uint32)desc.Height);
+			hasher.Add((uint32)desc.Depth);
+			hasher.Add((uint32)desc.ArraySize);
+			hasher.Add((uint32)desc.Mips);
+			hasher.Add((uint32)desc.SampleCount);
+			hasher.Add(desc.Type);
+			hasher.Add(desc.Format);
+			hasher.Add(desc.Flags);
+			hasher.Add(desc.ClearBindingValue.BindingValue);
+			if (desc.ClearBindingValue.BindingValue == ClearBinding::ClearBindingValue::Color)
+			{
+				hasher.Add(desc.ClearBindingValue.Color);
+			}
+			else if (desc.ClearBindingValue.BindingValue == ClearBinding::ClearBindingValue::DepthStencil)
+			{
+				hasher.Add(desc.ClearBindingValue.DepthStencil.Depth);
+				hasher.Add(desc.ClearBindingValue.DepthStencil.Stencil);
+			}
+		}
+		else
+		{
+			const BufferDesc& desc = static_cast<const RGBuffer*>(pResource)->GetDesc();
+			hasher.Add(desc.Size);
+			hasher.Add(desc.ElementSize);
+			hasher.Add(desc.Flags);
+			hasher.Add(desc.Format);
+		}
+	}
+
+	return hasher.Hash;
+}
+
+void RGGraph::StoreInCache(RGCompileCache& cache, Span<D3D12_RESOURCE_STATES> initialStates) const
+{
+	PROFILE_CPU_SCOPE();
+
+	auto StoreTransitions = [](const Array<RGPass::ResourceTransition>& transitions, Array<RGCompileCache::Transition>& outTransitions)
+	{
+		outTransitions.reserve(transitions.size());
+		for (const RGPass::ResourceTransition& transition : transitions)
+			outTransitions.push_back({ transition.pResource->ID, transition.BeforeState, transition.AfterState, transition.SubResource, transition.Flags });
+	};
+
+	cache.m_Passes.resize(m_Passes.size());
+	for (uint32 i = 0; i < (uint32)m_Passes.size(); ++i)
+	{
+		const RGPass* pPass = m_Passes[i];
+		RGCompileCache::Pass& pass = cache.m_Passes[i];
+		pass.IsCulled			= pPass->IsCulled;
+		pass.Queue				= pPass->Queue;
+		pass.QueueDependency	= pPass->QueueDependency;
+		pass.MergedWithPrevious	= pPass->MergedWithPrevious;
+		pass.MergedWithNext		= pPass->MergedWithNext;
+		pass.DepthStencilFlags	= pPass->DepthStencilTarget.Flags;
+		pass.RenderTargetFlags.reserve(pPass->RenderTargets.size());
+		for (const RGPass::RenderTargetAccess& renderTarget : pPass->RenderTargets)
+			pass.RenderTargetFlags.push_back(renderTarget.Flags);
+		pass.EventsToStart		= pPass->EventsToStart;
+		pass.CPUEventsToStart	= pPass->CPUEventsToStart;
+		pass.NumEventsToEnd		= pPass->NumEventsToEnd;
+		pass.NumCPUEventsToEnd	= pPass->NumCPUEventsToEnd;
+		pass.AliasingBarriers.reserve(pPass->AliasingBarriers.size());
+		for (const RGPass::AliasingBarrier& barrier : pPass->AliasingBarriers)
+			pass.AliasingBarriers.push_back({ barrier.pResource->ID, barrier.Discard, barrier.BeforeState, barrier.DiscardState });
+		StoreTransitions(pPass->Transitions, pass.Transitions);
+		StoreTransitions(pPass->PostTransitions, pass.PostTransitions);
+	}
+
+	HashMap<DeviceResource*, int32> sharedPhysicalIndices;
+	cache.m_Resources.resize(m_Resources.size());
+	for (uint32 i = 0; i < (uint32)m_Resources.size(); ++i)
+	{
+		const RGResource* pResource = m_Resources[i];
+		RGCompileCache::Resource& resource = cache.m_Resources[i];
+		resource.FirstAccess		= pResource->FirstAccess;
+		resource.LastAccess			= pResource->LastAccess;
+		resource.IsAliased			= pResource->IsAliased;
+		resource.IsAsyncCompute		= pResource->IsAsyncCompute;
+		resource.SharedPhysicalIndex = -1;
+		resource.IsFirstUse			= false;
+		resource.InitialState		= D3D12_RESOURCE_STATE_UNKNOWN;
+		resource.FinalState			= D3D12_RESOURCE_STATE_UNKNOWN;
+		if (pResource->GetType() == RGResourceType::Texture)
+			resource.Flags = (uint32)static_cast<const RGTexture*>(pResource)->GetDesc().Flags;
+		else
+			resource.Flags = (uint32)static_cast<const RGBuffer*>(pResource)->GetDesc().Flags;
+
+		DeviceResource* pPhysical = pResource->GetPhysicalUnsafe();
+		if (!pResource->FirstAccess.IsValid() || !pPhysical)
+			continue;
+
+		// Exported resources are handed out by the graph, so they're allocated again every time the cache is used
+		if (!pResource->IsImported && !pResource->IsExported)
+			resource.pPhysicalResource = pPhysical;
+		resource.SharedPhysicalIndex	= sharedPhysicalIndices.try_emplace(pPhysical, (int32)i).first->second;
+		resource.InitialState			= initialStates[i];
+		resource.IsFirstUse				= resource.InitialState != D3D12_RESOURCE_STATE_UNKNOWN;
+		resource.FinalState				= pPhysical->GetResourceState(0xFFFFFFFF);
+	}
+
+	cache.m_PassExecuteGroups.clear();
+	for (const Span<const RGPass*>& group : m_PassExecuteGroups)
+		cache.m_PassExecuteGroups.push_back({ group[0]->ID.GetIndex(), group.GetSize() });
+	cache.m_Submissions = m_Submissions;
+	cache.m_BarrierStats = m_BarrierStats;
+	cache.m_PartitionStats = m_PartitionStats;
+	cache.m_RenderPassStats = m_RenderPassStats;
+	cache.m_IsValid = true;
+}
+
+bool RGGraph::LoadFromCache(const RGCompileCache& cache, RGResourcePool& resourcePool)
+{
+	PROFILE_CPU_SCOPE();
+
+	gAssert(cache.m_Passes.size() == m_Passes.size() && cache.m_Resources.size() == m_Resources.size());
+
+	// Find the physical resource of each resource and check if the cached barriers are still valid for it.
+	// Nothing is modified until all resources are validated.
+	Array<Ref<DeviceResource>> physicalResources(m_Resources.size());
+	HashMap<DeviceResource*, int32> sharedPhysicalIndices;
+	for (uint32 i = 0; i < (uint32)m_Resources.size(); ++i)
+	{
+		const RGResource* pResource = m_Resources[i];
+		const RGCompileCache::Resource& resource = cache.m_Resources[i];
+		if (!resource.FirstAccess.IsValid())
+			continue;
+
+		if (pResource->IsImported)
+		{
+			// Imported resources must alias each other the same way as when the cache was stored
+			physicalResources[i] = pResource->GetPhysicalUnsafe();
+			if (sharedPhysicalIndices.try_emplace(pResource->GetPhysicalUnsafe(), (int32)i).first->second != resource.SharedPhysicalIndex)
+				return false;
+		}
+		else if (pResource->IsExported)
+		{
+			if (pResource->GetType() == RGResourceType::Texture)
+			{
+				TextureDesc desc = static_cast<const RGTexture*>(pResource)->GetDesc();
+				desc.Flags = (TextureFlag)resource.Flags;
+				physicalResources[i] = resourcePool.Allocate(pResource->GetName(), desc);
+			}
+			else
+			{
+				BufferDesc desc = static_cast<const RGBuffer*>(pResource)->GetDesc();
+				desc.Flags = (BufferFlag)resource.Flags;
+				physicalResources[i] = resourcePool.Allocate(pResource->GetName(), desc);
+			}
+		}
+		else
+		{
+			physicalResources[i] = resource.pPhysicalResource;
+		}
+
+		const DeviceResource* pPhysical = physicalResources[i];
+		if (resource.IsFirstUse && pPhysical->UseStateTracking() && pPhysical->GetResourceState(0xFFFFFFFF) != resource.InitialState)
+			return false;
+	}
+
+	for (uint32 i = 0; i < (uint32)m_Resources.size(); ++i)
+	{
+		RGResource* pResource = m_Resources[i];
+		const RGCompileCache::Resource& resource = cache.m_Resources[i];
+		pResource->FirstAccess		= resource.FirstAccess;
+		pResource->LastAccess		= resource.LastAccess;
+		pResource->IsAliased		= resource.IsAliased;
+		pResource->IsAsyncCompute	= resource.IsAsyncCompute;
+		if (pResource->GetType() == RGResourceType::Texture)
+			static_cast<RGTexture*>(pResource)->Desc.Flags = (TextureFlag)resource.Flags;
+		else
+			static_cast<RGBuffer*>(pResource)->Desc.Flags = (BufferFlag)resource.Flags;
+
+		DeviceResource* pPhysical = physicalResources[i];
+		if (!pPhysical)
+			continue;
+
+		if (!pResource->IsImported)
+		{
+			pResource->SetResource(pPhysical);
+
+			// Like after a regular compile, the reference is given back right away. The pool and the cache keep the resource alive.
+			if (!pResource->IsExported)
+				pResource->Release();
+		}
+
+		if (pPhysical->UseStateTracking())
+			pPhysical->SetResourceState(resource.FinalState);
+	}
+
+	auto LoadTransitions = [this](const Array<RGCompileCache::Transition>& transitions, Array<RGPass::ResourceTransition>& outTransitions)
+	{
+		outTransitions.reserve(transitions.size());
+		for (const RGCompileCache::Transition& transition : transitions)
+			outTransitions.push_back({ m_Resources[transition.Resource.GetIndex()], transition.BeforeState, transition.AfterState, transition.SubResource, transition.Flags });
+	};
+
+	for (uint32 i = 0; i < (uint32)m_Passes.size(); ++i)
+	{
+		RGPass* pPass = m_Passes[i];
+		const RGCompileCache::Pass& pass = cache.m_Passes[i];
+		pPass->IsCulled				= pass.IsCulled;
+		pPass->Queue				= pass.Queue;
+		pPass->QueueDependency		= pass.QueueDependency;
+		pPass->MergedWithPrevious	= pass.MergedWithPrevious;
+		pPass->MergedWithNext		= pass.MergedWithNext;
+		pPass->DepthStencilTarget.Flags = pass.DepthStencilFlags;
+		for (uint32 targetIndex = 0; targetIndex < (uint32)pass.RenderTargetFlags.size(); ++targetIndex)
+			pPass->RenderTargets[targetIndex].Flags = pass.RenderTargetFlags[targetIndex];
+		pPass->EventsToStart		= pass.EventsToStart;
+		pPass->CPUEventsToStart		= pass.CPUEventsToStart;
+		pPass->NumEventsToEnd		= pass.NumEventsToEnd;
+		pPass->NumCPUEventsToEnd	= pass.NumCPUEventsToEnd;
+		pPass->AliasingBarriers.reserve(pass.AliasingBarriers.size());
+		for (const RGCompileCache::AliasingBarrier& barrier : pass.AliasingBarriers)
+			pPass->AliasingBarriers.push_back({ m_Resources[barrier.Resource.GetIndex()], barrier.Discard, barrier.BeforeState, barrier.DiscardState });
+		LoadTransitions(pass.Transitions, pPass->Transitions);
+		LoadTransitions(pass.PostTransitions, pPass->PostTransitions);
+	}
+
+	for (const std::pair<uint32, uint32>& group : cache.m_PassExecuteGroups)
+		m_PassExecuteGroups.push_back(Span<const RGPass*>(&m_Passes[group.first], group.second));
+	m_Submissions = cache.m_Submissions;
+	m_BarrierStats = cache.m_BarrierStats;
+	m_PartitionStats = cache.m_PartitionStats;
+	m_RenderPassStats = cache.m_RenderPassStats;
+
+	ExportResources();
+	return true;
+}
@@ -807,3 +807,104 @@ void RGGraph::DumpDebugGraph(const char* pPath) const
 		ShellExecuteA(nullptr, "open", fullPath.c_str(), nullptr, nullptr, SW_SHOW);
 	}
 }
+
+
+void RGGraph::DumpBarrierPlan(const char* pPath) const
+{
+	gAssert(m_IsCompiled);
+
+	auto BarrierFlagToString = [](D3D12_RESOURCE_BARRIER_FLAGS flags)
+	{
+		switch (flags)
+		{
+		case D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY:	return "Begin";
+		case D3D12_RESOURCE_BARRIER_FLAG_END_ONLY:		return "End";
+		default:										return "Full";
+		}
+	};
+
+	String output = Sprintf("Barriers: %d (%d split) in %d batches. Unoptimized: %d in %d batches\n",
+		m_BarrierStats.NumBarriers, m_BarrierStats.NumSplitBarriers, m_BarrierStats.NumBatches, m_BarrierStats.NumUnoptimizedBarriers, m_BarrierStats.NumUnoptimizedBatches);
+
+	for (const RGPass* pPass : m_Passes)
+	{
+		if (pPass->IsCulled)
+			continue;
+
+		output += Sprintf("\n[%d] %s\n", pPass->ID.GetIndex(), pPass->GetName());
+		for (const RGPass::AliasingBarrier& barrier : pPass->AliasingBarriers)
+			output += Sprintf("\tAlias\t%s%s\n", barrier.pResource->GetName(), barrier.Discard ? " (Discard)" : "");
+		for (const RGPass::ResourceTransition& transition : pPass->Transitions)
+		{
+			output += Sprintf("\t%s\t%s: %s -> %s\n",
+				BarrierFlagToString(transition.Flags),
+				transition.pResource->GetName(),
+				D3D::ResourceStateToString(transition.BeforeState).c_str(),
+				D3D::ResourceStateToString(transition.AfterState).c_str());
+		}
+		for (const RGPass::ResourceTransition& transition : pPass->PostTransitions)
+		{
+			output += Sprintf("\tPost\t%s: %s -> %s\n",
+				transition.pResource->GetName(),
+				D3D::ResourceStateToString(transition.BeforeState).c_str(),
+				D3D::ResourceStateToString(transition.AfterState).c_str());
+		}
+	}
+
+	String fullPath = Paths::MakeAbsolute(Sprintf("%s_Barriers.txt", pPath).c_str());
+	Paths::CreateDirectoryTree(fullPath);
+
+	FileStream file;
+	if (file.Open(fullPath.c_str(), FileMode::Write | FileMode::Create))
+		file.Write(output.c_str(), (uint32)output.length());
+	E_LOG(Info, "Barrier plan written to '%s'", fullPath.c_str());
+}
+
+void RGGraph::DumpSchedule(const char* pPath) const
+{
+	gAssert(m_IsCompiled);
+
+	auto QueueToString = [](RGQueue queue)
+	{
+		return queue == RGQueue::Compute ? "Compute" : "Graphics";
+	};
+
+	String output = Sprintf("Render passes: %d for %d raster passes (%d merged). Discarded: %d loads, %d stores\n\n",
+		m_RenderPassStats.NumRenderPasses, m_RenderPassStats.NumRasterPasses, m_RenderPassStats.NumMergedPasses, m_RenderPassStats.NumDiscardedLoads, m_RenderPassStats.NumDiscardedStores);
+
+	for (uint32 submissionIndex = 0; submissionIndex < (uint32)m_Submissions.size(); ++submissionIndex)
+	{
+		const Submission& submission = m_Submissions[submissionIndex];
+		output += Sprintf("Submission %d - %s", submissionIndex, QueueToString(submission.Queue));
+		if (submission.WaitSubmission >= 0)
+			output += Sprintf(" (Waits for %d)", submission.WaitSubmission);
+		output += "\n";
+
+		for (uint32 groupIndex = submission.FirstGroup; groupIndex < submission.FirstGroup + submission.NumGroups; ++groupIndex)
+		{
+			output += Sprintf("\tCommandlist %d\n", groupIndex);
+			for (const RGPass* pPass : m_PassExecuteGroups[groupIndex])
+			{
+				if (pPass->IsCulled || pPass->Queue != submission.Queue)
+					continue;
+
+				output += Sprintf("\t\t[%d] %s", pPass->ID.GetIndex(), pPass->GetName());
+				if (pPass->QueueDependency.IsValid())
+					output += Sprintf(" (Depends on [%d] %s)", pPass->QueueDependency.GetIndex(), m_Passes[pPass->QueueDependency.GetIndex()]->GetName());
+				if (pPass->Queue == RGQueue::Graphics && EnumHasAllFlags(pPass->Flags, RGPassFlag::AsyncCompute))
+					output += " (Async compute candidate)";
+				if (pPass->MergedWithPrevious)
+					output += " (Continues render pass)";
+				output += "\n";
+			}
+		}
+	}
+
+	String fullPath = Paths::MakeAbsolute(Sprintf("%s_Schedule.txt", pPath).c_str());
+	Paths::CreateDirectoryTree(fullPath);
+
+	FileStream file;
+	if (file.Open(fullPath.c_str(), FileMode::Write | FileMode::Create))
+		file.Write(output.c_str(), (uint32)output.length());
+	E_LOG(Info, "Queue schedule written to '%s'", fullPath.c_str());
+}
@@ -60,9 +60,11 @@ class RGResource
 public:
 	friend class RGGraph;
 	friend class RGPass;
+	friend class RGResourcePool;
+	friend class RGGraphCapture;
 
 	RGResource(const char* pName, RGResourceID id, RGResourceType type, DeviceResource* pPhysicalResource = nullptr)
-		: pName(pName), ID(id), Allocated(false), IsImported(!!pPhysicalResource), IsExported(false), Type((uint32)type), pPhysicalResource(nullptr)
+		: pName(pName), ID(id), Allocated(false), IsImported(!!pPhysicalResource), IsExported(false), IsAliased(false), IsAsyncCompute(false), Type((uint32)type), pPhysicalResource(nullptr)
 	{
 		if (pPhysicalResource)
 			SetResource(pPhysicalResource);
@@ -103,6 +105,8 @@ protected:
 	uint32					Allocated			: 1;
 	uint32					IsImported			: 1;
 	uint32					IsExported			: 1;
+	uint32					IsAliased			: 1;	///< Placed in a heap shared with other transient resources
+	uint32					IsAsyncCompute		: 1;	///< Accessed on the async compute queue. Kept alive for the whole graph so its memory isn't reused by passes running at the same time
 	uint32					Type				: 1;
 
 	// Compile-time data
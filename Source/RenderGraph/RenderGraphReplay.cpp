@@ -0,0 +1,368 @@
+#include "stdafx.h"
+#include "RenderGraphReplay.h"
+#include "Core/Stream.h"
+#include "Core/Utils.h"
+#include "RHI/Device.h"
+
+namespace
+{
+	struct CaptureWriter
+	{
+		template<typename T>
+		void Write(const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			File.Write(&value, sizeof(T));
+		}
+
+		void Write(const String& value)
+		{
+			File << value;
+		}
+
+		FileStream& File;
+	};
+
+	struct CaptureReader
+	{
+		template<typename T>
+		T Read()
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			T value{};
+			uint32 read = 0;
+			if (!File.Read(&value, sizeof(T), &read) || read != sizeof(T))
+				HasFailed = true;
+			return value;
+		}
+
+		String ReadString()
+		{
+			uint32 length = Read<uint32>();
+			if (HasFailed || File.GetCursor() + length > File.GetLength())
+			{
+				HasFailed = true;
+				return {};
+			}
+			String value;
+			value.resize(length);
+			File.Read(value.data(), length);
+			return value;
+		}
+
+		FileStream& File;
+		bool HasFailed = false;
+	};
+}
+
+bool RGGraphCapture::Save(const RGGraph& graph, const char* pFilePath)
+{
+	gAssert(!graph.m_IsCompiled, "A graph can only be captured before it is compiled");
+
+	FileStream file;
+	if (!file.Open(pFilePath, FileMode::Write | FileMode::Create))
+		return false;
+
+	CaptureWriter writer{ file };
+	writer.Write(Magic);
+	writer.Write(Version);
+
+	writer.Write((uint32)graph.m_Events.size());
+	for (const RGEvent& event : graph.m_Events)
+		writer.Write(String(event.pName));
+
+	writer.Write((uint32)graph.m_Resources.size());
+	for (const RGResource* pResource : graph.m_Resources)
+	{
+		writer.Write(String(pResource->GetName()));
+		writer.Write(pResource->GetType());
+		writer.Write((bool)pResource->IsImported);
+		writer.Write((bool)pResource->IsExported);
+		if (pResource->GetType() == RGResourceType::Texture)
+			writer.Write(static_cast<const RGTexture*>(pResource)->GetDesc());
+		else
+			writer.Write(static_cast<const RGBuffer*>(pResource)->GetDesc());
+	}
+
+	writer.Write((uint32)graph.m_Passes.size());
+	for (const RGPass* pPass : graph.m_Passes)
+	{
+		writer.Write(String(pPass->GetName()));
+		writer.Write(pPass->Flags);
+
+		writer.Write((uint32)pPass->EventsToStart.size());
+		for (RGEventID event : pPass->EventsToStart)
+			writer.Write(event.GetIndex());
+		writer.Write(pPass->NumEventsToEnd);
+
+		writer.Write((uint32)pPass->Accesses.size());
+		for (const RGPass::ResourceAccess& access : pPass->Accesses)
+			writer.Write(Access{ access.pResource->ID.GetIndex(), access.Access });
+
+		writer.Write((uint32)pPass->RenderTargets.size());
+		for (const RGPass::RenderTargetAccess& renderTarget : pPass->RenderTargets)
+			writer.Write(RenderTarget{ renderTarget.pResource->ID.GetIndex(), renderTarget.Flags, renderTarget.pResolveTarget ? renderTarget.pResolveTarget->ID.GetIndex() : InvalidResource });
+
+		const RGPass::DepthStencilAccess& depthStencil = pPass->DepthStencilTarget;
+		writer.Write(depthStencil.pResource ? depthStencil.pResource->ID.GetIndex() : InvalidResource);
+		writer.Write(depthStencil.Flags);
+		writer.Write(depthStencil.pResource ? depthStencil.Write : false);
+	}
+
+	return true;
+}
+
+bool RGGraphCapture::Load(const char* pFilePath)
+{
+	m_Events.clear();
+	m_Resources.clear();
+	m_Passes.clear();
+
+	FileStream file;
+	if (!file.Open(pFilePath, FileMode::Read))
+		return false;
+
+	CaptureReader reader{ file };
+	if (reader.Read<uint32>() != Magic)
+	{
+		E_LOG(Warning, "'%s' is not a render graph capture", pFilePath);
+		return false;
+	}
+	uint32 version = reader.Read<uint32>();
+	if (version != Version)
+	{
+		E_LOG(Warning, "Render graph capture '%s' has version %d, expected %d", pFilePath, version, Version);
+		return false;
+	}
+
+	// Counts are validated against the file size so a corrupt file doesn't cause huge allocations
+	auto ReadCount = [&](uint32 minElementSize)
+	{
+		uint32 count = reader.Read<uint32>();
+		if ((uint64)count * minElementSize > file.GetLength() - file.GetCursor())
+			reader.HasFailed = true;
+		return reader.HasFailed ? 0 : count;
+	};
+
+	m_Events.resize(ReadCount(sizeof(uint32)));
+	for (String& event : m_Events)
+		event = reader.ReadString();
+
+	m_Resources.resize(ReadCount(sizeof(uint32)));
+	for (Resource& resource : m_Resources)
+	{
+		resource.Name		= reader.ReadString();
+		resource.Type		= reader.Read<RGResourceType>();
+		reader.HasFailed	|= resource.Type != RGResourceType::Texture && resource.Type != RGResourceType::Buffer;
+		resource.IsImported	= reader.Read<bool>();
+		resource.IsExported	= reader.Read<bool>();
+		if (resource.Type == RGResourceType::Texture)
+			resource.TexDesc = reader.Read<TextureDesc>();
+		else
+			resource.BufDesc = reader.Read<BufferDesc>();
+	}
+
+	auto IsValidResource = [&](uint16 resource, bool allowInvalid)
+	{
+		return resource < m_Resources.size() || (allowInvalid && resource == InvalidResource);
+	};
+
+	// Build casts render and depth targets to textures
+	auto IsValidTexture = [&](uint16 resource, bool allowInvalid)
+	{
+		if (allowInvalid && resource == InvalidResource)
+			return true;
+		return resource < m_Resources.size() && m_Resources[resource].Type == RGResourceType::Texture;
+	};
+
+	// Events are a stack over the passes, a pass can only end events that are open after it started its own
+	uint32 numOpenEvents = 0;
+
+	m_Passes.resize(ReadCount(sizeof(uint32)));
+	for (Pass& pass : m_Passes)
+	{
+		pass.Name = reader.ReadString();
+		pass.Flags = reader.Read<RGPassFlag>();
+
+		pass.EventsToStart.resize(ReadCount(sizeof(uint16)));
+		for (uint16& event : pass.EventsToStart)
+		{
+			event = reader.Read<uint16>();
+			reader.HasFailed |= event >= m_Events.size();
+		}
+		pass.NumEventsToEnd = reader.Read<uint32>();
+		numOpenEvents += (uint32)pass.EventsToStart.size();
+		reader.HasFailed |= pass.NumEventsToEnd > numOpenEvents;
+		numOpenEvents -= Math::Min(pass.NumEventsToEnd, numOpenEvents);
+
+		pass.Accesses.resize(ReadCount(sizeof(Access)));
+		for (Access& access : pass.Accesses)
+		{
+			access = reader.Read<Access>();
+			reader.HasFailed |= !IsValidResource(access.Resource, false);
+		}
+
+		pass.RenderTargets.resize(ReadCount(sizeof(RenderTarget)));
+		for (RenderTarget& renderTarget : pass.RenderTargets)
+		{
+			renderTarget = reader.Read<RenderTarget>();
+			reader.HasFailed |= !IsValidTexture(renderTarget.Resource, false) || !IsValidTexture(renderTarget.ResolveTarget, true);
+		}
+
+		pass.DepthStencil		= reader.Read<uint16>();
+		pass.DepthStencilFlags	= reader.Read<RenderPassDepthFlags>();
+		pass.DepthStencilWrite	= reader.Read<bool>();
+		reader.HasFailed |= !IsValidTexture(pass.DepthStencil, true);
+
+		if (reader.HasFailed)
+			break;
+	}
+
+	if (reader.HasFailed)
+	{
+		E_LOG(Warning, "Render graph capture '%s' is corrupt", pFilePath);
+		m_Events.clear();
+		m_Resources.clear();
+		m_Passes.clear();
+		return false;
+	}
+	return true;
+}
+
+void RGGraphCapture::CreateResources(GraphicsDevice* pDevice)
+{
+	for (Resource& resource : m_Resources)
+	{
+		if (!resource.IsImported || resource.pImported)
+			continue;
+
+		if (resource.Type == RGResourceType::Texture)
+			resource.pImported = pDevice->CreateTexture(resource.TexDesc, resource.Name.c_str());
+		else
+			resource.pImported = pDevice->CreateBuffer(resource.BufDesc, resource.Name.c_str());
+	}
+}
+
+void RGGraphCapture::Build(RGGraph& graph)
+{
+	gAssert(graph.m_Passes.empty() && graph.m_Resources.empty() && graph.m_Events.empty(), "Captures can only be built into an empty graph");
+
+	for (const String& event : m_Events)
+		graph.AddEvent(event.c_str(), "", 0);
+
+	for (Resource& resource : m_Resources)
+	{
+		if (resource.Type == RGResourceType::Texture)
+		{
+			gAssert(!resource.IsImported || resource.pImported, "CreateResources was not called");
+			RGTexture* pTexture = resource.IsImported ? graph.Import(static_cast<Texture*>(resource.pImported.Get())) : graph.Create(resource.Name.c_str(), resource.TexDesc);
+			if (resource.IsExported)
+				graph.Export(pTexture, &resource.pExportedTexture);
+		}
+		else
+		{
+			gAssert(!resource.IsImported || resource.pImported, "CreateResources was not called");
+			RGBuffer* pBuffer = resource.IsImported ? graph.Import(static_cast<Buffer*>(resource.pImported.Get())) : graph.Create(resource.Name.c_str(), resource.BufDesc);
+			if (resource.IsExported)
+				graph.Export(pBuffer, &resource.pExportedBuffer);
+		}
+	}
+
+	auto GetTexture = [&](uint16 resource) { return resource == InvalidResource ? nullptr : static_cast<RGTexture*>(graph.m_Resources[resource]); };
+
+	for (const Pass& pass : m_Passes)
+	{
+		RGPass& rgPass = graph.AddPass(pass.Name.c_str(), pass.Flags);
+
+		rgPass.EventsToStart.clear();
+		for (uint16 event : pass.EventsToStart)
+			rgPass.EventsToStart.push_back(RGEventID(event));
+		rgPass.NumEventsToEnd = pass.NumEventsToEnd;
+
+		for (const Access& access : pass.Accesses)
+			rgPass.Accesses.push_back({ graph.m_Resources[access.Resource], access.State });
+		for (const RenderTarget& renderTarget : pass.RenderTargets)
+			rgPass.RenderTargets.push_back({ GetTexture(renderTarget.Resource), renderTarget.Flags, GetTexture(renderTarget.ResolveTarget) });
+		rgPass.DepthStencilTarget = { GetTexture(pass.DepthStencil), pass.DepthStencilFlags, pass.DepthStencilWrite };
+	}
+}
+
+namespace RGReplay
+{
+	struct TimingSummary
+	{
+		float Min		= FLT_MAX;
+		float Median	= 0;
+		float Average	= 0;
+	};
+
+	static TimingSummary Summarize(Array<float>& times)
+	{
+		TimingSummary summary;
+		if (times.empty())
+			return summary;
+		std::sort(times.begin(), times.end());
+		summary.Min = times.front();
+		summary.Median = times[times.size() / 2];
+		for (float time : times)
+			summary.Average += time;
+		summary.Average /= times.size();
+		return summary;
+	}
+
+	void RunBenchmark(GraphicsDevice* pDevice, const char* pFilePath, uint32 iterations)
+	{
+		RGGraphCapture capture;
+		if (!capture.Load(pFilePath))
+		{
+			E_LOG(Warning, "Failed to load render graph capture '%s'", pFilePath);
+			return;
+		}
+		capture.CreateResources(pDevice);
+
+		E_LOG(Info, "Replaying '%s' (%d passes, %d resources) %d times", pFilePath, capture.GetNumPasses(), capture.GetNumResources(), iterations);
+
+		RGResourcePool resourcePool(pDevice);
+		RGGraphAllocator allocator;
+		RGCompileCache compileCache;
+		RGGraphOptions options;
+		RGRenderPassStats renderPassStats;
+
+		auto Run = [&](RGCompileCache* pCache, Array<float>& outBuildTimes, Array<float>& outCompileTimes)
+		{
+			for (uint32 i = 0; i < iterations; ++i)
+			{
+				RGGraph graph(allocator);
+
+				Utils::TimeScope buildTimer;
+				capture.Build(graph);
+				outBuildTimes.push_back(buildTimer.Stop() * 1000.0f);
+
+				Utils::TimeScope compileTimer;
+				graph.Compile(resourcePool, options, pCache);
+				outCompileTimes.push_back(compileTimer.Stop() * 1000.0f);
+				renderPassStats = graph.GetRenderPassStats();
+
+				resourcePool.Tick();
+			}
+		};
+
+		Array<float> buildTimes, coldTimes, warmTimes;
+		Run(nullptr, buildTimes, coldTimes);
+		Run(&compileCache, buildTimes, warmTimes);
+
+		TimingSummary build = Summarize(buildTimes);
+		TimingSummary cold = Summarize(coldTimes);
+		TimingSummary warm = Summarize(warmTimes);
+		E_LOG(Info, "%-8s | %8s | %8s | %8s", "", "Min (ms)", "Med (ms)", "Avg (ms)");
+		E_LOG(Info, "%-8s | %8.3f | %8.3f | %8.3f", "Build", build.Min, build.Median, build.Average);
+		E_LOG(Info, "%-8s | %8.3f | %8.3f | %8.3f", "Compile", cold.Min, cold.Median, cold.Average);
+		E_LOG(Info, "%-8s | %8.3f | %8.3f | %8.3f (%d/%d from cache)", "Cached", warm.Min, warm.Median, warm.Average, compileCache.GetNumHits(), iterations);
+		E_LOG(Info, "Graph memory: %s", Math::PrettyPrintDataSize(allocator.GetHighWaterMark()).c_str());
+		E_LOG(Info, "Render passes: %d for %d raster passes (%d merged). Discarded: %d loads, %d stores",
+			renderPassStats.NumRenderPasses, renderPassStats.NumRasterPasses, renderPassStats.NumMergedPasses, renderPassStats.NumDiscardedLoads, renderPassStats.NumDiscardedStores);
+
+		// Resources of the cache go back to the pool before the pool is destroyed
+		compileCache.Invalidate();
+	}
+}
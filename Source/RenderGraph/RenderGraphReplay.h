@@ -0,0 +1,77 @@
+#pragma once
+#include "RenderGraph.h"
+
+// Structure of a recorded graph: events, passes, resource accesses and resource descriptions.
+// It can be saved to a compact binary file and rebuilt into a graph without the renderer.
+// Execute callbacks are not stored, passes of a rebuilt graph don't record anything.
+class RGGraphCapture
+{
+public:
+	// The graph must not be compiled yet, compilation modifies the passes and resources
+	static bool Save(const RGGraph& graph, const char* pFilePath);
+	bool Load(const char* pFilePath);
+
+	// Create the physical resources of imported resources. Required before Build.
+	void CreateResources(GraphicsDevice* pDevice);
+
+	// Add the captured events, resources and passes to an empty graph
+	void Build(RGGraph& graph);
+
+	uint32 GetNumPasses() const { return (uint32)m_Passes.size(); }
+	uint32 GetNumResources() const { return (uint32)m_Resources.size(); }
+
+private:
+	static constexpr uint32 Magic	= 0x46524752;	///< 'RGRF'
+	static constexpr uint32 Version = 1;
+	static constexpr uint16 InvalidResource = 0xFFFF;
+
+	struct Access
+	{
+		uint16					Resource;
+		D3D12_RESOURCE_STATES	State;
+	};
+
+	struct RenderTarget
+	{
+		uint16					Resource;
+		RenderPassColorFlags	Flags;
+		uint16					ResolveTarget;
+	};
+
+	struct Pass
+	{
+		String					Name;
+		RGPassFlag				Flags;
+		Array<uint16>			EventsToStart;
+		uint32					NumEventsToEnd;
+		Array<Access>			Accesses;
+		Array<RenderTarget>		RenderTargets;
+		uint16					DepthStencil;
+		RenderPassDepthFlags	DepthStencilFlags;
+		bool					DepthStencilWrite;
+	};
+
+	struct Resource
+	{
+		String					Name;
+		RGResourceType			Type;
+		bool					IsImported;
+		bool					IsExported;
+		TextureDesc				TexDesc;
+		BufferDesc				BufDesc;
+		Ref<DeviceResource>		pImported;			///< Created by CreateResources
+		Ref<Texture>			pExportedTexture;	///< Export target of the last built graph
+		Ref<Buffer>				pExportedBuffer;
+	};
+
+	Array<String>	m_Events;
+	Array<Resource>	m_Resources;
+	Array<Pass>		m_Passes;
+};
+
+namespace RGReplay
+{
+	// Compile a captured graph repeatedly, without and with a compile cache, and log the timings.
+	// Passes are never executed, so this only needs a device to create resources on.
+	void RunBenchmark(GraphicsDevice* pDevice, const char* pFilePath, uint32 iterations);
+}
@@ -61,7 +61,8 @@ void AccelerationStructure::Build(CommandContext& context, const Buffer* pInstan
 				geometryDesc.Triangles.IndexBuffer = pMesh->IndicesLocation.Location;
 				geometryDesc.Triangles.IndexCount = pMesh->IndicesLocation.Elements;
 				geometryDesc.Triangles.IndexFormat = D3D::ConvertFormat(pMesh->IndicesLocation.Format);
-				geometryDesc.Triangles.Transform3x4 = 0;
+				// Quantized positions are dequantized by the transform stored with the geometry
+				geometryDesc.Triangles.Transform3x4 = pMesh->PositionsTransformLocation;
 				geometryDesc.Triangles.VertexBuffer.StartAddress = pMesh->SkinnedPositionStreamLocation.IsValid() ? pMesh->SkinnedPositionStreamLocation.Location : pMesh->PositionStreamLocation.Location;
 				geometryDesc.Triangles.VertexBuffer.StrideInBytes = pMesh->PositionStreamLocation.Stride;
 				geometryDesc.Triangles.VertexCount = pMesh->PositionStreamLocation.Elements;
@@ -121,7 +122,7 @@ void AccelerationStructure::Build(CommandContext& context, const Buffer* pInstan
 				pCmd->BuildRaytracingAccelerationStructure(&asDesc, 0, nullptr);
 
 				if (!pMesh->IsAnimated())
-					m_QueuedRequests.push_back(&pMesh->pBLAS);
+					m_QueuedRequests.push_back(CompactionRequest{ &pMesh->pBLAS, pMesh->pBLAS });
 			}
 
 			if (pMesh->pBLAS)
@@ -238,30 +239,38 @@ void AccelerationStructure::ProcessCompaction(CommandContext& context)
 		}
 
 		const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC* pPostCompactSizes = static_cast<D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC*>(m_pPostBuildInfoReadbackBuffer->GetMappedData());
-		for (Ref<Buffer>* pSourceBLAS: m_ActiveRequests)
+		for (const CompactionRequest& request : m_ActiveRequests)
 		{
 			gAssert(pPostCompactSizes->CompactedSizeInBytes > 0);
-			Ref<Buffer> pTargetBLAS = context.GetParent()->CreateBuffer(BufferDesc::CreateBLAS(pPostCompactSizes->CompactedSizeInBytes), "BLAS.Compacted");
-			context.GetCommandList()->CopyRaytracingAccelerationStructure(pTargetBLAS->GetGpuHandle(), (*pSourceBLAS)->GetGpuHandle(), D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE_COMPACT);
-			*pSourceBLAS = pTargetBLAS;
+			if (request.pTarget->Get() == request.pSource.Get())
+			{
+				Ref<Buffer> pTargetBLAS = context.GetParent()->CreateBuffer(BufferDesc::CreateBLAS(pPostCompactSizes->CompactedSizeInBytes), "BLAS.Compacted");
+				context.GetCommandList()->CopyRaytracingAccelerationStructure(pTargetBLAS->GetGpuHandle(), request.pSource->GetGpuHandle(), D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE_COMPACT);
+				*request.pTarget = pTargetBLAS;
+			}
 			pPostCompactSizes++;
 		}
 		//E_LOG(Info, "Compacted %d BLAS instances", m_ActiveRequests.size());
 		m_ActiveRequests.clear();
 	}
 
-	for (Ref<Buffer>* pSourceBLAS : m_QueuedRequests)
+	uint32 numProcessedRequests = 0;
+	for (const CompactionRequest& request : m_QueuedRequests)
 	{
-		m_ActiveRequests.push_back(pSourceBLAS);
 		if (m_ActiveRequests.size() >= sMaxNumCompactionsPerFrame)
 		{
 			break;
 		}
+		++numProcessedRequests;
+
+		// Skip BLAS that were replaced since the request was queued
+		if (request.pTarget->Get() == request.pSource.Get())
+			m_ActiveRequests.push_back(request);
 	}
+	m_QueuedRequests.erase(m_QueuedRequests.begin(), m_QueuedRequests.begin() + numProcessedRequests);
 
 	if(!m_ActiveRequests.empty())
 	{
-		m_QueuedRequests.erase(m_QueuedRequests.begin(), m_QueuedRequests.begin() + m_ActiveRequests.size());
 
 		if (!m_pPostBuildInfoBuffer)
 		{
@@ -272,8 +281,8 @@ void AccelerationStructure::ProcessCompaction(CommandContext& context)
 
 		Array<D3D12_GPU_VIRTUAL_ADDRESS> blasAddresses;
 		blasAddresses.reserve(m_ActiveRequests.size());
-		for (Ref<Buffer>* pSourceBLAS : m_ActiveRequests)
-			blasAddresses.push_back((*pSourceBLAS)->GetGpuHandle());
+		for (const CompactionRequest& request : m_ActiveRequests)
+			blasAddresses.push_back(request.pSource->GetGpuHandle());
 
 		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC desc;
 		desc.DestBuffer = m_pPostBuildInfoBuffer->GetGpuHandle();
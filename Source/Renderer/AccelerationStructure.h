@@ -31,6 +31,13 @@ private:
 	Ref<Buffer> m_pPostBuildInfoBuffer;
 	Ref<Buffer> m_pPostBuildInfoReadbackBuffer;
 	SyncPoint m_PostBuildInfoFence;
-	Array<Ref<Buffer>*> m_QueuedRequests;
-	Array<Ref<Buffer>*> m_ActiveRequests;
+
+	// The BLAS of a mesh is replaced when its geometry changes, so a request only applies while the mesh still holds the BLAS it was made for
+	struct CompactionRequest
+	{
+		Ref<Buffer>*	pTarget;
+		Ref<Buffer>		pSource;
+	};
+	Array<CompactionRequest> m_QueuedRequests;
+	Array<CompactionRequest> m_ActiveRequests;
 };
@@ -0,0 +1,181 @@
+#include "stdafx.h"
+#include "BatchSort.h"
+#include "FrustumCulling.h"
+#include "Core/Benchmark.h"
+#include "Core/TaskQueue.h"
+#include "Core/Utils.h"
+#include "Renderer/RenderTypes.h"
+
+/*
+	Microbenchmark of the per frame batch work: world matrices, batch building and sorting.
+	Compares the serial paths with the parallel/SIMD paths and std::sort with the radix sort.
+	Run from the console with "bench.BatchBuild".
+*/
+
+namespace BatchBuildBenchmark
+{
+	struct Instance
+	{
+		Vector3		Position;
+		Quaternion	Rotation;
+		Vector3		Scale;
+		uint32		MeshIndex;
+		Batch::Blending BlendMode;
+	};
+
+	static void Run(Benchmark::Context& context)
+	{
+		constexpr uint32 instanceCounts[] = { 10'000, 100'000, 1'000'000 };
+		constexpr uint32 instancesPerJob = 256;
+		const Vector3 viewPosition(0, 50, -400);
+
+		E_LOG(Info, "Batch build benchmark - %d threads", TaskQueue::ThreadCount());
+		E_LOG(Info, "%10s | %16s | %16s | %16s | %16s | %16s | %16s",
+			"Instances", "World (ms)", "World MT (ms)", "Build (ms)", "Build MT/SIMD (ms)", "std::sort (ms)", "Radix sort (ms)");
+
+		// A handful of meshes, shared by all instances
+		constexpr uint32 numMeshes = 16;
+		BoundingBox meshBounds[numMeshes];
+		uint32 seed = 0x12345678u;
+		auto Random = [&seed](float minValue, float maxValue)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				return minValue + (float)(seed >> 8) / (float)(1u << 24) * (maxValue - minValue);
+			};
+		for (BoundingBox& bounds : meshBounds)
+		{
+			bounds.Center = Vector3(Random(-1, 1), Random(-1, 1), Random(-1, 1));
+			bounds.Extents = Vector3(Random(0.5f, 4.0f), Random(0.5f, 4.0f), Random(0.5f, 4.0f));
+		}
+
+		for (uint32 numInstances : instanceCounts)
+		{
+			Array<Instance> instances(numInstances);
+			for (Instance& instance : instances)
+			{
+				instance.Position = Vector3(Random(-1000, 1000), Random(-50, 150), Random(-1000, 1000));
+				instance.Rotation = Quaternion::CreateFromYawPitchRoll(Random(0, Math::PI * 2), Random(0, Math::PI * 2), Random(0, Math::PI * 2));
+				instance.Scale = Vector3(Random(0.5f, 2.0f));
+				instance.MeshIndex = (uint32)Random(0, numMeshes - 0.01f);
+				const float blend = Random(0, 1);
+				instance.BlendMode = blend < 0.8f ? Batch::Blending::Opaque : blend < 0.9f ? Batch::Blending::AlphaMask : Batch::Blending::AlphaBlend;
+			}
+
+			auto ComputeWorld = [&](uint32 i)
+				{
+					const Instance& instance = instances[i];
+					return Matrix::CreateScale(instance.Scale) * Matrix::CreateFromQuaternion(instance.Rotation) * Matrix::CreateTranslation(instance.Position);
+				};
+
+			Array<Matrix> worlds(numInstances);
+			float worldTime = 0;
+			{
+				Utils::TimeScope timer;
+				for (uint32 i = 0; i < numInstances; ++i)
+					worlds[i] = ComputeWorld(i);
+				worldTime = timer.Stop() * 1000.0f;
+			}
+
+			float worldParallelTime = 0;
+			{
+				Utils::TimeScope timer;
+				TaskQueue::ParallelFor(numInstances, [&](TaskDistributeArgs args) { worlds[args.JobIndex] = ComputeWorld(args.JobIndex); }, instancesPerJob);
+				worldParallelTime = timer.Stop() * 1000.0f;
+			}
+
+			CullBounds cullBounds;
+			cullBounds.Resize(numInstances);
+			auto BuildBatch = [&](uint32 i, Batch& batch)
+				{
+					batch.InstanceID = i;
+					batch.pMesh = nullptr;
+					batch.pMaterial = nullptr;
+					batch.BlendMode = instances[i].BlendMode;
+					batch.WorldMatrix = worlds[i];
+				};
+
+			// Serial, transforming all 8 corners of the bounds
+			Array<Batch> referenceBatches(numInstances);
+			float buildTime = 0;
+			{
+				Utils::TimeScope timer;
+				for (uint32 i = 0; i < numInstances; ++i)
+				{
+					Batch& batch = referenceBatches[i];
+					BuildBatch(i, batch);
+					meshBounds[instances[i].MeshIndex].Transform(batch.Bounds, batch.WorldMatrix);
+					batch.Radius = Vector3(batch.Bounds.Extents).Length();
+					cullBounds.Set(i, batch.Bounds);
+				}
+				buildTime = timer.Stop() * 1000.0f;
+			}
+
+			// Parallel, projecting the extents on the basis vectors
+			Array<Batch> batches(numInstances);
+			float buildParallelTime = 0;
+			{
+				Utils::TimeScope timer;
+				TaskQueue::ParallelFor(numInstances, [&](TaskDistributeArgs args)
+					{
+						Batch& batch = batches[args.JobIndex];
+						BuildBatch(args.JobIndex, batch);
+						batch.Bounds = Math::TransformBoundingBox(meshBounds[instances[args.JobIndex].MeshIndex], batch.WorldMatrix);
+						batch.Radius = Vector3(batch.Bounds.Extents).Length();
+						cullBounds.Set(args.JobIndex, batch.Bounds);
+					}, instancesPerJob);
+				buildParallelTime = timer.Stop() * 1000.0f;
+			}
+
+			float maxBoundsError = 0;
+			for (uint32 i = 0; i < numInstances; ++i)
+			{
+				const BoundingBox& a = referenceBatches[i].Bounds;
+				const BoundingBox& b = batches[i].Bounds;
+				maxBoundsError = Math::Max(maxBoundsError, Vector3::Distance(a.Center, b.Center));
+				maxBoundsError = Math::Max(maxBoundsError, Vector3::Distance(a.Extents, b.Extents));
+			}
+
+			float stdSortTime = 0;
+			{
+				Utils::TimeScope timer;
+				std::sort(referenceBatches.begin(), referenceBatches.end(), [&](const Batch& a, const Batch& b)
+					{
+						float aDist = Vector3::DistanceSquared(a.Bounds.Center, viewPosition);
+						float bDist = Vector3::DistanceSquared(b.Bounds.Center, viewPosition);
+						if (a.BlendMode != b.BlendMode)
+							return (int)a.BlendMode < (int)b.BlendMode;
+						return EnumHasAnyFlags(a.BlendMode, Batch::Blending::AlphaBlend) ? bDist < aDist : aDist < bDist;
+					});
+				stdSortTime = timer.Stop() * 1000.0f;
+			}
+
+			float radixSortTime = 0;
+			{
+				Utils::TimeScope timer;
+				BatchSort::Sort(batches, viewPosition);
+				radixSortTime = timer.Stop() * 1000.0f;
+			}
+
+			// The radix sort must keep every batch exactly once
+			Array<uint32> instanceCounts(numInstances);
+			for (const Batch& batch : batches)
+				++instanceCounts[batch.InstanceID];
+			const uint32 numNotOnce = (uint32)std::count_if(instanceCounts.begin(), instanceCounts.end(), [](uint32 count) { return count != 1; });
+
+			// Both sorts must agree up to the depth quantization
+			uint32 numOutOfOrder = 0;
+			for (uint32 i = 1; i < numInstances; ++i)
+				numOutOfOrder += BatchSort::GetSortKey(batches[i - 1], viewPosition) > BatchSort::GetSortKey(batches[i], viewPosition);
+			for (uint32 i = 0; i < numInstances; ++i)
+				numOutOfOrder += BatchSort::GetSortKey(batches[i], viewPosition) != BatchSort::GetSortKey(referenceBatches[i], viewPosition);
+
+			E_LOG(Info, "%10d | %16.3f | %16.3f | %16.3f | %16.3f | %16.3f | %16.3f",
+				numInstances, worldTime, worldParallelTime, buildTime, buildParallelTime, stdSortTime, radixSortTime);
+			context.Check(maxBoundsError <= 1.0e-3f, "Bounds differ from BoundingBox::Transform by up to %f", maxBoundsError);
+			context.Check(numNotOnce == 0, "%d batches are lost or duplicated by the radix sort", numNotOnce);
+			context.Check(numOutOfOrder == 0, "%d batches are out of order after the radix sort", numOutOfOrder);
+		}
+	}
+
+	static Benchmark::Command<> gBenchmarkCommand("bench.BatchBuild", &Run);
+}
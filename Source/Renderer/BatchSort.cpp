@@ -0,0 +1,99 @@
+#include "stdafx.h"
+#include "BatchSort.h"
+#include "Core/Profiler.h"
+#include "Core/TaskQueue.h"
+#include "Renderer/RenderTypes.h"
+#include <bit>
+
+namespace
+{
+	// LSD radix sort on the upper 32 bits of the values, 8 bits per pass.
+	// The lower 32 bits are carried along as payload.
+	void RadixSortUpper32(Array<uint64>& values, Array<uint64>& scratch)
+	{
+		constexpr uint32 numPasses = 4;
+		constexpr uint32 numBuckets = 256;
+
+		const uint32 count = (uint32)values.size();
+		if (count <= 1)
+			return;
+
+		// Build the histograms of all passes in a single read of the data
+		uint32 histograms[numPasses][numBuckets]{};
+		for (uint64 value : values)
+		{
+			const uint32 key = (uint32)(value >> 32);
+			for (uint32 pass = 0; pass < numPasses; ++pass)
+				++histograms[pass][(key >> (pass * 8)) & 0xFF];
+		}
+
+		scratch.resize(count);
+		uint64* pSource = values.data();
+		uint64* pTarget = scratch.data();
+		for (uint32 pass = 0; pass < numPasses; ++pass)
+		{
+			const uint32 shift = 32 + pass * 8;
+			uint32* pOffsets = histograms[pass];
+
+			// All values share the same digit, nothing would move
+			if (pOffsets[(pSource[0] >> shift) & 0xFF] == count)
+				continue;
+
+			uint32 offset = 0;
+			for (uint32 bucket = 0; bucket < numBuckets; ++bucket)
+			{
+				const uint32 bucketSize = pOffsets[bucket];
+				pOffsets[bucket] = offset;
+				offset += bucketSize;
+			}
+
+			for (uint32 i = 0; i < count; ++i)
+				pTarget[pOffsets[(pSource[i] >> shift) & 0xFF]++] = pSource[i];
+			std::swap(pSource, pTarget);
+		}
+
+		if (pSource != values.data())
+			values.swap(scratch);
+	}
+}
+
+namespace BatchSort
+{
+	uint32 GetSortKey(const Batch& batch, const Vector3& viewPosition)
+	{
+		constexpr uint32 depthBits = 30;
+		constexpr uint32 depthMask = (1u << depthBits) - 1;
+
+		// Opaque, AlphaMask and AlphaBlend map to 0, 1 and 2, keeping their order
+		const uint32 blendIndex = (uint32)std::countr_zero((uint32)batch.BlendMode);
+
+		// The bits of a positive float increase with its value.
+		// Dropping the sign bit and the lowest mantissa bit keeps that order in 30 bits.
+		const float distance = Vector3::DistanceSquared(batch.Bounds.Center, viewPosition);
+		uint32 depth = (std::bit_cast<uint32>(distance) >> 1) & depthMask;
+		if (EnumHasAnyFlags(batch.BlendMode, Batch::Blending::AlphaBlend))
+			depth = ~depth & depthMask;
+
+		return (blendIndex << depthBits) | depth;
+	}
+
+	void Sort(Array<Batch>& batches, const Vector3& viewPosition)
+	{
+		PROFILE_CPU_SCOPE();
+
+		const uint32 count = (uint32)batches.size();
+		Array<uint64> keys(count);
+		TaskQueue::ParallelFor(count, [&](TaskDistributeArgs args)
+			{
+				keys[args.JobIndex] = (uint64)GetSortKey(batches[args.JobIndex], viewPosition) << 32 | (uint32)args.JobIndex;
+			}, 1024);
+
+		Array<uint64> scratch;
+		RadixSortUpper32(keys, scratch);
+
+		Array<Batch> sorted(count);
+		for (uint32 i = 0; i < count; ++i)
+			sorted[i] = batches[(uint32)keys[i]];
+		batches.swap(sorted);
+	}
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+struct Batch;
+
+namespace BatchSort
+{
+	// Blend mode in the top 2 bits and the quantized squared view distance in the low 30 bits.
+	// The distance bits are inverted for alpha blended batches so they sort back to front.
+	uint32 GetSortKey(const Batch& batch, const Vector3& viewPosition);
+
+	// Radix sorts the batches by blend mode, then front to back (back to front for alpha blended batches).
+	// Batches with equal keys keep their relative order.
+	void Sort(Array<Batch>& batches, const Vector3& viewPosition);
+}
@@ -0,0 +1,221 @@
+#include "stdafx.h"
+#include "FrustumCulling.h"
+#include "Core/Profiler.h"
+#include "Core/TaskQueue.h"
+#include "Renderer/RenderTypes.h"
+#include <immintrin.h>
+
+namespace
+{
+	// The project is built without /arch:AVX2 by default, so the SSE path is what normally runs.
+	// It still processes 8 boxes per step, as two 4-wide halves.
+#if defined(__AVX2__)
+	using SIMDFloat = __m256;
+	constexpr uint32 SIMDWidth = 8;
+
+	inline SIMDFloat SIMDSplat(float v)							{ return _mm256_set1_ps(v); }
+	inline SIMDFloat SIMDLoad(const float* p)					{ return _mm256_loadu_ps(p); }
+	inline SIMDFloat SIMDZero()									{ return _mm256_setzero_ps(); }
+	inline SIMDFloat SIMDMulAdd(SIMDFloat a, SIMDFloat b, SIMDFloat c)	{ return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+	inline SIMDFloat SIMDMul(SIMDFloat a, SIMDFloat b)			{ return _mm256_mul_ps(a, b); }
+	inline SIMDFloat SIMDOr(SIMDFloat a, SIMDFloat b)			{ return _mm256_or_ps(a, b); }
+	inline SIMDFloat SIMDGreater(SIMDFloat a, SIMDFloat b)		{ return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	inline uint32 SIMDMoveMask(SIMDFloat a)						{ return (uint32)_mm256_movemask_ps(a); }
+#else
+	using SIMDFloat = __m128;
+	constexpr uint32 SIMDWidth = 4;
+
+	inline SIMDFloat SIMDSplat(float v)							{ return _mm_set1_ps(v); }
+	inline SIMDFloat SIMDLoad(const float* p)					{ return _mm_loadu_ps(p); }
+	inline SIMDFloat SIMDZero()									{ return _mm_setzero_ps(); }
+	inline SIMDFloat SIMDMulAdd(SIMDFloat a, SIMDFloat b, SIMDFloat c)	{ return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	inline SIMDFloat SIMDMul(SIMDFloat a, SIMDFloat b)			{ return _mm_mul_ps(a, b); }
+	inline SIMDFloat SIMDOr(SIMDFloat a, SIMDFloat b)			{ return _mm_or_ps(a, b); }
+	inline SIMDFloat SIMDGreater(SIMDFloat a, SIMDFloat b)		{ return _mm_cmpgt_ps(a, b); }
+	inline uint32 SIMDMoveMask(SIMDFloat a)						{ return (uint32)_mm_movemask_ps(a); }
+#endif
+
+	constexpr uint32 BoxesPerStep = 8;
+	static_assert(BoxesPerStep % SIMDWidth == 0);
+	static_assert(CullBounds::BoxesPerWord % BoxesPerStep == 0);
+
+	// Plane with each component splatted across all lanes
+	struct SIMDPlane
+	{
+		SIMDFloat NormalX, NormalY, NormalZ, Distance;
+		SIMDFloat AbsNormalX, AbsNormalY, AbsNormalZ;
+	};
+
+	// Returns a bit per box that is set when the box is not entirely in front of any plane
+	inline uint32 CullStep(const CullBounds& bounds, uint32 first, const SIMDPlane* pPlanes, uint32 numPlanes)
+	{
+		uint32 visible = 0;
+		for (uint32 lane = 0; lane < BoxesPerStep; lane += SIMDWidth)
+		{
+			const uint32 i = first + lane;
+			SIMDFloat centerX	= SIMDLoad(&bounds.CenterX[i]);
+			SIMDFloat centerY	= SIMDLoad(&bounds.CenterY[i]);
+			SIMDFloat centerZ	= SIMDLoad(&bounds.CenterZ[i]);
+			SIMDFloat extentsX	= SIMDLoad(&bounds.ExtentsX[i]);
+			SIMDFloat extentsY	= SIMDLoad(&bounds.ExtentsY[i]);
+			SIMDFloat extentsZ	= SIMDLoad(&bounds.ExtentsZ[i]);
+
+			SIMDFloat outside = SIMDZero();
+			for (uint32 p = 0; p < numPlanes; ++p)
+			{
+				const SIMDPlane& plane = pPlanes[p];
+				SIMDFloat distance = SIMDMulAdd(plane.NormalX, centerX, SIMDMulAdd(plane.NormalY, centerY, SIMDMulAdd(plane.NormalZ, centerZ, plane.Distance)));
+				SIMDFloat radius = SIMDMulAdd(plane.AbsNormalX, extentsX, SIMDMulAdd(plane.AbsNormalY, extentsY, SIMDMul(plane.AbsNormalZ, extentsZ)));
+				outside = SIMDOr(outside, SIMDGreater(distance, radius));
+			}
+			visible |= (~SIMDMoveMask(outside) & ((1u << SIMDWidth) - 1)) << lane;
+		}
+		return visible;
+	}
+}
+
+void CullBounds::Resize(uint32 count)
+{
+	Count = count;
+	uint32 paddedCount = Math::AlignUp(count, BoxesPerWord);
+	CenterX.resize(paddedCount);
+	CenterY.resize(paddedCount);
+	CenterZ.resize(paddedCount);
+	ExtentsX.resize(paddedCount);
+	ExtentsY.resize(paddedCount);
+	ExtentsZ.resize(paddedCount);
+}
+
+void CullBounds::Set(uint32 index, const BoundingBox& bounds)
+{
+	gAssert(index < Count);
+	CenterX[index]	= bounds.Center.x;
+	CenterY[index]	= bounds.Center.y;
+	CenterZ[index]	= bounds.Center.z;
+	ExtentsX[index] = bounds.Extents.x;
+	ExtentsY[index] = bounds.Extents.y;
+	ExtentsZ[index] = bounds.Extents.z;
+}
+
+namespace FrustumCulling
+{
+	CullPlanes GetPlanes(const ViewTransform& view)
+	{
+		CullPlanes out;
+		if (view.IsPerspective)
+		{
+			DirectX::XMVECTOR planes[6];
+			view.PerspectiveFrustum.GetPlanes(&planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+			for (const DirectX::XMVECTOR& plane : planes)
+				out.Planes[out.NumPlanes++] = Vector4(plane);
+		}
+		else
+		{
+			// The face planes of the box and the planes of its world-space AABB.
+			// This is a subset of the separating axes OrientedBoundingBox::Contains tests, so the result is conservative.
+			const OrientedBoundingBox& box = view.OrthographicFrustum;
+			const Vector3 center = box.Center;
+			const Vector3 extents = box.Extents;
+			const Quaternion orientation = box.Orientation;
+			const Vector3 axes[] = {
+				Vector3::Transform(Vector3::UnitX, orientation),
+				Vector3::Transform(Vector3::UnitY, orientation),
+				Vector3::Transform(Vector3::UnitZ, orientation),
+			};
+
+			Vector3 worldExtents;
+			for (uint32 i = 0; i < 3; ++i)
+			{
+				const float extent = (&extents.x)[i];
+				const float centerDistance = axes[i].Dot(center);
+				out.Planes[out.NumPlanes++] = Vector4(axes[i].x, axes[i].y, axes[i].z, -centerDistance - extent);
+				out.Planes[out.NumPlanes++] = Vector4(-axes[i].x, -axes[i].y, -axes[i].z, centerDistance - extent);
+				worldExtents += Vector3(fabsf(axes[i].x), fabsf(axes[i].y), fabsf(axes[i].z)) * extent;
+			}
+
+			out.Planes[out.NumPlanes++] = Vector4(1, 0, 0, -center.x - worldExtents.x);
+			out.Planes[out.NumPlanes++] = Vector4(-1, 0, 0, center.x - worldExtents.x);
+			out.Planes[out.NumPlanes++] = Vector4(0, 1, 0, -center.y - worldExtents.y);
+			out.Planes[out.NumPlanes++] = Vector4(0, -1, 0, center.y - worldExtents.y);
+			out.Planes[out.NumPlanes++] = Vector4(0, 0, 1, -center.z - worldExtents.z);
+			out.Planes[out.NumPlanes++] = Vector4(0, 0, -1, center.z - worldExtents.z);
+		}
+		gAssert(out.NumPlanes <= CullPlanes::MaxPlanes);
+		return out;
+	}
+
+	void CullWords(const CullBounds& bounds, const CullPlanes& planes, uint32* pMaskWords, uint32 firstWord, uint32 numWords)
+	{
+		gAssert(firstWord + numWords <= bounds.GetNumWords());
+
+		SIMDPlane simdPlanes[CullPlanes::MaxPlanes];
+		for (uint32 p = 0; p < planes.NumPlanes; ++p)
+		{
+			const Vector4& plane = planes.Planes[p];
+			SIMDPlane& simdPlane = simdPlanes[p];
+			simdPlane.NormalX		= SIMDSplat(plane.x);
+			simdPlane.NormalY		= SIMDSplat(plane.y);
+			simdPlane.NormalZ		= SIMDSplat(plane.z);
+			simdPlane.Distance		= SIMDSplat(plane.w);
+			simdPlane.AbsNormalX	= SIMDSplat(fabsf(plane.x));
+			simdPlane.AbsNormalY	= SIMDSplat(fabsf(plane.y));
+			simdPlane.AbsNormalZ	= SIMDSplat(fabsf(plane.z));
+		}
+
+		for (uint32 word = firstWord; word < firstWord + numWords; ++word)
+		{
+			uint32 visible = 0;
+			for (uint32 step = 0; step < CullBounds::BoxesPerWord; step += BoxesPerStep)
+				visible |= CullStep(bounds, word * CullBounds::BoxesPerWord + step, simdPlanes, planes.NumPlanes) << step;
+			pMaskWords[word] = visible;
+		}
+
+		// Padding boxes past the instance count must not show up as visible
+		const uint32 tailBits = bounds.GetCount() % CullBounds::BoxesPerWord;
+		if (tailBits != 0 && firstWord + numWords == bounds.GetNumWords())
+			pMaskWords[bounds.GetNumWords() - 1] &= (1u << tailBits) - 1;
+	}
+
+	void Cull(const CullBounds& bounds, Span<RenderView*> views)
+	{
+		PROFILE_CPU_SCOPE();
+
+		const uint32 numWords = bounds.GetNumWords();
+
+		Array<CullPlanes> planes(views.GetSize());
+		for (uint32 i = 0; i < views.GetSize(); ++i)
+		{
+			planes[i] = GetPlanes(*views[i]);
+			views[i]->VisibilityMask.Resize(bounds.GetCount());
+			gAssert(views[i]->VisibilityMask.NumStorageElements() == numWords);
+		}
+
+		// Each job culls a range of instances for a single view, so jobs never write to the same mask word
+		constexpr uint32 wordsPerJob = 16;
+		const uint32 jobsPerView = Math::DivideAndRoundUp(numWords, wordsPerJob);
+		TaskQueue::ParallelFor(views.GetSize() * jobsPerView, [&](TaskDistributeArgs args)
+			{
+				const uint32 viewIndex = args.JobIndex / jobsPerView;
+				const uint32 firstWord = (args.JobIndex % jobsPerView) * wordsPerJob;
+				CullWords(bounds, planes[viewIndex], views[viewIndex]->VisibilityMask.GetData(), firstWord, Math::Min(wordsPerJob, numWords - firstWord));
+			}, 1);
+	}
+
+	void CullScalar(Span<const Batch> batches, Span<RenderView*> views)
+	{
+		PROFILE_CPU_SCOPE();
+
+		TaskContext taskContext;
+		TaskQueue::ExecuteMany([&](TaskDistributeArgs args)
+			{
+				PROFILE_CPU_SCOPE("Frustum Cull View");
+				RenderView& view = *views[args.JobIndex];
+				view.VisibilityMask.Resize(batches.GetSize());
+				for (const Batch& b : batches)
+				{
+					view.VisibilityMask.AssignBit(b.InstanceID, view.IsInFrustum(b.Bounds));
+				}
+			}, taskContext, views.GetSize(), 1);
+		TaskQueue::Join(taskContext);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+struct Batch;
+struct RenderView;
+struct ViewTransform;
+
+// Batch bounds as a structure of arrays, indexed by InstanceID.
+// The arrays are padded to a multiple of 32 so the culling loop always produces whole VisibilityMask words.
+struct CullBounds
+{
+	static constexpr uint32 BoxesPerWord = 32;
+
+	void Resize(uint32 count);
+	void Set(uint32 index, const BoundingBox& bounds);
+
+	uint32 GetCount() const { return Count; }
+	uint32 GetNumWords() const { return (Count + BoxesPerWord - 1) / BoxesPerWord; }
+
+	Array<float> CenterX;
+	Array<float> CenterY;
+	Array<float> CenterZ;
+	Array<float> ExtentsX;
+	Array<float> ExtentsY;
+	Array<float> ExtentsZ;
+	uint32 Count = 0;
+};
+
+// Outward facing culling planes of a view. A box is culled when it lies entirely in front of any plane.
+struct CullPlanes
+{
+	static constexpr uint32 MaxPlanes = 12;
+
+	Vector4 Planes[MaxPlanes];
+	uint32	NumPlanes = 0;
+};
+
+namespace FrustumCulling
+{
+	// Perspective views get their 6 frustum planes.
+	// Orthographic views get the 6 face planes of the oriented box and the 6 planes of its world-space AABB.
+	CullPlanes GetPlanes(const ViewTransform& view);
+
+	// Culls the boxes of the mask words [firstWord, firstWord + numWords) and writes the visibility bits straight into pMaskWords.
+	// Bits of padding boxes in the last word are cleared.
+	void CullWords(const CullBounds& bounds, const CullPlanes& planes, uint32* pMaskWords, uint32 firstWord, uint32 numWords);
+
+	// Resizes the visibility mask of each view to the instance count and culls all bounds against all views,
+	// split across views and ranges of instances.
+	void Cull(const CullBounds& bounds, Span<RenderView*> views);
+
+	// Reference path: one task per view, testing every batch with BoundingFrustum/OrientedBoundingBox::Contains.
+	void CullScalar(Span<const Batch> batches, Span<RenderView*> views);
+}
@@ -0,0 +1,144 @@
+#include "stdafx.h"
+#include "FrustumCulling.h"
+#include "Core/Benchmark.h"
+#include "Core/TaskQueue.h"
+#include "Core/Utils.h"
+#include "Renderer/RenderTypes.h"
+
+/*
+	Microbenchmark comparing the scalar BoundingFrustum/OrientedBoundingBox::Contains culling with the SoA SIMD culling.
+	Run from the console with "bench.FrustumCull".
+*/
+
+namespace FrustumCullingBenchmark
+{
+	// One perspective main view and a set of orthographic shadow cascades
+	static Array<ViewTransform> CreateViews()
+	{
+		Array<ViewTransform> views;
+
+		const Vector3 cameraPosition(0, 50, -400);
+		Vector3 cameraDirection(0, -0.2f, 1.0f);
+		cameraDirection.Normalize();
+
+		ViewTransform& mainView = views.emplace_back();
+		mainView.IsPerspective = true;
+		mainView.PerspectiveFrustum = Math::CreateBoundingFrustum(
+			Math::CreatePerspectiveMatrix(60.0f * Math::PI / 180, 16.0f / 9.0f, 0.1f, 1000.0f),
+			Math::CreateLookToMatrix(cameraPosition, cameraDirection, Vector3::Up));
+
+		const Quaternion lightOrientation = Quaternion::CreateFromYawPitchRoll(0.6f, 0.9f, 0.0f);
+		constexpr uint32 numCascades = 4;
+		for (uint32 i = 0; i < numCascades; ++i)
+		{
+			const float cascadeSize = 100.0f * (float)(1u << i);
+			ViewTransform& shadowView = views.emplace_back();
+			shadowView.IsPerspective = false;
+			shadowView.OrthographicFrustum.Center = cameraPosition + cameraDirection * cascadeSize;
+			shadowView.OrthographicFrustum.Extents = Vector3(cascadeSize, cascadeSize, cascadeSize * 10);
+			shadowView.OrthographicFrustum.Orientation = lightOrientation;
+		}
+		return views;
+	}
+
+	static void Run(Benchmark::Context& context)
+	{
+		constexpr uint32 instanceCounts[] = { 8'192, 65'536, 262'144 };
+		const Array<ViewTransform> views = CreateViews();
+		const uint32 numViews = (uint32)views.size();
+
+		Array<CullPlanes> planes(numViews);
+		for (uint32 i = 0; i < numViews; ++i)
+			planes[i] = FrustumCulling::GetPlanes(views[i]);
+
+		E_LOG(Info, "Frustum culling benchmark - %d views, %d threads", numViews, TaskQueue::ThreadCount());
+		E_LOG(Info, "%10s | %12s | %12s | %8s | %14s | %8s | %10s | %8s", "Instances", "Scalar (ms)", "SIMD (ms)", "Speedup", "Parallel (ms)", "Speedup", "Extra vis.", "Missed");
+
+		for (uint32 numInstances : instanceCounts)
+		{
+			// Deterministic pseudo random scene
+			Array<BoundingBox> boxes(numInstances);
+			CullBounds bounds;
+			bounds.Resize(numInstances);
+			uint32 seed = 0x12345678u;
+			auto Random = [&seed](float minValue, float maxValue)
+				{
+					seed = seed * 1664525u + 1013904223u;
+					return minValue + (float)(seed >> 8) / (float)(1u << 24) * (maxValue - minValue);
+				};
+			for (uint32 i = 0; i < numInstances; ++i)
+			{
+				boxes[i].Center = Vector3(Random(-1000, 1000), Random(-50, 150), Random(-1000, 1000));
+				boxes[i].Extents = Vector3(Random(0.5f, 8.0f), Random(0.5f, 8.0f), Random(0.5f, 8.0f));
+				bounds.Set(i, boxes[i]);
+			}
+
+			const uint32 numWords = bounds.GetNumWords();
+			Array<uint32> scalarMask(numWords * numViews);
+			Array<uint32> simdMask(numWords * numViews);
+			Array<uint32> parallelMask(numWords * numViews);
+
+			float scalarTime = 0;
+			{
+				Utils::TimeScope timer;
+				for (uint32 v = 0; v < numViews; ++v)
+				{
+					uint32* pMask = &scalarMask[v * numWords];
+					for (uint32 i = 0; i < numInstances; ++i)
+					{
+						if (views[v].IsInFrustum(boxes[i]))
+							pMask[i / CullBounds::BoxesPerWord] |= 1u << (i % CullBounds::BoxesPerWord);
+					}
+				}
+				scalarTime = timer.Stop() * 1000.0f;
+			}
+
+			float simdTime = 0;
+			{
+				Utils::TimeScope timer;
+				for (uint32 v = 0; v < numViews; ++v)
+					FrustumCulling::CullWords(bounds, planes[v], &simdMask[v * numWords], 0, numWords);
+				simdTime = timer.Stop() * 1000.0f;
+			}
+
+			float parallelTime = 0;
+			{
+				Utils::TimeScope timer;
+				constexpr uint32 wordsPerJob = 16;
+				const uint32 jobsPerView = Math::DivideAndRoundUp(numWords, wordsPerJob);
+				TaskQueue::ParallelFor(numViews * jobsPerView, [&](TaskDistributeArgs args)
+					{
+						const uint32 viewIndex = args.JobIndex / jobsPerView;
+						const uint32 firstWord = (args.JobIndex % jobsPerView) * wordsPerJob;
+						FrustumCulling::CullWords(bounds, planes[viewIndex], &parallelMask[viewIndex * numWords], firstWord, Math::Min(wordsPerJob, numWords - firstWord));
+					}, 1);
+				parallelTime = timer.Stop() * 1000.0f;
+			}
+
+			// The SIMD path may keep boxes the oriented box SAT test rejects, but must never cull a box the scalar path keeps.
+			uint32 numExtraVisible = 0;
+			uint32 numMissed = 0;
+			uint32 numParallelMismatches = 0;
+			for (uint32 v = 0; v < numViews; ++v)
+			{
+				for (uint32 i = 0; i < numInstances; ++i)
+				{
+					const uint32 word = v * numWords + i / CullBounds::BoxesPerWord;
+					const uint32 bit = 1u << (i % CullBounds::BoxesPerWord);
+					const bool scalarVisible = (scalarMask[word] & bit) != 0;
+					const bool simdVisible = (simdMask[word] & bit) != 0;
+					numParallelMismatches += simdVisible != ((parallelMask[word] & bit) != 0);
+					numExtraVisible += simdVisible && !scalarVisible;
+					numMissed += scalarVisible && !simdVisible;
+				}
+			}
+
+			E_LOG(Info, "%10d | %12.3f | %12.3f | %7.2fx | %14.3f | %7.2fx | %10d | %8d",
+				numInstances, scalarTime, simdTime, scalarTime / simdTime, parallelTime, scalarTime / parallelTime, numExtraVisible, numMissed);
+			context.Check(numMissed == 0, "SIMD frustum culling rejected %d boxes that are visible to the scalar path", numMissed);
+			context.Check(numParallelMismatches == 0, "Parallel frustum culling differs from the single threaded SIMD path for %d boxes", numParallelMismatches);
+		}
+	}
+
+	static Benchmark::Command<> gBenchmarkCommand("bench.FrustumCull", &Run);
+}
@@ -0,0 +1,432 @@
+#include "stdafx.h"
+#include "GeometryStreaming.h"
+#include "Core/ConsoleVariables.h"
+#include "Core/Profiler.h"
+#include "RHI/Device.h"
+#include "RHI/Buffer.h"
+#include "RHI/CommandContext.h"
+#include "RHI/RingBufferAllocator.h"
+#include "Renderer/Mesh.h"
+#include "Renderer/MeshCompression.h"
+#include "Scene/World.h"
+
+namespace Tweakables
+{
+	static ConsoleVariable gGeometryHeapSize("r.Streaming.GeometryHeapSize", 512);		///< In MB. Applied when a scene is loaded
+	static ConsoleVariable gGeometryBudget("r.Streaming.GeometryBudget", 512);			///< In MB. Limited to the heap size
+	static ConsoleVariable gGeometryUploadLimit("r.Streaming.GeometryUploadLimit", 32);	///< In MB of loads started per frame
+}
+
+// Loads are copied in chunks of this size, so a mesh can be larger than the staging ring buffer.
+// The ring is not a multiple of the chunk size, so it is never filled up to exactly the start of the oldest chunk.
+static constexpr uint32 StreamingChunkSize = 1536 * 1024;
+static constexpr uint32 StreamingStagingSize = 8 * 1024 * 1024;
+
+
+void GeometryHeapAllocator::Init(uint64 size)
+{
+	m_Size = size;
+	m_UsedSize = 0;
+	m_FreeRanges.clear();
+	if (size > 0)
+		m_FreeRanges.push_back(Range{ 0, size });
+}
+
+uint64 GeometryHeapAllocator::Allocate(uint64 size)
+{
+	size = Math::AlignUp(size, Alignment);
+	for (uint32 i = 0; i < (uint32)m_FreeRanges.size(); ++i)
+	{
+		Range& range = m_FreeRanges[i];
+		if (range.Size >= size)
+		{
+			uint64 offset = range.Offset;
+			range.Offset += size;
+			range.Size -= size;
+			if (range.Size == 0)
+				m_FreeRanges.erase(m_FreeRanges.begin() + i);
+			m_UsedSize += size;
+			return offset;
+		}
+	}
+	return InvalidOffset;
+}
+
+void GeometryHeapAllocator::Free(uint64 offset, uint64 size)
+{
+	size = Math::AlignUp(size, Alignment);
+	gAssert(offset + size <= m_Size && size <= m_UsedSize);
+	m_UsedSize -= size;
+
+	auto it = std::lower_bound(m_FreeRanges.begin(), m_FreeRanges.end(), offset, [](const Range& range, uint64 offset) { return range.Offset < offset; });
+	gAssert(it == m_FreeRanges.end() || offset + size <= it->Offset, "Freed range overlaps a free range");
+	it = m_FreeRanges.insert(it, Range{ offset, size });
+
+	// Merge with the next and the previous range
+	auto next = it + 1;
+	if (next != m_FreeRanges.end() && it->Offset + it->Size == next->Offset)
+	{
+		it->Size += next->Size;
+		it = m_FreeRanges.erase(next) - 1;
+	}
+	if (it != m_FreeRanges.begin())
+	{
+		auto prev = it - 1;
+		gAssert(prev->Offset + prev->Size <= it->Offset, "Freed range overlaps a free range");
+		if (prev->Offset + prev->Size == it->Offset)
+		{
+			prev->Size += it->Size;
+			m_FreeRanges.erase(it);
+		}
+	}
+}
+
+uint64 GeometryHeapAllocator::GetLargestFreeRange() const
+{
+	uint64 largest = 0;
+	for (const Range& range : m_FreeRanges)
+		largest = Math::Max(largest, range.Size);
+	return largest;
+}
+
+
+void GeometryResidency::Init(uint64 heapSize)
+{
+	m_Allocator.Init(heapSize);
+	m_Meshes.clear();
+	m_VisibleMeshes.clear();
+	m_Frame = 0;
+	m_Stats = {};
+}
+
+uint32 GeometryResidency::AddMesh(uint64 size)
+{
+	MeshState& mesh = m_Meshes.emplace_back();
+	mesh.Size = Math::AlignUp(size, GeometryHeapAllocator::Alignment);
+	return (uint32)m_Meshes.size() - 1;
+}
+
+void GeometryResidency::BeginFrame(uint32 frame)
+{
+	m_Frame = frame;
+	m_VisibleMeshes.clear();
+}
+
+void GeometryResidency::MarkVisible(uint32 mesh, float priority)
+{
+	MeshState& state = m_Meshes[mesh];
+	if (state.LastVisibleFrame != m_Frame)
+	{
+		state.LastVisibleFrame = m_Frame;
+		state.Priority = priority;
+		m_VisibleMeshes.push_back(mesh);
+	}
+	else
+	{
+		state.Priority = Math::Max(state.Priority, priority);
+	}
+}
+
+void GeometryResidency::Update(uint64 budget, uint64 maxLoadSize, Array<Load>& outLoads, Array<Eviction>& outEvictions)
+{
+	m_Stats.LoadedSize = 0;
+	m_Stats.NumLoads = 0;
+	m_Stats.NumEvictions = 0;
+	budget = Math::Min(budget, m_Allocator.GetSize());
+
+	// Visible meshes that are not resident, most important first
+	Array<uint32> requests;
+	for (uint32 mesh : m_VisibleMeshes)
+	{
+		const MeshState& state = m_Meshes[mesh];
+		if (state.State == State::Evicted && state.Size <= budget)
+			requests.push_back(mesh);
+	}
+	std::sort(requests.begin(), requests.end(), [this](uint32 a, uint32 b) { return m_Meshes[a].Priority > m_Meshes[b].Priority; });
+
+	// Resident meshes that are not visible, least recently visible first
+	Array<uint32> victims;
+	for (uint32 mesh = 0; mesh < (uint32)m_Meshes.size(); ++mesh)
+	{
+		const MeshState& state = m_Meshes[mesh];
+		if (state.State == State::Resident && state.LastVisibleFrame != m_Frame)
+			victims.push_back(mesh);
+	}
+	std::sort(victims.begin(), victims.end(), [this](uint32 a, uint32 b)
+		{
+			const MeshState& stateA = m_Meshes[a];
+			const MeshState& stateB = m_Meshes[b];
+			if (stateA.LastVisibleFrame != stateB.LastVisibleFrame)
+				return stateA.LastVisibleFrame < stateB.LastVisibleFrame;
+			return stateA.Priority < stateB.Priority;
+		});
+	uint32 nextVictim = 0;
+
+	// The budget may have been lowered
+	while (m_Stats.ResidentSize > budget && nextVictim < (uint32)victims.size())
+		Evict(victims[nextVictim++], outEvictions);
+
+	for (uint32 mesh : requests)
+	{
+		MeshState& state = m_Meshes[mesh];
+
+		// Always start at least one load, so meshes larger than the upload limit still make progress
+		if (m_Stats.LoadedSize > 0 && m_Stats.LoadedSize + state.Size > maxLoadSize)
+			break;
+
+		while (m_Stats.ResidentSize + state.Size > budget && nextVictim < (uint32)victims.size())
+			Evict(victims[nextVictim++], outEvictions);
+
+		// The budget is taken by visible meshes
+		if (m_Stats.ResidentSize + state.Size > budget)
+			break;
+
+		uint64 offset = m_Allocator.Allocate(state.Size);
+		if (offset == GeometryHeapAllocator::InvalidOffset)
+		{
+			// No contiguous range is large enough. Unless enough space is already retiring, evict another mesh so a later frame can fit it.
+			if (m_Stats.RetiringSize < state.Size && nextVictim < (uint32)victims.size())
+				Evict(victims[nextVictim++], outEvictions);
+			continue;
+		}
+
+		state.Offset = offset;
+		state.State = State::Loading;
+		m_Stats.ResidentSize += state.Size;
+		m_Stats.LoadedSize += state.Size;
+		++m_Stats.NumLoading;
+		++m_Stats.NumLoads;
+		outLoads.push_back(Load{ mesh, offset });
+	}
+
+	m_Stats.NumVisible = (uint32)m_VisibleMeshes.size();
+	m_Stats.NumVisibleFallback = 0;
+	for (uint32 mesh : m_VisibleMeshes)
+		m_Stats.NumVisibleFallback += m_Meshes[mesh].State != State::Resident;
+}
+
+void GeometryResidency::OnLoaded(uint32 mesh)
+{
+	MeshState& state = m_Meshes[mesh];
+	gAssert(state.State == State::Loading);
+	state.State = State::Resident;
+	--m_Stats.NumLoading;
+	++m_Stats.NumResident;
+}
+
+void GeometryResidency::Release(uint64 offset, uint64 size)
+{
+	m_Allocator.Free(offset, size);
+	m_Stats.RetiringSize -= size;
+}
+
+void GeometryResidency::Evict(uint32 mesh, Array<Eviction>& outEvictions)
+{
+	MeshState& state = m_Meshes[mesh];
+	gAssert(state.State == State::Resident);
+	outEvictions.push_back(Eviction{ mesh, state.Offset, state.Size });
+
+	state.State = State::Evicted;
+	state.Offset = GeometryHeapAllocator::InvalidOffset;
+	m_Stats.ResidentSize -= state.Size;
+	m_Stats.RetiringSize += state.Size;
+	--m_Stats.NumResident;
+	++m_Stats.NumEvictions;
+}
+
+
+GeometryStreamer::GeometryStreamer() = default;
+GeometryStreamer::~GeometryStreamer() = default;
+
+void GeometryStreamer::Init(GraphicsDevice* pDevice)
+{
+	m_pDevice = pDevice;
+	m_pStagingBuffer = new RingBufferAllocator(pDevice, StreamingStagingSize);
+}
+
+void GeometryStreamer::Shutdown()
+{
+	TaskQueue::Join(m_TaskContext);
+	m_PendingLoads.clear();
+	m_pStagingBuffer = nullptr;
+}
+
+void GeometryStreamer::Reset(World* pWorld)
+{
+	TaskQueue::Join(m_TaskContext);
+
+	if (pWorld)
+	{
+		for (uint32 meshIndex : m_MeshFromHandle)
+		{
+			Mesh& mesh = pWorld->Meshes[meshIndex];
+			mesh.SetGeometry(mesh.Streaming.pFallbackBuffer, 0, mesh.Streaming.Fallback);
+		}
+	}
+
+	m_PendingLoads.clear();
+	m_RetiredRanges.clear();
+	m_MeshFromHandle.clear();
+	m_HandleFromMesh.clear();
+	m_Residency.Init(0);
+	m_pHeap = nullptr;
+}
+
+void GeometryStreamer::BeginFrame(World& world, uint32 frame)
+{
+	const uint32 firstNewMesh = (uint32)m_HandleFromMesh.size();
+	const uint32 numMeshes = (uint32)world.Meshes.size();
+
+	// The heap is created when the first streamed mesh shows up
+	if (!m_pHeap)
+	{
+		bool hasStreamedMeshes = false;
+		for (uint32 i = firstNewMesh; i < numMeshes; ++i)
+			hasStreamedMeshes |= world.Meshes[i].IsStreamed();
+
+		if (hasStreamedMeshes)
+		{
+			const uint64 heapSize = (uint64)Math::Max(Tweakables::gGeometryHeapSize.Get(), 1) * 1024 * 1024;
+			m_pHeap = m_pDevice->CreateBuffer(BufferDesc::CreateByteAddress(heapSize), "Geometry Heap");
+			m_Residency.Init(heapSize);
+		}
+	}
+
+	for (uint32 i = firstNewMesh; i < numMeshes; ++i)
+	{
+		const Mesh& mesh = world.Meshes[i];
+		uint32 handle = ~0u;
+		if (mesh.IsStreamed())
+		{
+			handle = m_Residency.AddMesh(mesh.Streaming.Full.BufferSize);
+			m_MeshFromHandle.push_back(i);
+		}
+		m_HandleFromMesh.push_back(handle);
+	}
+
+	m_Residency.BeginFrame(frame);
+}
+
+void GeometryStreamer::MarkVisible(uint32 meshIndex, float priority)
+{
+	const uint32 handle = m_HandleFromMesh[meshIndex];
+	if (handle != ~0u)
+		m_Residency.MarkVisible(handle, priority);
+}
+
+void GeometryStreamer::Update(World& world)
+{
+	PROFILE_CPU_SCOPE();
+
+	if (!m_pHeap)
+		return;
+
+	// Switch meshes to their full geometry once all their copies have completed
+	for (uint32 i = 0; i < (uint32)m_PendingLoads.size();)
+	{
+		PendingLoad& load = *m_PendingLoads[i];
+		if (load.IsCopied && load.Sync.IsComplete())
+		{
+			Mesh& mesh = world.Meshes[load.MeshIndex];
+			mesh.SetGeometry(m_pHeap, load.Offset, mesh.Streaming.Full);
+			m_Residency.OnLoaded(load.Handle);
+
+			std::swap(m_PendingLoads[i], m_PendingLoads.back());
+			m_PendingLoads.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	// Evicted ranges can be reused once the GPU is done with the frames that may still read them
+	for (uint32 i = 0; i < (uint32)m_RetiredRanges.size();)
+	{
+		const RetiredRange& range = m_RetiredRanges[i];
+		if (range.Sync.IsComplete())
+		{
+			m_Residency.Release(range.Offset, range.Size);
+			std::swap(m_RetiredRanges[i], m_RetiredRanges.back());
+			m_RetiredRanges.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	Array<GeometryResidency::Load> loads;
+	Array<GeometryResidency::Eviction> evictions;
+	const uint64 budget = (uint64)Math::Max(Tweakables::gGeometryBudget.Get(), 0) * 1024 * 1024;
+	const uint64 maxLoadSize = (uint64)Math::Max(Tweakables::gGeometryUploadLimit.Get(), 0) * 1024 * 1024;
+	m_Residency.Update(budget, maxLoadSize, loads, evictions);
+
+	// This frame already renders evicted meshes with their fallback, so their range is free once this frame completes
+	Fence* pFrameFence = m_pDevice->GetFrameFence();
+	const SyncPoint frameSync(pFrameFence, pFrameFence->GetCurrentValue());
+	for (const GeometryResidency::Eviction& eviction : evictions)
+	{
+		Mesh& mesh = world.Meshes[m_MeshFromHandle[eviction.Mesh]];
+		mesh.SetGeometry(mesh.Streaming.pFallbackBuffer, 0, mesh.Streaming.Fallback);
+		m_RetiredRanges.push_back(RetiredRange{ frameSync, eviction.Offset, eviction.Size });
+	}
+
+	for (const GeometryResidency::Load& load : loads)
+	{
+		const uint32 meshIndex = m_MeshFromHandle[load.Mesh];
+		const MeshStreamingData& streaming = world.Meshes[meshIndex].Streaming;
+
+		UniquePtr<PendingLoad>& pLoad = m_PendingLoads.emplace_back(std::make_unique<PendingLoad>());
+		pLoad->MeshIndex = meshIndex;
+		pLoad->Handle = load.Mesh;
+		pLoad->Offset = load.Offset;
+		pLoad->pSource = streaming.pSource;
+
+		// Reading the source may page in the cache file and decoding it takes time, so the copies are recorded on a worker thread
+		TaskQueue::Execute([this, pLoad = pLoad.get(), pSourceData = streaming.pSource->GetData() + streaming.SourceOffset, sourceSize = streaming.SourceSize, layout = streaming.Full](int)
+			{
+				PROFILE_CPU_SCOPE("Stream Geometry");
+				const uint64 size = layout.BufferSize;
+				const uint8* pData = pSourceData;
+				Array<uint8> decodedData;
+				if (sourceSize > 0)
+				{
+					PROFILE_CPU_SCOPE("Decode");
+					decodedData.resize(size);
+					gVerify(MeshCompression::Decode(layout, pSourceData, sourceSize, decodedData.data()), == true);
+					pData = decodedData.data();
+				}
+
+				for (uint64 chunkOffset = 0; chunkOffset < size; chunkOffset += StreamingChunkSize)
+				{
+					const uint32 chunkSize = (uint32)Math::Min<uint64>(StreamingChunkSize, size - chunkOffset);
+					RingBufferAllocation allocation;
+					gVerify(m_pStagingBuffer->Allocate(chunkSize, allocation), == true);
+					memcpy(allocation.pMappedMemory, pData + chunkOffset, chunkSize);
+					allocation.pContext->CopyBuffer(allocation.pBackingResource, m_pHeap, chunkSize, allocation.Offset, pLoad->Offset + chunkOffset);
+
+					// Chunks are submitted in order on the copy queue, so the last sync point covers the whole mesh
+					pLoad->Sync = m_pStagingBuffer->Free(allocation);
+				}
+				pLoad->IsCopied = true;
+			}, m_TaskContext);
+	}
+}
+
+void GeometryStreamer::DrawImGui()
+{
+	const GeometryResidency::Stats& stats = m_Residency.GetStats();
+	const GeometryHeapAllocator& allocator = m_Residency.GetAllocator();
+
+	ImGui::SliderInt("Geometry Budget (MB)", &Tweakables::gGeometryBudget.Get(), 0, Tweakables::gGeometryHeapSize.Get());
+	ImGui::SliderInt("Upload Limit (MB/frame)", &Tweakables::gGeometryUploadLimit.Get(), 1, 128);
+	ImGui::Text("Streamed Meshes: %d (%d resident, %d loading)", m_Residency.GetNumMeshes(), stats.NumResident, stats.NumLoading);
+	ImGui::Text("Visible: %d (%d on fallback)", stats.NumVisible, stats.NumVisibleFallback);
+	ImGui::Text("Heap: %s of %s (%s retiring, largest free %s)",
+		Math::PrettyPrintDataSize(stats.ResidentSize).c_str(),
+		Math::PrettyPrintDataSize(allocator.GetSize()).c_str(),
+		Math::PrettyPrintDataSize(stats.RetiringSize).c_str(),
+		Math::PrettyPrintDataSize(allocator.GetLargestFreeRange()).c_str());
+	ImGui::Text("Last Frame: %d loads (%s), %d evictions", stats.NumLoads, Math::PrettyPrintDataSize(stats.LoadedSize).c_str(), stats.NumEvictions);
+}
@@ -0,0 +1,171 @@
+#pragma once
+#include "Core/TaskQueue.h"
+#include "RHI/Fence.h"
+
+class RingBufferAllocator;
+struct GeometrySource;
+struct World;
+
+// First-fit free list allocator for ranges of the geometry heap. Adjacent free ranges are merged.
+class GeometryHeapAllocator
+{
+public:
+	static constexpr uint64 InvalidOffset = ~0ull;
+	static constexpr uint64 Alignment = 16;
+
+	void Init(uint64 size);
+	uint64 Allocate(uint64 size);
+	void Free(uint64 offset, uint64 size);
+
+	uint64 GetSize() const				{ return m_Size; }
+	uint64 GetUsedSize() const			{ return m_UsedSize; }
+	uint64 GetLargestFreeRange() const;
+
+private:
+	struct Range
+	{
+		uint64 Offset;
+		uint64 Size;
+	};
+	Array<Range>	m_FreeRanges;		///< Sorted by offset
+	uint64			m_Size		= 0;
+	uint64			m_UsedSize	= 0;
+};
+
+
+/*
+	Decides which streamed meshes are resident in the geometry heap.
+	This is CPU only, so the policy can be driven by a simulation with any budget (see bench.GeometryStreaming).
+
+	Each frame, the visible meshes are reported with a priority, usually their projected size. Update then:
+	 - Starts loading the visible meshes that are not resident, highest priority first, up to the upload limit per frame.
+	 - Makes room by evicting the resident meshes that were visible least recently. Meshes visible this frame are never evicted.
+	Evicted ranges may still be read by the GPU, so they are only reused after the caller releases them.
+*/
+class GeometryResidency
+{
+public:
+	enum class State : uint8
+	{
+		Evicted,
+		Loading,
+		Resident,
+	};
+
+	struct Load
+	{
+		uint32 Mesh;
+		uint64 Offset;
+	};
+
+	struct Eviction
+	{
+		uint32 Mesh;
+		uint64 Offset;
+		uint64 Size;
+	};
+
+	struct Stats
+	{
+		uint64 ResidentSize			= 0;	///< Loading and resident meshes
+		uint64 RetiringSize			= 0;	///< Evicted but not released yet
+		uint64 LoadedSize			= 0;	///< Started loading during the last update
+		uint32 NumResident			= 0;
+		uint32 NumLoading			= 0;
+		uint32 NumVisible			= 0;
+		uint32 NumVisibleFallback	= 0;	///< Visible meshes that render with their fallback
+		uint32 NumLoads				= 0;
+		uint32 NumEvictions			= 0;
+	};
+
+	void Init(uint64 heapSize);
+	uint32 AddMesh(uint64 size);
+
+	void BeginFrame(uint32 frame);
+	void MarkVisible(uint32 mesh, float priority);
+	// `budget` limits the size of the loading and resident meshes, `maxLoadSize` the size of the loads started per call
+	void Update(uint64 budget, uint64 maxLoadSize, Array<Load>& outLoads, Array<Eviction>& outEvictions);
+
+	void OnLoaded(uint32 mesh);
+	void Release(uint64 offset, uint64 size);
+
+	State GetState(uint32 mesh) const	{ return m_Meshes[mesh].State; }
+	uint32 GetNumMeshes() const			{ return (uint32)m_Meshes.size(); }
+	const Stats& GetStats() const		{ return m_Stats; }
+	const GeometryHeapAllocator& GetAllocator() const { return m_Allocator; }
+
+private:
+	void Evict(uint32 mesh, Array<Eviction>& outEvictions);
+
+	struct MeshState
+	{
+		uint64	Size				= 0;
+		uint64	Offset				= GeometryHeapAllocator::InvalidOffset;
+		uint32	LastVisibleFrame	= ~0u;
+		float	Priority			= 0;
+		State	State				= State::Evicted;
+	};
+
+	GeometryHeapAllocator	m_Allocator;
+	Array<MeshState>		m_Meshes;
+	Array<uint32>			m_VisibleMeshes;
+	uint32					m_Frame = 0;
+	Stats					m_Stats;
+};
+
+
+/*
+	Streams the full detail geometry of meshes in and out of a single suballocated geometry heap.
+	Streamed meshes are uploaded with a low detail fallback by the scene loader and point at their fallback while they are not resident.
+	Loads copy from the GeometrySource of the mesh in chunks through a dedicated staging ring buffer on worker threads, decoding it first when it is compressed,
+	so a mesh may be larger than the staging memory and loading never stalls the frame.
+	A mesh switches to its full geometry when all its copies have completed on the GPU.
+*/
+class GeometryStreamer
+{
+public:
+	GeometryStreamer();
+	~GeometryStreamer();
+
+	void Init(GraphicsDevice* pDevice);
+	void Shutdown();
+
+	// Waits for all loads, points all streamed meshes of the world back at their fallback and drops the heap
+	void Reset(World* pWorld);
+
+	// Registers meshes added to the world since the last frame and starts the visibility reports for this frame
+	void BeginFrame(World& world, uint32 frame);
+	void MarkVisible(uint32 meshIndex, float priority);
+	// Finishes completed loads and starts new loads and evictions. Meshes are updated in place.
+	void Update(World& world);
+
+	void DrawImGui();
+
+private:
+	struct PendingLoad
+	{
+		uint32					MeshIndex;
+		uint32					Handle;
+		uint64					Offset;
+		Ref<GeometrySource>		pSource;
+		SyncPoint				Sync;				///< Sync point of the last chunk
+		std::atomic<bool>		IsCopied = false;	///< Set by the task when all chunks are submitted
+	};
+
+	struct RetiredRange
+	{
+		SyncPoint	Sync;
+		uint64		Offset;
+		uint64		Size;
+	};
+
+	GraphicsDevice*						m_pDevice = nullptr;
+	Ref<Buffer>							m_pHeap;
+	Ref<RingBufferAllocator>			m_pStagingBuffer;
+	GeometryResidency					m_Residency;
+	Array<uint32>						m_MeshFromHandle;
+	Array<uint32>						m_HandleFromMesh;		///< ~0u for meshes that are not streamed
+	Array<UniquePtr<PendingLoad>>		m_PendingLoads;
+	Array<RetiredRange>					m_RetiredRanges;
+	TaskContext							m_TaskContext;
+};
@@ -0,0 +1,187 @@
+#include "stdafx.h"
+#include "GeometryStreaming.h"
+#include "Core/Benchmark.h"
+#include "Core/Utils.h"
+
+/*
+	Simulation of the geometry residency policy with a camera flying over a large grid of streamed meshes.
+	Runs the policy at a range of budgets and reports how often visible meshes render with their fallback,
+	how much is streamed and how fragmented the heap ends up. Checks that the budget holds and no visible mesh is evicted.
+	Run from the console with "bench.GeometryStreaming".
+*/
+
+namespace GeometryStreamingBenchmark
+{
+	struct SimMesh
+	{
+		Vector3 Position;
+		float	Radius;
+		uint64	Size;
+	};
+
+	static void Run(Benchmark::Context& context)
+	{
+		constexpr uint32 gridSize = 64;
+		constexpr float gridSpacing = 40.0f;
+		constexpr uint32 numFrames = 2000;
+		constexpr uint32 copyLatency = 3;			///< Frames between starting a load and the mesh becoming resident
+		constexpr uint32 releaseLatency = 2;		///< Frames an evicted range may still be read by the GPU
+		constexpr float viewDistance = 600.0f;
+		constexpr float viewCosAngle = 0.5f;
+		constexpr uint64 uploadLimit = 32ull * 1024 * 1024;
+		constexpr uint32 budgetsMB[] = { 64, 128, 256, 512, 1024 };
+
+		uint32 seed = 0x12345678u;
+		auto Random = [&seed](float minValue, float maxValue)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				return minValue + (float)(seed >> 8) / (float)(1u << 24) * (maxValue - minValue);
+			};
+
+		Array<SimMesh> meshes(gridSize * gridSize);
+		uint64 totalSize = 0;
+		for (uint32 i = 0; i < (uint32)meshes.size(); ++i)
+		{
+			SimMesh& mesh = meshes[i];
+			mesh.Position = Vector3((i % gridSize) * gridSpacing, 0, (i / gridSize) * gridSpacing);
+			mesh.Radius = Random(2.0f, 15.0f);
+			// Mostly small meshes with a long tail of large ones
+			const float t = Random(0, 1);
+			mesh.Size = (uint64)(Math::Lerp(t * t * t, 0.25f, 16.0f) * 1024 * 1024);
+			totalSize += mesh.Size;
+		}
+
+		// The camera flies a loop around the middle of the grid
+		const Vector3 gridCenter(gridSize * gridSpacing * 0.5f, 0, gridSize * gridSpacing * 0.5f);
+		auto GetCamera = [&](uint32 frame, Vector3& outPosition, Vector3& outForward)
+			{
+				const float angle = (float)frame / numFrames * Math::PI * 2;
+				const float loopRadius = gridSize * gridSpacing * 0.35f;
+				outPosition = gridCenter + Vector3(cosf(angle), 0, sinf(angle)) * loopRadius;
+				outForward = Vector3(-sinf(angle), 0, cosf(angle));
+			};
+
+		E_LOG(Info, "Geometry streaming simulation - %d meshes (%s), %d frames, upload limit %s/frame",
+			(uint32)meshes.size(), Math::PrettyPrintDataSize(totalSize).c_str(), numFrames, Math::PrettyPrintDataSize(uploadLimit).c_str());
+		E_LOG(Info, "%10s | %12s | %12s | %10s | %10s | %12s | %12s | %12s | %10s",
+			"Budget", "Fallback %", "Max Fallback", "Loads", "Evictions", "Streamed", "Peak Used", "Largest Free", "Time (ms)");
+
+		for (uint32 budgetMB : budgetsMB)
+		{
+			const uint64 budget = (uint64)budgetMB * 1024 * 1024;
+
+			GeometryResidency residency;
+			residency.Init(budget);
+			for (const SimMesh& mesh : meshes)
+				residency.AddMesh(mesh.Size);
+
+			struct InFlight
+			{
+				uint32 Frame;
+				uint32 Mesh;
+				uint64 Offset;
+				uint64 Size;
+			};
+			Array<InFlight> pendingLoads;
+			Array<InFlight> retiredRanges;
+			Array<GeometryResidency::Load> loads;
+			Array<GeometryResidency::Eviction> evictions;
+			Array<uint32> visibleFrame(meshes.size(), ~0u);
+
+			uint64 numVisible = 0;
+			uint64 numVisibleFallback = 0;
+			float maxFallbackRatio = 0;
+			uint64 numLoads = 0;
+			uint64 numEvictions = 0;
+			uint64 streamedSize = 0;
+			uint64 peakUsedSize = 0;
+			uint32 numErrors = 0;
+
+			Utils::TimeScope timer;
+			for (uint32 frame = 0; frame < numFrames; ++frame)
+			{
+				for (uint32 i = 0; i < (uint32)pendingLoads.size();)
+				{
+					if (frame - pendingLoads[i].Frame >= copyLatency)
+					{
+						residency.OnLoaded(pendingLoads[i].Mesh);
+						std::swap(pendingLoads[i], pendingLoads.back());
+						pendingLoads.pop_back();
+					}
+					else
+					{
+						++i;
+					}
+				}
+				for (uint32 i = 0; i < (uint32)retiredRanges.size();)
+				{
+					if (frame - retiredRanges[i].Frame >= releaseLatency)
+					{
+						residency.Release(retiredRanges[i].Offset, retiredRanges[i].Size);
+						std::swap(retiredRanges[i], retiredRanges.back());
+						retiredRanges.pop_back();
+					}
+					else
+					{
+						++i;
+					}
+				}
+
+				Vector3 cameraPosition, cameraForward;
+				GetCamera(frame, cameraPosition, cameraForward);
+				residency.BeginFrame(frame);
+				for (uint32 i = 0; i < (uint32)meshes.size(); ++i)
+				{
+					const SimMesh& mesh = meshes[i];
+					Vector3 toMesh = mesh.Position - cameraPosition;
+					const float distance = toMesh.Length();
+					if (distance > viewDistance + mesh.Radius)
+						continue;
+					if (distance > mesh.Radius && toMesh.Dot(cameraForward) < viewCosAngle * distance - mesh.Radius)
+						continue;
+					residency.MarkVisible(i, mesh.Radius / Math::Max(distance, 1.0f));
+					visibleFrame[i] = frame;
+				}
+
+				loads.clear();
+				evictions.clear();
+				residency.Update(budget, uploadLimit, loads, evictions);
+
+				for (const GeometryResidency::Load& load : loads)
+				{
+					pendingLoads.push_back(InFlight{ frame, load.Mesh, load.Offset, meshes[load.Mesh].Size });
+					streamedSize += meshes[load.Mesh].Size;
+				}
+				for (const GeometryResidency::Eviction& eviction : evictions)
+				{
+					numErrors += visibleFrame[eviction.Mesh] == frame;
+					retiredRanges.push_back(InFlight{ frame, eviction.Mesh, eviction.Offset, eviction.Size });
+				}
+
+				const GeometryResidency::Stats& stats = residency.GetStats();
+				numErrors += stats.ResidentSize > budget;
+				numLoads += stats.NumLoads;
+				numEvictions += stats.NumEvictions;
+				numVisible += stats.NumVisible;
+				numVisibleFallback += stats.NumVisibleFallback;
+				if (stats.NumVisible > 0)
+					maxFallbackRatio = Math::Max(maxFallbackRatio, (float)stats.NumVisibleFallback / stats.NumVisible);
+				peakUsedSize = Math::Max(peakUsedSize, residency.GetAllocator().GetUsedSize());
+			}
+			const float time = timer.Stop() * 1000.0f;
+
+			E_LOG(Info, "%10s | %11.2f%% | %11.2f%% | %10lld | %10lld | %12s | %12s | %12s | %10.3f",
+				Math::PrettyPrintDataSize(budget).c_str(),
+				numVisible > 0 ? 100.0f * numVisibleFallback / numVisible : 0.0f,
+				100.0f * maxFallbackRatio,
+				numLoads, numEvictions,
+				Math::PrettyPrintDataSize(streamedSize).c_str(),
+				Math::PrettyPrintDataSize(peakUsedSize).c_str(),
+				Math::PrettyPrintDataSize(residency.GetAllocator().GetLargestFreeRange()).c_str(),
+				time);
+			context.Check(numErrors == 0, "%d frames exceeded the budget or evicted a visible mesh", numErrors);
+		}
+	}
+
+	static Benchmark::Command<> gBenchmarkCommand("bench.GeometryStreaming", &Run);
+}
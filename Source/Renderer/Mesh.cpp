@@ -33,3 +33,43 @@ Vector4 AnimationChannel::Evaluate(float time) const
 	gUnreachable();
 	return Vector4::Zero;
 }
+
+
+void Mesh::SetGeometry(Buffer* pGeometryBuffer, uint64 offset, const CookedMesh& layout)
+{
+	auto GetStreamView = [&](const CookedStream& stream)
+		{
+			if (stream.Stride == 0)
+				return VertexBufferView();
+			return VertexBufferView(pGeometryBuffer->GetGpuHandle() + offset + stream.Offset, stream.NumElements, stream.Stride, offset + stream.Offset);
+		};
+
+	Bounds = layout.Bounds;
+	PositionsFormat = layout.PositionsFormat;
+	QuantizationBounds = layout.QuantizationBounds;
+	PositionsTransformLocation = layout.PositionsFormat == ResourceFormat::RGBA16_SNORM ? pGeometryBuffer->GetGpuHandle() + offset + layout.PositionsTransformOffset : 0;
+	PositionStreamLocation			= GetStreamView(layout.Positions);
+	SkinnedPositionStreamLocation	= GetStreamView(layout.SkinnedPositions);
+	NormalStreamLocation			= GetStreamView(layout.Normals);
+	SkinnedNormalStreamLocation		= GetStreamView(layout.SkinnedNormals);
+	ColorsStreamLocation			= GetStreamView(layout.Colors);
+	UVStreamLocation				= GetStreamView(layout.UVs);
+	JointsStreamLocation			= GetStreamView(layout.Joints);
+	WeightsStreamLocation			= GetStreamView(layout.Weights);
+
+	const CookedStream& indices = layout.Indices;
+	IndicesLocation = IndexBufferView(pGeometryBuffer->GetGpuHandle() + offset + indices.Offset, indices.NumElements, indices.Stride == sizeof(uint16) ? ResourceFormat::R16_UINT : ResourceFormat::R32_UINT, offset + indices.Offset);
+
+	MeshletsLocation			= (uint32)(offset + layout.MeshletsOffset);
+	MeshletVerticesLocation		= (uint32)(offset + layout.MeshletVerticesOffset);
+	MeshletTrianglesLocation	= (uint32)(offset + layout.MeshletTrianglesOffset);
+	MeshletBoundsLocation		= (uint32)(offset + layout.MeshletBoundsOffset);
+	MeshletVertexStride			= layout.MeshletVertexStride;
+	NumMeshlets					= layout.NumMeshlets;
+
+	pBuffer = pGeometryBuffer;
+
+	// Ray tracing fetches attributes with the primitive index of the BLAS, which only matches the geometry it was built from
+	pBLAS = nullptr;
+	pBLASScratch = nullptr;
+}
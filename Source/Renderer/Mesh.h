@@ -2,6 +2,8 @@
 
 #include "RHI/RHI.h"
 #include "RHI/Buffer.h"
+#include "Core/Stream.h"
+#include "Renderer/MeshletLOD.h"
 
 struct JointTransform
 {
@@ -85,11 +87,81 @@ struct Material
 };
 
 
+// A vertex or index stream inside a cooked geometry buffer. Stride is 0 when the stream is absent.
+struct CookedStream
+{
+	uint32 Offset = 0;
+	uint32 NumElements = 0;
+	uint32 Stride = 0;
+};
+
+// Layout of a mesh in its geometry buffer, exactly as it is uploaded to the GPU.
+// This is stored as-is in the mesh cache, so it must remain trivially copyable.
+struct CookedMesh
+{
+	uint64 BufferSize = 0;
+	BoundingBox Bounds;
+
+	// Quantized positions are RGBA16_SNORM relative to QuantizationBounds: position = Center + value * Extents
+	ResourceFormat PositionsFormat = ResourceFormat::RGB32_FLOAT;
+	BoundingBox QuantizationBounds;
+	uint32 PositionsTransformOffset = 0;	///< 3x4 matrix applying QuantizationBounds, for BLAS builds. Only with quantized positions
+
+	CookedStream Positions;
+	CookedStream SkinnedPositions;
+	CookedStream Normals;
+	CookedStream SkinnedNormals;
+	CookedStream Colors;
+	CookedStream UVs;
+	CookedStream Joints;
+	CookedStream Weights;
+	CookedStream Indices;
+
+	uint32 MeshletsOffset = 0;
+	uint32 MeshletVerticesOffset = 0;
+	uint32 MeshletTrianglesOffset = 0;
+	uint32 MeshletBoundsOffset = 0;
+	uint32 MeshletVertexStride = sizeof(uint32);	///< 16-bit when the mesh has small indices and is compressed
+	uint32 NumMeshlets = 0;			///< Meshlets of the full detail mesh
+};
+static_assert(std::is_trivially_copyable_v<CookedMesh>);
+
+
+// Cooked geometry that streamed meshes page their data from.
+// Either a memory mapped mesh cache file shared by all meshes of a scene, or an in-memory copy when there is no cache.
+struct GeometrySource : public RefCounted<GeometrySource>
+{
+	const uint8* GetData() const { return File.IsOpen() ? static_cast<const uint8*>(File.GetData()) : Memory.data(); }
+
+	MappedFile File;
+	Array<uint8> Memory;
+};
+
+// Full detail geometry of a mesh that is streamed in by the GeometryStreamer.
+// Until it is resident, the mesh renders with the low detail fallback.
+struct MeshStreamingData
+{
+	Ref<GeometrySource> pSource;
+	uint64				SourceOffset = 0;	///< Offset of the full detail geometry in pSource
+	uint64				SourceSize = 0;		///< Size of the encoded geometry in pSource (see MeshCompression). 0 when it is stored raw
+	CookedMesh			Full;
+	CookedMesh			Fallback;
+	Ref<Buffer>			pFallbackBuffer;	///< Always resident
+};
+
+
 struct Mesh
 {
 	bool IsAnimated() const { return SkinnedPositionStreamLocation.IsValid(); }
+	bool IsStreamed() const { return Streaming.pSource != nullptr; }
+
+	// Points the streams and meshlets at geometry with the given layout, placed at `offset` in pBuffer.
+	// Drops the BLAS, so it is rebuilt from the new geometry.
+	void SetGeometry(Buffer* pBuffer, uint64 offset, const CookedMesh& layout);
 
 	ResourceFormat PositionsFormat = ResourceFormat::RGB32_FLOAT;
+	BoundingBox QuantizationBounds;
+	D3D12_GPU_VIRTUAL_ADDRESS PositionsTransformLocation = 0;	///< 0 when positions are not quantized
 	VertexBufferView PositionStreamLocation;
 	VertexBufferView SkinnedPositionStreamLocation;
 	VertexBufferView UVStreamLocation;
@@ -105,13 +177,17 @@ struct Mesh
 	uint32 MeshletVerticesLocation;
 	uint32 MeshletTrianglesLocation;
 	uint32 MeshletBoundsLocation;
+	uint32 MeshletVertexStride;
 	uint32 NumMeshlets;
+	Array<MeshletLOD::Node> MeshletLODs;	///< One per meshlet in the geometry buffer, CPU-side only. Empty without scene.MeshletLOD
 
 	BoundingBox Bounds;
 
 	Ref<Buffer> pBuffer;
 	Ref<Buffer> pBLASScratch;
 	Ref<Buffer> pBLAS;
+
+	MeshStreamingData Streaming;
 };
 
 struct Model
@@ -0,0 +1,148 @@
+#include "stdafx.h"
+#include "MeshCompression.h"
+#include "Renderer/Mesh.h"
+#include "ShaderInterop.h"
+#include <meshoptimizer.h>
+
+namespace MeshCompression
+{
+	// A range of the geometry buffer that is encoded with a single codec and element size
+	struct Section
+	{
+		uint32	Offset;
+		uint32	Size			= 0;	///< Up to the next section, including padding
+		uint32	ElementSize;			///< 0 to store the section as is
+		uint32	NumElements		= 0;	///< Elements covered by the codec, the remaining bytes of the section are stored as is
+		bool	IsIndices		= false;
+	};
+
+	static void GetSections(const CookedMesh& mesh, Array<Section>& outSections)
+	{
+		auto AddStream = [&](const CookedStream& stream)
+			{
+				if (stream.Stride > 0)
+					outSections.push_back(Section{ .Offset = stream.Offset, .ElementSize = stream.Stride });
+			};
+		AddStream(mesh.Positions);
+		AddStream(mesh.SkinnedPositions);
+		AddStream(mesh.Normals);
+		AddStream(mesh.SkinnedNormals);
+		AddStream(mesh.Colors);
+		AddStream(mesh.UVs);
+		AddStream(mesh.Joints);
+		AddStream(mesh.Weights);
+		if (mesh.Indices.Stride > 0)
+			outSections.push_back(Section{ .Offset = mesh.Indices.Offset, .ElementSize = mesh.Indices.Stride, .NumElements = mesh.Indices.NumElements, .IsIndices = true });
+
+		outSections.push_back(Section{ .Offset = mesh.MeshletsOffset,			.ElementSize = sizeof(ShaderInterop::Meshlet) });
+		outSections.push_back(Section{ .Offset = mesh.MeshletVerticesOffset,	.ElementSize = mesh.MeshletVertexStride });
+		outSections.push_back(Section{ .Offset = mesh.MeshletTrianglesOffset,	.ElementSize = sizeof(ShaderInterop::Meshlet::Triangle) });
+		outSections.push_back(Section{ .Offset = mesh.MeshletBoundsOffset,		.ElementSize = sizeof(ShaderInterop::Meshlet::Bounds) });
+		if (mesh.PositionsFormat == ResourceFormat::RGBA16_SNORM)
+			outSections.push_back(Section{ .Offset = mesh.PositionsTransformOffset, .ElementSize = 0 });
+
+		std::stable_sort(outSections.begin(), outSections.end(), [](const Section& a, const Section& b) { return a.Offset < b.Offset; });
+		if (outSections.front().Offset > 0)
+			outSections.insert(outSections.begin(), Section{ .Offset = 0, .ElementSize = 0 });
+
+		for (uint32 i = 0; i < (uint32)outSections.size(); ++i)
+		{
+			Section& section = outSections[i];
+			const uint64 end = i + 1 < (uint32)outSections.size() ? outSections[i + 1].Offset : mesh.BufferSize;
+			section.Size = (uint32)(end - section.Offset);
+			if (section.IsIndices)
+			{
+				gAssert((uint64)section.NumElements * section.ElementSize <= section.Size);
+			}
+			else if (section.ElementSize > 0)
+			{
+				// The vertex codec works on multiples of 4 bytes. 16-bit meshlet vertices are encoded in pairs.
+				section.ElementSize = Math::AlignUp<uint32>(section.ElementSize, 4);
+				section.NumElements = section.Size / section.ElementSize;
+			}
+		}
+	}
+
+	uint64 Encode(const CookedMesh& mesh, const uint8* pData, Array<uint8>& outData)
+	{
+		Array<Section> sections;
+		GetSections(mesh, sections);
+
+		const uint64 start = outData.size();
+		Array<uint32> indices;
+		for (const Section& section : sections)
+		{
+			const uint8* pSection = pData + section.Offset;
+			const uint32 encodedBytes = section.NumElements * section.ElementSize;
+
+			uint32 encodedSize = 0;
+			const uint64 sizeOffset = outData.size();
+			outData.resize(sizeOffset + sizeof(uint32));
+			if (section.NumElements > 0)
+			{
+				if (section.IsIndices)
+				{
+					indices.resize(section.NumElements);
+					for (uint32 i = 0; i < section.NumElements; ++i)
+					{
+						uint32 index = 0;
+						memcpy(&index, pSection + i * section.ElementSize, section.ElementSize);
+						indices[i] = index;
+					}
+					const size_t bound = meshopt_encodeIndexBufferBound(indices.size(), mesh.Positions.NumElements);
+					outData.resize(sizeOffset + sizeof(uint32) + bound);
+					encodedSize = (uint32)meshopt_encodeIndexBuffer(&outData[sizeOffset + sizeof(uint32)], bound, indices.data(), indices.size());
+				}
+				else
+				{
+					const size_t bound = meshopt_encodeVertexBufferBound(section.NumElements, section.ElementSize);
+					outData.resize(sizeOffset + sizeof(uint32) + bound);
+					encodedSize = (uint32)meshopt_encodeVertexBuffer(&outData[sizeOffset + sizeof(uint32)], bound, pSection, section.NumElements, section.ElementSize);
+				}
+				gAssert(encodedSize > 0);
+			}
+			memcpy(&outData[sizeOffset], &encodedSize, sizeof(uint32));
+			outData.resize(sizeOffset + sizeof(uint32) + encodedSize);
+			outData.insert(outData.end(), pSection + encodedBytes, pSection + section.Size);
+		}
+		return outData.size() - start;
+	}
+
+	bool Decode(const CookedMesh& mesh, const uint8* pEncoded, uint64 encodedSize, uint8* pOutData)
+	{
+		Array<Section> sections;
+		GetSections(mesh, sections);
+
+		const uint8* pRead = pEncoded;
+		const uint8* pEnd = pEncoded + encodedSize;
+		for (const Section& section : sections)
+		{
+			uint32 size;
+			if (pEnd - pRead < (int64)sizeof(uint32))
+				return false;
+			memcpy(&size, pRead, sizeof(uint32));
+			pRead += sizeof(uint32);
+			if (pEnd - pRead < (int64)size)
+				return false;
+
+			uint8* pSection = pOutData + section.Offset;
+			if (section.NumElements > 0)
+			{
+				const int result = section.IsIndices ?
+					meshopt_decodeIndexBuffer(pSection, section.NumElements, section.ElementSize, pRead, size) :
+					meshopt_decodeVertexBuffer(pSection, section.NumElements, section.ElementSize, pRead, size);
+				if (result != 0)
+					return false;
+			}
+			pRead += size;
+
+			const uint32 decodedBytes = section.NumElements * section.ElementSize;
+			const uint32 rawSize = section.Size - decodedBytes;
+			if (pEnd - pRead < (int64)rawSize)
+				return false;
+			memcpy(pSection + decodedBytes, pRead, rawSize);
+			pRead += rawSize;
+		}
+		return pRead == pEnd;
+	}
+}
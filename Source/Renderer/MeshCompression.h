@@ -0,0 +1,21 @@
+#pragma once
+
+struct CookedMesh;
+
+/*
+	Lossless compression of cooked geometry buffers with the meshoptimizer vertex and index codecs, used by the mesh cache.
+
+	The buffer is split in its streams and each stream is encoded on its own, so the codecs see elements of a single type:
+	 - Indices use the index codec, which relies on the vertex cache order BuildMeshData leaves them in.
+	 - All other streams, including the meshlet data, use the vertex codec. It encodes byte deltas between consecutive
+	   elements, so it compresses quantized streams much better than floats.
+	Padding between streams is stored as is. The decoder selects its SIMD implementation for the CPU at runtime.
+*/
+namespace MeshCompression
+{
+	// Appends the encoded geometry buffer to `outData` and returns the encoded size
+	uint64 Encode(const CookedMesh& mesh, const uint8* pData, Array<uint8>& outData);
+
+	// Decodes into `pOutData`, which must hold mesh.BufferSize bytes. Returns false when the encoded data is invalid.
+	bool Decode(const CookedMesh& mesh, const uint8* pEncoded, uint64 encodedSize, uint8* pOutData);
+}
@@ -0,0 +1,243 @@
+#include "stdafx.h"
+#include "MeshletLOD.h"
+#include <meshoptimizer.h>
+
+namespace MeshletLOD
+{
+	// Merging 4 meshlets and halving their triangles gives about 2 meshlets per group on the next level
+	static constexpr uint32 GroupSize = 4;
+	// Groups that do not simplify below this fraction of their triangles are not simplified further and stay roots
+	static constexpr float MaxSimplifyRatio = 0.85f;
+	static constexpr uint32 MaxLevels = 32;
+
+	// The vertices referenced by a part of the mesh, so meshoptimizer works on the size of a group instead of the whole mesh
+	struct LocalMesh
+	{
+		Array<uint32>	Vertices;		///< Index in the mesh of each local vertex
+		Array<Vector3>	Positions;
+		Array<uint32>	Indices;
+	};
+
+	static void MakeLocal(Span<const Vector3> positions, Span<const uint32> indices, LocalMesh& outMesh)
+	{
+		outMesh.Vertices.assign(indices.begin(), indices.end());
+		std::sort(outMesh.Vertices.begin(), outMesh.Vertices.end());
+		outMesh.Vertices.erase(std::unique(outMesh.Vertices.begin(), outMesh.Vertices.end()), outMesh.Vertices.end());
+
+		outMesh.Positions.resize(outMesh.Vertices.size());
+		for (uint32 i = 0; i < (uint32)outMesh.Vertices.size(); ++i)
+			outMesh.Positions[i] = positions[outMesh.Vertices[i]];
+
+		outMesh.Indices.resize(indices.GetSize());
+		for (uint32 i = 0; i < indices.GetSize(); ++i)
+			outMesh.Indices[i] = (uint32)(std::lower_bound(outMesh.Vertices.begin(), outMesh.Vertices.end(), indices[i]) - outMesh.Vertices.begin());
+	}
+
+	// Splits the triangles of a local mesh into meshlets, with indices into the vertices of the whole mesh
+	static void Split(const LocalMesh& mesh, Span<const uint32> indices, uint32 maxVertices, uint32 maxTriangles, Array<Array<uint32>>& outClusters)
+	{
+		const size_t maxMeshlets = meshopt_buildMeshletsBound(indices.GetSize(), maxVertices, maxTriangles);
+		Array<meshopt_Meshlet> meshlets(maxMeshlets);
+		Array<uint32> meshletVertices(maxMeshlets * maxVertices);
+		Array<uint8> meshletTriangles(maxMeshlets * maxTriangles * 3);
+		const size_t numMeshlets = meshopt_buildMeshlets(meshlets.data(), meshletVertices.data(), meshletTriangles.data(),
+			indices.GetData(), indices.GetSize(), &mesh.Positions[0].x, mesh.Positions.size(), sizeof(Vector3), maxVertices, maxTriangles, 0);
+
+		for (size_t i = 0; i < numMeshlets; ++i)
+		{
+			const meshopt_Meshlet& meshlet = meshlets[i];
+			Array<uint32>& clusterIndices = outClusters.emplace_back(meshlet.triangle_count * 3);
+			for (uint32 k = 0; k < meshlet.triangle_count * 3; ++k)
+				clusterIndices[k] = mesh.Vertices[meshletVertices[meshlet.vertex_offset + meshletTriangles[meshlet.triangle_offset + k]]];
+		}
+	}
+
+	// Greedily groups clusters with the unassigned neighbours they share the most vertices with
+	static void Partition(const Array<Cluster>& clusters, Span<const uint32> pending, Span<const uint32> positionRemap, Array<Array<uint32>>& outGroups)
+	{
+		struct Neighbour
+		{
+			uint32 Cluster;
+			uint32 NumShared;
+		};
+		auto AddShared = [](Array<Neighbour>& neighbours, uint32 cluster, uint32 numShared)
+			{
+				for (Neighbour& neighbour : neighbours)
+				{
+					if (neighbour.Cluster == cluster)
+					{
+						neighbour.NumShared += numShared;
+						return;
+					}
+				}
+				neighbours.push_back(Neighbour{ cluster, numShared });
+			};
+
+		// Pairs of (vertex, cluster), sorted by vertex, to find the clusters sharing each vertex
+		Array<std::pair<uint32, uint32>> vertexClusters;
+		for (uint32 i = 0; i < pending.GetSize(); ++i)
+		{
+			for (uint32 index : clusters[pending[i]].Indices)
+				vertexClusters.emplace_back(positionRemap[index], i);
+		}
+		std::sort(vertexClusters.begin(), vertexClusters.end());
+		vertexClusters.erase(std::unique(vertexClusters.begin(), vertexClusters.end()), vertexClusters.end());
+
+		Array<Array<Neighbour>> neighbours(pending.GetSize());
+		for (size_t first = 0; first < vertexClusters.size();)
+		{
+			size_t last = first + 1;
+			while (last < vertexClusters.size() && vertexClusters[last].first == vertexClusters[first].first)
+				++last;
+			for (size_t a = first; a < last; ++a)
+			{
+				for (size_t b = first; b < last; ++b)
+				{
+					if (a != b)
+						AddShared(neighbours[vertexClusters[a].second], vertexClusters[b].second, 1);
+				}
+			}
+			first = last;
+		}
+
+		Array<bool> isAssigned(pending.GetSize(), false);
+		Array<Neighbour> candidates;
+		for (uint32 seed = 0; seed < pending.GetSize(); ++seed)
+		{
+			if (isAssigned[seed])
+				continue;
+
+			Array<uint32> group{ seed };
+			isAssigned[seed] = true;
+			while (group.size() < GroupSize)
+			{
+				candidates.clear();
+				for (uint32 member : group)
+				{
+					for (const Neighbour& neighbour : neighbours[member])
+					{
+						if (!isAssigned[neighbour.Cluster])
+							AddShared(candidates, neighbour.Cluster, neighbour.NumShared);
+					}
+				}
+				if (candidates.empty())
+					break;
+
+				const Neighbour& best = *std::max_element(candidates.begin(), candidates.end(), [](const Neighbour& a, const Neighbour& b) { return a.NumShared < b.NumShared; });
+				group.push_back(best.Cluster);
+				isAssigned[best.Cluster] = true;
+			}
+
+			Array<uint32>& outGroup = outGroups.emplace_back();
+			for (uint32 member : group)
+				outGroup.push_back(pending[member]);
+		}
+	}
+
+	void Build(Span<const Vector3> positions, Span<const uint32> indices, uint32 maxVertices, uint32 maxTriangles, Hierarchy& outHierarchy)
+	{
+		outHierarchy.Clusters.clear();
+		outHierarchy.NumLevels = 0;
+		if (indices.GetSize() == 0)
+			return;
+
+		// Vertices at the same position are the same vertex when looking for neighbours, so attribute seams do not separate clusters
+		Array<uint32> positionRemap(positions.GetSize());
+		meshopt_generateVertexRemap(positionRemap.data(), nullptr, positions.GetSize(), positions.GetData(), positions.GetSize(), sizeof(Vector3));
+
+		auto AddClusters = [&](Array<Array<uint32>>& clusters, uint32 level, const Vector4* pBounds, float error, Array<uint32>& outPending)
+			{
+				for (Array<uint32>& clusterIndices : clusters)
+				{
+					Cluster& cluster = outHierarchy.Clusters.emplace_back();
+					cluster.Indices = std::move(clusterIndices);
+					cluster.Level = level;
+					cluster.Error = error;
+					if (pBounds)
+					{
+						cluster.Bounds = *pBounds;
+					}
+					else
+					{
+						meshopt_Bounds bounds = meshopt_computeClusterBounds(cluster.Indices.data(), cluster.Indices.size(), &positions[0].x, positions.GetSize(), sizeof(Vector3));
+						cluster.Bounds = Vector4(bounds.center[0], bounds.center[1], bounds.center[2], bounds.radius);
+					}
+					cluster.ParentBounds = cluster.Bounds;
+					outPending.push_back((uint32)outHierarchy.Clusters.size() - 1);
+				}
+				clusters.clear();
+			};
+
+		Array<uint32> pending;
+		Array<Array<uint32>> newClusters;
+		LocalMesh localMesh;
+		{
+			MakeLocal(positions, indices, localMesh);
+			Split(localMesh, localMesh.Indices, maxVertices, maxTriangles, newClusters);
+			AddClusters(newClusters, 0, nullptr, 0.0f, pending);
+		}
+		outHierarchy.NumLevels = 1;
+
+		Array<Array<uint32>> groups;
+		Array<uint32> groupIndices;
+		Array<uint32> simplified;
+		Array<uint32> nextPending;
+		for (uint32 level = 1; level < MaxLevels && pending.size() > 1; ++level)
+		{
+			groups.clear();
+			Partition(outHierarchy.Clusters, pending, positionRemap, groups);
+
+			nextPending.clear();
+			for (const Array<uint32>& group : groups)
+			{
+				groupIndices.clear();
+				for (uint32 cluster : group)
+				{
+					const Array<uint32>& clusterIndices = outHierarchy.Clusters[cluster].Indices;
+					groupIndices.insert(groupIndices.end(), clusterIndices.begin(), clusterIndices.end());
+				}
+
+				// Locking the border of the group keeps it watertight with its neighbours, whichever level they are drawn at
+				MakeLocal(positions, groupIndices, localMesh);
+				const size_t targetIndexCount = (localMesh.Indices.size() / 6) * 3;
+				simplified.resize(localMesh.Indices.size());
+				float simplifyError = 0;
+				const size_t indexCount = meshopt_simplify(simplified.data(), localMesh.Indices.data(), localMesh.Indices.size(), &localMesh.Positions[0].x, localMesh.Positions.size(), sizeof(Vector3),
+					targetIndexCount, FLT_MAX, meshopt_SimplifyLockBorder, &simplifyError);
+				if (indexCount == 0 || indexCount > localMesh.Indices.size() * MaxSimplifyRatio)
+					continue;
+				simplified.resize(indexCount);
+
+				// The group error includes the error of its clusters and the group bounds contain theirs, so both grow towards the roots
+				float groupError = 0;
+				DirectX::BoundingSphere groupSphere;
+				for (uint32 i = 0; i < (uint32)group.size(); ++i)
+				{
+					const Cluster& cluster = outHierarchy.Clusters[group[i]];
+					const DirectX::BoundingSphere sphere(Vector3(cluster.Bounds.x, cluster.Bounds.y, cluster.Bounds.z), cluster.Bounds.w);
+					if (i == 0)
+						groupSphere = sphere;
+					else
+						DirectX::BoundingSphere::CreateMerged(groupSphere, groupSphere, sphere);
+					groupError = Math::Max(groupError, cluster.Error);
+				}
+				groupError += simplifyError * meshopt_simplifyScale(&localMesh.Positions[0].x, localMesh.Positions.size(), sizeof(Vector3));
+				const Vector4 groupBounds(groupSphere.Center.x, groupSphere.Center.y, groupSphere.Center.z, groupSphere.Radius);
+
+				for (uint32 cluster : group)
+				{
+					outHierarchy.Clusters[cluster].ParentBounds = groupBounds;
+					outHierarchy.Clusters[cluster].ParentError = groupError;
+				}
+
+				Split(localMesh, simplified, maxVertices, maxTriangles, newClusters);
+				AddClusters(newClusters, level, &groupBounds, groupError, nextPending);
+			}
+
+			if (nextPending.empty())
+				break;
+			outHierarchy.NumLevels = level + 1;
+			std::swap(pending, nextPending);
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+/*
+	Builds a hierarchy of meshlet LODs (a cluster DAG) for a mesh.
+
+	Level 0 are the meshlets of the full detail mesh. Each following level is built from the previous one:
+	 - Meshlets are grouped with the neighbours they share the most vertices with.
+	 - Each group is merged and simplified to half its triangles, with the border of the group locked.
+	 - The simplified group is split into new meshlets again.
+	Because group borders are locked, any cut through the hierarchy gives a crack free mesh as long as
+	each group is either drawn with all its meshlets or all its simplified meshlets.
+
+	Each meshlet gets the error of the simplification that produced it and the error of the group it was simplified into (its parent).
+	Errors are in mesh space and grow monotonically towards the roots, as do the bounding spheres they are measured from.
+	For a screen space error threshold, a meshlet is part of the cut when its own error is small enough and its parent error is not.
+
+	Scenes cooked with scene.MeshletLOD keep a Node per meshlet on the CPU (Mesh::MeshletLODs) and in the mesh cache.
+	Nothing selects a cut at runtime yet, so the nodes are not uploaded.
+*/
+namespace MeshletLOD
+{
+	struct Cluster
+	{
+		Array<uint32>	Indices;					///< Triangle list into the vertices of the mesh
+		Vector4			Bounds;						///< xyz: Center, w: Radius. Bounds the error of this cluster
+		Vector4			ParentBounds;
+		float			Error			= 0;
+		float			ParentError		= FLT_MAX;	///< FLT_MAX for roots of the hierarchy
+		uint32			Level			= 0;
+	};
+
+	// Error and bounds of a meshlet in the hierarchy, without its geometry.
+	// Stored as-is in the mesh cache, so it must remain trivially copyable.
+	struct Node
+	{
+		Vector4			Bounds;
+		Vector4			ParentBounds;
+		float			Error			= 0;
+		float			ParentError		= FLT_MAX;
+	};
+	static_assert(std::is_trivially_copyable_v<Node>);
+
+	struct Hierarchy
+	{
+		Array<Cluster>	Clusters;		///< Sorted by level. Level 0 is the full detail mesh
+		uint32			NumLevels = 0;
+	};
+
+	void Build(Span<const Vector3> positions, Span<const uint32> indices, uint32 maxVertices, uint32 maxTriangles, Hierarchy& outHierarchy);
+
+	// Returns true when the cluster is part of the cut of the hierarchy for the given error threshold in mesh space
+	inline bool IsInCut(float error, float parentError, float threshold) { return error <= threshold && parentError > threshold; }
+}
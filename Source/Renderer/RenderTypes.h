@@ -60,7 +60,7 @@ struct ViewTransform
 	}
 };
 
-using VisibilityMask = BitField<8192>;
+using VisibilityMask = DynamicBitField;
 
 
 struct RenderView : ViewTransform
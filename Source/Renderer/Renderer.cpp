@@ -20,6 +20,8 @@
 
 #include "Renderer/Mesh.h"
 #include "Renderer/Light.h"
+#include "Renderer/BatchSort.h"
+#include "Renderer/FrustumCulling.h"
 #include "Renderer/Techniques/DebugRenderer.h"
 #include "Renderer/Techniques/GpuParticles.h"
 #include "Renderer/Techniques/RTAO.h"
@@ -38,6 +40,7 @@
 #include "Renderer/Techniques/ImGuiRenderer.h"
 
 #include "RenderGraph/RenderGraph.h"
+#include "RenderGraph/RenderGraphReplay.h"
 
 #include "Scene/World.h"
 #include "Scene/Camera.h"
@@ -90,19 +93,32 @@ namespace Tweakables
 	// Misc
 	ConsoleVariable gVisibilityDebugMode("r.Raster.VisibilityDebug", 0);
 	ConsoleVariable gCullDebugStats("r.CullingStats", false);
+	ConsoleVariable gCullSIMD("r.CullSIMD", true);
+	ConsoleVariable gSceneDeltaUpload("r.Scene.DeltaUpload", true);
 
 	// Render Graph
 	ConsoleVariable gRenderGraphJobify("r.RenderGraph.Jobify", true);
 	ConsoleVariable gRenderGraphResourceAliasing("r.RenderGraph.Aliasing", true);
 	ConsoleVariable gRenderGraphPassCulling("r.RenderGraph.PassCulling", true);
 	ConsoleVariable gRenderGraphStateTracking("r.RenderGraph.StateTracking", true);
+	ConsoleVariable gRenderGraphSplitBarriers("r.RenderGraph.SplitBarriers", true);
+	ConsoleVariable gRenderGraphAsyncCompute("r.RenderGraph.AsyncCompute", false);
+	ConsoleVariable gRenderGraphRenderPassMerging("r.RenderGraph.RenderPassMerging", true);
 	ConsoleVariable gRenderGraphPassGroupSize("r.RenderGraph.PassGroupSize", 10);
+	ConsoleVariable gRenderGraphCompileCache("r.RenderGraph.CompileCache", true);
+	ConsoleVariable gRenderGraphCostPartitioning("r.RenderGraph.CostPartitioning", true);
+	ConsoleVariable gRenderGraphPoolBudget("r.RenderGraph.PoolBudget", 0);		///< In MB. 0 is unlimited
+	ConsoleVariable gRenderGraphPoolRetention("r.RenderGraph.PoolRetention", 5);
+	ConsoleVariable gRenderGraphBufferSizeClasses("r.RenderGraph.BufferSizeClasses", false);
 	ConsoleVariable gRenderGraphResourceTracker("r.RenderGraph.ResourceTracker", false);
 	ConsoleVariable gRenderGraphPassView("r.RenderGraph.PassView", false);
 
 	bool gDumpRenderGraphNextFrame = false;
 	ConsoleCommand<> gDumpRenderGraph("DumpRenderGraph", []() { gDumpRenderGraphNextFrame = true; });
 
+	int gBenchmarkRenderGraphFrames = 0;
+	ConsoleCommand<int> gBenchmarkRenderGraph("bench.RenderGraphCompile", [](int frames) { gBenchmarkRenderGraphFrames = frames; });
+
 	String VisualizeTextureName = "";
 	ConsoleCommand<const char*> gVisualizeTexture("vis", [](const char* pName) { VisualizeTextureName = pName; });
 }
@@ -116,6 +132,19 @@ void Renderer::Init(GraphicsDevice* pDevice, World* pWorld)
 	m_pWorld = pWorld;
 
 	m_RenderGraphPool = std::make_unique<RGResourcePool>(m_pDevice);
+	Tweakables::gDumpRenderGraphNextFrame = CommandLine::GetBool("dumprendergraph");
+	if (CommandLine::GetBool("asynccompute"))
+		Tweakables::gRenderGraphAsyncCompute = true;
+	CommandLine::GetInt("benchrendergraph", Tweakables::gBenchmarkRenderGraphFrames);
+
+	// Replay a render graph capture made with -dumprendergraph or DumpRenderGraph
+	const char* pReplayPath = nullptr;
+	if (CommandLine::GetValue("rgreplay", &pReplayPath))
+	{
+		int iterations = 0;
+		CommandLine::GetInt("rgreplayiterations", iterations, 100);
+		RGReplay::RunBenchmark(m_pDevice, pReplayPath, (uint32)Math::Max(iterations, 1));
+	}
 
 	DebugRenderer::Get()->Initialize(m_pDevice);
 	m_pShaderDebugRenderer	= std::make_unique<ShaderDebugRenderer>(m_pDevice);
@@ -140,15 +169,47 @@ void Renderer::Init(GraphicsDevice* pDevice, World* pWorld)
 	m_MainView.pRenderer	= this;
 	m_MainView.pWorld		= pWorld;
 	m_AccelerationStructure.Init(m_pDevice);
+	m_GeometryStreamer.Init(m_pDevice);
 
 	m_pLensDirtTexture = GraphicsCommon::CreateTextureFromFile(m_pDevice, "Resources/Textures/LensDirt.dds", true, "Lens Dirt");
 }
 
 void Renderer::Shutdown()
 {
+	ResetScene();
+	m_GeometryStreamer.Shutdown();
 	DebugRenderer::Get()->Shutdown();
 }
 
+void Renderer::ResetScene()
+{
+	if (m_IsTrackingScene)
+	{
+		entt::registry& registry = m_pWorld->Registry;
+		m_InstanceObserver.disconnect();
+		registry.on_construct<Model>().disconnect(this);
+		registry.on_destroy<Model>().disconnect(this);
+		registry.on_construct<Transform>().disconnect(this);
+		registry.on_destroy<Transform>().disconnect(this);
+		m_IsTrackingScene = false;
+	}
+
+	m_InstanceObserver.clear();
+	m_SceneInstances.clear();
+	m_InstanceFromEntity.clear();
+	m_Batches.clear();
+	m_BatchIndexFromInstanceID.clear();
+	m_CullBounds.Resize(0);
+	m_GeometryStreamer.Reset(m_pWorld);
+	m_BatchesDirty = true;
+	m_SceneStructureDirty = true;
+}
+
+void Renderer::OnSceneStructureChanged(entt::registry& registry, entt::entity entity)
+{
+	m_SceneStructureDirty = true;
+}
+
 void Renderer::Render(const Transform& cameraTransform, const Camera& camera, Texture* pTarget)
 {
 	uint32 w = pTarget->GetWidth();
@@ -171,6 +232,11 @@ void Renderer::Render(const Transform& cameraTransform, const Camera& camera, Te
 
 		m_pDevice->GetShaderManager()->ConditionallyReloadShaders();
 
+		RGResourcePoolOptions poolOptions;
+		poolOptions.Budget = (uint64)Math::Max(Tweakables::gRenderGraphPoolBudget.Get(), 0) * 1024 * 1024;
+		poolOptions.NumFrameRetention = (uint32)Math::Max(Tweakables::gRenderGraphPoolRetention.Get(), 0);
+		poolOptions.BufferSizeClasses = Tweakables::gRenderGraphBufferSizeClasses;
+		m_RenderGraphPool->SetOptions(poolOptions);
 		m_RenderGraphPool->Tick();
 
 		RenderPath newRenderPath = m_RenderPath;
@@ -256,52 +322,65 @@ void Renderer::Render(const Transform& cameraTransform, const Camera& camera, Te
 		const RenderView* pView = &m_MainView;
 
 		{
-			TaskContext taskContext;
-
 			{
 				PROFILE_CPU_SCOPE("Distance Sort");
 
-				// Sort
-				auto CompareSort = [this](const Batch& a, const Batch& b)
-					{
-						float aDist = Vector3::DistanceSquared(a.Bounds.Center, m_MainView.Position);
-						float bDist = Vector3::DistanceSquared(b.Bounds.Center, m_MainView.Position);
-						if (a.BlendMode != b.BlendMode)
-							return (int)a.BlendMode < (int)b.BlendMode;
-						return EnumHasAnyFlags(a.BlendMode, Batch::Blending::AlphaBlend) ? bDist < aDist : aDist < bDist;
-					};
-				std::sort(m_Batches.begin(), m_Batches.end(), CompareSort);
+				// The previous order still holds when no instance changed and the camera did not move
+				if (m_BatchesDirty || m_BatchSortPosition != m_MainView.Position)
+				{
+					BatchSort::Sort(m_Batches, m_MainView.Position);
+					m_BatchSortPosition = m_MainView.Position;
+					m_BatchesDirty = false;
+
+					m_BatchIndexFromInstanceID.resize(m_Batches.size());
+					for (uint32 i = 0; i < (uint32)m_Batches.size(); ++i)
+						m_BatchIndexFromInstanceID[m_Batches[i].InstanceID] = i;
+				}
 			}
 
-			// In Visibility Buffer mode, culling is done on the GPU.
-			if (m_RenderPath != RenderPath::Visibility && m_RenderPath != RenderPath::VisibilityDeferred)
 			{
-				TaskQueue::Execute([&](int)
-					{
-						PROFILE_CPU_SCOPE("Frustum Cull Main");
-						m_MainView.VisibilityMask.SetAll();
-						BoundingFrustum frustum = pView->PerspectiveFrustum;
-						for (const Batch& b : m_Batches)
-						{
-							m_MainView.VisibilityMask.AssignBit(b.InstanceID, frustum.Contains(b.Bounds));
-						}
-					}, taskContext);
+				PROFILE_CPU_SCOPE("Frustum Cull");
+
+				Array<RenderView*> cullViews;
+				// In Visibility Buffer mode, culling is done on the GPU.
+				if (m_RenderPath != RenderPath::Visibility && m_RenderPath != RenderPath::VisibilityDeferred)
+					cullViews.push_back(&m_MainView);
+				if (!Tweakables::gShadowsGPUCull)
+				{
+					for (ShadowView& shadowView : m_ShadowViews)
+						cullViews.push_back(&shadowView);
+				}
+
+				if (Tweakables::gCullSIMD)
+					FrustumCulling::Cull(m_CullBounds, cullViews);
+				else
+					FrustumCulling::CullScalar(m_Batches, cullViews);
 			}
-			if (!Tweakables::gShadowsGPUCull)
+
 			{
-				TaskQueue::ExecuteMany([&](TaskDistributeArgs args)
-					{
-						PROFILE_CPU_SCOPE("Frustum Cull Shadows");
-						RenderView& shadowView = m_ShadowViews[args.JobIndex];
-						shadowView.VisibilityMask.SetAll();
-						for (const Batch& b : m_Batches)
-						{
-							shadowView.VisibilityMask.AssignBit(b.InstanceID, shadowView.IsInFrustum(b.Bounds));
-						}
-					}, taskContext, (uint32)m_ShadowViews.size(), 1);
-			}
+				PROFILE_CPU_SCOPE("Geometry Streaming");
 
-			TaskQueue::Join(taskContext);
+				// Visible meshes are streamed in with a priority based on their size on screen.
+				// The main view is culled on the GPU in the Visibility render paths, so it is culled here just for streaming.
+				VisibilityMask streamingMask;
+				const VisibilityMask* pVisibility = &m_MainView.VisibilityMask;
+				if (m_RenderPath == RenderPath::Visibility || m_RenderPath == RenderPath::VisibilityDeferred)
+				{
+					streamingMask.Resize(m_CullBounds.GetCount());
+					if (m_CullBounds.GetNumWords() > 0)
+						FrustumCulling::CullWords(m_CullBounds, FrustumCulling::GetPlanes(m_MainView), streamingMask.GetData(), 0, m_CullBounds.GetNumWords());
+					pVisibility = &streamingMask;
+				}
+
+				m_GeometryStreamer.BeginFrame(*m_pWorld, m_Frame);
+				for (uint32 instanceID : *pVisibility)
+				{
+					const Batch& batch = m_Batches[m_BatchIndexFromInstanceID[instanceID]];
+					const float distance = Math::Max(Vector3::Distance(batch.Bounds.Center, m_MainView.Position), 1.0f);
+					m_GeometryStreamer.MarkVisible(m_SceneInstances[instanceID].MeshIndex, batch.Radius / distance);
+				}
+				m_GeometryStreamer.Update(*m_pWorld);
+			}
 		}
 
 		{
@@ -324,7 +403,7 @@ void Renderer::Render(const Transform& cameraTransform, const Camera& camera, Te
 			pContext->Execute();
 		}
 
-		RGGraph graph;
+		RGGraph graph(m_RenderGraphAllocator);
 
 		{
 			RG_GRAPH_SCOPE("GPU Frame", graph);
@@ -529,12 +608,12 @@ void Renderer::Render(const Transform& cameraTransform, const Camera& camera, Te
 										{
 											PROFILE_GPU_SCOPE(context.GetCommandList(), "Opaque");
 											context.SetPipelineState(m_pShadowsOpaquePSO);
-											DrawScene(context, m_Batches, view.VisibilityMask, Batch::Blending::Opaque);
+											DrawScene(context, m_Batches, m_BatchIndexFromInstanceID, view.VisibilityMask, Batch::Blending::Opaque);
 										}
 										{
 											PROFILE_GPU_SCOPE(context.GetCommandList(), "Masked");
 											context.SetPipelineState(m_pShadowsAlphaMaskPSO);
-											DrawScene(context, m_Batches, view.VisibilityMask, Batch::Blending::AlphaMask | Batch::Blending::AlphaBlend);
+											DrawScene(context, m_Batches, m_BatchIndexFromInstanceID, view.VisibilityMask, Batch::Blending::AlphaMask | Batch::Blending::AlphaBlend);
 										}
 									});
 						}
@@ -986,7 +1065,7 @@ void Renderer::Render(const Transform& cameraTransform, const Camera& camera, Te
 									resources.GetSRV(pAverageLuminance),
 									});
 
-								context.Dispatch(1, resources.Get(pLuminanceHistogram)->GetNumElements());
+								context.Dispatch(1, pLuminanceHistogram->GetDesc().NumElements());
 							});
 				}
 			}
@@ -1178,10 +1257,67 @@ void Renderer::Render(const Transform& cameraTransform, const Camera& camera, Te
 		graphOptions.PassCulling = Tweakables::gRenderGraphPassCulling;
 		graphOptions.ResourceAliasing = Tweakables::gRenderGraphResourceAliasing;
 		graphOptions.StateTracking = Tweakables::gRenderGraphStateTracking;
+		graphOptions.SplitBarriers = Tweakables::gRenderGraphSplitBarriers;
+		graphOptions.AsyncCompute = Tweakables::gRenderGraphAsyncCompute;
+		graphOptions.RenderPassMerging = Tweakables::gRenderGraphRenderPassMerging;
 		graphOptions.CommandlistGroupSize = Tweakables::gRenderGraphPassGroupSize;
+		graphOptions.pCostModel = Tweakables::gRenderGraphCostPartitioning ? &m_RenderGraphCostModel : nullptr;
+
+		// Captures are taken before compiling, compilation modifies the graph
+		String dumpPath;
+		if (Tweakables::gDumpRenderGraphNextFrame)
+		{
+			dumpPath = Sprintf("%sRenderGraph_%s", Paths::SavedDir(), Utils::GetTimeString());
+			RGGraphCapture::Save(graph, (dumpPath + ".rgraph").c_str());
+		}
 
 		// Compile graph
-		graph.Compile(*m_RenderGraphPool, graphOptions);
+		RenderGraphCompileBenchmark& benchmark = m_RenderGraphCompileBenchmark;
+		if (Tweakables::gBenchmarkRenderGraphFrames > 0)
+		{
+			benchmark = {};
+			benchmark.NumFrames = Tweakables::gBenchmarkRenderGraphFrames;
+			Tweakables::gBenchmarkRenderGraphFrames = 0;
+			E_LOG(Info, "Benchmarking RenderGraph compile over %d cold and %d warm frames", benchmark.NumFrames, benchmark.NumFrames);
+		}
+		const bool isColdBenchmarkFrame = benchmark.NumFrames > 0 && benchmark.Frame < benchmark.NumFrames;
+
+		// A cache that isn't used for a compile could be out of date, so its resources are given back to the pool
+		RGCompileCache* pCompileCache = &m_RenderGraphCompileCache;
+		if (!Tweakables::gRenderGraphCompileCache || isColdBenchmarkFrame)
+		{
+			m_RenderGraphCompileCache.Invalidate();
+			pCompileCache = nullptr;
+		}
+
+		Utils::TimeScope compileTimer;
+		graph.Compile(*m_RenderGraphPool, graphOptions, pCompileCache);
+		float compileTime = compileTimer.Stop();
+		m_RenderGraphBarrierStats = graph.GetBarrierStats();
+		m_RenderGraphRenderPassStats = graph.GetRenderPassStats();
+
+		if (benchmark.NumFrames > 0)
+		{
+			if (isColdBenchmarkFrame)
+			{
+				benchmark.ColdTime += compileTime;
+			}
+			else if (m_RenderGraphCompileCache.WasHit())
+			{
+				// The first warm frame and frames where the graph changed are full compiles
+				benchmark.WarmTime += compileTime;
+				++benchmark.NumWarmHits;
+			}
+
+			if (++benchmark.Frame == benchmark.NumFrames * 2)
+			{
+				E_LOG(Info, "RenderGraph compile - Cold: %.3f ms - Warm: %.3f ms (%d/%d frames from cache)",
+					benchmark.ColdTime * 1000.0f / benchmark.NumFrames,
+					benchmark.NumWarmHits > 0 ? benchmark.WarmTime * 1000.0f / benchmark.NumWarmHits : 0.0f,
+					benchmark.NumWarmHits, benchmark.NumFrames);
+				benchmark = {};
+			}
+		}
 
 		// Debug options
 		graph.DrawResourceTracker(Tweakables::gRenderGraphResourceTracker.Get());
@@ -1189,12 +1325,15 @@ void Renderer::Render(const Transform& cameraTransform, const Camera& camera, Te
 
 		if (Tweakables::gDumpRenderGraphNextFrame)
 		{
-			graph.DumpDebugGraph(Sprintf("%sRenderGraph_%s", Paths::SavedDir(), Utils::GetTimeString()).c_str());
+			graph.DumpBarrierPlan(dumpPath.c_str());
+			graph.DumpSchedule(dumpPath.c_str());
+			graph.DumpDebugGraph(dumpPath.c_str());
 			Tweakables::gDumpRenderGraphNextFrame = false;
 		}
 
 		// Execute
 		graph.Execute(m_pDevice);
+		m_RenderGraphPartitionStats = graph.GetPartitionStats();
 
 	}
 
@@ -1421,51 +1560,109 @@ void Renderer::UploadSceneData(CommandContext& context)
 	const World* pWorld = m_pWorld;
 
 	GraphicsDevice* pDevice = context.GetParent();
-	auto CopyBufferData = [&](uint32 numElements, uint32 stride, const char* pName, const void* pSource, SceneBuffer& target)
+	const bool deltaUpload = Tweakables::gSceneDeltaUpload;
+	m_SceneUploadStats = {};
+
+	// Copies the given element ranges of pSource to the target buffer, packed in a single scratch allocation.
+	// Everything is uploaded when the buffer has to be (re)created.
+	auto UploadRanges = [&](uint32 numElements, uint32 stride, const char* pName, const void* pSource, Span<const SceneBufferRange> ranges, SceneBuffer& target)
 		{
+			const SceneBufferRange fullRange{ 0, numElements };
 			uint32 desiredElements = Math::AlignUp(Math::Max(1u, numElements), 8u);
 			if (!target.pBuffer || desiredElements > target.pBuffer->GetNumElements())
+			{
 				target.pBuffer = pDevice->CreateBuffer(BufferDesc::CreateStructured(desiredElements, stride, BufferFlag::ShaderResource), pName);
-			ScratchAllocation alloc = context.AllocateScratch(numElements * stride);
-			memcpy(alloc.pMappedMemory, pSource, numElements * stride);
-			context.CopyBuffer(alloc.pBackingResource, target.pBuffer, alloc.Size, alloc.Offset, 0);
+				ranges = fullRange;
+			}
 			target.Count = numElements;
+
+			uint64 uploadSize = 0;
+			for (const SceneBufferRange& range : ranges)
+				uploadSize += (uint64)range.Count * stride;
+			if (uploadSize == 0)
+				return;
+
+			ScratchAllocation alloc = context.AllocateScratch(uploadSize);
+			uint64 offset = 0;
+			for (const SceneBufferRange& range : ranges)
+			{
+				const uint64 size = (uint64)range.Count * stride;
+				memcpy((uint8*)alloc.pMappedMemory + offset, (const uint8*)pSource + (uint64)range.First * stride, size);
+				context.CopyBuffer(alloc.pBackingResource, target.pBuffer, size, alloc.Offset + offset, (uint64)range.First * stride);
+				offset += size;
+			}
+			m_SceneUploadStats.BytesUploaded += uploadSize;
+			m_SceneUploadStats.NumCopies += ranges.GetSize();
 		};
 
-	Array<Batch> sceneBatches;
-	uint32 instanceID = 0;
+	// Appends an element to a list of ranges. Elements must be added in ascending order.
+	// Gaps of up to maxGap unchanged elements are copied along to save copy commands.
+	auto AddToRanges = [](Array<SceneBufferRange>& ranges, uint32 element, uint32 maxGap)
+		{
+			if (!ranges.empty() && element <= ranges.back().First + ranges.back().Count + maxGap)
+				ranges.back().Count = element + 1 - ranges.back().First;
+			else
+				ranges.push_back(SceneBufferRange{ element, 1 });
+		};
+
+	// Uploads only the elements that differ from the CPU copy of the previous upload.
+	// Used for the small arrays that are cheap to regenerate but depend on per-frame renderer state.
+	auto UploadChanged = [&](uint32 numElements, uint32 stride, const char* pName, const void* pSource, SceneBuffer& target)
+		{
+			const uint8* pData = (const uint8*)pSource;
+			const uint32 numPrevious = (uint32)(target.Contents.size() / stride);
+
+			Array<SceneBufferRange> ranges;
+			for (uint32 i = 0; i < numElements; ++i)
+			{
+				const uint64 offset = (uint64)i * stride;
+				if (!deltaUpload || i >= numPrevious || memcmp(&target.Contents[offset], pData + offset, stride) != 0)
+					AddToRanges(ranges, i, 0);
+			}
+			target.Contents.assign(pData, pData + (uint64)numElements * stride);
+			UploadRanges(numElements, stride, pName, pSource, ranges, target);
+		};
 
 	// Instances
+	// These are persistent. Changes to Transform and Model are picked up by an observer and only the changed instances are uploaded.
+	// Adding or removing models rebuilds all instances.
 	{
-		Array<ShaderInterop::InstanceData> meshInstances;
-		meshInstances.reserve(pWorld->Registry.view<Model>().size());
+		entt::registry& registry = m_pWorld->Registry;
+		if (!m_IsTrackingScene)
+		{
+			m_InstanceObserver.connect(registry, entt::collector.update<Transform>().where<Model>().update<Model>().where<Transform>());
+			registry.on_construct<Model>().connect<&Renderer::OnSceneStructureChanged>(this);
+			registry.on_destroy<Model>().connect<&Renderer::OnSceneStructureChanged>(this);
+			registry.on_construct<Transform>().connect<&Renderer::OnSceneStructureChanged>(this);
+			registry.on_destroy<Transform>().connect<&Renderer::OnSceneStructureChanged>(this);
+			m_IsTrackingScene = true;
+			m_SceneStructureDirty = true;
+		}
+
+		auto GetBlendMode = [](MaterialAlphaMode mode) {
+			switch (mode)
+			{
+			case MaterialAlphaMode::Blend: return Batch::Blending::AlphaBlend;
+			case MaterialAlphaMode::Opaque: return Batch::Blending::Opaque;
+			case MaterialAlphaMode::Masked: return Batch::Blending::AlphaMask;
+			}
+			return Batch::Blending::Opaque;
+			};
 
-		auto view = pWorld->Registry.view<Transform, Model>();
-		view.each([&](const Transform& transform, const Model& model)
+		auto UpdateInstance = [&](uint32 instanceID, const Transform& transform, const Model& model, Batch& batch, ShaderInterop::InstanceData& meshInstance)
 			{
 				const Mesh& mesh = pWorld->Meshes[model.MeshIndex];
 				const Material& material = pWorld->Materials[model.MaterialId];
 
-				auto GetBlendMode = [](MaterialAlphaMode mode) {
-					switch (mode)
-					{
-					case MaterialAlphaMode::Blend: return Batch::Blending::AlphaBlend;
-					case MaterialAlphaMode::Opaque: return Batch::Blending::Opaque;
-					case MaterialAlphaMode::Masked: return Batch::Blending::AlphaMask;
-					}
-					return Batch::Blending::Opaque;
-					};
-
-				Batch& batch = sceneBatches.emplace_back();
 				batch.InstanceID = instanceID;
 				batch.pMesh = &mesh;
 				batch.pMaterial = &material;
 				batch.BlendMode = GetBlendMode(material.AlphaMode);
 				batch.WorldMatrix = transform.World;
+				batch.Bounds = Math::TransformBoundingBox(mesh.Bounds, batch.WorldMatrix);
 				batch.Radius = Vector3(batch.Bounds.Extents).Length();
-				mesh.Bounds.Transform(batch.Bounds, batch.WorldMatrix);
+				m_CullBounds.Set(instanceID, batch.Bounds);
 
-				ShaderInterop::InstanceData& meshInstance = meshInstances.emplace_back();
 				meshInstance.ID = instanceID;
 				meshInstance.MeshIndex = model.MeshIndex;
 				meshInstance.MaterialIndex = model.MaterialId;
@@ -1473,10 +1670,80 @@ void Renderer::UploadSceneData(CommandContext& context)
 				meshInstance.LocalToWorldPrev = transform.WorldPrev;
 				meshInstance.LocalBoundsOrigin = mesh.Bounds.Center;
 				meshInstance.LocalBoundsExtents = mesh.Bounds.Extents;
+			};
 
-				++instanceID;
-			});
-		CopyBufferData((uint32)meshInstances.size(), sizeof(ShaderInterop::InstanceData), "Instances", meshInstances.data(), m_InstanceBuffer);
+		// Instances are updated in parallel. Each job writes only its own batch, instance and cull bounds slot.
+		constexpr uint32 instancesPerJob = 256;
+		auto view = registry.view<Transform, Model>();
+
+		Array<SceneBufferRange> ranges;
+		if (m_SceneStructureDirty || !deltaUpload)
+		{
+			m_SceneStructureDirty = false;
+			m_InstanceObserver.clear();
+			m_InstanceFromEntity.clear();
+
+			Array<entt::entity> entities;
+			entities.reserve(view.size_hint());
+			for (entt::entity entity : view)
+			{
+				m_InstanceFromEntity[entity] = (uint32)entities.size();
+				entities.push_back(entity);
+			}
+
+			const uint32 numInstances = (uint32)entities.size();
+			m_Batches.resize(numInstances);
+			m_SceneInstances.resize(numInstances);
+			m_CullBounds.Resize(numInstances);
+			TaskQueue::ParallelFor(numInstances, [&](TaskDistributeArgs args)
+				{
+					const uint32 instanceID = (uint32)args.JobIndex;
+					auto [transform, model] = view.get<Transform, Model>(entities[instanceID]);
+					UpdateInstance(instanceID, transform, model, m_Batches[instanceID], m_SceneInstances[instanceID]);
+				}, instancesPerJob);
+
+			m_BatchIndexFromInstanceID.resize(numInstances);
+			for (uint32 i = 0; i < numInstances; ++i)
+				m_BatchIndexFromInstanceID[i] = i;
+
+			ranges.push_back(SceneBufferRange{ 0, numInstances });
+			m_SceneUploadStats.NumDirtyInstances = numInstances;
+			m_SceneUploadStats.FullRebuild = true;
+			m_BatchesDirty = true;
+		}
+		else
+		{
+			struct DirtyInstance
+			{
+				entt::entity Entity;
+				uint32 InstanceID;
+			};
+			Array<DirtyInstance> dirtyInstances;
+			dirtyInstances.reserve(m_InstanceObserver.size());
+			for (entt::entity entity : m_InstanceObserver)
+			{
+				auto it = m_InstanceFromEntity.find(entity);
+				if (it != m_InstanceFromEntity.end())
+					dirtyInstances.push_back(DirtyInstance{ entity, it->second });
+			}
+			m_InstanceObserver.clear();
+
+			TaskQueue::ParallelFor((uint32)dirtyInstances.size(), [&](TaskDistributeArgs args)
+				{
+					const DirtyInstance& dirty = dirtyInstances[args.JobIndex];
+					auto [transform, model] = view.get<Transform, Model>(dirty.Entity);
+					UpdateInstance(dirty.InstanceID, transform, model, m_Batches[m_BatchIndexFromInstanceID[dirty.InstanceID]], m_SceneInstances[dirty.InstanceID]);
+				}, instancesPerJob);
+
+			std::sort(dirtyInstances.begin(), dirtyInstances.end(), [](const DirtyInstance& a, const DirtyInstance& b) { return a.InstanceID < b.InstanceID; });
+			constexpr uint32 maxInstanceGap = 4;
+			for (const DirtyInstance& dirty : dirtyInstances)
+				AddToRanges(ranges, dirty.InstanceID, maxInstanceGap);
+			m_SceneUploadStats.NumDirtyInstances = (uint32)dirtyInstances.size();
+			m_BatchesDirty |= !dirtyInstances.empty();
+		}
+
+		UploadRanges((uint32)m_SceneInstances.size(), sizeof(ShaderInterop::InstanceData), "Instances", m_SceneInstances.data(), ranges, m_InstanceBuffer);
 	}
 
 	// Meshes
@@ -1499,8 +1766,13 @@ void Renderer::UploadSceneData(CommandContext& context)
 			meshData.MeshletTriangleOffset = mesh.MeshletTrianglesLocation;
 			meshData.MeshletBoundsOffset = mesh.MeshletBoundsLocation;
 			meshData.MeshletCount = mesh.NumMeshlets;
+			meshData.MeshletVertexByteSize = mesh.MeshletVertexStride;
+
+			meshData.PositionsQuantized = mesh.PositionsFormat == ResourceFormat::RGBA16_SNORM;
+			meshData.PositionsCenter = mesh.QuantizationBounds.Center;
+			meshData.PositionsExtents = mesh.QuantizationBounds.Extents;
 		}
-		CopyBufferData((uint32)meshes.size(), sizeof(ShaderInterop::MeshData), "Meshes", meshes.data(), m_MeshBuffer);
+		UploadChanged((uint32)meshes.size(), sizeof(ShaderInterop::MeshData), "Meshes", meshes.data(), m_MeshBuffer);
 	}
 
 	// Materials
@@ -1526,7 +1798,7 @@ void Renderer::UploadSceneData(CommandContext& context)
 			case MaterialAlphaMode::Masked: materialData.RasterBin = 1;				break;
 			}
 		}
-		CopyBufferData((uint32)materials.size(), sizeof(ShaderInterop::MaterialData), "Materials", materials.data(), m_MaterialBuffer);
+		UploadChanged((uint32)materials.size(), sizeof(ShaderInterop::MaterialData), "Materials", materials.data(), m_MaterialBuffer);
 	}
 
 	// DDGI
@@ -1549,7 +1821,7 @@ void Renderer::UploadSceneData(CommandContext& context)
 					ddgi.MaxRaysPerProbe = volume.MaxNumRays;
 				});
 		}
-		CopyBufferData((uint32)ddgiVolumes.size(), sizeof(ShaderInterop::DDGIVolume), "DDGI Volumes", ddgiVolumes.data(), m_DDGIVolumesBuffer);
+		UploadChanged((uint32)ddgiVolumes.size(), sizeof(ShaderInterop::DDGIVolume), "DDGI Volumes", ddgiVolumes.data(), m_DDGIVolumesBuffer);
 	}
 	// Lights
 	{
@@ -1577,7 +1849,7 @@ void Renderer::UploadSceneData(CommandContext& context)
 				data.IsSpot = light.Type == LightType::Spot;
 				data.IsDirectional = light.Type == LightType::Directional;
 			});
-		CopyBufferData((uint32)lightData.size(), sizeof(ShaderInterop::Light), "Lights", lightData.data(), m_LightBuffer);
+		UploadChanged((uint32)lightData.size(), sizeof(ShaderInterop::Light), "Lights", lightData.data(), m_LightBuffer);
 	}
 
 	// Shadow Matrices
@@ -1585,11 +1857,9 @@ void Renderer::UploadSceneData(CommandContext& context)
 		Array<Matrix> lightMatrices(m_ShadowViews.size());
 		for (uint32 i = 0; i < m_ShadowViews.size(); ++i)
 			lightMatrices[i] = m_ShadowViews[i].WorldToClip;
-		CopyBufferData((uint32)lightMatrices.size(), sizeof(Matrix), "Light Matrices", lightMatrices.data(), m_LightMatricesBuffer);
+		UploadChanged((uint32)lightMatrices.size(), sizeof(Matrix), "Light Matrices", lightMatrices.data(), m_LightMatricesBuffer);
 	}
 
-	sceneBatches.swap(m_Batches);
-
 	// View Uniform Buffers
 	{
 		Renderer::UploadViewUniforms(context, m_MainView);
@@ -1599,18 +1869,31 @@ void Renderer::UploadSceneData(CommandContext& context)
 
 void Renderer::DrawScene(CommandContext& context, const RenderView& view, Batch::Blending blendModes)
 {
-	DrawScene(context, view.pRenderer->GetBatches(), view.VisibilityMask, blendModes);
+	const Renderer* pRenderer = view.pRenderer;
+	DrawScene(context, pRenderer->m_Batches, pRenderer->m_BatchIndexFromInstanceID, view.VisibilityMask, blendModes);
 }
 
 
-void Renderer::DrawScene(CommandContext& context, Span<const Batch> batches, const VisibilityMask& visibility, Batch::Blending blendModes)
+void Renderer::DrawScene(CommandContext& context, Span<const Batch> batches, Span<const uint32> batchIndexFromInstanceID, const VisibilityMask& visibility, Batch::Blending blendModes)
 {
 	PROFILE_CPU_SCOPE();
 	PROFILE_GPU_SCOPE(context.GetCommandList());
-	gAssert(batches.GetSize() <= visibility.Size());
-	for (const Batch& b : batches)
+
+	// The mask is indexed by InstanceID. Gather the visible batch indices in a second mask so they are drawn in sorted order.
+	// Passes may be recorded on any thread, so each thread keeps its own scratch mask. Resize only allocates when it grows.
+	static thread_local VisibilityMask visibleBatches;
+	visibleBatches.Resize(batches.GetSize());
+	for (uint32 instanceID : visibility)
+	{
+		if (instanceID >= batchIndexFromInstanceID.GetSize())
+			break;
+		visibleBatches.SetBit(batchIndexFromInstanceID[instanceID]);
+	}
+
+	for (uint32 batchIndex : visibleBatches)
 	{
-		if (EnumHasAnyFlags(b.BlendMode, blendModes) && visibility.GetBit(b.InstanceID))
+		const Batch& b = batches[batchIndex];
+		if (EnumHasAnyFlags(b.BlendMode, blendModes))
 		{
 			PROFILE_CPU_SCOPE("Draw Primitive");
 			PROFILE_GPU_SCOPE(context.GetCommandList(), "Draw Pritimive");
@@ -2027,7 +2310,57 @@ void Renderer::DrawImGui()
 			ImGui::Checkbox("RenderGraph Aliasing", &Tweakables::gRenderGraphResourceAliasing.Get());
 			ImGui::Checkbox("RenderGraph Pass Culling", &Tweakables::gRenderGraphPassCulling.Get());
 			ImGui::Checkbox("RenderGraph State Tracking", &Tweakables::gRenderGraphStateTracking.Get());
+			ImGui::Checkbox("RenderGraph Split Barriers", &Tweakables::gRenderGraphSplitBarriers.Get());
+			ImGui::Checkbox("RenderGraph Async Compute", &Tweakables::gRenderGraphAsyncCompute.Get());
+			ImGui::Checkbox("RenderGraph Render Pass Merging", &Tweakables::gRenderGraphRenderPassMerging.Get());
+			ImGui::Checkbox("RenderGraph Compile Cache", &Tweakables::gRenderGraphCompileCache.Get());
+			ImGui::Checkbox("RenderGraph Cost Partitioning", &Tweakables::gRenderGraphCostPartitioning.Get());
 			ImGui::SliderInt("RenderGraph Pass Group Size", &Tweakables::gRenderGraphPassGroupSize.Get(), 5, 50);
+			ImGui::SliderInt("RenderGraph Pool Budget (MB)", &Tweakables::gRenderGraphPoolBudget.Get(), 0, 4096);
+			ImGui::SliderInt("RenderGraph Pool Retention", &Tweakables::gRenderGraphPoolRetention.Get(), 0, 60);
+			ImGui::Checkbox("RenderGraph Buffer Size Classes", &Tweakables::gRenderGraphBufferSizeClasses.Get());
+
+			const RGPoolStats& poolStats = m_RenderGraphPool->GetStats();
+			ImGui::Text("Pool Memory: %s", Math::PrettyPrintDataSize(poolStats.TotalSize).c_str());
+			ImGui::Text("Pool Frame: %d allocated (%s), %d reused (%s), %d evicted (%s)",
+				poolStats.NumAllocated, Math::PrettyPrintDataSize(poolStats.BytesAllocated).c_str(),
+				poolStats.NumReused, Math::PrettyPrintDataSize(poolStats.BytesReused).c_str(),
+				poolStats.NumEvicted, Math::PrettyPrintDataSize(poolStats.BytesEvicted).c_str());
+
+			const RGAliasingStats& aliasingStats = m_RenderGraphPool->GetAliasingStats();
+			ImGui::Text("Transient Resources: %d in %d heaps (%s)", aliasingStats.NumResources, aliasingStats.NumHeaps, Math::PrettyPrintDataSize(aliasingStats.HeapSize).c_str());
+			ImGui::Text("Aliasing Saved: %s of %s", Math::PrettyPrintDataSize(aliasingStats.GetBytesSaved()).c_str(), Math::PrettyPrintDataSize(aliasingStats.UnaliasedSize).c_str());
+
+			const RGBarrierStats& barrierStats = m_RenderGraphBarrierStats;
+			ImGui::Text("Barriers: %d (%d split) in %d batches", barrierStats.NumBarriers, barrierStats.NumSplitBarriers, barrierStats.NumBatches);
+			ImGui::Text("Unoptimized: %d in %d batches", barrierStats.NumUnoptimizedBarriers, barrierStats.NumUnoptimizedBatches);
+
+			const RGRenderPassStats& renderPassStats = m_RenderGraphRenderPassStats;
+			ImGui::Text("Render Passes: %d for %d raster passes (%d merged)", renderPassStats.NumRenderPasses, renderPassStats.NumRasterPasses, renderPassStats.NumMergedPasses);
+			ImGui::Text("Discarded Targets: %d loads, %d stores", renderPassStats.NumDiscardedLoads, renderPassStats.NumDiscardedStores);
+			ImGui::Text("Compile Cache: %d hits, %d misses", m_RenderGraphCompileCache.GetNumHits(), m_RenderGraphCompileCache.GetNumMisses());
+			ImGui::Text("Graph Memory: %s (peak %s) of %s in %d chunks",
+				Math::PrettyPrintDataSize(m_RenderGraphAllocator.GetLastSize()).c_str(),
+				Math::PrettyPrintDataSize(m_RenderGraphAllocator.GetHighWaterMark()).c_str(),
+				Math::PrettyPrintDataSize(m_RenderGraphAllocator.GetCapacity()).c_str(),
+				m_RenderGraphAllocator.GetNumChunks());
+
+			const RGPartitionStats& partitionStats = m_RenderGraphPartitionStats;
+			ImGui::Text("Commandlists: %d", partitionStats.NumGroups);
+			ImGui::Text("Imbalance: %.2f fixed, %.2f predicted, %.2f measured", partitionStats.FixedImbalance, partitionStats.PredictedImbalance, partitionStats.MeasuredImbalance);
+		}
+
+		if (ImGui::CollapsingHeader("Scene"))
+		{
+			ImGui::Checkbox("Delta Upload", &Tweakables::gSceneDeltaUpload.Get());
+
+			const SceneUploadStats& uploadStats = m_SceneUploadStats;
+			ImGui::Text("Instances: %d", (uint32)m_SceneInstances.size());
+			ImGui::Text("Uploaded: %s in %d copies", Math::PrettyPrintDataSize(uploadStats.BytesUploaded).c_str(), uploadStats.NumCopies);
+			ImGui::Text("Dirty Instances: %d%s", uploadStats.NumDirtyInstances, uploadStats.FullRebuild ? " (full rebuild)" : "");
+
+			ImGui::SeparatorText("Geometry Streaming");
+			m_GeometryStreamer.DrawImGui();
 		}
 
 		if (ImGui::CollapsingHeader("Atmosphere"))
@@ -8,8 +8,11 @@
 #include "Renderer/Techniques/ShaderDebugRenderer.h"
 #include "Renderer/Techniques/VolumetricFog.h"
 #include "Renderer/AccelerationStructure.h"
+#include "Renderer/FrustumCulling.h"
+#include "Renderer/GeometryStreaming.h"
 #include "RenderGraph/RenderGraphDefinitions.h"
 #include "RenderGraph/RenderGraph.h"
+#include "Scene/World.h"
 
 struct Transform;
 class Camera;
@@ -36,12 +39,15 @@ public:
 	void Init(GraphicsDevice* pDevice, World* pWorld);
 	void Shutdown();
 
+	// Drops the persistent scene data and stops tracking the world. Call before the world is replaced.
+	void ResetScene();
+
 	void Render(const Transform& cameraTransform, const Camera& camera, Texture* pTarget);
 	void DrawImGui();
 	void MakeScreenshot(Texture* pSource);
 
 	static void DrawScene(CommandContext& context, const RenderView& view, Batch::Blending blendModes);
-	static void DrawScene(CommandContext& context, Span<const Batch> batches, const VisibilityMask& visibility, Batch::Blending blendModes);
+	static void DrawScene(CommandContext& context, Span<const Batch> batches, Span<const uint32> batchIndexFromInstanceID, const VisibilityMask& visibility, Batch::Blending blendModes);
 	static void BindViewUniforms(CommandContext& context, const RenderView& view, RenderView::Type type = RenderView::Type::Default);
 
 	uint32 GetNumLights() const { return m_LightBuffer.Count; }
@@ -67,6 +73,7 @@ private:
 
 	void UploadViewUniforms(CommandContext& context, RenderView& view);
 	void UploadSceneData(CommandContext& context);
+	void OnSceneStructureChanged(entt::registry& registry, entt::entity entity);
 
 	void CreateShadowViews(const RenderView& mainView);
 
@@ -75,6 +82,23 @@ private:
 	/*-----------------------*/
 
 	UniquePtr<RGResourcePool>				m_RenderGraphPool;
+	RGGraphAllocator						m_RenderGraphAllocator;
+	RGCompileCache							m_RenderGraphCompileCache;		///< Holds resources of the pool, so it must be destroyed before the pool
+	RGBarrierStats							m_RenderGraphBarrierStats;
+	RGRenderPassStats						m_RenderGraphRenderPassStats;
+	RGPassCostModel							m_RenderGraphCostModel;
+	RGPartitionStats						m_RenderGraphPartitionStats;
+
+	// Compares compiling the graph without and with the compile cache. Cold frames are compiled first, then warm frames.
+	struct RenderGraphCompileBenchmark
+	{
+		uint32	NumFrames		= 0;	///< Frames per phase. 0 when not running
+		uint32	Frame			= 0;
+		float	ColdTime		= 0;
+		float	WarmTime		= 0;
+		uint32	NumWarmHits		= 0;
+	};
+	RenderGraphCompileBenchmark				m_RenderGraphCompileBenchmark;
 
 	UniquePtr<VolumetricFog>				m_pVolumetricFog;
 	VolumetricFogData						m_FogData;
@@ -105,14 +129,42 @@ private:
 	GraphicsDevice*							m_pDevice		= nullptr;
 	World*									m_pWorld		= nullptr;
 	Array<Batch>							m_Batches;
+	Array<uint32>							m_BatchIndexFromInstanceID;
+	CullBounds								m_CullBounds;
+	bool									m_BatchesDirty = true;		///< Set when instances changed since the batches were last sorted
+	Vector3									m_BatchSortPosition;
 
 	struct SceneBuffer
 	{
 		uint32		Count = 0;
 		Ref<Buffer> pBuffer;
+		Array<uint8> Contents;		///< CPU copy of the last upload, to find the elements that changed
+	};
+
+	struct SceneBufferRange
+	{
+		uint32 First;
+		uint32 Count;
 	};
 
+	struct SceneUploadStats
+	{
+		uint64 BytesUploaded		= 0;
+		uint32 NumCopies			= 0;
+		uint32 NumDirtyInstances	= 0;
+		bool FullRebuild			= false;
+	};
+
+	// Persistent scene representation, kept in sync with the world through EnTT signals
+	Array<ShaderInterop::InstanceData>		m_SceneInstances;
+	HashMap<entt::entity, uint32>			m_InstanceFromEntity;
+	entt::observer							m_InstanceObserver;
+	bool									m_IsTrackingScene = false;
+	bool									m_SceneStructureDirty = true;
+	SceneUploadStats						m_SceneUploadStats;
+
 	AccelerationStructure					m_AccelerationStructure;
+	GeometryStreamer						m_GeometryStreamer;
 	SceneBuffer								m_LightBuffer;
 	SceneBuffer								m_MaterialBuffer;
 	SceneBuffer								m_MeshBuffer;
@@ -125,7 +125,7 @@ void DDGI::Execute(RGGraph& graph, const RenderView* pView)
 							context.InsertUAVBarrier(resources.Get(pRayBuffer));
 						});
 
-				graph.AddPass("Update Irradiance", RGPassFlag::Compute)
+				graph.AddPass("Update Irradiance", RGPassFlag::Compute | RGPassFlag::AsyncCompute)
 					.Read({ pIrradianceHistory, pRayBuffer, pProbeStates })
 					.Write(pIrradianceTarget)
 					.Bind([=](CommandContext& context, const RGResources& resources)
@@ -144,7 +144,7 @@ void DDGI::Execute(RGGraph& graph, const RenderView* pView)
 							context.InsertUAVBarrier(resources.Get(pIrradianceTarget));
 						});
 
-				graph.AddPass("Update Depth", RGPassFlag::Compute)
+				graph.AddPass("Update Depth", RGPassFlag::Compute | RGPassFlag::AsyncCompute)
 					.Read({ pDepthHistory, pRayBuffer, pProbeStates })
 					.Write(pDepthTarget)
 					.Bind([=](CommandContext& context, const RGResources& resources)
@@ -165,7 +165,7 @@ void DDGI::Execute(RGGraph& graph, const RenderView* pView)
 							context.InsertUAVBarrier(resources.Get(pDepthTarget));
 						});
 
-				graph.AddPass("Update Probe States", RGPassFlag::Compute)
+				graph.AddPass("Update Probe States", RGPassFlag::Compute | RGPassFlag::AsyncCompute)
 					.Read(pRayBuffer)
 					.Write({ pProbeOffsets, pProbeStates })
 					.Bind([=](CommandContext& context, const RGResources& resources)
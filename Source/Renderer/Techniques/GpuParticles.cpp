@@ -103,7 +103,7 @@ void GpuParticles::Simulate(RGGraph& graph, const RenderView* pView, RGTexture*
 
 	if (needsInitialize)
 	{
-		graph.AddPass("Initialize", RGPassFlag::Compute)
+		graph.AddPass("Initialize", RGPassFlag::Compute | RGPassFlag::AsyncCompute)
 			.Write({ pDeadList, pCountersBuffer })
 			.Bind([=](CommandContext& context, const RGResources& resources)
 				{
@@ -129,7 +129,7 @@ void GpuParticles::Simulate(RGGraph& graph, const RenderView* pView, RGTexture*
 
 	if (g_Simulate)
 	{
-		graph.AddPass("Prepare Arguments", RGPassFlag::Compute)
+		graph.AddPass("Prepare Arguments", RGPassFlag::Compute | RGPassFlag::AsyncCompute)
 			.Read(pDepth)
 			.Write({ pCountersBuffer, pIndirectArgs })
 			.Bind([=](CommandContext& context, const RGResources& resources)
@@ -153,7 +153,7 @@ void GpuParticles::Simulate(RGGraph& graph, const RenderView* pView, RGTexture*
 					context.InsertUAVBarrier();
 				});
 
-		graph.AddPass("Emit", RGPassFlag::Compute)
+		graph.AddPass("Emit", RGPassFlag::Compute | RGPassFlag::AsyncCompute)
 			.Read({ pDepth, pIndirectArgs, pDeadList })
 			.Write({ pParticlesBuffer, pCountersBuffer, pCurrentAliveList })
 			.Bind([=](CommandContext& context, const RGResources& resources)
@@ -179,7 +179,7 @@ void GpuParticles::Simulate(RGGraph& graph, const RenderView* pView, RGTexture*
 					context.InsertUAVBarrier();
 				});
 
-		graph.AddPass("Simulate", RGPassFlag::Compute)
+		graph.AddPass("Simulate", RGPassFlag::Compute | RGPassFlag::AsyncCompute)
 			.Read({ pDepth, pIndirectArgs, pCurrentAliveList })
 			.Write({ pCountersBuffer, pDeadList, pNewAliveList, pParticlesBuffer })
 			.Bind([=](CommandContext& context, const RGResources& resources)
@@ -213,7 +213,7 @@ void GpuParticles::Simulate(RGGraph& graph, const RenderView* pView, RGTexture*
 				});
 	}
 
-	graph.AddPass("Simulate End", RGPassFlag::Compute)
+	graph.AddPass("Simulate End", RGPassFlag::Compute | RGPassFlag::AsyncCompute)
 		.Read({ pCountersBuffer })
 		.Write({ pIndirectArgs })
 		.Bind([=](CommandContext& context, const RGResources& resources)
@@ -38,7 +38,7 @@ RGTexture* SSAO::Execute(RGGraph& graph, const RenderView* pView, RGTexture* pDe
 	TextureDesc textureDesc = TextureDesc::Create2D(pDepth->GetDesc().Width, pDepth->GetDesc().Height, ResourceFormat::R8_UNORM);
 	RGTexture* pRawAmbientOcclusion = graph.Create("Raw Ambient Occlusion", textureDesc);
 
-	graph.AddPass("SSAO", RGPassFlag::Compute)
+	graph.AddPass("SSAO", RGPassFlag::Compute | RGPassFlag::AsyncCompute)
 		.Read(pDepth)
 		.Write(pRawAmbientOcclusion)
 		.Bind([=](CommandContext& context, const RGResources& resources)
@@ -71,7 +71,7 @@ RGTexture* SSAO::Execute(RGGraph& graph, const RenderView* pView, RGTexture* pDe
 
 	RGTexture* pBlurTarget = graph.Create("AO Blur", textureDesc);
 
-	graph.AddPass("Blur SSAO - Horizonal", RGPassFlag::Compute)
+	graph.AddPass("Blur SSAO - Horizonal", RGPassFlag::Compute | RGPassFlag::AsyncCompute)
 		.Read({ pRawAmbientOcclusion, pDepth })
 		.Write(pBlurTarget)
 		.Bind([=](CommandContext& context, const RGResources& resources)
@@ -103,7 +103,7 @@ RGTexture* SSAO::Execute(RGGraph& graph, const RenderView* pView, RGTexture* pDe
 
 	RGTexture* pAmbientOcclusion = graph.Create("Ambient Occlusion", textureDesc);
 
-	graph.AddPass("Blur SSAO - Vertical", RGPassFlag::Compute)
+	graph.AddPass("Blur SSAO - Vertical", RGPassFlag::Compute | RGPassFlag::AsyncCompute)
 		.Read({ pBlurTarget, pDepth })
 		.Write(pAmbientOcclusion)
 		.Bind([=](CommandContext& context, const RGResources& resources)
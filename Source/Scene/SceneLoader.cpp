@@ -8,9 +8,13 @@
 #include "Core/Paths.h"
 #include "Core/Image.h"
 #include "Core/Utils.h"
+#include "Core/ConsoleVariables.h"
+#include "Core/Benchmark.h"
 #include "ShaderInterop.h"
 #include "Renderer/Renderer.h"
 #include "Renderer/Mesh.h"
+#include "Renderer/MeshletLOD.h"
+#include "Renderer/MeshCompression.h"
 #include "Renderer/Light.h"
 #include "Core/Stream.h"
 #include "Scene/World.h"
@@ -25,7 +29,17 @@
 #include <LDraw.h>
 #include <Core/TaskQueue.h>
 
+static ConsoleVariable gMeshCache("scene.MeshCache", true);
+static ConsoleVariable gStreamGeometry("scene.StreamGeometry", true);
+static ConsoleVariable gMeshletLOD("scene.MeshletLOD", false);			///< Build the meshlet LOD hierarchy. Its nodes are kept on the CPU until the renderer selects a cut
+static ConsoleVariable gCompressMeshes("scene.CompressMeshes", false);	///< Quantize positions and meshlet vertices, and compress the mesh cache
 
+enum class MeshCacheMode
+{
+	Disabled,
+	Enabled,	///< Load from the cache, cook and write it on a miss
+	Rebuild,	///< Always cook and overwrite the cache
+};
 
 struct MeshData
 {
@@ -42,10 +56,13 @@ struct MeshData
 	Array<uint32> MeshletVertices;
 	Array<ShaderInterop::Meshlet::Triangle> MeshletTriangles;
 	Array<ShaderInterop::Meshlet::Bounds> MeshletBounds;
+	Array<MeshletLOD::Node> MeshletLODs;				///< Empty without a meshlet LOD hierarchy. Not part of the geometry buffer
+	uint32 NumFullDetailMeshlets = 0;					///< The meshlets of the full detail mesh come first
 };
 
 
-static void BuildMeshData(MeshData& meshData)
+// Optimizes the mesh and builds its meshlets. With `buildMeshletLOD`, the meshlets of all levels of the meshlet LOD hierarchy are built.
+static void BuildMeshData(MeshData& meshData, bool buildMeshletLOD = false)
 {
 	meshopt_optimizeVertexCache(meshData.Indices.data(), meshData.Indices.data(), meshData.Indices.size(), meshData.PositionsStream.size());
 	meshopt_optimizeOverdraw(meshData.Indices.data(), meshData.Indices.data(), meshData.Indices.size(), &meshData.PositionsStream[0].x, meshData.PositionsStream.size(), sizeof(Vector3), 1.05f);
@@ -62,93 +79,181 @@ static void BuildMeshData(MeshData& meshData)
 	meshopt_remapVertexBuffer(meshData.ColorsStream.data(), meshData.ColorsStream.data(), meshData.ColorsStream.size(), sizeof(Vector4), &remap[0]);
 
 	// Meshlet generation
-	const size_t maxVertices = ShaderInterop::MESHLET_MAX_VERTICES;
-	const size_t maxTriangles = ShaderInterop::MESHLET_MAX_TRIANGLES;
-	const size_t maxMeshlets = meshopt_buildMeshletsBound(meshData.Indices.size(), maxVertices, maxTriangles);
-
-	meshData.Meshlets.resize(maxMeshlets);
-	meshData.MeshletVertices.resize(maxMeshlets * maxVertices);
+	const uint32 maxVertices = ShaderInterop::MESHLET_MAX_VERTICES;
+	const uint32 maxTriangles = ShaderInterop::MESHLET_MAX_TRIANGLES;
 
-	Array<unsigned char> meshletTriangles(maxMeshlets * maxTriangles * 3);
-	Array<meshopt_Meshlet> meshlets(maxMeshlets);
+	auto AddMeshlet = [&meshData](uint32* pVertices, uint32 vertexCount, uint8* pTriangles, uint32 triangleCount)
+		{
+			meshopt_optimizeMeshlet(pVertices, pTriangles, triangleCount, vertexCount);
+
+			ShaderInterop::Meshlet& outMeshlet = meshData.Meshlets.emplace_back();
+			outMeshlet.VertexOffset = (uint32)meshData.MeshletVertices.size();
+			outMeshlet.VertexCount = vertexCount;
+			outMeshlet.TriangleOffset = (uint32)meshData.MeshletTriangles.size();
+			outMeshlet.TriangleCount = triangleCount;
+			meshData.MeshletVertices.insert(meshData.MeshletVertices.end(), pVertices, pVertices + vertexCount);
+
+			Vector3 min = Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+			Vector3 max = Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			for (uint32 triIdx = 0; triIdx < triangleCount; ++triIdx)
+			{
+				ShaderInterop::Meshlet::Triangle& tri = meshData.MeshletTriangles.emplace_back();
+				tri.V0 = pTriangles[triIdx * 3 + 0];
+				tri.V1 = pTriangles[triIdx * 3 + 1];
+				tri.V2 = pTriangles[triIdx * 3 + 2];
+				for (uint32 k = 0; k < 3; ++k)
+				{
+					const Vector3& p = meshData.PositionsStream[pVertices[pTriangles[triIdx * 3 + k]]];
+					max = Vector3::Max(max, p);
+					min = Vector3::Min(min, p);
+				}
+			}
+			ShaderInterop::Meshlet::Bounds& outBounds = meshData.MeshletBounds.emplace_back();
+			outBounds.LocalCenter = (max + min) / 2;
+			outBounds.LocalExtents = (max - min) / 2;
+		};
 
-	size_t meshlet_count = meshopt_buildMeshlets(meshlets.data(), meshData.MeshletVertices.data(), meshletTriangles.data(),
-		meshData.Indices.data(), meshData.Indices.size(), &meshData.PositionsStream[0].x, meshData.PositionsStream.size(), sizeof(Vector3), maxVertices, maxTriangles, 0);
+	if (!buildMeshletLOD)
+	{
+		const size_t maxMeshlets = meshopt_buildMeshletsBound(meshData.Indices.size(), maxVertices, maxTriangles);
+		Array<meshopt_Meshlet> meshlets(maxMeshlets);
+		Array<uint32> meshletVertices(maxMeshlets * maxVertices);
+		Array<uint8> meshletTriangles(maxMeshlets * maxTriangles * 3);
 
-	// Trimming
-	const meshopt_Meshlet& last = meshlets[meshlet_count - 1];
-	meshletTriangles.resize(last.triangle_offset + ((last.triangle_count * 3 + 3) & ~3));
-	meshlets.resize(meshlet_count);
+		size_t meshlet_count = meshopt_buildMeshlets(meshlets.data(), meshletVertices.data(), meshletTriangles.data(),
+			meshData.Indices.data(), meshData.Indices.size(), &meshData.PositionsStream[0].x, meshData.PositionsStream.size(), sizeof(Vector3), maxVertices, maxTriangles, 0);
 
-	meshData.MeshletVertices.resize(last.vertex_offset + last.vertex_count);
-	meshData.Meshlets.resize(meshlet_count);
-	meshData.MeshletBounds.resize(meshlet_count);
-	meshData.MeshletTriangles.resize(meshletTriangles.size() / 3);
+		const meshopt_Meshlet& last = meshlets[meshlet_count - 1];
+		meshData.Meshlets.reserve(meshlet_count);
+		meshData.MeshletBounds.reserve(meshlet_count);
+		meshData.MeshletVertices.reserve(last.vertex_offset + last.vertex_count);
+		meshData.MeshletTriangles.reserve(last.triangle_offset / 3 + last.triangle_count);
 
-	uint32 triangleOffset = 0;
-	for (size_t i = 0; i < meshlet_count; ++i)
+		for (size_t i = 0; i < meshlet_count; ++i)
+		{
+			const meshopt_Meshlet& meshlet = meshlets[i];
+			AddMeshlet(&meshletVertices[meshlet.vertex_offset], meshlet.vertex_count, &meshletTriangles[meshlet.triangle_offset], meshlet.triangle_count);
+		}
+		meshData.NumFullDetailMeshlets = (uint32)meshlet_count;
+	}
+	else
 	{
-		const meshopt_Meshlet& meshlet = meshlets[i];
+		// All levels of the hierarchy are stored, the full detail level first
+		MeshletLOD::Hierarchy hierarchy;
+		MeshletLOD::Build(meshData.PositionsStream, meshData.Indices, maxVertices, maxTriangles, hierarchy);
 
-		Vector3 min = Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
-		Vector3 max = Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
-		for (uint32 k = 0; k < meshlet.triangle_count * 3; ++k)
+		Array<uint32> vertices;
+		Array<uint8> triangles;
+		for (const MeshletLOD::Cluster& cluster : hierarchy.Clusters)
 		{
-			uint32 idx = meshData.MeshletVertices[meshlet.vertex_offset + meshletTriangles[meshlet.triangle_offset + k]];
-			const Vector3& p = meshData.PositionsStream[idx];
-			max = Vector3::Max(max, p);
-			min = Vector3::Min(min, p);
+			vertices.clear();
+			triangles.clear();
+			for (uint32 index : cluster.Indices)
+			{
+				auto it = std::find(vertices.begin(), vertices.end(), index);
+				triangles.push_back((uint8)(it - vertices.begin()));
+				if (it == vertices.end())
+					vertices.push_back(index);
+			}
+			AddMeshlet(vertices.data(), (uint32)vertices.size(), triangles.data(), (uint32)cluster.Indices.size() / 3);
+
+			MeshletLOD::Node& lod = meshData.MeshletLODs.emplace_back();
+			lod.Bounds = cluster.Bounds;
+			lod.ParentBounds = cluster.ParentBounds;
+			lod.Error = cluster.Error;
+			lod.ParentError = cluster.ParentError;
+			meshData.NumFullDetailMeshlets += cluster.Level == 0;
 		}
-		ShaderInterop::Meshlet::Bounds& outBounds = meshData.MeshletBounds[i];
-		outBounds.LocalCenter = (max + min) / 2;
-		outBounds.LocalExtents = (max - min) / 2;
+	}
+}
+
+
+// Meshes with fewer triangles are always fully resident
+static constexpr uint32 MinStreamedTriangles = 4096;
+// Fraction of the triangles of the full mesh the fallback aims for
+static constexpr float FallbackTriangleRatio = 1.0f / 16.0f;
+
+// Builds the low detail version of a mesh that is rendered while its full geometry is not streamed in.
+// Returns false when the mesh is not streamed, because it is skinned, small, or does not simplify well.
+static bool BuildFallbackMeshData(const MeshData& meshData, MeshData& outFallback)
+{
+	const size_t numTriangles = meshData.Indices.size() / 3;
+	if (!meshData.WeightsStream.empty() || numTriangles < MinStreamedTriangles)
+		return false;
+
+	const float* pPositions = &meshData.PositionsStream[0].x;
+	const size_t numVertices = meshData.PositionsStream.size();
+	const size_t targetIndexCount = (size_t)(numTriangles * FallbackTriangleRatio) * 3;
+	constexpr float targetError = 0.05f;
 
-		// Encode triangles and get rid of 4 byte padding
-		unsigned char* pSourceTriangles = meshletTriangles.data() + meshlet.triangle_offset;
+	Array<uint32> indices(meshData.Indices.size());
+	float error = 0;
+	size_t indexCount = meshopt_simplify(indices.data(), meshData.Indices.data(), meshData.Indices.size(), pPositions, numVertices, sizeof(Vector3), targetIndexCount, targetError, 0, &error);
 
-		meshopt_optimizeMeshlet(&meshData.MeshletVertices[meshlet.vertex_offset], pSourceTriangles, meshlet.triangle_count, meshlet.vertex_count);
+	// Topology can keep the simplifier far from the target, the sloppy simplifier ignores it
+	if (indexCount > targetIndexCount * 2)
+		indexCount = meshopt_simplifySloppy(indices.data(), meshData.Indices.data(), meshData.Indices.size(), pPositions, numVertices, sizeof(Vector3), targetIndexCount, targetError, &error);
 
-		for (uint32 triIdx = 0; triIdx < meshlet.triangle_count; ++triIdx)
+	if (indexCount == 0 || indexCount * 4 > meshData.Indices.size())
+		return false;
+	indices.resize(indexCount);
+
+	// Keep only the vertices the simplified mesh references
+	Array<uint32> remap(numVertices);
+	const size_t numFallbackVertices = meshopt_optimizeVertexFetchRemap(remap.data(), indices.data(), indices.size(), numVertices);
+	outFallback.Indices.resize(indexCount);
+	meshopt_remapIndexBuffer(outFallback.Indices.data(), indices.data(), indexCount, remap.data());
+
+	auto RemapStream = [&](const auto& source, auto& target)
 		{
-			ShaderInterop::Meshlet::Triangle& tri = meshData.MeshletTriangles[triIdx + triangleOffset];
-			tri.V0 = *pSourceTriangles++;
-			tri.V1 = *pSourceTriangles++;
-			tri.V2 = *pSourceTriangles++;
-		}
+			if (source.empty())
+				return;
+			target.resize(numFallbackVertices);
+			meshopt_remapVertexBuffer(target.data(), source.data(), source.size(), sizeof(source[0]), remap.data());
+		};
+	RemapStream(meshData.PositionsStream, outFallback.PositionsStream);
+	RemapStream(meshData.NormalsStream, outFallback.NormalsStream);
+	RemapStream(meshData.TangentsStream, outFallback.TangentsStream);
+	RemapStream(meshData.UVsStream, outFallback.UVsStream);
+	RemapStream(meshData.ColorsStream, outFallback.ColorsStream);
 
-		ShaderInterop::Meshlet& outMeshlet = meshData.Meshlets[i];
-		outMeshlet.TriangleCount = meshlet.triangle_count;
-		outMeshlet.TriangleOffset = triangleOffset;
-		outMeshlet.VertexCount = meshlet.vertex_count;
-		outMeshlet.VertexOffset = meshlet.vertex_offset;
-		triangleOffset += meshlet.triangle_count;
-	}
-	meshData.MeshletTriangles.resize(triangleOffset);
+	BuildMeshData(outFallback);
+	return true;
 }
 
 
-static void UploadMesh(GraphicsDevice* pDevice, const MeshData& meshData, Mesh& outMesh)
+// Packs the mesh data in the final GPU layout.
+// With `quantize`, positions are stored as RGBA16_SNORM relative to the bounds of the mesh and meshlet vertices as 16-bit when they fit.
+// Skinned meshes keep float positions, because skinning writes them back as floats.
+static void CookMesh(const MeshData& meshData, CookedMesh& outMesh, Array<uint8>& outData, bool quantize = false)
 {
 	bool hasAnim = !meshData.WeightsStream.empty();
+	bool smallIndices = meshData.PositionsStream.size() < std::numeric_limits<uint16>::max();
+	bool quantizePositions = quantize && !hasAnim;
 
 	constexpr uint64 bufferAlignment = 16;
 	uint64 bufferSize = 0;
 	using TVertexPositionStream = Vector3;
+	using TQuantizedPositionStream = Vector2u;
+	using TPositionsTransform = float[3][4];
 	using TVertexNormalStream = Vector2u;
 	using TVertexColorStream = uint32;
 	using TVertexUVStream = uint32;
 	using TWeightsStream = Vector2u;
 	struct TJointsStream { uint16 Joints[4]; };
+	const uint32 indexSize = smallIndices ? sizeof(uint16) : sizeof(uint32);
+	const uint32 positionSize = quantizePositions ? sizeof(TQuantizedPositionStream) : sizeof(TVertexPositionStream);
+	const uint32 meshletVertexSize = quantize && smallIndices ? sizeof(uint16) : sizeof(uint32);
 
-	bufferSize += Math::AlignUp<uint64>(meshData.Indices.size()				* sizeof(uint32),										bufferAlignment);
-	bufferSize += Math::AlignUp<uint64>(meshData.PositionsStream.size()		* sizeof(TVertexPositionStream),						bufferAlignment);
+	bufferSize += Math::AlignUp<uint64>(meshData.Indices.size()				* indexSize,											bufferAlignment);
+	bufferSize += Math::AlignUp<uint64>(meshData.PositionsStream.size()		* positionSize,											bufferAlignment);
 	bufferSize += Math::AlignUp<uint64>(meshData.UVsStream.size()			* sizeof(TVertexUVStream),								bufferAlignment);
 	bufferSize += Math::AlignUp<uint64>(meshData.NormalsStream.size()		* sizeof(TVertexNormalStream),							bufferAlignment);
 	bufferSize += Math::AlignUp<uint64>(meshData.ColorsStream.size()		* sizeof(TVertexColorStream),							bufferAlignment);
 	bufferSize += Math::AlignUp<uint64>(meshData.JointsStream.size()		* sizeof(TJointsStream),								bufferAlignment);
 	bufferSize += Math::AlignUp<uint64>(meshData.WeightsStream.size()		* sizeof(TWeightsStream),								bufferAlignment);
 	bufferSize += Math::AlignUp<uint64>(meshData.Meshlets.size()			* sizeof(ShaderInterop::Meshlet),						bufferAlignment);
-	bufferSize += Math::AlignUp<uint64>(meshData.MeshletVertices.size()		* sizeof(uint32),										bufferAlignment);
+	bufferSize += Math::AlignUp<uint64>(meshData.MeshletVertices.size()		* meshletVertexSize,									bufferAlignment);
 	bufferSize += Math::AlignUp<uint64>(meshData.MeshletTriangles.size()	* sizeof(ShaderInterop::Meshlet::Triangle),				bufferAlignment);
 	bufferSize += Math::AlignUp<uint64>(meshData.MeshletBounds.size()		* sizeof(ShaderInterop::Meshlet::Bounds),				bufferAlignment);
 
@@ -157,46 +262,73 @@ static void UploadMesh(GraphicsDevice* pDevice, const MeshData& meshData, Mesh&
 		bufferSize += Math::AlignUp<uint64>(meshData.PositionsStream.size() * sizeof(TVertexPositionStream), bufferAlignment);
 		bufferSize += Math::AlignUp<uint64>(meshData.NormalsStream.size()	* sizeof(TVertexNormalStream), bufferAlignment);
 	}
+	if (quantizePositions)
+		bufferSize += Math::AlignUp<uint64>(sizeof(TPositionsTransform), bufferAlignment);
 
 	gAssert(bufferSize < std::numeric_limits<uint32>::max(), "Offset stored in 32-bit int");
-	Ref<Buffer> pGeometryData = pDevice->CreateBuffer(BufferDesc{ .Size = bufferSize, .ElementSize = (uint32)bufferSize, .Flags = BufferFlag::ShaderResource | BufferFlag::ByteAddress | BufferFlag::UnorderedAccess }, "Geometry Buffer");
-
-	RingBufferAllocation allocation;
-	pDevice->GetRingBuffer()->Allocate((uint32)bufferSize, allocation);
+	outData.assign(bufferSize, 0);
+	outMesh.BufferSize = bufferSize;
 
-	char* pMappedMemory = (char*)allocation.pMappedMemory;
+	uint8* pMappedMemory = outData.data();
 
 	uint64 dataOffset = 0;
-	auto CopyData = [&dataOffset, &allocation, bufferAlignment](const void* pSource, uint64 size)
+	auto CopyData = [&dataOffset, pMappedMemory, bufferAlignment](const void* pSource, uint64 size)
 		{
-			memcpy(static_cast<char*>(allocation.pMappedMemory) + dataOffset, pSource, size);
+			memcpy(pMappedMemory + dataOffset, pSource, size);
 			dataOffset = Math::AlignUp(dataOffset + size, bufferAlignment);
 		};
 
+	auto AddStream = [&dataOffset, bufferAlignment](CookedStream& stream, size_t numElements, uint32 stride)
+		{
+			stream.Offset = (uint32)dataOffset;
+			stream.NumElements = (uint32)numElements;
+			stream.Stride = stride;
+			dataOffset = Math::AlignUp(dataOffset + numElements * stride, bufferAlignment);
+		};
+
 	BoundingBox bounds;
 	bounds.CreateFromPoints(bounds, meshData.PositionsStream.size(), (DirectX::XMFLOAT3*)meshData.PositionsStream.data(), sizeof(Vector3));
-
 	outMesh.Bounds = bounds;
-	outMesh.PositionsFormat = ResourceFormat::RGB32_FLOAT;
 
+	if (quantizePositions)
+	{
+		// Flat meshes have no extent on an axis, which must not divide by 0
+		const Vector3 center = bounds.Center;
+		const Vector3 extents = Vector3::Max(bounds.Extents, Vector3(1.0e-6f));
+		outMesh.PositionsFormat = ResourceFormat::RGBA16_SNORM;
+		outMesh.QuantizationBounds = BoundingBox(center, extents);
+
+		TQuantizedPositionStream* pTarget = (TQuantizedPositionStream*)(pMappedMemory + dataOffset);
+		for (const Vector3& position : meshData.PositionsStream)
+		{
+			const Vector3 normalized = (position - center) / extents;
+			*pTarget++ = Math::Pack_RGBA16_SNORM(Vector4(normalized.x, normalized.y, normalized.z, 0.0f));
+		}
+		AddStream(outMesh.Positions, meshData.PositionsStream.size(), sizeof(TQuantizedPositionStream));
+
+		// Lets raytracing build BLAS directly from the quantized positions
+		const TPositionsTransform transform = {
+			{ extents.x, 0, 0, center.x },
+			{ 0, extents.y, 0, center.y },
+			{ 0, 0, extents.z, center.z },
+		};
+		outMesh.PositionsTransformOffset = (uint32)dataOffset;
+		CopyData(transform, sizeof(TPositionsTransform));
+	}
+	else
 	{
-		outMesh.PositionStreamLocation = VertexBufferView(pGeometryData->GetGpuHandle() + dataOffset, (uint32)meshData.PositionsStream.size(), sizeof(TVertexPositionStream), dataOffset);
 		TVertexPositionStream* pTarget = (TVertexPositionStream*)(pMappedMemory + dataOffset);
 		for (const Vector3& position : meshData.PositionsStream)
 		{
 			*pTarget++ = { position };
 		}
-		dataOffset = Math::AlignUp(dataOffset + meshData.PositionsStream.size() * sizeof(TVertexPositionStream), bufferAlignment);
+		AddStream(outMesh.Positions, meshData.PositionsStream.size(), sizeof(TVertexPositionStream));
 
 		if (hasAnim)
-		{
-			outMesh.SkinnedPositionStreamLocation = VertexBufferView(pGeometryData->GetGpuHandle() + dataOffset, (uint32)meshData.PositionsStream.size(), sizeof(TVertexPositionStream), dataOffset);
-			dataOffset = Math::AlignUp(dataOffset + meshData.PositionsStream.size() * sizeof(TVertexPositionStream), bufferAlignment);
-		}
+			AddStream(outMesh.SkinnedPositions, meshData.PositionsStream.size(), sizeof(TVertexPositionStream));
 	}
 
 	{
-		outMesh.NormalStreamLocation = VertexBufferView(pGeometryData->GetGpuHandle() + dataOffset, (uint32)meshData.NormalsStream.size(), sizeof(TVertexNormalStream), dataOffset);
 		TVertexNormalStream* pTarget = (TVertexNormalStream*)(pMappedMemory + dataOffset);
 		for (size_t i = 0; i < meshData.NormalsStream.size(); ++i)
 		{
@@ -205,93 +337,374 @@ static void UploadMesh(GraphicsDevice* pDevice, const MeshData& meshData, Mesh&
 					Math::Pack_RGB10A2_SNORM(meshData.TangentsStream.empty() ? Vector4(1, 0, 0, 1) : meshData.TangentsStream[i])
 			};
 		}
-		dataOffset = Math::AlignUp(dataOffset + meshData.NormalsStream.size() * sizeof(TVertexNormalStream), bufferAlignment);
+		AddStream(outMesh.Normals, meshData.NormalsStream.size(), sizeof(TVertexNormalStream));
 
 		if (hasAnim)
-		{
-			outMesh.SkinnedNormalStreamLocation = VertexBufferView(pGeometryData->GetGpuHandle() + dataOffset, (uint32)meshData.NormalsStream.size(), sizeof(TVertexNormalStream), dataOffset);
-			dataOffset = Math::AlignUp(dataOffset + meshData.NormalsStream.size() * sizeof(TVertexNormalStream), bufferAlignment);
-		}
+			AddStream(outMesh.SkinnedNormals, meshData.NormalsStream.size(), sizeof(TVertexNormalStream));
 	}
 
 	if (!meshData.ColorsStream.empty())
 	{
-		outMesh.ColorsStreamLocation = VertexBufferView(pGeometryData->GetGpuHandle() + dataOffset, (uint32)meshData.ColorsStream.size(), sizeof(TVertexColorStream), dataOffset);
 		TVertexColorStream* pTarget = (TVertexColorStream*)(pMappedMemory + dataOffset);
 		for (const Vector4& color : meshData.ColorsStream)
 		{
 			*pTarget++ = { Math::Pack_RGBA8_UNORM(color) };
 		}
-		dataOffset = Math::AlignUp(dataOffset + meshData.ColorsStream.size() * sizeof(TVertexColorStream), bufferAlignment);
+		AddStream(outMesh.Colors, meshData.ColorsStream.size(), sizeof(TVertexColorStream));
 	}
 
 	if (!meshData.UVsStream.empty())
 	{
-		outMesh.UVStreamLocation = VertexBufferView(pGeometryData->GetGpuHandle() + dataOffset, (uint32)meshData.UVsStream.size(), sizeof(TVertexUVStream), dataOffset);
 		TVertexUVStream* pTarget = (TVertexUVStream*)(pMappedMemory + dataOffset);
 		for (const Vector2& uv : meshData.UVsStream)
 		{
 			*pTarget++ = { Math::Pack_RG16_FLOAT(uv) };
 		}
-		dataOffset = Math::AlignUp(dataOffset + meshData.UVsStream.size() * sizeof(TVertexUVStream), bufferAlignment);
+		AddStream(outMesh.UVs, meshData.UVsStream.size(), sizeof(TVertexUVStream));
 	}
 
 	if (!meshData.JointsStream.empty())
 	{
-		outMesh.JointsStreamLocation = VertexBufferView(pGeometryData->GetGpuHandle() + dataOffset, (uint32)meshData.JointsStream.size(), sizeof(TJointsStream), dataOffset);
 		TJointsStream* pTarget = (TJointsStream*)(pMappedMemory + dataOffset);
 		for (const Vector4i& joint : meshData.JointsStream)
 		{
 			*pTarget++ = { (uint16)joint.x, (uint16)joint.y, (uint16)joint.z, (uint16)joint.w };
 		}
-		dataOffset = Math::AlignUp(dataOffset + meshData.JointsStream.size() * sizeof(TJointsStream), bufferAlignment);
+		AddStream(outMesh.Joints, meshData.JointsStream.size(), sizeof(TJointsStream));
 	}
 
 	if (!meshData.WeightsStream.empty())
 	{
-		outMesh.WeightsStreamLocation = VertexBufferView(pGeometryData->GetGpuHandle() + dataOffset, (uint32)meshData.WeightsStream.size(), sizeof(TWeightsStream), dataOffset);
 		TWeightsStream* pTarget = (TWeightsStream*)(pMappedMemory + dataOffset);
 		for (const Vector4& weight : meshData.WeightsStream)
 		{
 			*pTarget++ = { Math::Pack_RGBA16_FLOAT(weight) };
 		}
-		dataOffset = Math::AlignUp(dataOffset + meshData.WeightsStream.size() * sizeof(TWeightsStream), bufferAlignment);
+		AddStream(outMesh.Weights, meshData.WeightsStream.size(), sizeof(TWeightsStream));
 	}
 
 	{
-		bool smallIndices = meshData.PositionsStream.size() < std::numeric_limits<uint16>::max();
-		uint32 indexSize = smallIndices ? sizeof(uint16) : sizeof(uint32);
-		outMesh.IndicesLocation = IndexBufferView(pGeometryData->GetGpuHandle() + dataOffset, (uint32)meshData.Indices.size(), smallIndices ? ResourceFormat::R16_UINT : ResourceFormat::R32_UINT, dataOffset);
-		char* pTarget = (char*)(pMappedMemory + dataOffset);
+		uint8* pTarget = pMappedMemory + dataOffset;
 		for (uint32 index : meshData.Indices)
 		{
 			memcpy(pTarget, &index, indexSize);
 			pTarget += indexSize;
 		}
-		dataOffset = Math::AlignUp(dataOffset + meshData.Indices.size() * indexSize, bufferAlignment);
+		AddStream(outMesh.Indices, meshData.Indices.size(), indexSize);
 	}
 
-	outMesh.MeshletsLocation = (uint32)dataOffset;
+	outMesh.MeshletsOffset = (uint32)dataOffset;
 	CopyData(meshData.Meshlets.data(), sizeof(ShaderInterop::Meshlet) * meshData.Meshlets.size());
 
-	outMesh.MeshletVerticesLocation = (uint32)dataOffset;
-	CopyData(meshData.MeshletVertices.data(), sizeof(uint32) * meshData.MeshletVertices.size());
+	outMesh.MeshletVerticesOffset = (uint32)dataOffset;
+	outMesh.MeshletVertexStride = meshletVertexSize;
+	if (meshletVertexSize == sizeof(uint16))
+	{
+		uint16* pTarget = (uint16*)(pMappedMemory + dataOffset);
+		for (uint32 vertex : meshData.MeshletVertices)
+			*pTarget++ = (uint16)vertex;
+		dataOffset = Math::AlignUp(dataOffset + meshData.MeshletVertices.size() * sizeof(uint16), bufferAlignment);
+	}
+	else
+	{
+		CopyData(meshData.MeshletVertices.data(), sizeof(uint32) * meshData.MeshletVertices.size());
+	}
 
-	outMesh.MeshletTrianglesLocation = (uint32)dataOffset;
+	outMesh.MeshletTrianglesOffset = (uint32)dataOffset;
 	CopyData(meshData.MeshletTriangles.data(), sizeof(ShaderInterop::Meshlet::Triangle) * meshData.MeshletTriangles.size());
 
-	outMesh.MeshletBoundsLocation = (uint32)dataOffset;
+	outMesh.MeshletBoundsOffset = (uint32)dataOffset;
 	CopyData(meshData.MeshletBounds.data(), sizeof(ShaderInterop::Meshlet::Bounds) * meshData.MeshletBounds.size());
 
-	outMesh.NumMeshlets = (uint32)meshData.Meshlets.size();
+	outMesh.NumMeshlets = meshData.NumFullDetailMeshlets;
+	gAssert(dataOffset == bufferSize);
+}
+
+
+// A cooked mesh and its optional low detail fallback. Fallback.BufferSize is 0 when the mesh is not streamed.
+struct CookedMeshData
+{
+	CookedMesh		Mesh;
+	Array<uint8>	Data;
+	CookedMesh		Fallback;
+	Array<uint8>	FallbackData;
+	Array<uint8>	EncodedData;			///< Data encoded by MeshCompression for the mesh cache. Empty when the cache is not compressed
+	Array<uint8>	EncodedFallbackData;
+	Array<MeshletLOD::Node> MeshletLODs;	///< CPU-side, not part of the geometry buffer
+};
+
+
+static void CookMeshWithFallback(const MeshData& meshData, CookedMeshData& outMesh, bool quantize)
+{
+	CookMesh(meshData, outMesh.Mesh, outMesh.Data, quantize);
+	outMesh.MeshletLODs = meshData.MeshletLODs;
+
+	MeshData fallbackData;
+	if (BuildFallbackMeshData(meshData, fallbackData))
+	{
+		CookMesh(fallbackData, outMesh.Fallback, outMesh.FallbackData, quantize);
+
+		// Keep the bounds of the full mesh, so culling does not change when it streams in
+		outMesh.Fallback.Bounds = outMesh.Mesh.Bounds;
+	}
+}
 
-	outMesh.pBuffer = pGeometryData;
+
+static void UploadMesh(GraphicsDevice* pDevice, const CookedMesh& cookedMesh, const void* pData, Mesh& outMesh)
+{
+	const uint64 bufferSize = cookedMesh.BufferSize;
+	Ref<Buffer> pGeometryData = pDevice->CreateBuffer(BufferDesc{ .Size = bufferSize, .ElementSize = (uint32)bufferSize, .Flags = BufferFlag::ShaderResource | BufferFlag::ByteAddress | BufferFlag::UnorderedAccess }, "Geometry Buffer");
+
+	RingBufferAllocation allocation;
+	pDevice->GetRingBuffer()->Allocate((uint32)bufferSize, allocation);
+	memcpy(allocation.pMappedMemory, pData, bufferSize);
+
+	outMesh.SetGeometry(pGeometryData, 0, cookedMesh);
 
 	allocation.pContext->CopyBuffer(allocation.pBackingResource, pGeometryData, bufferSize, allocation.Offset, 0);
 	pDevice->GetRingBuffer()->Free(allocation);
 }
 
 
+// Uploads only the fallback. The full geometry is streamed in by the GeometryStreamer once the caller assigns its source.
+static void UploadStreamedMesh(GraphicsDevice* pDevice, const CookedMesh& fullMesh, const CookedMesh& fallbackMesh, const void* pFallbackData, Mesh& outMesh)
+{
+	UploadMesh(pDevice, fallbackMesh, pFallbackData, outMesh);
+	outMesh.Streaming.Full = fullMesh;
+	outMesh.Streaming.Fallback = fallbackMesh;
+	outMesh.Streaming.pFallbackBuffer = outMesh.pBuffer;
+}
+
+
+static void UploadMesh(GraphicsDevice* pDevice, const MeshData& meshData, Mesh& outMesh)
+{
+	CookedMesh cookedMesh;
+	Array<uint8> data;
+	CookMesh(meshData, cookedMesh, data);
+	UploadMesh(pDevice, cookedMesh, data.data(), outMesh);
+}
+
+
+/*
+	Cooked mesh cache.
+	Holds the geometry buffers of all meshes of a glTF file exactly as UploadMesh uploads them, so a warm load
+	skips decoding the accessors and running meshoptimizer.
+	With scene.CompressMeshes, the buffers are stored encoded by MeshCompression and decoded before they are uploaded.
+	With scene.MeshletLOD, the nodes of the meshlet LOD hierarchy follow the buffers of each mesh. They are read back on the CPU and never uploaded.
+	The file is keyed by a hash of the glTF content and the cook settings, and memory mapped on load.
+*/
+namespace MeshCache
+{
+	// Bump when CookedMesh, CookMesh, BuildMeshData, BuildFallbackMeshData, MeshletLOD::Build or MeshCompression change
+	constexpr uint32 Version = 6;
+	constexpr uint32 Magic = 0x4853454D;	// "MESH"
+	constexpr uint64 DataAlignment = 16;
+
+	struct Header
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint64 ContentHash;
+		uint32 NumMeshes;
+		uint32 Padding;
+	};
+
+	struct Entry
+	{
+		CookedMesh	Mesh;
+		CookedMesh	Fallback;
+		uint64		DataOffset;				///< Offset of the geometry buffer from the start of the file
+		uint64		FallbackDataOffset;		///< Offset of the fallback geometry buffer. Only valid if Fallback.BufferSize > 0
+		uint64		DataSize;				///< Size of the geometry buffer in the file. Smaller than Mesh.BufferSize when it is compressed
+		uint64		FallbackDataSize;
+		uint64		MeshletLODsOffset;		///< Offset of the MeshletLOD::Node array. Only valid if NumMeshletLODs > 0
+		uint32		NumMeshletLODs;
+		uint32		Padding;
+	};
+
+	// 64-bit FNV-1a, consuming 8 bytes per step
+	static uint64 HashBytes(uint64 hash, const void* pData, size_t size)
+	{
+		const uint8* pBytes = static_cast<const uint8*>(pData);
+		for (; size >= sizeof(uint64); size -= sizeof(uint64), pBytes += sizeof(uint64))
+		{
+			uint64 word;
+			memcpy(&word, pBytes, sizeof(uint64));
+			hash = (hash ^ word) * 0x100000001b3ull;
+		}
+		for (; size > 0; --size, ++pBytes)
+			hash = (hash ^ *pBytes) * 0x100000001b3ull;
+		return hash;
+	}
+
+	// The cook settings are part of the hash, so each combination gets its own cache file
+	static uint64 ComputeContentHash(const cgltf_data* pGltfData, bool buildMeshletLOD, bool compress)
+	{
+		uint64 hash = 0xcbf29ce484222325ull;
+		const uint32 cookSettings[] = { ShaderInterop::MESHLET_MAX_VERTICES, ShaderInterop::MESHLET_MAX_TRIANGLES, buildMeshletLOD, compress };
+		hash = HashBytes(hash, cookSettings, sizeof(cookSettings));
+		hash = HashBytes(hash, pGltfData->json, pGltfData->json_size);
+		for (const cgltf_buffer& buffer : Span(pGltfData->buffers, (uint32)pGltfData->buffers_count))
+		{
+			if (buffer.data)
+				hash = HashBytes(hash, buffer.data, buffer.size);
+		}
+		return hash;
+	}
+
+	static String GetCachePath(const char* pFilePath, uint64 contentHash)
+	{
+		return Sprintf("%s%s_%016llx.bin", Paths::MeshCacheDir().c_str(), Paths::GetFileNameWithoutExtension(pFilePath).c_str(), contentHash);
+	}
+
+	static const Entry* GetEntries(const MappedFile& file)
+	{
+		return reinterpret_cast<const Entry*>(static_cast<const uint8*>(file.GetData()) + sizeof(Header));
+	}
+
+	// Uncompressed geometry is used straight from the mapped file, so its size has to match the layout exactly
+	static bool Validate(const MappedFile& file, uint64 contentHash, uint32 numMeshes, bool compressed)
+	{
+		if (file.GetSize() < sizeof(Header))
+			return false;
+
+		const Header& header = *static_cast<const Header*>(file.GetData());
+		if (header.Magic != Magic || header.Version != Version || header.ContentHash != contentHash || header.NumMeshes != numMeshes)
+			return false;
+
+		if (sizeof(Header) + (uint64)numMeshes * sizeof(Entry) > file.GetSize())
+			return false;
+
+		for (const Entry& entry : Span<const Entry>(GetEntries(file), numMeshes))
+		{
+			if (entry.DataOffset + entry.DataSize > file.GetSize())
+				return false;
+			if (entry.Fallback.BufferSize > 0 && entry.FallbackDataOffset + entry.FallbackDataSize > file.GetSize())
+				return false;
+			if (entry.NumMeshletLODs > 0 && entry.MeshletLODsOffset + entry.NumMeshletLODs * sizeof(MeshletLOD::Node) > file.GetSize())
+				return false;
+			if (!compressed && entry.DataSize != entry.Mesh.BufferSize)
+				return false;
+			if (!compressed && entry.Fallback.BufferSize > 0 && entry.FallbackDataSize != entry.Fallback.BufferSize)
+				return false;
+		}
+		return true;
+	}
+
+	// Maps the cache file and validates it. The returned entries point into the mapped file.
+	// An invalid file is unmapped again, so it can be overwritten.
+	static bool Open(const char* pCachePath, uint64 contentHash, uint32 numMeshes, bool compressed, MappedFile& file, Span<const Entry>& outEntries)
+	{
+		if (!file.Open(pCachePath))
+			return false;
+
+		if (!Validate(file, contentHash, numMeshes, compressed))
+		{
+			file.Close();
+			return false;
+		}
+
+		outEntries = Span<const Entry>(GetEntries(file), numMeshes);
+		return true;
+	}
+
+	static bool WriteToFile(const char* pPath, uint64 contentHash, Span<const CookedMeshData> meshes, bool compressed)
+	{
+		FileStream stream;
+		if (!stream.Open(pPath, FileMode::Write | FileMode::Create))
+			return false;
+
+		constexpr uint8 padding[DataAlignment]{};
+		const uint32 numMeshes = meshes.GetSize();
+		uint64 offset = sizeof(Header) + (uint64)numMeshes * sizeof(Entry);
+
+		Header header{ Magic, Version, contentHash, numMeshes, 0 };
+		bool success = stream.Write(&header, sizeof(Header));
+
+		// Each mesh is followed by its fallback and its meshlet LOD nodes
+		uint64 dataOffset = Math::AlignUp(offset, DataAlignment);
+		for (const CookedMeshData& mesh : meshes)
+		{
+			const Array<uint8>& data = compressed ? mesh.EncodedData : mesh.Data;
+			const Array<uint8>& fallbackData = compressed ? mesh.EncodedFallbackData : mesh.FallbackData;
+			Entry entry{ mesh.Mesh, mesh.Fallback, dataOffset, 0, data.size(), fallbackData.size() };
+			dataOffset = Math::AlignUp(dataOffset + data.size(), DataAlignment);
+			entry.FallbackDataOffset = dataOffset;
+			dataOffset = Math::AlignUp(dataOffset + fallbackData.size(), DataAlignment);
+			entry.MeshletLODsOffset = dataOffset;
+			entry.NumMeshletLODs = (uint32)mesh.MeshletLODs.size();
+			dataOffset = Math::AlignUp(dataOffset + mesh.MeshletLODs.size() * sizeof(MeshletLOD::Node), DataAlignment);
+			success &= stream.Write(&entry, sizeof(Entry));
+		}
+
+		auto WriteData = [&](const void* pData, uint64 size)
+			{
+				success &= stream.Write(padding, (uint32)(Math::AlignUp(offset, DataAlignment) - offset));
+				offset = Math::AlignUp(offset, DataAlignment);
+				success &= stream.Write(pData, (uint32)size);
+				offset += size;
+			};
+		for (const CookedMeshData& mesh : meshes)
+		{
+			const Array<uint8>& data = compressed ? mesh.EncodedData : mesh.Data;
+			const Array<uint8>& fallbackData = compressed ? mesh.EncodedFallbackData : mesh.FallbackData;
+			WriteData(data.data(), data.size());
+			WriteData(fallbackData.data(), fallbackData.size());
+			WriteData(mesh.MeshletLODs.data(), mesh.MeshletLODs.size() * sizeof(MeshletLOD::Node));
+		}
+		return success;
+	}
+
+	// With `compressed`, the encoded data of the meshes is written.
+	// The file is written next to the cache and then moved into place, because the cache may still be mapped by a loaded scene.
+	static bool Write(const char* pCachePath, uint64 contentHash, Span<const CookedMeshData> meshes, bool compressed)
+	{
+		Paths::CreateDirectoryTree(pCachePath);
+		const String tempPath = Sprintf("%s.%u.tmp", pCachePath, ::GetCurrentThreadId());
+		if (!WriteToFile(tempPath.c_str(), contentHash, meshes, compressed))
+		{
+			::DeleteFileA(tempPath.c_str());
+			return false;
+		}
+
+		if (!::MoveFileExA(tempPath.c_str(), pCachePath, MOVEFILE_REPLACE_EXISTING))
+		{
+			::DeleteFileA(tempPath.c_str());
+
+			// A cache that is mapped can't be replaced. It has the same content hash, so it is still good to use.
+			MappedFile existing;
+			return existing.Open(pCachePath) && Validate(existing, contentHash, meshes.GetSize(), compressed);
+		}
+		return true;
+	}
+
+	// Delete the caches of older versions of the same source file. Files that are still mapped are skipped.
+	static void DeleteStaleFiles(const char* pFilePath, const char* pCachePath)
+	{
+		const String prefix = Paths::GetFileNameWithoutExtension(pFilePath) + "_";
+		const String cacheName = Paths::GetFileName(pCachePath);
+		const String pattern = Paths::MeshCacheDir() + prefix + "*.bin";
+
+		WIN32_FIND_DATAA findData;
+		HANDLE findHandle = ::FindFirstFileA(pattern.c_str(), &findData);
+		if (findHandle == INVALID_HANDLE_VALUE)
+			return;
+
+		do
+		{
+			// Only "<name>_<16 hex digits>.bin", so other files that start with the same name are left alone
+			const String name = findData.cFileName;
+			const String suffix = name.substr(prefix.length());
+			const bool isCache = suffix.length() == 16 + 4 && suffix.ends_with(".bin") &&
+				std::all_of(suffix.begin(), suffix.begin() + 16, [](char c) { return isxdigit((unsigned char)c) != 0; });
+			if (isCache && name != cacheName)
+				::DeleteFileA((Paths::MeshCacheDir() + name).c_str());
+		} while (::FindNextFileA(findHandle, &findData));
+		::FindClose(findHandle);
+	}
+}
+
+
 static bool LoadLdr(const char* pFilePath, GraphicsDevice* pDevice, World& world)
 {
 	LdrConfig config;
@@ -434,8 +847,102 @@ static bool LoadLdr(const char* pFilePath, GraphicsDevice* pDevice, World& world
 }
 
 
-static bool LoadGltf(const char* pFilePath, GraphicsDevice* pDevice, World& world)
+// CPU time spent in each stage of a glTF load.
+// Stages that run in tasks accumulate the time of all tasks, so they can add up to more than the total load time.
+struct GltfLoadTimings
 {
+	enum class Stage
+	{
+		Parse,
+		Animation,
+		Materials,
+		ImageDecode,
+		TextureUpload,
+		MeshCache,
+		MeshDecode,
+		MeshBuild,
+		MeshUpload,
+		Nodes,
+		Num,
+	};
+
+	static constexpr const char* StageNames[] = { "Parse", "Animation", "Materials", "Image Decode", "Texture Upload", "Mesh Cache", "Mesh Decode", "Mesh Build", "Mesh Upload", "Nodes" };
+	static_assert(ARRAYSIZE(StageNames) == (int)Stage::Num);
+
+	void Add(Stage stage, Utils::TimeScope& timer)
+	{
+		Microseconds[(int)stage] += (uint64)(timer.Stop() * 1'000'000.0f);
+	}
+
+	std::atomic<uint64> Microseconds[(int)Stage::Num]{};
+};
+
+// Reads the vertex streams and indices of a glTF primitive
+static void ReadPrimitive(const cgltf_primitive& primitive, MeshData& outMeshData)
+{
+	outMeshData.Indices.resize(primitive.indices->count);
+
+	constexpr int indexMap[] = { 0, 2, 1 };
+	for (size_t i = 0; i < primitive.indices->count; i += 3)
+	{
+		outMeshData.Indices[i + 0] = (uint32)cgltf_accessor_read_index(primitive.indices, i + indexMap[0]);
+		outMeshData.Indices[i + 1] = (uint32)cgltf_accessor_read_index(primitive.indices, i + indexMap[1]);
+		outMeshData.Indices[i + 2] = (uint32)cgltf_accessor_read_index(primitive.indices, i + indexMap[2]);
+	}
+
+	for (size_t attrIdx = 0; attrIdx < primitive.attributes_count; ++attrIdx)
+	{
+		const cgltf_attribute& attribute = primitive.attributes[attrIdx];
+		if (attribute.type == cgltf_attribute_type_position)
+		{
+			outMeshData.PositionsStream.resize(attribute.data->count);
+			gVerify(cgltf_accessor_unpack_floats(attribute.data, &outMeshData.PositionsStream[0].x, attribute.data->count * 3), > 0);
+		}
+		else if (attribute.type == cgltf_attribute_type_normal)
+		{
+			outMeshData.NormalsStream.resize(attribute.data->count);
+			gVerify(cgltf_accessor_unpack_floats(attribute.data, &outMeshData.NormalsStream[0].x, attribute.data->count * 3), > 0);
+		}
+		else if (attribute.type == cgltf_attribute_type_tangent)
+		{
+			outMeshData.TangentsStream.resize(attribute.data->count);
+			gVerify(cgltf_accessor_unpack_floats(attribute.data, &outMeshData.TangentsStream[0].x, attribute.data->count * 4), > 0);
+		}
+		else if (attribute.type == cgltf_attribute_type_texcoord && attribute.index == 0)
+		{
+			outMeshData.UVsStream.resize(attribute.data->count);
+			gVerify(cgltf_accessor_unpack_floats(attribute.data, &outMeshData.UVsStream[0].x, attribute.data->count * 2), > 0);
+		}
+		else if (attribute.type == cgltf_attribute_type_color && attribute.index == 0)
+		{
+			outMeshData.ColorsStream.resize(attribute.data->count);
+			gVerify(cgltf_accessor_unpack_floats(attribute.data, &outMeshData.ColorsStream[0].x, attribute.data->count * 4), > 0);
+		}
+		else if (attribute.type == cgltf_attribute_type_weights && attribute.index == 0)
+		{
+			outMeshData.WeightsStream.resize(attribute.data->count);
+			gVerify(cgltf_accessor_unpack_floats(attribute.data, &outMeshData.WeightsStream[0].x, attribute.data->count * 4), > 0);
+		}
+		else if (attribute.type == cgltf_attribute_type_joints && attribute.index == 0)
+		{
+			Vector4 joints;
+			outMeshData.JointsStream.resize(attribute.data->count);
+			for (int i = 0; i < attribute.data->count; ++i)
+			{
+				gVerify(cgltf_accessor_read_float(attribute.data, i, &joints.x, 4), > 0);
+				outMeshData.JointsStream[i] = Vector4i((int)joints.x, (int)joints.y, (int)joints.z, (int)joints.w);
+			}
+		}
+	}
+}
+
+
+static bool LoadGltf(const char* pFilePath, GraphicsDevice* pDevice, World& world, MeshCacheMode cacheMode)
+{
+	GltfLoadTimings timings;
+	Utils::TimeScope loadTimer;
+
+	Utils::TimeScope parseTimer;
 	cgltf_options options{};
 	cgltf_data* pGltfData = nullptr;
 	cgltf_result result = cgltf_parse_file(&options, pFilePath, &pGltfData);
@@ -451,13 +958,14 @@ static bool LoadGltf(const char* pFilePath, GraphicsDevice* pDevice, World& worl
 		return false;
 	}
 
-	// Load unique textures;
-	HashMap<const cgltf_texture*, Texture*> imageToTexture;
+	timings.Add(GltfLoadTimings::Stage::Parse, parseTimer);
+
 	HashMap<const cgltf_material*, uint32> materialToIndex;
 	materialToIndex[nullptr] = 0;
 	HashMap<const cgltf_primitive*, uint32> meshToIndex;
 
 	// Load Animations
+	Utils::TimeScope animationTimer;
 	for (const cgltf_animation& gltfAnimation : Span(pGltfData->animations, (uint32)pGltfData->animations_count))
 	{
 		Animation& animation = world.Animations.emplace_back();
@@ -561,70 +1069,68 @@ static bool LoadGltf(const char* pFilePath, GraphicsDevice* pDevice, World& worl
 		}
 	}
 
-	// Load Materials and Textures
-	for (const cgltf_material& gltfMaterial : Span(pGltfData->materials, (uint32)pGltfData->materials_count))
-	{
-		materialToIndex[&gltfMaterial] = (uint32)world.Materials.size();
-		Material& material = world.Materials.emplace_back();
-		auto RetrieveTexture = [&imageToTexture, &world, pDevice, pFilePath](const cgltf_texture_view& texture, bool srgb) -> Texture*
-			{
-				if (texture.texture)
-				{
-					auto it = imageToTexture.find(texture.texture);
-					const cgltf_image* pImage = texture.texture->image;
-					const char* pName = pImage->uri ? pImage->uri : "Material Texture";
-					Ref<Texture> pTex;
-					if (it == imageToTexture.end())
-					{
-						Image image;
-						bool validImage = false;
-						if (pImage->buffer_view)
-						{
-							MemoryStream stream(false, (char*)pImage->buffer_view->buffer->data + pImage->buffer_view->offset, (uint32)pImage->buffer_view->size);
-							validImage = image.Load(stream, pImage->mime_type);
-						}
-						else
-						{
-							FileStream stream;
-							if (stream.Open(Paths::Combine(Paths::GetDirectoryPath(pFilePath), pImage->uri).c_str(), FileMode::Read))
-							{
-								validImage = image.Load(stream, Paths::GetFileExtenstion(pImage->uri).c_str());
-							}
-						}
-
-						if (validImage)
-							pTex = GraphicsCommon::CreateTextureFromImage(pDevice, image, srgb, pName);
+	timings.Add(GltfLoadTimings::Stage::Animation, animationTimer);
 
-						if (!pTex.Get())
-						{
-							E_LOG(Warning, "GLTF - Failed to load texture '%s' for '%s'", pImage->uri, pFilePath);
-							return nullptr;
-						}
+	// Textures are requested by the materials below and loaded in parallel afterwards.
+	// Each unique texture is loaded once, with the sRGB flag of the first material slot that uses it.
+	struct TextureLoad
+	{
+		const cgltf_texture* pGltfTexture;
+		bool SRGB;
+		Ref<Texture> pTexture;
+		TaskHandle pTask;
+	};
+	Array<TextureLoad> textureLoads;
+	HashMap<const cgltf_texture*, uint32> imageToTexture;
+	auto RequestTexture = [&](const cgltf_texture_view& texture, bool srgb) -> int
+		{
+			if (!texture.texture)
+				return -1;
+			auto it = imageToTexture.find(texture.texture);
+			if (it != imageToTexture.end())
+				return (int)it->second;
+			uint32 index = (uint32)textureLoads.size();
+			imageToTexture[texture.texture] = index;
+			textureLoads.push_back(TextureLoad{ texture.texture, srgb });
+			return (int)index;
+		};
 
-						world.Textures.push_back(pTex);
-						imageToTexture[texture.texture] = world.Textures.back();
-						return world.Textures.back();
+	auto GetAlphaMode = [](cgltf_alpha_mode mode) {
+		switch (mode)
+		{
+		case cgltf_alpha_mode_blend: return MaterialAlphaMode::Blend;
+		case cgltf_alpha_mode_opaque: return MaterialAlphaMode::Opaque;
+		case cgltf_alpha_mode_mask: return MaterialAlphaMode::Masked;
+		}
+		return MaterialAlphaMode::Opaque;
+		};
 
-					}
-					return it->second;
-				}
-				return nullptr;
-			};
+	// Texture slots of a material, resolved once its textures are loaded
+	struct MaterialTextures
+	{
+		int Diffuse = -1;
+		int RoughnessMetalness = -1;
+		int Emissive = -1;
+		int Normal = -1;
+	};
 
-		auto GetAlphaMode = [](cgltf_alpha_mode mode) {
-			switch (mode)
-			{
-			case cgltf_alpha_mode_blend: return MaterialAlphaMode::Blend;
-			case cgltf_alpha_mode_opaque: return MaterialAlphaMode::Opaque;
-			case cgltf_alpha_mode_mask: return MaterialAlphaMode::Masked;
-			}
-			return MaterialAlphaMode::Opaque;
-			};
+	// Load Materials
+	Utils::TimeScope materialTimer;
+	const uint32 firstMaterial = (uint32)world.Materials.size();
+	const uint32 numMaterials = (uint32)pGltfData->materials_count;
+	world.Materials.resize(firstMaterial + numMaterials);
+	Array<MaterialTextures> materialTextures(numMaterials);
+	for (uint32 materialIndex = 0; materialIndex < numMaterials; ++materialIndex)
+	{
+		const cgltf_material& gltfMaterial = pGltfData->materials[materialIndex];
+		materialToIndex[&gltfMaterial] = firstMaterial + materialIndex;
+		Material& material = world.Materials[firstMaterial + materialIndex];
+		MaterialTextures& textures = materialTextures[materialIndex];
 
 		if (gltfMaterial.has_pbr_metallic_roughness)
 		{
-			material.pDiffuseTexture = RetrieveTexture(gltfMaterial.pbr_metallic_roughness.base_color_texture, true);
-			material.pRoughnessMetalnessTexture = RetrieveTexture(gltfMaterial.pbr_metallic_roughness.metallic_roughness_texture, false);
+			textures.Diffuse = RequestTexture(gltfMaterial.pbr_metallic_roughness.base_color_texture, true);
+			textures.RoughnessMetalness = RequestTexture(gltfMaterial.pbr_metallic_roughness.metallic_roughness_texture, false);
 			material.BaseColorFactor.x = gltfMaterial.pbr_metallic_roughness.base_color_factor[0];
 			material.BaseColorFactor.y = gltfMaterial.pbr_metallic_roughness.base_color_factor[1];
 			material.BaseColorFactor.z = gltfMaterial.pbr_metallic_roughness.base_color_factor[2];
@@ -634,7 +1140,7 @@ static bool LoadGltf(const char* pFilePath, GraphicsDevice* pDevice, World& worl
 		}
 		else if (gltfMaterial.has_pbr_specular_glossiness)
 		{
-			material.pDiffuseTexture = RetrieveTexture(gltfMaterial.pbr_specular_glossiness.diffuse_texture, true);
+			textures.Diffuse = RequestTexture(gltfMaterial.pbr_specular_glossiness.diffuse_texture, true);
 			material.RoughnessFactor = 1.0f - gltfMaterial.pbr_specular_glossiness.glossiness_factor;
 			material.BaseColorFactor.x = gltfMaterial.pbr_specular_glossiness.diffuse_factor[0];
 			material.BaseColorFactor.y = gltfMaterial.pbr_specular_glossiness.diffuse_factor[1];
@@ -643,105 +1149,252 @@ static bool LoadGltf(const char* pFilePath, GraphicsDevice* pDevice, World& worl
 		}
 		material.AlphaCutoff = gltfMaterial.alpha_mode == cgltf_alpha_mode_mask ? gltfMaterial.alpha_cutoff : 1.0f;
 		material.AlphaMode = GetAlphaMode(gltfMaterial.alpha_mode);
-		material.pEmissiveTexture = RetrieveTexture(gltfMaterial.emissive_texture, true);
+		textures.Emissive = RequestTexture(gltfMaterial.emissive_texture, true);
 		material.EmissiveFactor.x = gltfMaterial.emissive_factor[0];
 		material.EmissiveFactor.y = gltfMaterial.emissive_factor[1];
 		material.EmissiveFactor.z = gltfMaterial.emissive_factor[2];
 		if (gltfMaterial.has_emissive_strength)
 			material.EmissiveFactor *= gltfMaterial.emissive_strength.emissive_strength;
-		material.pNormalTexture = RetrieveTexture(gltfMaterial.normal_texture, false);
+		textures.Normal = RequestTexture(gltfMaterial.normal_texture, false);
 		if (gltfMaterial.name)
 			material.Name = gltfMaterial.name;
 	}
+	timings.Add(GltfLoadTimings::Stage::Materials, materialTimer);
 
-	uint32 meshCount = 0;
-	for (const cgltf_mesh& mesh : Span(pGltfData->meshes, (uint32)pGltfData->meshes_count))
-		meshCount += (uint32)mesh.primitives_count;
-
+	// Everything below runs in tasks: textures are decoded and uploaded, materials pick up their textures
+	// as soon as those are done, and meshes are uploaded as soon as each one is built.
 	TaskContext taskContext;
-	Array<MeshData> meshDatas;
-	meshDatas.reserve(meshCount);
-	Array<uint32> meshIndices;
-	meshIndices.reserve(meshCount);
+
+	// Load Textures
+	for (TextureLoad& textureLoad : textureLoads)
+	{
+		textureLoad.pTask = TaskQueue::Schedule([&, pLoad = &textureLoad](int)
+			{
+				const cgltf_image* pImage = pLoad->pGltfTexture->image;
+				const char* pName = pImage->uri ? pImage->uri : "Material Texture";
+
+				Utils::TimeScope decodeTimer;
+				Image image;
+				bool validImage = false;
+				if (pImage->buffer_view)
+				{
+					MemoryStream stream(false, (char*)pImage->buffer_view->buffer->data + pImage->buffer_view->offset, (uint32)pImage->buffer_view->size);
+					validImage = image.Load(stream, pImage->mime_type);
+				}
+				else
+				{
+					FileStream stream;
+					if (stream.Open(Paths::Combine(Paths::GetDirectoryPath(pFilePath), pImage->uri).c_str(), FileMode::Read))
+					{
+						validImage = image.Load(stream, Paths::GetFileExtenstion(pImage->uri).c_str());
+					}
+				}
+				timings.Add(GltfLoadTimings::Stage::ImageDecode, decodeTimer);
+
+				Utils::TimeScope uploadTimer;
+				if (validImage)
+					pLoad->pTexture = GraphicsCommon::CreateTextureFromImage(pDevice, image, pLoad->SRGB, pName);
+				timings.Add(GltfLoadTimings::Stage::TextureUpload, uploadTimer);
+
+				if (!pLoad->pTexture.Get())
+					E_LOG(Warning, "GLTF - Failed to load texture '%s' for '%s'", pImage->uri, pFilePath);
+			}, {}, &taskContext);
+	}
+
+	// Resolve the textures of each material once they are loaded
+	for (uint32 materialIndex = 0; materialIndex < numMaterials; ++materialIndex)
+	{
+		const MaterialTextures& textures = materialTextures[materialIndex];
+		Array<TaskHandle> textureTasks;
+		for (int slot : { textures.Diffuse, textures.RoughnessMetalness, textures.Emissive, textures.Normal })
+		{
+			if (slot >= 0)
+				textureTasks.push_back(textureLoads[slot].pTask);
+		}
+
+		TaskQueue::Schedule([&, materialIndex](int)
+			{
+				const MaterialTextures& textures = materialTextures[materialIndex];
+				auto GetTexture = [&](int slot) { return slot >= 0 ? textureLoads[slot].pTexture.Get() : nullptr; };
+
+				Material& material = world.Materials[firstMaterial + materialIndex];
+				material.pDiffuseTexture = GetTexture(textures.Diffuse);
+				material.pRoughnessMetalnessTexture = GetTexture(textures.RoughnessMetalness);
+				material.pEmissiveTexture = GetTexture(textures.Emissive);
+				material.pNormalTexture = GetTexture(textures.Normal);
+			}, textureTasks, &taskContext);
+	}
 
 	// Load Meshes
+	// Every primitive becomes a mesh, in declaration order
+	Array<const cgltf_primitive*> primitives;
 	for (const cgltf_mesh& mesh : Span(pGltfData->meshes, (uint32)pGltfData->meshes_count))
 	{
 		for (const cgltf_primitive& primitive : Span(mesh.primitives, (uint32)mesh.primitives_count))
 		{
-			uint32 meshIndex = (uint32)world.Meshes.size();
-			world.Meshes.emplace_back();
-			meshIndices.push_back(meshIndex);
-			MeshData& meshData = meshDatas.emplace_back();
-			meshToIndex[&primitive] = meshIndex;
+			meshToIndex[&primitive] = (uint32)(world.Meshes.size() + primitives.size());
+			primitives.push_back(&primitive);
+		}
+	}
+	const uint32 firstMesh = (uint32)world.Meshes.size();
+	const uint32 numMeshes = (uint32)primitives.size();
+	world.Meshes.resize(firstMesh + numMeshes);
+
+	// Large meshes only upload a low detail fallback here and stream in their full geometry when they are visible
+	const bool streamGeometry = gStreamGeometry;
+	const bool buildMeshletLOD = gMeshletLOD;
+	const bool compressMeshes = gCompressMeshes;
+
+	Utils::TimeScope cacheTimer;
+	uint64 contentHash = 0;
+	String cachePath;
+	Ref<GeometrySource> pCacheSource = new GeometrySource();
+	Span<const MeshCache::Entry> cachedMeshes;
+	if (cacheMode != MeshCacheMode::Disabled)
+	{
+		contentHash = MeshCache::ComputeContentHash(pGltfData, buildMeshletLOD, compressMeshes);
+		cachePath = MeshCache::GetCachePath(pFilePath, contentHash);
+	}
+	const bool cacheHit = cacheMode == MeshCacheMode::Enabled && MeshCache::Open(cachePath.c_str(), contentHash, numMeshes, compressMeshes, pCacheSource->File, cachedMeshes);
+	timings.Add(GltfLoadTimings::Stage::MeshCache, cacheTimer);
 
-			TaskQueue::Execute([&](int)
+	Array<CookedMeshData> cookedMeshes;
+	if (cacheHit)
+	{
+		const uint8* pCacheData = pCacheSource->GetData();
+		for (uint32 meshIndex = 0; meshIndex < numMeshes; ++meshIndex)
+		{
+			TaskQueue::Execute([&, meshIndex](int)
 				{
-					meshData.Indices.resize(primitive.indices->count);
+					const MeshCache::Entry& entry = cachedMeshes[meshIndex];
+					Mesh& mesh = world.Meshes[firstMesh + meshIndex];
+
+					const MeshletLOD::Node* pMeshletLODs = reinterpret_cast<const MeshletLOD::Node*>(pCacheData + entry.MeshletLODsOffset);
+					mesh.MeshletLODs.assign(pMeshletLODs, pMeshletLODs + entry.NumMeshletLODs);
 
-					constexpr int indexMap[] = { 0, 2, 1 };
-					for (size_t i = 0; i < primitive.indices->count; i += 3)
+					// Compressed geometry is decoded before it is uploaded. Streamed meshes decode their full geometry when it streams in.
+					Array<uint8> decodedData;
+					auto GetData = [&](const CookedMesh& layout, uint64 offset, uint64 size) -> const uint8*
+						{
+							if (!compressMeshes)
+								return pCacheData + offset;
+							Utils::TimeScope decodeTimer;
+							decodedData.resize(layout.BufferSize);
+							gVerify(MeshCompression::Decode(layout, pCacheData + offset, size, decodedData.data()), == true);
+							timings.Add(GltfLoadTimings::Stage::MeshDecode, decodeTimer);
+							return decodedData.data();
+						};
+
+					if (streamGeometry && entry.Fallback.BufferSize > 0)
+					{
+						const uint8* pFallbackData = GetData(entry.Fallback, entry.FallbackDataOffset, entry.FallbackDataSize);
+						Utils::TimeScope uploadTimer;
+						UploadStreamedMesh(pDevice, entry.Mesh, entry.Fallback, pFallbackData, mesh);
+						mesh.Streaming.pSource = pCacheSource;
+						mesh.Streaming.SourceOffset = entry.DataOffset;
+						mesh.Streaming.SourceSize = compressMeshes ? entry.DataSize : 0;
+						timings.Add(GltfLoadTimings::Stage::MeshUpload, uploadTimer);
+					}
+					else
 					{
-						meshData.Indices[i + 0] = (uint32)cgltf_accessor_read_index(primitive.indices, i + indexMap[0]);
-						meshData.Indices[i + 1] = (uint32)cgltf_accessor_read_index(primitive.indices, i + indexMap[1]);
-						meshData.Indices[i + 2] = (uint32)cgltf_accessor_read_index(primitive.indices, i + indexMap[2]);
+						const uint8* pData = GetData(entry.Mesh, entry.DataOffset, entry.DataSize);
+						Utils::TimeScope uploadTimer;
+						UploadMesh(pDevice, entry.Mesh, pData, mesh);
+						timings.Add(GltfLoadTimings::Stage::MeshUpload, uploadTimer);
 					}
+				}, taskContext);
+		}
+	}
+	else
+	{
+		cookedMeshes.resize(numMeshes);
 
-					for (size_t attrIdx = 0; attrIdx < primitive.attributes_count; ++attrIdx)
+		for (uint32 meshIndex = 0; meshIndex < numMeshes; ++meshIndex)
+		{
+			TaskQueue::Execute([&, meshIndex](int)
+				{
+					Utils::TimeScope buildTimer;
+					MeshData meshData;
+					ReadPrimitive(*primitives[meshIndex], meshData);
+					BuildMeshData(meshData, buildMeshletLOD);
+					CookedMeshData& cooked = cookedMeshes[meshIndex];
+					CookMeshWithFallback(meshData, cooked, compressMeshes);
+					if (compressMeshes && cacheMode != MeshCacheMode::Disabled)
 					{
-						const cgltf_attribute& attribute = primitive.attributes[attrIdx];
-						if (attribute.type == cgltf_attribute_type_position)
-						{
-							meshData.PositionsStream.resize(attribute.data->count);
-							gVerify(cgltf_accessor_unpack_floats(attribute.data, &meshData.PositionsStream[0].x, attribute.data->count * 3), > 0);
-						}
-						else if (attribute.type == cgltf_attribute_type_normal)
-						{
-							meshData.NormalsStream.resize(attribute.data->count);
-							gVerify(cgltf_accessor_unpack_floats(attribute.data, &meshData.NormalsStream[0].x, attribute.data->count * 3), > 0);
-						}
-						else if (attribute.type == cgltf_attribute_type_tangent)
-						{
-							meshData.TangentsStream.resize(attribute.data->count);
-							gVerify(cgltf_accessor_unpack_floats(attribute.data, &meshData.TangentsStream[0].x, attribute.data->count * 4), > 0);
-						}
-						else if (attribute.type == cgltf_attribute_type_texcoord && attribute.index == 0)
-						{
-							meshData.UVsStream.resize(attribute.data->count);
-							gVerify(cgltf_accessor_unpack_floats(attribute.data, &meshData.UVsStream[0].x, attribute.data->count * 2), > 0);
-						}
-						else if (attribute.type == cgltf_attribute_type_color && attribute.index == 0)
-						{
-							meshData.ColorsStream.resize(attribute.data->count);
-							gVerify(cgltf_accessor_unpack_floats(attribute.data, &meshData.ColorsStream[0].x, attribute.data->count * 4), > 0);
-						}
-						else if (attribute.type == cgltf_attribute_type_weights && attribute.index == 0)
-						{
-							meshData.WeightsStream.resize(attribute.data->count);
-							gVerify(cgltf_accessor_unpack_floats(attribute.data, &meshData.WeightsStream[0].x, attribute.data->count * 4), > 0);
-						}
-						else if (attribute.type == cgltf_attribute_type_joints && attribute.index == 0)
-						{
-							Vector4 joints;
-							meshData.JointsStream.resize(attribute.data->count);
-							for (int i = 0; i < attribute.data->count; ++i)
-							{
-								gVerify(cgltf_accessor_read_float(attribute.data, i, &joints.x, 4), > 0);
-								meshData.JointsStream[i] = Vector4i((int)joints.x, (int)joints.y, (int)joints.z, (int)joints.w);
-							}
-						}
+						MeshCompression::Encode(cooked.Mesh, cooked.Data.data(), cooked.EncodedData);
+						if (cooked.Fallback.BufferSize > 0)
+							MeshCompression::Encode(cooked.Fallback, cooked.FallbackData.data(), cooked.EncodedFallbackData);
 					}
-					BuildMeshData(meshData);
+					timings.Add(GltfLoadTimings::Stage::MeshBuild, buildTimer);
+
+					Utils::TimeScope uploadTimer;
+					Mesh& mesh = world.Meshes[firstMesh + meshIndex];
+					if (streamGeometry && cooked.Fallback.BufferSize > 0)
+						UploadStreamedMesh(pDevice, cooked.Mesh, cooked.Fallback, cooked.FallbackData.data(), mesh);
+					else
+						UploadMesh(pDevice, cooked.Mesh, cooked.Data.data(), mesh);
+					timings.Add(GltfLoadTimings::Stage::MeshUpload, uploadTimer);
+
+					// Copied, the cooked nodes are still written to the mesh cache
+					mesh.MeshletLODs = cooked.MeshletLODs;
 				}, taskContext);
 		}
 	}
 
 	TaskQueue::Join(taskContext);
 
-	for(uint32 i = 0; i < (uint32)meshDatas.size(); ++i)
-		UploadMesh(pDevice, meshDatas[i], world.Meshes[meshIndices[i]]);
+	// Failed textures are left out, the materials using them fall back to no texture
+	for (TextureLoad& textureLoad : textureLoads)
+	{
+		if (textureLoad.pTexture.Get())
+			world.Textures.push_back(textureLoad.pTexture);
+	}
+
+	if (!cacheHit)
+	{
+		Utils::TimeScope writeTimer;
+		bool cacheWritten = false;
+		if (cacheMode != MeshCacheMode::Disabled)
+		{
+			cacheWritten = MeshCache::Write(cachePath.c_str(), contentHash, cookedMeshes, compressMeshes);
+			if (cacheWritten)
+				MeshCache::DeleteStaleFiles(pFilePath, cachePath.c_str());
+			else
+				E_LOG(Warning, "GLTF - Failed to write mesh cache '%s'", cachePath.c_str());
+		}
+
+		// Streamed meshes page from the cache file that was just written, or from memory when there is none
+		if (streamGeometry)
+		{
+			if (cacheWritten)
+				MeshCache::Open(cachePath.c_str(), contentHash, numMeshes, compressMeshes, pCacheSource->File, cachedMeshes);
+
+			for (uint32 meshIndex = 0; meshIndex < numMeshes; ++meshIndex)
+			{
+				CookedMeshData& cooked = cookedMeshes[meshIndex];
+				if (cooked.Fallback.BufferSize == 0)
+					continue;
+
+				MeshStreamingData& streaming = world.Meshes[firstMesh + meshIndex].Streaming;
+				if (pCacheSource->File.IsOpen())
+				{
+					streaming.pSource = pCacheSource;
+					streaming.SourceOffset = cachedMeshes[meshIndex].DataOffset;
+					streaming.SourceSize = compressMeshes ? cachedMeshes[meshIndex].DataSize : 0;
+				}
+				else
+				{
+					streaming.pSource = new GeometrySource();
+					streaming.pSource->Memory = std::move(cooked.Data);
+					streaming.SourceOffset = 0;
+				}
+			}
+		}
+		timings.Add(GltfLoadTimings::Stage::MeshCache, writeTimer);
+	}
 
 	// Load Scene Nodes
+	Utils::TimeScope nodeTimer;
 	for (const cgltf_node& node : Span(pGltfData->nodes, (uint32)pGltfData->nodes_count))
 	{
 		if (node.mesh)
@@ -792,7 +1445,14 @@ static bool LoadGltf(const char* pFilePath, GraphicsDevice* pDevice, World& worl
 		}
 	}
 
+	timings.Add(GltfLoadTimings::Stage::Nodes, nodeTimer);
+
 	cgltf_free(pGltfData);
+
+	E_LOG(Info, "GLTF - Loaded '%s' in %.2f ms (%d meshes%s, %d textures, %d materials)", pFilePath, loadTimer.Stop() * 1000.0f,
+		numMeshes, cacheHit ? " from cache" : "", (uint32)textureLoads.size(), numMaterials);
+	for (int stage = 0; stage < (int)GltfLoadTimings::Stage::Num; ++stage)
+		E_LOG(Info, "\t%-16s %8.2f ms", GltfLoadTimings::StageNames[stage], timings.Microseconds[stage] / 1000.0f);
 	return true;
 }
 
@@ -806,8 +1466,296 @@ bool SceneLoader::Load(const char* pFilePath, GraphicsDevice* pDevice, World& wo
 	}
 	else
 	{
-		LoadGltf(pFilePath, pDevice, world);
+		LoadGltf(pFilePath, pDevice, world, gMeshCache ? MeshCacheMode::Enabled : MeshCacheMode::Disabled);
 	}
 	return true;
 }
 
+
+void SceneLoader::BenchmarkMeshCache(Benchmark::Context& context, const char* pFilePath, GraphicsDevice* pDevice)
+{
+	// What a load produced, to check that all modes load the same meshes
+	struct LoadResult
+	{
+		bool	Success			= false;
+		uint32	NumMeshes		= 0;
+		uint64	NumMeshlets		= 0;
+		uint64	NumVertices		= 0;
+		bool operator==(const LoadResult& rhs) const = default;
+	};
+
+	auto LoadTimed = [&](MeshCacheMode cacheMode, LoadResult& outResult)
+		{
+			World world;
+			Utils::TimeScope timer;
+			outResult.Success = LoadGltf(pFilePath, pDevice, world, cacheMode);
+			float time = timer.Stop() * 1000.0f;
+			pDevice->IdleGPU();
+
+			outResult.NumMeshes = (uint32)world.Meshes.size();
+			for (const Mesh& mesh : world.Meshes)
+			{
+				outResult.NumMeshlets += mesh.NumMeshlets;
+				outResult.NumVertices += mesh.PositionStreamLocation.Elements;
+			}
+			return time;
+		};
+
+	// Cold cooks every mesh and rewrites the cache. Warm maps the cache written by the cold load.
+	LoadResult uncachedResult, coldResult, warmResult;
+	const float uncachedTime = LoadTimed(MeshCacheMode::Disabled, uncachedResult);
+	const float coldTime = LoadTimed(MeshCacheMode::Rebuild, coldResult);
+	const float warmTime = LoadTimed(MeshCacheMode::Enabled, warmResult);
+	context.Check(uncachedResult.Success, "Failed to load '%s'", pFilePath);
+	context.Check(coldResult == uncachedResult, "The cold load produced different meshes than the load without cache");
+	context.Check(warmResult == uncachedResult, "The warm load produced different meshes than the load without cache");
+
+	E_LOG(Info, "Mesh cache benchmark - '%s'", pFilePath);
+	E_LOG(Info, "%12s | %12s | %12s | %8s", "No cache (ms)", "Cold (ms)", "Warm (ms)", "Speedup");
+	E_LOG(Info, "%12.2f | %12.2f | %12.2f | %7.2fx", uncachedTime, coldTime, warmTime, coldTime / warmTime);
+}
+
+void SceneLoader::BenchmarkMeshletLOD(Benchmark::Context& context, const char* pFilePath)
+{
+	cgltf_options options{};
+	cgltf_data* pGltfData = nullptr;
+	if (!context.Check(cgltf_parse_file(&options, pFilePath, &pGltfData) == cgltf_result_success && cgltf_load_buffers(&options, pGltfData, pFilePath) == cgltf_result_success, "GLTF - Failed to load '%s'", pFilePath))
+	{
+		cgltf_free(pGltfData);
+		return;
+	}
+
+	Array<MeshData> sourceMeshes;
+	for (const cgltf_mesh& mesh : Span(pGltfData->meshes, (uint32)pGltfData->meshes_count))
+	{
+		for (const cgltf_primitive& primitive : Span(mesh.primitives, (uint32)mesh.primitives_count))
+			ReadPrimitive(primitive, sourceMeshes.emplace_back());
+	}
+	cgltf_free(pGltfData);
+
+	const uint32 numMeshes = (uint32)sourceMeshes.size();
+	auto BuildTimed = [&](bool buildMeshletLOD, Array<MeshData>& outMeshes)
+		{
+			outMeshes = sourceMeshes;
+			Utils::TimeScope timer;
+			TaskQueue::ParallelFor(numMeshes, [&](TaskDistributeArgs args) { BuildMeshData(outMeshes[args.JobIndex], buildMeshletLOD); }, 1);
+			return timer.Stop() * 1000.0f;
+		};
+
+	Array<MeshData> flatMeshes, lodMeshes;
+	const float flatTime = BuildTimed(false, flatMeshes);
+	const float lodTime = BuildTimed(true, lodMeshes);
+
+	auto GetMeshletDataSize = [](const MeshData& meshData)
+		{
+			return meshData.Meshlets.size() * sizeof(ShaderInterop::Meshlet) +
+				meshData.MeshletVertices.size() * sizeof(uint32) +
+				meshData.MeshletTriangles.size() * sizeof(ShaderInterop::Meshlet::Triangle) +
+				meshData.MeshletBounds.size() * sizeof(ShaderInterop::Meshlet::Bounds) +
+				meshData.MeshletLODs.size() * sizeof(MeshletLOD::Node);
+		};
+
+	uint64 numTriangles = 0;
+	uint64 numFlatMeshlets = 0;
+	uint64 numLODMeshlets = 0;
+	uint64 flatSize = 0;
+	uint64 lodSize = 0;
+	uint32 numErrorViolations = 0;
+	uint32 numIncompleteMeshes = 0;
+	Array<float> meshScales(numMeshes);
+	for (uint32 i = 0; i < numMeshes; ++i)
+	{
+		const MeshData& flat = flatMeshes[i];
+		const MeshData& lod = lodMeshes[i];
+		numTriangles += flat.Indices.size() / 3;
+		numFlatMeshlets += flat.Meshlets.size();
+		numLODMeshlets += lod.Meshlets.size();
+		flatSize += GetMeshletDataSize(flat);
+		lodSize += GetMeshletDataSize(lod);
+		meshScales[i] = meshopt_simplifyScale(&lod.PositionsStream[0].x, lod.PositionsStream.size(), sizeof(Vector3));
+
+		// Errors must grow towards the roots, otherwise the cut is not watertight
+		for (const MeshletLOD::Node& meshletLOD : lod.MeshletLODs)
+			numErrorViolations += meshletLOD.ParentError < meshletLOD.Error;
+
+		// The full detail level must hold every triangle of the mesh
+		uint64 numFullDetailTriangles = 0;
+		for (uint32 meshlet = 0; meshlet < lod.NumFullDetailMeshlets; ++meshlet)
+			numFullDetailTriangles += lod.Meshlets[meshlet].TriangleCount;
+		numIncompleteMeshes += numFullDetailTriangles != lod.Indices.size() / 3;
+	}
+
+	E_LOG(Info, "Meshlet LOD benchmark - '%s' - %d meshes, %lld triangles", pFilePath, numMeshes, numTriangles);
+	E_LOG(Info, "%20s | %12s | %12s | %14s", "", "Build (ms)", "Meshlets", "Meshlet Data");
+	E_LOG(Info, "%20s | %12.2f | %12lld | %14s", "Flat", flatTime, numFlatMeshlets, Math::PrettyPrintDataSize(flatSize).c_str());
+	E_LOG(Info, "%20s | %12.2f | %12lld | %14s", "Hierarchy", lodTime, numLODMeshlets, Math::PrettyPrintDataSize(lodSize).c_str());
+
+	// Triangles in the cut of the hierarchy for a range of errors, relative to the size of each mesh
+	constexpr float relativeErrors[] = { 0.0f, 0.0001f, 0.0005f, 0.001f, 0.0025f, 0.005f, 0.01f, 0.025f, 0.05f, 0.1f };
+	E_LOG(Info, "%20s | %12s | %12s | %14s", "Error (% of size)", "Triangles", "% of full", "Meshlets");
+	for (float relativeError : relativeErrors)
+	{
+		uint64 numCutTriangles = 0;
+		uint64 numCutMeshlets = 0;
+		for (uint32 i = 0; i < numMeshes; ++i)
+		{
+			const MeshData& lod = lodMeshes[i];
+			const float threshold = relativeError * meshScales[i];
+			for (uint32 meshlet = 0; meshlet < (uint32)lod.MeshletLODs.size(); ++meshlet)
+			{
+				const MeshletLOD::Node& meshletLOD = lod.MeshletLODs[meshlet];
+				if (MeshletLOD::IsInCut(meshletLOD.Error, meshletLOD.ParentError, threshold))
+				{
+					numCutTriangles += lod.Meshlets[meshlet].TriangleCount;
+					++numCutMeshlets;
+				}
+			}
+		}
+		E_LOG(Info, "%20.2f | %12lld | %11.2f%% | %14lld", relativeError * 100.0f, numCutTriangles, 100.0 * numCutTriangles / Math::Max<uint64>(numTriangles, 1), numCutMeshlets);
+	}
+
+	context.Check(numErrorViolations == 0, "%d meshlets have a parent error smaller than their own error", numErrorViolations);
+	context.Check(numIncompleteMeshes == 0, "%d meshes have a full detail level with a different triangle count than the mesh", numIncompleteMeshes);
+}
+
+void SceneLoader::BenchmarkMeshCompression(Benchmark::Context& context, const char* pFilePath)
+{
+	cgltf_options options{};
+	cgltf_data* pGltfData = nullptr;
+	if (!context.Check(cgltf_parse_file(&options, pFilePath, &pGltfData) == cgltf_result_success && cgltf_load_buffers(&options, pGltfData, pFilePath) == cgltf_result_success, "GLTF - Failed to load '%s'", pFilePath))
+	{
+		cgltf_free(pGltfData);
+		return;
+	}
+
+	Array<MeshData> meshes;
+	for (const cgltf_mesh& mesh : Span(pGltfData->meshes, (uint32)pGltfData->meshes_count))
+	{
+		for (const cgltf_primitive& primitive : Span(mesh.primitives, (uint32)mesh.primitives_count))
+			ReadPrimitive(primitive, meshes.emplace_back());
+	}
+	cgltf_free(pGltfData);
+
+	const uint32 numMeshes = (uint32)meshes.size();
+	TaskQueue::ParallelFor(numMeshes, [&](TaskDistributeArgs args) { BuildMeshData(meshes[args.JobIndex]); }, 1);
+
+	struct CompressedMesh
+	{
+		CookedMesh		Mesh;
+		Array<uint8>	Data;
+		Array<uint8>	EncodedData;
+	};
+	auto CookTimed = [&](bool quantize, Array<CompressedMesh>& outMeshes)
+		{
+			outMeshes.resize(numMeshes);
+			Utils::TimeScope timer;
+			TaskQueue::ParallelFor(numMeshes, [&](TaskDistributeArgs args)
+				{
+					CompressedMesh& mesh = outMeshes[args.JobIndex];
+					CookMesh(meshes[args.JobIndex], mesh.Mesh, mesh.Data, quantize);
+					MeshCompression::Encode(mesh.Mesh, mesh.Data.data(), mesh.EncodedData);
+				}, 1);
+			return timer.Stop() * 1000.0f;
+		};
+
+	Array<CompressedMesh> defaultMeshes, quantizedMeshes;
+	const float defaultEncodeTime = CookTimed(false, defaultMeshes);
+	const float quantizedEncodeTime = CookTimed(true, quantizedMeshes);
+
+	uint64 numTriangles = 0;
+	for (const MeshData& mesh : meshes)
+		numTriangles += mesh.Indices.size() / 3;
+
+	// Decodes all meshes a number of times, on one thread and on all threads, and checks the result matches the cooked data
+	auto DecodeTimed = [&](const Array<CompressedMesh>& compressedMeshes, float& outSingleThreaded, float& outParallel)
+		{
+			constexpr uint32 numRepeats = 5;
+			Array<Array<uint8>> decodedData(numMeshes);
+			for (uint32 i = 0; i < numMeshes; ++i)
+				decodedData[i].resize(compressedMeshes[i].Mesh.BufferSize);
+
+			std::atomic<uint32> numErrors = 0;
+			auto Decode = [&](uint32 meshIndex)
+				{
+					const CompressedMesh& mesh = compressedMeshes[meshIndex];
+					if (!MeshCompression::Decode(mesh.Mesh, mesh.EncodedData.data(), mesh.EncodedData.size(), decodedData[meshIndex].data()) ||
+						memcmp(decodedData[meshIndex].data(), mesh.Data.data(), mesh.Data.size()) != 0)
+						++numErrors;
+				};
+
+			Utils::TimeScope singleThreadedTimer;
+			for (uint32 repeat = 0; repeat < numRepeats; ++repeat)
+			{
+				for (uint32 i = 0; i < numMeshes; ++i)
+					Decode(i);
+			}
+			outSingleThreaded = singleThreadedTimer.Stop() / numRepeats;
+
+			Utils::TimeScope parallelTimer;
+			for (uint32 repeat = 0; repeat < numRepeats; ++repeat)
+				TaskQueue::ParallelFor(numMeshes, [&](TaskDistributeArgs args) { Decode(args.JobIndex); }, 1);
+			outParallel = parallelTimer.Stop() / numRepeats;
+			return numErrors.load();
+		};
+
+	auto GetSizes = [](const Array<CompressedMesh>& compressedMeshes, uint64& outSize, uint64& outEncodedSize)
+		{
+			outSize = 0;
+			outEncodedSize = 0;
+			for (const CompressedMesh& mesh : compressedMeshes)
+			{
+				outSize += mesh.Data.size();
+				outEncodedSize += mesh.EncodedData.size();
+			}
+		};
+
+	E_LOG(Info, "Mesh compression benchmark - '%s' - %d meshes, %lld triangles", pFilePath, numMeshes, numTriangles);
+	E_LOG(Info, "%10s | %12s | %12s | %12s | %12s | %10s | %14s | %14s",
+		"", "GPU", "GPU (B/tri)", "Cache", "Cache (B/tri)", "Encode (ms)", "Decode (MB/s)", "Decode MT (MB/s)");
+
+	uint32 numErrors = 0;
+	auto Report = [&](const char* pName, const Array<CompressedMesh>& compressedMeshes, float encodeTime)
+		{
+			uint64 size, encodedSize;
+			GetSizes(compressedMeshes, size, encodedSize);
+			float singleThreadedTime, parallelTime;
+			numErrors += DecodeTimed(compressedMeshes, singleThreadedTime, parallelTime);
+			const double sizeMB = size / (1024.0 * 1024.0);
+			const double triangles = (double)Math::Max<uint64>(numTriangles, 1);
+			E_LOG(Info, "%10s | %12s | %12.2f | %12s | %12.2f | %10.2f | %14.1f | %14.1f",
+				pName,
+				Math::PrettyPrintDataSize(size).c_str(), size / triangles,
+				Math::PrettyPrintDataSize(encodedSize).c_str(), encodedSize / triangles,
+				encodeTime,
+				sizeMB / Math::Max(singleThreadedTime, FLT_MIN),
+				sizeMB / Math::Max(parallelTime, FLT_MIN));
+		};
+	Report("Default", defaultMeshes, defaultEncodeTime);
+	Report("Quantized", quantizedMeshes, quantizedEncodeTime);
+
+	// Largest position error of the quantized meshes, relative to the size of their bounds
+	float maxError = 0;
+	for (uint32 i = 0; i < numMeshes; ++i)
+	{
+		const CookedMesh& cooked = quantizedMeshes[i].Mesh;
+		if (cooked.PositionsFormat != ResourceFormat::RGBA16_SNORM)
+			continue;
+
+		const Vector3 center = cooked.QuantizationBounds.Center;
+		const Vector3 extents = cooked.QuantizationBounds.Extents;
+		const float size = Math::Max(Vector3(cooked.Bounds.Extents).Length() * 2.0f, FLT_MIN);
+		const Vector2u* pPositions = reinterpret_cast<const Vector2u*>(quantizedMeshes[i].Data.data() + cooked.Positions.Offset);
+		for (uint32 vertex = 0; vertex < cooked.Positions.NumElements; ++vertex)
+		{
+			auto Unpack = [](uint32 value) { return Math::Max((float)(int16)(value & 0xFFFF) / 32767.0f, -1.0f); };
+			const Vector2u& packed = pPositions[vertex];
+			const Vector3 position = center + Vector3(Unpack(packed.x), Unpack(packed.x >> 16), Unpack(packed.y)) * extents;
+			maxError = Math::Max(maxError, (position - meshes[i].PositionsStream[vertex]).Length() / size);
+		}
+	}
+	E_LOG(Info, "Max position error: %.5f%% of the mesh size", maxError * 100.0f);
+
+	// 16-bit quantization of the bounds is accurate to well below 0.01% of the mesh size
+	context.Check(numErrors == 0, "%d meshes did not decode to their cooked data", numErrors);
+	context.Check(maxError <= 1.0e-4f, "Quantized positions are off by up to %.5f%% of the mesh size", maxError * 100.0f);
+}
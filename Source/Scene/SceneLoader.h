@@ -2,9 +2,19 @@
 
 struct World;
 class GraphicsDevice;
+namespace Benchmark { class Context; }
 
 class SceneLoader
 {
 public:
 	static bool Load(const char* pFilePath, GraphicsDevice* pDevice, World& world);
+
+	// Loads a glTF file without, with a cold and with a warm mesh cache and logs the timings
+	static void BenchmarkMeshCache(Benchmark::Context& context, const char* pFilePath, GraphicsDevice* pDevice);
+
+	// Builds the meshes of a glTF file with and without meshlet LOD hierarchy and logs build times and triangle counts per error threshold
+	static void BenchmarkMeshletLOD(Benchmark::Context& context, const char* pFilePath);
+
+	// Cooks the meshes of a glTF file with and without quantization and logs the bytes per triangle and decode throughput of the compressed mesh cache
+	static void BenchmarkMeshCompression(Benchmark::Context& context, const char* pFilePath);
 };